@@ -0,0 +1,297 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimationCurve.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- AnimationCurve implementation
+- Segment coefficient building for constant, linear, Hermite and Bezier keys
+- Curve sampling, serialization and fitting to recorded samples
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "AnimationCurve.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAnimation
+{
+    namespace
+    {
+        // Cubic coefficients in local time u (0..h) from end values and slopes, shared by Hermite and Bezier
+        void hermiteCoefficients(float v0, float v1, float m0, float m1, float h, float& a, float& b, float& c, float& d)
+        {
+            const float invH = 1.0f / h;
+            a = (2.0f * (v0 - v1) * invH + m0 + m1) * invH * invH;
+            b = (3.0f * (v1 - v0) * invH - 2.0f * m0 - m1) * invH;
+            c = m0;
+            d = v0;
+        }
+
+        float slopeAt(const float* values, uint32_t count, uint32_t index, float sampleTime)
+        {
+            if (count < 2) return 0.0f;
+            if (index == 0) return (values[1] - values[0]) / sampleTime;
+            if (index == count - 1) return (values[count - 1] - values[count - 2]) / sampleTime;
+            return (values[index + 1] - values[index - 1]) / (2.0f * sampleTime);
+        }
+    }
+
+    void AnimationCurve::setKeys(std::vector<CurveKey> keys)
+    {
+        m_keys = std::move(keys);
+        std::stable_sort(m_keys.begin(), m_keys.end(), [](const CurveKey& a, const CurveKey& b) { return a.time < b.time; });
+
+        m_times.resize(m_keys.size());
+        for (size_t i = 0; i < m_keys.size(); i++)
+        {
+            m_times[i] = m_keys[i].time;
+        }
+        m_segments.resize(m_keys.size());
+        rebuildSegments(0, m_keys.size());
+    }
+
+    size_t AnimationCurve::setKey(size_t index, const CurveKey& key)
+    {
+        if (index >= m_keys.size()) return addKey(key);
+
+        if (key.time == m_keys[index].time)
+        {
+            m_keys[index] = key;
+
+            // Auto tangents of the neighbours depend on this key, so two segments on each side change
+            rebuildSegments(index >= 2 ? index - 2 : 0, std::min(index + 2, m_keys.size()));
+            return index;
+        }
+
+        removeKey(index);
+        return addKey(key);
+    }
+
+    size_t AnimationCurve::addKey(const CurveKey& key)
+    {
+        const size_t index = static_cast<size_t>(std::upper_bound(m_times.begin(), m_times.end(), key.time) - m_times.begin());
+        m_keys.insert(m_keys.begin() + index, key);
+        m_times.insert(m_times.begin() + index, key.time);
+        m_segments.insert(m_segments.begin() + index, Segment{});
+
+        rebuildSegments(index >= 2 ? index - 2 : 0, std::min(index + 2, m_keys.size()));
+        return index;
+    }
+
+    void AnimationCurve::removeKey(size_t index)
+    {
+        if (index >= m_keys.size()) return;
+
+        m_keys.erase(m_keys.begin() + index);
+        m_times.erase(m_times.begin() + index);
+        m_segments.erase(m_segments.begin() + index);
+
+        rebuildSegments(index >= 2 ? index - 2 : 0, std::min(index + 1, m_keys.size()));
+    }
+
+    void AnimationCurve::clear()
+    {
+        m_keys.clear();
+        m_times.clear();
+        m_segments.clear();
+    }
+
+    float AnimationCurve::getAutoTangent(size_t key) const
+    {
+        const size_t count = m_keys.size();
+        if (count < 2) return 0.0f;
+
+        const size_t previous = key == 0 ? 0 : key - 1;
+        const size_t next = key + 1 >= count ? count - 1 : key + 1;
+        const float span = m_keys[next].time - m_keys[previous].time;
+        return span > 0.0f ? (m_keys[next].value - m_keys[previous].value) / span : 0.0f;
+    }
+
+    AnimationCurve::Segment AnimationCurve::buildSegment(size_t key) const
+    {
+        const CurveKey& start = m_keys[key];
+        Segment segment{ 0.0f, 0.0f, 0.0f, start.value };
+
+        // The last key, and keys sharing a time with the next one, hold their value
+        if (key + 1 >= m_keys.size()) return segment;
+        const CurveKey& end = m_keys[key + 1];
+        const float h = end.time - start.time;
+        if (h <= 0.0f) return segment;
+
+        switch (start.interpolation)
+        {
+        case CurveInterpolation::Constant:
+            break;
+        case CurveInterpolation::Linear:
+            segment.c = (end.value - start.value) / h;
+            break;
+        case CurveInterpolation::Hermite:
+            hermiteCoefficients(start.value, end.value, getAutoTangent(key), getAutoTangent(key + 1), h,
+                segment.a, segment.b, segment.c, segment.d);
+            break;
+        case CurveInterpolation::Bezier:
+        {
+            // Handles sit at a third of the segment, control values v0 + out * h / 3 and v1 - in * h / 3
+            const float control0 = start.value + start.outTangent * h / 3.0f;
+            const float control1 = end.value - end.inTangent * h / 3.0f;
+            hermiteCoefficients(start.value, end.value, 3.0f * (control0 - start.value) / h, 3.0f * (end.value - control1) / h, h,
+                segment.a, segment.b, segment.c, segment.d);
+            break;
+        }
+        }
+        return segment;
+    }
+
+    void AnimationCurve::rebuildSegments(size_t firstKey, size_t lastKey)
+    {
+        for (size_t key = firstKey; key < lastKey && key < m_keys.size(); key++)
+        {
+            m_segments[key] = buildSegment(key);
+        }
+    }
+
+    size_t AnimationCurve::findSegment(float time) const
+    {
+        const size_t upper = static_cast<size_t>(std::upper_bound(m_times.begin(), m_times.end(), time) - m_times.begin());
+        return upper == 0 ? 0 : upper - 1;
+    }
+
+    float AnimationCurve::sample(float time) const
+    {
+        if (m_segments.empty()) return 0.0f;
+
+        const size_t segment = findSegment(time);
+        return m_segments[segment].evaluate(std::max(0.0f, time - m_times[segment]));
+    }
+
+    void AnimationCurve::sampleRange(float startTime, float step, uint32_t count, float* out) const
+    {
+        if (m_segments.empty())
+        {
+            std::fill(out, out + count, 0.0f);
+            return;
+        }
+
+        // Times only move forward, so the segment cursor only ever advances
+        size_t segment = findSegment(startTime);
+        const size_t lastSegment = m_segments.size() - 1;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float time = startTime + step * static_cast<float>(i);
+            while (segment < lastSegment && m_times[segment + 1] <= time)
+            {
+                segment++;
+            }
+            out[i] = m_segments[segment].evaluate(std::max(0.0f, time - m_times[segment]));
+        }
+    }
+
+    AnimationCurve AnimationCurve::fitSamples(const float* values, uint32_t count, float sampleTime, float tolerance)
+    {
+        if (count == 0 || sampleTime <= 0.0f)
+        {
+            return AnimationCurve();
+        }
+
+        std::vector<uint8_t> kept(count, 0);
+        kept[0] = 1;
+        kept[count - 1] = 1;
+
+        // Split the span at the worst sample until every span fits within the tolerance
+        std::vector<std::pair<uint32_t, uint32_t>> spans;
+        if (count > 2) spans.emplace_back(0, count - 1);
+        while (!spans.empty())
+        {
+            auto [first, last] = spans.back();
+            spans.pop_back();
+
+            const float h = static_cast<float>(last - first) * sampleTime;
+            float a, b, c, d;
+            hermiteCoefficients(values[first], values[last], slopeAt(values, count, first, sampleTime),
+                slopeAt(values, count, last, sampleTime), h, a, b, c, d);
+
+            uint32_t worst = first;
+            float worstError = tolerance;
+            for (uint32_t i = first + 1; i < last; i++)
+            {
+                const float u = static_cast<float>(i - first) * sampleTime;
+                const float error = std::fabs(((a * u + b) * u + c) * u + d - values[i]);
+                if (error > worstError)
+                {
+                    worstError = error;
+                    worst = i;
+                }
+            }
+
+            if (worst != first)
+            {
+                kept[worst] = 1;
+                if (worst - first > 1) spans.emplace_back(first, worst);
+                if (last - worst > 1) spans.emplace_back(worst, last);
+            }
+        }
+
+        std::vector<CurveKey> keys;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!kept[i]) continue;
+
+            const float slope = slopeAt(values, count, i, sampleTime);
+            keys.push_back({ static_cast<float>(i) * sampleTime, values[i], slope, slope, CurveInterpolation::Bezier });
+        }
+        return AnimationCurve(std::move(keys));
+    }
+
+    void AnimationCurve::serialize(rapidjson::Value& out, rapidjson::Document::AllocatorType& allocator) const
+    {
+        // Compact [time, value, in, out, interpolation] arrays, one per key
+        out.SetArray();
+        out.Reserve(static_cast<rapidjson::SizeType>(m_keys.size()), allocator);
+        for (const auto& key : m_keys)
+        {
+            rapidjson::Value keyValue(rapidjson::kArrayType);
+            keyValue.PushBack(key.time, allocator);
+            keyValue.PushBack(key.value, allocator);
+            keyValue.PushBack(key.inTangent, allocator);
+            keyValue.PushBack(key.outTangent, allocator);
+            keyValue.PushBack(static_cast<unsigned>(key.interpolation), allocator);
+            out.PushBack(keyValue, allocator);
+        }
+    }
+
+    bool AnimationCurve::deserialize(const rapidjson::Value& in)
+    {
+        if (!in.IsArray()) return false;
+
+        std::vector<CurveKey> keys;
+        keys.reserve(in.Size());
+        for (const auto& keyValue : in.GetArray())
+        {
+            if (!keyValue.IsArray() || keyValue.Size() < 5) return false;
+            for (rapidjson::SizeType i = 0; i < 5; i++)
+            {
+                if (!keyValue[i].IsNumber()) return false;
+            }
+
+            CurveKey key;
+            key.time = keyValue[0].GetFloat();
+            key.value = keyValue[1].GetFloat();
+            key.inTangent = keyValue[2].GetFloat();
+            key.outTangent = keyValue[3].GetFloat();
+            key.interpolation = static_cast<CurveInterpolation>(static_cast<int>(std::clamp(keyValue[4].GetDouble(), 0.0, 3.0)));
+            keys.push_back(key);
+        }
+
+        // Coefficients are built once here, sampling never looks at the key types
+        setKeys(std::move(keys));
+        return true;
+    }
+}
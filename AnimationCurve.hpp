@@ -0,0 +1,127 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimationCurve.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- CurveKey with tangents and per segment interpolation
+- AnimationCurve class precomputing every segment into cubic coefficients
+- Key reduction turning dense recorded samples into a sparse curve
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAnimation
+{
+    // How the segment that starts at a key is interpolated
+    enum class CurveInterpolation : uint8_t
+    {
+        Constant,   // Holds the key value until the next key
+        Linear,
+        Hermite,    // Smooth, tangents computed from the neighbouring keys
+        Bezier      // Smooth, tangents authored on the keys (in and out may differ)
+    };
+
+    struct CurveKey
+    {
+        float time = 0.0f;                  // Seconds
+        float value = 0.0f;
+        float inTangent = 0.0f;             // Slope arriving at the key, Bezier only
+        float outTangent = 0.0f;            // Slope leaving the key, Bezier only
+        CurveInterpolation interpolation = CurveInterpolation::Hermite;
+    };
+
+    /**
+     * @brief One animated float channel made of keys
+     *
+     * This class handles:
+     * 1. Keeping the keys sorted and turning each segment into v(u) = ((a*u + b)*u + c)*u + d,
+     *    u being the time since the segment's first key, whenever keys are set, edited or loaded
+     * 2. Sampling with a binary search and one Horner evaluation, whatever the key types
+     * 3. Sampling consecutive times with a moving cursor instead of a search per sample
+     * 4. Fitting a sparse curve to dense recorded samples within a tolerance
+     *
+     * Editing one key only rebuilds the segments next to it.
+    */
+    class AnimationCurve
+    {
+    public:
+        AnimationCurve() = default;
+        explicit AnimationCurve(std::vector<CurveKey> keys) { setKeys(std::move(keys)); }
+
+        void setKeys(std::vector<CurveKey> keys);
+
+        /**
+         * @brief Replaces a key, moving it if its time changed
+         * @param index Index of the key
+         * @param key New key
+         * @return New index of the key
+        */
+        size_t setKey(size_t index, const CurveKey& key);
+
+        size_t addKey(const CurveKey& key);
+        void removeKey(size_t index);
+        void clear();
+
+        /**
+         * @brief Samples the curve, clamped to the first and last key
+         * @param time Time in seconds
+         * @return Value at that time, 0 for an empty curve
+        */
+        float sample(float time) const;
+
+        /**
+         * @brief Samples count evenly spaced times
+         * @param startTime First time
+         * @param step Time between samples, must not be negative
+         * @param count Number of samples
+         * @param out Receives count values
+        */
+        void sampleRange(float startTime, float step, uint32_t count, float* out) const;
+
+        /**
+         * @brief Fits a curve to evenly spaced samples, e.g. a dense recording
+         * @param values Sampled values
+         * @param count Number of samples
+         * @param sampleTime Time between two samples
+         * @param tolerance Largest error allowed at any sample
+         * @return Curve with Bezier keys at the samples that had to be kept
+        */
+        static AnimationCurve fitSamples(const float* values, uint32_t count, float sampleTime, float tolerance);
+
+        void serialize(rapidjson::Value& out, rapidjson::Document::AllocatorType& allocator) const;
+        bool deserialize(const rapidjson::Value& in);
+
+        const std::vector<CurveKey>& getKeys() const { return m_keys; }
+        size_t getKeyCount() const { return m_keys.size(); }
+        bool empty() const { return m_keys.empty(); }
+        float getStartTime() const { return m_keys.empty() ? 0.0f : m_keys.front().time; }
+        float getEndTime() const { return m_keys.empty() ? 0.0f : m_keys.back().time; }
+
+    private:
+        struct Segment
+        {
+            float a, b, c, d;
+
+            float evaluate(float u) const { return ((a * u + b) * u + c) * u + d; }
+        };
+
+        void rebuildSegments(size_t firstKey, size_t lastKey);
+        Segment buildSegment(size_t key) const;
+        float getAutoTangent(size_t key) const;
+        size_t findSegment(float time) const;
+
+        std::vector<CurveKey>   m_keys;
+        std::vector<float>      m_times;        // Key times, kept apart for the search
+        std::vector<Segment>    m_segments;     // One per key, the last one holds the final value
+    };
+}
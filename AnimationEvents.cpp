@@ -0,0 +1,233 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimationEvents.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- AnimationEventNames interning and per clip id caching
+- AnimationEventDispatcher subscription bookkeeping and batched delivery
+- Default event logging and unsubscription of destroyed entities
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "AnimationEvents.hpp"
+
+#include <algorithm>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAnimation
+{
+    std::unordered_map<std::string, AnimationEventId>                           AnimationEventNames::s_ids;
+    std::deque<std::string>                                                     AnimationEventNames::s_names;
+    std::unordered_map<const TeaGraphics::AnimationClipAsset*, AnimationEventNames::ClipEventIds> AnimationEventNames::s_clips;
+    size_t                                                                      AnimationEventNames::s_clipPruneSize = AnimationEventNames::MinPruneSize;
+    std::mutex                                                                  AnimationEventNames::s_mutex;
+
+    namespace
+    {
+        AnimationEventId internLocked(std::unordered_map<std::string, AnimationEventId>& ids, std::deque<std::string>& names,
+            std::string_view name)
+        {
+            auto it = ids.find(std::string(name));
+            if (it != ids.end())
+            {
+                return it->second;
+            }
+
+            const AnimationEventId id = static_cast<AnimationEventId>(names.size());
+            names.emplace_back(name);
+            ids.emplace(names.back(), id);
+            return id;
+        }
+    }
+
+    AnimationEventId AnimationEventNames::intern(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return internLocked(s_ids, s_names, name);
+    }
+
+    const std::string& AnimationEventNames::getName(AnimationEventId id)
+    {
+        static const std::string s_unknown = "<Unknown Event>";
+
+        // Names are only ever appended and the deque never moves them, only the lookup needs the lock
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return id < s_names.size() ? s_names[id] : s_unknown;
+    }
+
+    std::shared_ptr<const std::vector<AnimationEventId>> AnimationEventNames::getClipEventIds(const std::shared_ptr<const TeaGraphics::AnimationClipAsset>& clip)
+    {
+        static const auto s_noEvents = std::make_shared<const std::vector<AnimationEventId>>();
+        if (!clip) return s_noEvents;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        // Entries of freed clips are swept once the map doubled since the last sweep
+        if (s_clips.size() >= s_clipPruneSize && s_clips.find(clip.get()) == s_clips.end())
+        {
+            for (auto it = s_clips.begin(); it != s_clips.end();)
+            {
+                it = it->second.clip.expired() ? s_clips.erase(it) : std::next(it);
+            }
+            s_clipPruneSize = std::max(MinPruneSize, s_clips.size() * 2);
+        }
+
+        // The weak pointer tells a live clip from a new clip allocated at the same address
+        ClipEventIds& entry = s_clips[clip.get()];
+        if (entry.ids && entry.clip.lock() == clip && entry.ids->size() == clip->events.size())
+        {
+            return entry.ids;
+        }
+
+        // A new vector rather than refilling the old one, callers may still be reading it
+        auto ids = std::make_shared<std::vector<AnimationEventId>>();
+        ids->reserve(clip->events.size());
+        for (const auto& event : clip->events)
+        {
+            ids->push_back(internLocked(s_ids, s_names, event.eventName));
+        }
+        entry.clip = clip;
+        entry.ids = std::move(ids);
+        return entry.ids;
+    }
+
+    void AnimationEventNames::forgetClip(const TeaGraphics::AnimationClipAsset* clip)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_clips.erase(clip);
+    }
+
+    AnimationEventDispatcher::~AnimationEventDispatcher()
+    {
+        detach();
+    }
+
+    void AnimationEventDispatcher::attach(entt::registry& registry)
+    {
+        detach();
+        m_registry = &registry;
+        registry.on_destroy<entt::entity>().connect<&AnimationEventDispatcher::onEntityDestroy>(*this);
+    }
+
+    void AnimationEventDispatcher::detach()
+    {
+        if (m_registry)
+        {
+            m_registry->on_destroy<entt::entity>().disconnect<&AnimationEventDispatcher::onEntityDestroy>(*this);
+            m_registry = nullptr;
+        }
+    }
+
+    void AnimationEventDispatcher::logEvents(const FiredAnimationEvent* events, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            TEA_INFO("Triggering event: {0} at frame {1}", AnimationEventNames::getName(events[i].eventId), events[i].frame);
+        }
+    }
+
+    AnimationEventDispatcher::ScriptTypeId AnimationEventDispatcher::registerScriptType(const std::string& typeName)
+    {
+        auto it = m_scriptTypeIds.find(typeName);
+        if (it != m_scriptTypeIds.end())
+        {
+            return it->second;
+        }
+
+        const ScriptTypeId scriptType = static_cast<ScriptTypeId>(m_scriptTypeNames.size());
+        m_scriptTypeNames.push_back(typeName);
+        m_scriptTypeIds.emplace(typeName, scriptType);
+        m_batches.emplace_back();
+        return scriptType;
+    }
+
+    void AnimationEventDispatcher::subscribe(entt::entity entity, ScriptTypeId scriptType)
+    {
+        // flush() indexes the batches by script type, an id that was never registered has none
+        if (scriptType >= m_batches.size())
+        {
+            TEA_WARNING("AnimationEventDispatcher: script type {0} is not registered, the subscription is ignored", scriptType);
+            return;
+        }
+
+        auto& types = m_subscriptions[entity];
+        if (std::find(types.begin(), types.end(), scriptType) == types.end())
+        {
+            types.push_back(scriptType);
+        }
+    }
+
+    void AnimationEventDispatcher::unsubscribe(entt::entity entity, ScriptTypeId scriptType)
+    {
+        auto it = m_subscriptions.find(entity);
+        if (it == m_subscriptions.end()) return;
+
+        auto& types = it->second;
+        types.erase(std::remove(types.begin(), types.end(), scriptType), types.end());
+        if (types.empty())
+        {
+            m_subscriptions.erase(it);
+        }
+    }
+
+    void AnimationEventDispatcher::unsubscribeAll(entt::entity entity)
+    {
+        m_subscriptions.erase(entity);
+    }
+
+    void AnimationEventDispatcher::flush()
+    {
+        m_lastBatchCount = 0;
+        if (m_frameEvents.empty()) return;
+
+        // Without a batch handler (edit mode, no scripting) the default handler logs them
+        if (!m_handler)
+        {
+            if (m_defaultHandler)
+            {
+                m_defaultHandler(m_frameEvents.data(), m_frameEvents.size());
+            }
+        }
+        else
+        {
+            for (const auto& event : m_frameEvents)
+            {
+                auto it = m_subscriptions.find(event.entity);
+                if (it == m_subscriptions.end()) continue;
+
+                for (ScriptTypeId scriptType : it->second)
+                {
+                    m_batches[scriptType].push_back(event);
+                }
+            }
+
+            for (ScriptTypeId scriptType = 0; scriptType < m_batches.size(); scriptType++)
+            {
+                auto& batch = m_batches[scriptType];
+                if (batch.empty()) continue;
+
+                m_handler(scriptType, batch.data(), batch.size());
+                m_lastBatchCount++;
+                batch.clear();
+            }
+        }
+
+        m_frameEvents.clear();
+    }
+
+    void AnimationEventDispatcher::clear()
+    {
+        m_frameEvents.clear();
+        for (auto& batch : m_batches)
+        {
+            batch.clear();
+        }
+        m_subscriptions.clear();
+        m_lastBatchCount = 0;
+    }
+}
@@ -0,0 +1,184 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimationEvents.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- AnimationEventNames interning event names into ids when clips are loaded
+- FiredAnimationEvent records collected during a frame
+- AnimationEventDispatcher delivering the frame's events in one batch per script type
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "../Graphics/AnimationClip.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAnimation
+{
+    using AnimationEventId = uint32_t;
+
+    /**
+     * @brief Global table of interned animation event names
+     *
+     * This class handles:
+     * 1. Turning an event name into a small id, once per distinct name
+     * 2. Caching the ids of every event of a clip, parallel to clip->events, until the clip is freed
+    */
+    class AnimationEventNames
+    {
+    public:
+        static constexpr AnimationEventId InvalidId = 0xFFFFFFFF;
+
+        static AnimationEventId intern(std::string_view name);
+        static const std::string& getName(AnimationEventId id);
+
+        /**
+         * @brief Gets the ids of a clip's events, interning them on first use
+         * @param clip Loaded clip
+         * @return Ids parallel to clip->events, never nullptr. Shared so they stay valid while another
+         *         thread re-interns the clip
+        */
+        static std::shared_ptr<const std::vector<AnimationEventId>> getClipEventIds(const std::shared_ptr<const TeaGraphics::AnimationClipAsset>& clip);
+
+        /**
+         * @brief Drops the cached ids of a clip after its events were added, removed or renamed
+         * @param clip Edited clip
+        */
+        static void forgetClip(const TeaGraphics::AnimationClipAsset* clip);
+
+    private:
+        static constexpr size_t MinPruneSize = 64;
+
+        struct ClipEventIds
+        {
+            std::weak_ptr<const TeaGraphics::AnimationClipAsset> clip;
+            std::shared_ptr<const std::vector<AnimationEventId>> ids;
+        };
+
+        static std::unordered_map<std::string, AnimationEventId>                        s_ids;
+        static std::deque<std::string>                                                  s_names;            // Deque so getName references survive interning
+        static std::unordered_map<const TeaGraphics::AnimationClipAsset*, ClipEventIds> s_clips;
+        static size_t                                                                   s_clipPruneSize;    // Freed clips are swept once s_clips reaches it
+        static std::mutex                                                               s_mutex;
+    };
+
+    /**
+     * @brief One event fired by an animator this frame
+    */
+    struct FiredAnimationEvent
+    {
+        entt::entity entity;
+        AnimationEventId eventId;
+        int32_t frame;
+    };
+
+    /**
+     * @brief Collects fired animation events and hands them to scripts once per frame
+     *
+     * This class handles:
+     * 1. Buffering (entity, event id, frame) records as animators fire events
+     * 2. Tracking which script types on an entity listen to animation events
+     * 3. Grouping the frame's events by script type and making one handler call per type
+     * 4. Logging the events when no batch handler is installed (edit mode, no scripting)
+     * 5. Dropping the subscriptions of destroyed entities through the attached registry
+     *
+     * The scripting runtime installs the batch handler and subscribes script instances as
+     * they are created, so a crowd full of footsteps costs one managed call per script type.
+    */
+    class AnimationEventDispatcher
+    {
+    public:
+        using ScriptTypeId = uint32_t;
+
+        /**
+         * @brief Receives every event of one script type for the frame
+         * @param scriptType Script type the events are for
+         * @param events Events of every subscribed entity, in the order they fired
+         * @param count Number of events
+        */
+        using BatchHandler = std::function<void(ScriptTypeId scriptType, const FiredAnimationEvent* events, size_t count)>;
+
+        // Receives every event of the frame while no batch handler is installed
+        using DefaultHandler = std::function<void(const FiredAnimationEvent* events, size_t count)>;
+
+        AnimationEventDispatcher() = default;
+        ~AnimationEventDispatcher();
+
+        AnimationEventDispatcher(const AnimationEventDispatcher&) = delete;
+        AnimationEventDispatcher& operator=(const AnimationEventDispatcher&) = delete;
+
+        /**
+         * @brief Unsubscribes entities of a registry as they are destroyed
+         * @param registry Registry the subscribed entities live in, attach again after it is replaced
+        */
+        void attach(entt::registry& registry);
+        void detach();
+
+        ScriptTypeId registerScriptType(const std::string& typeName);
+        const std::string& getScriptTypeName(ScriptTypeId scriptType) const { return m_scriptTypeNames[scriptType]; }
+
+        /**
+         * @brief Delivers the animation events of an entity to a script type
+         * @param entity Entity whose animator fires the events
+         * @param scriptType Id returned by registerScriptType, other ids are ignored
+        */
+        void subscribe(entt::entity entity, ScriptTypeId scriptType);
+        void unsubscribe(entt::entity entity, ScriptTypeId scriptType);
+        void unsubscribeAll(entt::entity entity);
+
+        void setBatchHandler(BatchHandler handler) { m_handler = std::move(handler); }
+
+        // Replaces the logging done without a batch handler, nullptr drops those events
+        void setDefaultHandler(DefaultHandler handler) { m_defaultHandler = std::move(handler); }
+
+        // Default handler, logs every event with its name and frame
+        static void logEvents(const FiredAnimationEvent* events, size_t count);
+
+        /**
+         * @brief Records a fired event
+         * @param entity Entity whose animator fired the event
+         * @param eventId Interned event name
+         * @param frame Clip frame of the event
+        */
+        void push(entt::entity entity, AnimationEventId eventId, int32_t frame) { m_frameEvents.push_back({ entity, eventId, frame }); }
+
+        /**
+         * @brief Delivers the events collected this frame, one handler call per script type, then clears them
+        */
+        void flush();
+
+        void clear();
+
+        const std::vector<FiredAnimationEvent>& getFrameEvents() const { return m_frameEvents; }
+        uint32_t getLastBatchCount() const { return m_lastBatchCount; }
+
+    private:
+        void onEntityDestroy(entt::registry& registry, entt::entity entity) { unsubscribeAll(entity); }
+
+        std::vector<FiredAnimationEvent>                                m_frameEvents;
+        std::vector<std::vector<FiredAnimationEvent>>                   m_batches;              // Per script type, capacity reused every frame
+        std::unordered_map<entt::entity, std::vector<ScriptTypeId>>     m_subscriptions;
+        std::unordered_map<std::string, ScriptTypeId>                   m_scriptTypeIds;
+        std::vector<std::string>                                        m_scriptTypeNames;
+        BatchHandler                                                    m_handler;
+        DefaultHandler                                                  m_defaultHandler = &AnimationEventDispatcher::logEvents;
+        entt::registry*                                                 m_registry = nullptr;
+        uint32_t                                                        m_lastBatchCount = 0;
+    };
+}
@@ -20,6 +20,10 @@ the TeaEditor environment.
 #include "Asset/assetImporter.hpp"
 #include "Asset/AssetManager.hpp"
 #include "Asset/Prefab.hpp"
+#include "Graphics/AnimatorStateMachine.hpp"
+#include "Graphics/PoseCache.hpp"
+#include "Graphics/ClipLibrary.hpp"
+#include "Graphics/AnimationEvents.hpp"
 #include "Graphics/Picking.hpp"
 #include "Assetbrowser.hpp"
 
@@ -73,8 +77,27 @@ namespace TeaEditor {
 				ImGui::TextColored(ImVec4(1, 0, 0, 1), "Failed to save animation clip!");
 			}
 
+			if (m_isSavingClip)
+			{
+				ImGui::TextDisabled("Saving animation clip...");
+			}
+
+			// The save coroutine finished, the popup can only be closed from inside it
+			if (m_clipSaveFinished)
+			{
+				m_clipSaveFinished = false;
+				AssetBrowser::isPopUpActive = false;
+
+				// Reset stuff
+				showClipNameError = false;
+				showClipNameDuplicate = false;
+				showClipNameWriteError = false;
+				memset(animClipName, 0, sizeof(animClipName));
+				ImGui::CloseCurrentPopup();
+			}
+
 			ImGui::Separator();
-			bool saveAlready = false;
+			ImGui::BeginDisabled(m_isSavingClip);
 			if (ImGui::Button("Save", ImVec2(120, 0)))
 			{
 				std::cout << "Save button clicked" << std::endl;
@@ -94,21 +117,12 @@ namespace TeaEditor {
 					}
 					else
 					{
-						if (newClip.saveToFile())
-						{
-							showClipNameError = false;
-							showClipNameDuplicate = false;
-							showClipNameWriteError = false;
-							saveAlready = true;
-							std::cout << "Clip saved successfully" << std::endl;
-						}
-						else
-						{
-							showClipNameError = false;
-							showClipNameDuplicate = false;
-							showClipNameWriteError = true;
-							std::cout << "Failed to save clip" << std::endl;
-						}
+						// Save, refresh the handle and update the clip list without blocking the editor
+						showClipNameError = false;
+						showClipNameDuplicate = false;
+						showClipNameWriteError = false;
+						m_isSavingClip = true;
+						btEngine::spawn(saveNewClipAsync(clipName, m_HierarchyPanel.getSelectedEntity()), "Save animation clip");
 					}
 				}
 				else
@@ -116,27 +130,6 @@ namespace TeaEditor {
 					showClipNameError = true;
 					std::cout << "No name entered" << std::endl;
 				}
-
-
-				if (saveAlready) {
-					const std::string directoryPath = "../Asset/Clips/";
-					const std::string filePath = directoryPath + animClipName + ".clip";
-					TeaAsset::AssetHandle clipHandle = TeaAsset::AssetManager::getAssetHandle(filePath);
-
-					// Add to animator clip list compoennt
-					auto& animator = m_HierarchyPanel.getSelectedEntity()
-						.getComponent<TeaComponents::BjornAnimator>();
-					animator.animationClips[filePath] = clipHandle;
-					animator.currentClip = filePath;
-					AssetBrowser::isPopUpActive = false;
-
-					// Reset stuff
-					showClipNameError = false;
-					showClipNameDuplicate = false;
-					showClipNameWriteError = false;
-					memset(animClipName, 0, sizeof(animClipName));
-					ImGui::CloseCurrentPopup();
-				}
 			}
 
 			ImGui::SameLine();
@@ -150,6 +143,7 @@ namespace TeaEditor {
 				std::cout << "Popup canceled" << std::endl;
 				ImGui::CloseCurrentPopup();
 			}
+			ImGui::EndDisabled();
 			
 			ImGui::EndPopup();
 		}
@@ -158,6 +152,39 @@ namespace TeaEditor {
 			AssetBrowser::isPopUpActive = false;
 		}
 	}
+	btEngine::Task<void> Editor::saveNewClipAsync(std::string clipName, btEngine::Entity entity)
+	{
+		// Write the clip file on a worker, the editor keeps drawing frames meanwhile
+		TeaGraphics::AnimationClipAsset newClip(clipName);
+		bool saved = co_await btEngine::runOnWorker([&newClip] { return newClip.saveToFile(); });
+
+		// Back on the main thread from here on
+		m_isSavingClip = false;
+		if (!saved)
+		{
+			showClipNameWriteError = true;
+			std::cout << "Failed to save clip" << std::endl;
+			co_return;
+		}
+		std::cout << "Clip saved successfully" << std::endl;
+
+		// Refresh the asset handle of the new clip file
+		const std::string directoryPath = "../Asset/Clips/";
+		const std::string filePath = directoryPath + clipName + ".clip";
+		TeaAsset::AssetHandle clipHandle = TeaAsset::AssetManager::getAssetHandle(filePath);
+		TeaGraphics::ClipLibrary::import(filePath);
+
+		// Add to animator clip list component, the entity may have lost its animator while saving
+		if (entity && entity.hasComponent<TeaComponents::BjornAnimator>())
+		{
+			auto& animator = entity.getComponent<TeaComponents::BjornAnimator>();
+			animator.animationClips[filePath] = clipHandle;
+			animator.currentClip = filePath;
+		}
+
+		m_clipSaveFinished = true;
+	}
+
 	void Editor::renderEventSection(std::shared_ptr<TeaGraphics::AnimationClipAsset> clip) 
 	{
 		if (!ImGui::CollapsingHeader("Events"))
@@ -177,6 +204,7 @@ namespace TeaEditor {
 			if (strlen(eventNameBuffer) > 0)
 			{
 				clip->addEvent(eventNameBuffer, eventFrame);
+				TeaAnimation::AnimationEventNames::forgetClip(clip.get());
 				memset(eventNameBuffer, 0, sizeof(eventNameBuffer));
 			}
 		}
@@ -213,6 +241,7 @@ namespace TeaEditor {
 				{
 					// Remove the event from the list
 					clip->events.erase(clip->events.begin() + i); 
+					TeaAnimation::AnimationEventNames::forgetClip(clip.get());
 					i--;
 				}
 
@@ -222,6 +251,358 @@ namespace TeaEditor {
 		}
 	}
 
+	namespace
+	{
+		// Asset handle of the animator's current clip, 0 if it has none
+		uint64_t getCurrentClipHandle(const TeaComponents::BjornAnimator& animator)
+		{
+			auto clipIt = animator.animationClips.find(animator.currentClip);
+			return clipIt == animator.animationClips.end() ? 0 : static_cast<uint64_t>(clipIt->second);
+		}
+
+		// Edits a std::string through a fixed ImGui buffer
+		bool inputString(const char* label, std::string& value)
+		{
+			char buffer[256] = "";
+			value.copy(buffer, sizeof(buffer) - 1);
+			if (ImGui::InputText(label, buffer, sizeof(buffer)))
+			{
+				value = buffer;
+				return true;
+			}
+			return false;
+		}
+
+		// Combo over the controller's state names, the any state entry is only offered for transition sources
+		void stateCombo(const char* label, std::string& value, const std::vector<TeaAnimation::AnimatorStateDesc>& states, bool allowAnyState)
+		{
+			const char* preview = value.empty() ? (allowAnyState ? "<Any State>" : "<None>") : value.c_str();
+			if (ImGui::BeginCombo(label, preview))
+			{
+				if (allowAnyState && ImGui::Selectable("<Any State>", value.empty()))
+				{
+					value.clear();
+				}
+				for (const auto& state : states)
+				{
+					if (ImGui::Selectable(state.name.c_str(), state.name == value))
+					{
+						value = state.name;
+					}
+				}
+				ImGui::EndCombo();
+			}
+		}
+	}
+
+	void Editor::renderStateMachineSection(TeaComponents::BjornAnimator& animator, btEngine::Entity& selectedEntity)
+	{
+		if (!ImGui::CollapsingHeader("State Machine"))
+			return;
+
+		static const char* parameterTypeNames[] = { "Float", "Int", "Bool", "Trigger" };
+		static const char* conditionModeNames[] = { "Greater", "Less", "Equals", "NotEquals", "If", "IfNot" };
+
+		auto& stateMachines = m_engine.getAnimatorStateMachines();
+		auto& desc = m_controllerDesc;
+
+		// Controller file
+		ImGui::PushItemWidth(200);
+		ImGui::InputText("Controller", m_controllerName, sizeof(m_controllerName));
+		ImGui::PopItemWidth();
+		const std::string controllerPath = "../Asset/Controllers/" + std::string(m_controllerName) + ".controller";
+
+		ImGui::SameLine();
+		if (ImGui::Button("Load##Controller") && strlen(m_controllerName) > 0)
+		{
+			m_controllerError = desc.loadFromFile(controllerPath) ? "" : "Failed to load " + controllerPath;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save##Controller") && strlen(m_controllerName) > 0)
+		{
+			desc.name = m_controllerName;
+			m_controllerError = desc.saveToFile(controllerPath) ? "" : "Failed to save " + controllerPath;
+		}
+
+		// Parameters
+		if (ImGui::TreeNode("Parameters"))
+		{
+			for (size_t i = 0; i < desc.parameters.size(); i++)
+			{
+				auto& parameter = desc.parameters[i];
+				ImGui::PushID(static_cast<int>(i));
+				ImGui::PushItemWidth(120);
+
+				inputString("##Name", parameter.name);
+				ImGui::SameLine();
+				int type = static_cast<int>(parameter.type);
+				if (ImGui::Combo("##Type", &type, parameterTypeNames, IM_ARRAYSIZE(parameterTypeNames)))
+				{
+					parameter.type = static_cast<TeaAnimation::AnimatorParameterType>(type);
+				}
+				ImGui::SameLine();
+				ImGui::DragFloat("##Default", &parameter.defaultValue, 0.1f);
+
+				ImGui::PopItemWidth();
+				ImGui::SameLine();
+				if (ImGui::Button("X##Delete"))
+				{
+					desc.parameters.erase(desc.parameters.begin() + i);
+					i--;
+				}
+				ImGui::PopID();
+			}
+
+			if (ImGui::Button("+ Parameter"))
+			{
+				desc.parameters.push_back({ "Parameter" + std::to_string(desc.parameters.size()) });
+			}
+			ImGui::TreePop();
+		}
+
+		// States
+		if (ImGui::TreeNode("States"))
+		{
+			for (size_t i = 0; i < desc.states.size(); i++)
+			{
+				auto& state = desc.states[i];
+				ImGui::PushID(static_cast<int>(i));
+				ImGui::PushItemWidth(120);
+
+				bool isDefault = desc.defaultState.empty() ? i == 0 : state.name == desc.defaultState;
+				if (ImGui::RadioButton("##Default", isDefault))
+				{
+					desc.defaultState = state.name;
+				}
+				ImGui::SameLine();
+				// Renamed through the desc so the default state and the transitions follow
+				std::string stateName = state.name;
+				if (inputString("##Name", stateName))
+				{
+					desc.renameState(state.name, stateName);
+				}
+				ImGui::SameLine();
+
+				// States play one of the clips of the animator
+				if (ImGui::BeginCombo("##Clip", state.clip.empty() ? "<No Clip>" : state.clip.c_str()))
+				{
+					for (const auto& [clipName, clipHandle] : animator.animationClips)
+					{
+						if (ImGui::Selectable(clipName.c_str(), clipName == state.clip))
+						{
+							state.clip = clipName;
+						}
+					}
+					ImGui::EndCombo();
+				}
+				ImGui::SameLine();
+				ImGui::DragFloat("##Speed", &state.speed, 0.05f, 0.0f, 10.0f, "%.2fx");
+
+				ImGui::PopItemWidth();
+				ImGui::SameLine();
+				if (ImGui::Button("X##Delete"))
+				{
+					desc.states.erase(desc.states.begin() + i);
+					i--;
+				}
+				ImGui::PopID();
+			}
+
+			if (ImGui::Button("+ State"))
+			{
+				desc.states.push_back({ "State" + std::to_string(desc.states.size()), animator.currentClip });
+			}
+			ImGui::TreePop();
+		}
+
+		// Transitions
+		if (ImGui::TreeNode("Transitions"))
+		{
+			for (size_t i = 0; i < desc.transitions.size(); i++)
+			{
+				auto& transition = desc.transitions[i];
+				ImGui::PushID(static_cast<int>(i));
+				ImGui::PushItemWidth(120);
+
+				stateCombo("##From", transition.from, desc.states, true);
+				ImGui::SameLine();
+				ImGui::Text("->");
+				ImGui::SameLine();
+				stateCombo("##To", transition.to, desc.states, false);
+				ImGui::SameLine();
+				ImGui::DragFloat("Blend##Blend", &transition.blendTime, 0.01f, 0.0f, 5.0f, "%.2fs");
+				ImGui::SameLine();
+				ImGui::DragFloat("Exit##Exit", &transition.exitTime, 0.01f, -1.0f, 60.0f, transition.exitTime < 0.0f ? "None" : "%.2fs");
+
+				ImGui::SameLine();
+				if (ImGui::Button("X##Delete"))
+				{
+					ImGui::PopItemWidth();
+					ImGui::PopID();
+					desc.transitions.erase(desc.transitions.begin() + i);
+					i--;
+					continue;
+				}
+
+				// Conditions of the transition, all of them must pass
+				ImGui::Indent();
+				for (size_t c = 0; c < transition.conditions.size(); c++)
+				{
+					auto& condition = transition.conditions[c];
+					ImGui::PushID(static_cast<int>(c));
+
+					if (ImGui::BeginCombo("##Parameter", condition.parameter.empty() ? "<Parameter>" : condition.parameter.c_str()))
+					{
+						for (const auto& parameter : desc.parameters)
+						{
+							if (ImGui::Selectable(parameter.name.c_str(), parameter.name == condition.parameter))
+							{
+								condition.parameter = parameter.name;
+							}
+						}
+						ImGui::EndCombo();
+					}
+					ImGui::SameLine();
+					int mode = static_cast<int>(condition.mode);
+					if (ImGui::Combo("##Mode", &mode, conditionModeNames, IM_ARRAYSIZE(conditionModeNames)))
+					{
+						condition.mode = static_cast<TeaAnimation::AnimatorConditionMode>(mode);
+					}
+					ImGui::SameLine();
+					ImGui::DragFloat("##Threshold", &condition.threshold, 0.1f);
+					ImGui::SameLine();
+					if (ImGui::Button("X##DeleteCondition"))
+					{
+						transition.conditions.erase(transition.conditions.begin() + c);
+						c--;
+					}
+					ImGui::PopID();
+				}
+				if (ImGui::Button("+ Condition"))
+				{
+					transition.conditions.push_back({});
+				}
+				ImGui::Unindent();
+
+				ImGui::PopItemWidth();
+				ImGui::PopID();
+			}
+
+			if (ImGui::Button("+ Transition"))
+			{
+				desc.transitions.push_back({});
+			}
+			ImGui::TreePop();
+		}
+
+		// Compile the graph into the flat tables, save it and bind it through the component so it is saved with the scene
+		if (ImGui::Button("Compile & Bind"))
+		{
+			auto machine = TeaAnimation::AnimatorStateMachine::compile(desc, m_controllerError);
+			if (machine && strlen(m_controllerName) == 0)
+			{
+				m_controllerError = "Name the controller to bind it";
+			}
+			else if (machine)
+			{
+				desc.name = m_controllerName;
+				if (!desc.saveToFile(controllerPath))
+				{
+					m_controllerError = "Failed to save " + controllerPath;
+				}
+				else
+				{
+					// Entities already running this controller pick up the new machine, the old one is freed
+					stateMachines.setController(controllerPath, machine);
+
+					if (!selectedEntity.hasComponent<TeaComponents::AnimatorControllerComponent>())
+					{
+						selectedEntity.addComponent<TeaComponents::AnimatorControllerComponent>();
+					}
+					selectedEntity.getComponent<TeaComponents::AnimatorControllerComponent>().controllerPath = controllerPath;
+
+					if (auto* registry = m_engine.getSceneManager().getRegistry())
+					{
+						stateMachines.syncBindings(*registry);
+					}
+				}
+			}
+		}
+
+		const TeaAnimation::AnimatorStateMachine* machine = stateMachines.getStateMachine(selectedEntity);
+		if (machine)
+		{
+			ImGui::SameLine();
+			if (ImGui::Button("Unbind"))
+			{
+				if (selectedEntity.hasComponent<TeaComponents::AnimatorControllerComponent>())
+				{
+					selectedEntity.removeComponent<TeaComponents::AnimatorControllerComponent>();
+				}
+				stateMachines.unbind(selectedEntity);
+				machine = nullptr;
+			}
+		}
+
+		if (!m_controllerError.empty())
+		{
+			ImGui::TextColored(ImVec4(1, 0, 0, 1), "%s", m_controllerError.c_str());
+		}
+
+		if (!machine)
+			return;
+
+		// Live instance
+		uint16_t currentState = stateMachines.getCurrentState(selectedEntity);
+		ImGui::Text("Current State: %s (blend %.0f%%)", currentState < machine->getStateCount() ? machine->getStateName(currentState).c_str() : "<Entering>",
+			stateMachines.getBlendWeight(selectedEntity) * 100.0f);
+
+		for (uint16_t p = 0; p < machine->getParameterCount(); p++)
+		{
+			ImGui::PushID(p);
+			const char* name = machine->getParameterName(p).c_str();
+			float value = stateMachines.getParameter(selectedEntity, p);
+			switch (machine->getParameterType(p))
+			{
+			case TeaAnimation::AnimatorParameterType::Float:
+				if (ImGui::DragFloat(name, &value, 0.05f)) stateMachines.setParameter(selectedEntity, p, value);
+				break;
+			case TeaAnimation::AnimatorParameterType::Int:
+			{
+				int intValue = static_cast<int>(value);
+				if (ImGui::InputInt(name, &intValue)) stateMachines.setParameter(selectedEntity, p, static_cast<float>(intValue));
+				break;
+			}
+			case TeaAnimation::AnimatorParameterType::Bool:
+			{
+				bool boolValue = value != 0.0f;
+				if (ImGui::Checkbox(name, &boolValue)) stateMachines.setParameter(selectedEntity, p, boolValue ? 1.0f : 0.0f);
+				break;
+			}
+			case TeaAnimation::AnimatorParameterType::Trigger:
+				if (ImGui::Button(name)) stateMachines.setTrigger(selectedEntity, p);
+				ImGui::SameLine();
+				ImGui::TextDisabled("%s", value != 0.0f ? "(set)" : "");
+				break;
+			}
+			ImGui::PopID();
+		}
+
+		// The runtime evaluates every animator in the scene update, the editor only does it while previewing
+		ImGui::Checkbox("Preview In Edit Mode", &m_previewStateMachine);
+	}
+
+	void Editor::updateStateMachinePreview(float deltaTime)
+	{
+		if (!m_previewStateMachine || m_engine.getSceneManager().getEditorState() != SceneManager::EditorState::EditMode)
+			return;
+
+		if (auto* registry = m_engine.getSceneManager().getRegistry())
+		{
+			m_engine.getAnimatorStateMachines().update(*registry, deltaTime, &m_engine.getJobSystem());
+		}
+	}
+
 	void Editor::renderRecordingControls(TeaComponents::BjornAnimator& animator, btEngine::Entity& selectedEntity) 
 	{
 		// Display a button that toggles between "Start Recording" and "Stop Recording"
@@ -275,7 +656,22 @@ namespace TeaEditor {
 		// Button to save the current animation clip to a file
 		if (ImGui::Button("Save Clip"))
 		{
-			clip->saveToFile();
+			// Rehash the clip, it no longer shares keys with the clips it matched before
+			if (clip->saveToFile())
+			{
+				TeaGraphics::ClipLibrary::reimport(animator.currentClip);
+			}
+		}
+
+		ImGui::SameLine();
+
+		// Scrubbing copies baked poses instead of evaluating every track
+		ImGui::Checkbox("Pose Cache", &m_usePoseCache);
+		if (m_usePoseCache && m_poseCache)
+		{
+			ImGui::SameLine();
+			ImGui::TextDisabled("%.0f%% baked, %zu KB", m_poseCache->getBakedFraction(getCurrentClipHandle(animator)) * 100.0f,
+				m_poseCache->getMemoryUsage() / 1024);
 		}
 	}
 
@@ -317,17 +713,76 @@ namespace TeaEditor {
 		ImGui::PopItemWidth();
 	}
 
+	void Editor::applyPose(TeaComponents::BjornAnimator& animator, std::shared_ptr<TeaGraphics::AnimationClipAsset> clip,
+		btEngine::Entity& selectedEntity, int frame)
+	{
+		auto& transform = selectedEntity.getComponent<TeaComponents::Transform>();
+
+		// Baked frames are copied straight into the transform, the rest are evaluated from the keys.
+		// Keys change every frame while recording, so the cache is not even asked to bake them
+		const bool useCache = m_usePoseCache && m_poseCache && !m_sequencer.isRecording;
+		if (!useCache || !m_poseCache->apply(animator, getCurrentClipHandle(animator), clip->startFrame, clip->endFrame, frame, transform))
+		{
+			TeaAnimation::Animator::ApplyKeyframeAtTime(animator, transform, frame);
+		}
+
+		// Right after a state machine transition the new clip fades in from the pose held at the switch
+		m_engine.getAnimatorStateMachines().blendPose(static_cast<entt::entity>(selectedEntity), transform);
+		m_lastAppliedFrames[static_cast<entt::entity>(selectedEntity)] = frame;
+	}
+
 	void Editor::handlePlaybackUpdate(TeaComponents::BjornAnimator& animator, std::shared_ptr<TeaGraphics::AnimationClipAsset> clip,
 		btEngine::Entity& selectedEntity, float deltaTime)
 	{
-		// Ensure playback only happens if the animator is playing and the editor is in EditMode
-		if (!animator.isPlaying || m_engine.getSceneManager().getEditorState() != SceneManager::EditorState::EditMode)
+		// Ensure playback and scrubbing only happen in EditMode
+		if (m_engine.getSceneManager().getEditorState() != SceneManager::EditorState::EditMode)
 			return;
 
-		// Get the Transform component of the selected entity
-		auto& transform = selectedEntity.getComponent<TeaComponents::Transform>();
+		if (!m_poseCache)
+		{
+			m_poseCache = std::make_unique<TeaAnimation::PoseCache>(m_engine.getTaskQueue());
+		}
+
+		// Recording writes keys every frame, so the baked poses of the clip are stale. Playback carries on
+		if (m_sequencer.isRecording)
+		{
+			m_poseCache->invalidate(getCurrentClipHandle(animator));
+		}
+
+		// Switching to another animator picks up its own frame rather than snapping it to the timeline
+		const entt::entity entity = static_cast<entt::entity>(selectedEntity);
+		if (entity != m_playbackEntity)
+		{
+			m_playbackEntity = entity;
+			m_currentFrame = std::max(clip->startFrame, std::min(animator.currentFrame, clip->endFrame));
+
+			auto* registry = m_engine.getSceneManager().getRegistry();
+			for (auto it = m_lastAppliedFrames.begin(); it != m_lastAppliedFrames.end();)
+			{
+				it = registry && registry->valid(it->first) ? std::next(it) : m_lastAppliedFrames.erase(it);
+			}
+		}
+
+		// An animator seen for the first time already shows its own frame
+		auto lastApplied = m_lastAppliedFrames.emplace(entity, animator.currentFrame).first;
+
+		// Scrubbing, the pose is only applied when the frame changed
+		if (!animator.isPlaying)
+		{
+			if (m_currentFrame != lastApplied->second)
+			{
+				applyPose(animator, clip, selectedEntity, m_currentFrame);
+				animator.currentFrame = m_currentFrame;
+			}
+			return;
+		}
+
 		animator.timeAccumulator += deltaTime * clip->speed * animator.playbackSpeed;
 
+		// Event names are interned once per clip, the frame loop only compares frames
+		auto& animationEvents = m_engine.getAnimationEvents();
+		const auto eventIds = TeaAnimation::AnimationEventNames::getClipEventIds(clip);
+
 		// Process frames based on accumulated time at 30fps
 		while (animator.timeAccumulator >= (1.0f / 30.0f)) 
 		{
@@ -350,16 +805,18 @@ namespace TeaEditor {
 				}
 			}
 
-			// Trigger any events associated with the current frame (for testing/debugging)
-			auto currentEvents = animator.getCurrentFrameEvents();
-			for (const auto& event : currentEvents)
+			// Queue the events of this frame, scripts receive them in one batch when the frame is flushed
+			for (size_t i = 0; i < clip->events.size(); i++)
 			{
-				TEA_INFO("Triggering event: {} at frame {}", event.eventName, event.keyFrame);
+				if (clip->events[i].keyFrame == m_currentFrame)
+				{
+					animationEvents.push(selectedEntity, (*eventIds)[i], m_currentFrame);
+				}
 			}
 		}
 
 		// Apply keyframe data to the transform at the current frame
-		TeaAnimation::Animator::ApplyKeyframeAtTime(animator, transform, m_currentFrame);
+		applyPose(animator, clip, selectedEntity, m_currentFrame);
 		// Update the animator's current frame
 		animator.currentFrame = m_currentFrame;
 	}
@@ -369,7 +826,8 @@ namespace TeaEditor {
 		ImVec2 availableSpace = ImGui::GetContentRegionAvail();
 		if (availableSpace.x > 0 && availableSpace.y > 0)
 		{
-			Sequencer(&m_sequencer,
+			// Keys moved, added or removed in the timeline
+			m_sequencerEdited |= Sequencer(&m_sequencer,
 				&m_currentFrame,
 				&m_expanded,
 				&m_selectedEntry,
@@ -383,6 +841,9 @@ namespace TeaEditor {
 	}
 	void Editor::renderSequencer(float deltaTime)
 	{
+		// Animators are advanced before any window of this frame is built
+		updateStateMachinePreview(deltaTime);
+
 		// Begin the Sequencer window
 		ImGui::Begin("Sequencer", nullptr, ImGuiWindowFlags_NoCollapse);
 		ImGui::SetWindowSize(ImVec2(400, 400), ImGuiCond_FirstUseEver);
@@ -429,6 +890,7 @@ namespace TeaEditor {
 					{
 						// If user select, then set the selected clip as the current clip
 						animator.currentClip = name;
+						m_lastAppliedFrames[static_cast<entt::entity>(selectedEntity)] = INT_MIN;
 						std::cout << "Selected clip: " << name << std::endl;
 					}
 				}
@@ -487,6 +949,9 @@ namespace TeaEditor {
 				ImGui::EndPopup();
 			}
 
+			// The state machine only needs the animator clips, not a current clip
+			renderStateMachineSection(animator, selectedEntity);
+
 			// Render additional sequencer controls if a current clip is selected
 			if (!animator.currentClip.empty())
 			{
@@ -508,6 +973,13 @@ namespace TeaEditor {
 							renderFrameControls(clip);
 							handlePlaybackUpdate(animator, clip, selectedEntity, deltaTime);
 							renderSequencerUI();
+
+							if (m_sequencerEdited && m_poseCache)
+							{
+								m_poseCache->invalidate(getCurrentClipHandle(animator));
+								m_lastAppliedFrames[static_cast<entt::entity>(selectedEntity)] = INT_MIN;
+							}
+							m_sequencerEdited = false;
 						}
 						else
 						{
@@ -530,6 +1002,9 @@ namespace TeaEditor {
 			}
 		}
 
+		// Deliver the events fired by the preview this frame
+		m_engine.getAnimationEvents().flush();
+
 		ImGui::EndChild();
 		ImGui::End();
 	}
@@ -18,7 +18,9 @@ editor interface and functionality, including:
 
 /*                                                                          includes
 ====================================================================================*/
+#include <climits>
 #include <iostream>
+#include <memory>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -35,6 +37,8 @@ editor interface and functionality, including:
 #include "../../TeaEngine/Src/Core/scene.hpp"
 #include "Asset/assetImporter.hpp"
 #include "AnimationController.hpp"
+#include "Graphics/AnimatorStateMachine.hpp"
+#include "Graphics/PoseCache.hpp"
 #include "UndoRedo.hpp"
 
 /*                                                             function declarations
@@ -126,6 +130,46 @@ namespace TeaEditor
 		 */
 		void renderAnimationClipSaveDialog();
 
+		/**
+		 * @brief Renders the animator state machine editor for the selected entity
+		 *
+		 * This function handles:
+		 * 1. Loading and saving the controller file
+		 * 2. Editing parameters, states (with their clips) and transitions with their conditions
+		 * 3. Compiling the controller, saving it and binding it to the selected entity through
+		 *    its AnimatorControllerComponent so the binding is saved with the scene
+		 * 4. Showing the live state and editing the parameters of the bound instance
+		 * 5. Toggling the edit mode preview
+		 *
+		 * @param animator Reference to the animator whose clips the states can use
+		 * @param selectedEntity Reference to the entity the controller is bound to
+		 */
+		void renderStateMachineSection(TeaComponents::BjornAnimator& animator, btEngine::Entity& selectedEntity);
+
+		/**
+		 * @brief Evaluates the state machines in edit mode while the preview is on
+		 *
+		 * Runs once per frame before the sequencer window is built, never from inside a UI section.
+		 *
+		 * @param deltaTime Time elapsed since last frame in seconds
+		 */
+		void updateStateMachinePreview(float deltaTime);
+
+		/**
+		 * @brief Saves a new animation clip without blocking the editor
+		 *
+		 * This coroutine handles:
+		 * 1. Writing the clip file on a worker thread
+		 * 2. Refreshing the asset handle of the new clip on the main thread
+		 * 3. Adding the clip to the animator clip list and selecting it
+		 * 4. Flagging the save dialog to close or to show the write error
+		 *
+		 * @param clipName Name of the new clip
+		 * @param entity Entity whose animator receives the clip
+		 * @return Task that finishes once the clip list is updated
+		 */
+		btEngine::Task<void> saveNewClipAsync(std::string clipName, btEngine::Entity entity);
+
 		/**
 		 * @brief Main render function for the animation sequencer editor
 		 *
@@ -159,6 +203,18 @@ namespace TeaEditor
 			btEngine::Entity& selectedEntity,
 			float deltaTime);
 	private:
+		/**
+		 * @brief Applies the pose of a frame, from the pose cache when it is baked
+		 *
+		 * @param animator Reference to the animator being sampled
+		 * @param clip Pointer to the animator's current clip
+		 * @param selectedEntity Reference to the entity whose transform receives the pose
+		 * @param frame Frame to sample
+		 */
+		void applyPose(TeaComponents::BjornAnimator& animator, std::shared_ptr<TeaGraphics::AnimationClipAsset> clip,
+			btEngine::Entity& selectedEntity, int frame);
+
+
 		// Engine reference for entity management
 		btEngine::engine& m_engine;
 		
@@ -180,6 +236,21 @@ namespace TeaEditor
 		bool showClipNameDuplicate = false;  // Error flag for duplicate clip names
 		bool showClipNameWriteError = false; // Error flag for write errors
 		bool isClipPopUpActive = false;      // Indicates if a clip popup is active
+		bool m_isSavingClip = false;         // A clip save coroutine is running
+		bool m_clipSaveFinished = false;     // The clip save coroutine finished, close the popup
+
+		// Baked poses for scrubbing, created on first use
+		std::unique_ptr<TeaAnimation::PoseCache> m_poseCache;
+		bool m_usePoseCache = true;          // Serve baked frames when scrubbing and playing
+		bool m_sequencerEdited = false;      // Keys changed in the timeline this frame
+		std::unordered_map<entt::entity, int> m_lastAppliedFrames;  // Last frame applied to the transform of each animator
+		entt::entity m_playbackEntity = entt::null;                  // Animator the timeline frame belongs to
+
+		// Animator state machine authoring
+		TeaAnimation::AnimatorControllerDesc m_controllerDesc;   // Controller being edited
+		char m_controllerName[256] = "";     // Buffer for the controller file name
+		std::string m_controllerError;       // Last load, save or compile error
+		bool m_previewStateMachine = false;  // Evaluate state machines in edit mode
 
 		// Popup management flags
 		bool m_OpenSaveClipPopup = false;    // Flag for save clip popup
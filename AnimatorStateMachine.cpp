@@ -0,0 +1,825 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimatorStateMachine.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- AnimatorControllerDesc serialization
+- AnimatorStateMachine compilation and transition lookup
+- AnimatorStateMachineSystem batched evaluation, state switching and pose crossfades
+- Binding from AnimatorControllerComponent and controller hot reload
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "AnimatorStateMachine.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <glm/gtc/quaternion.hpp>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAnimation
+{
+    namespace
+    {
+        const char* const s_parameterTypeNames[] = { "Float", "Int", "Bool", "Trigger" };
+        const char* const s_conditionModeNames[] = { "Greater", "Less", "Equals", "NotEquals", "If", "IfNot" };
+
+        template<typename Enum, size_t Count>
+        Enum parseEnum(const rapidjson::Value& value, const char* const (&names)[Count], Enum fallback)
+        {
+            if (!value.IsString()) return fallback;
+            for (size_t i = 0; i < Count; i++)
+            {
+                if (std::strcmp(value.GetString(), names[i]) == 0) return static_cast<Enum>(i);
+            }
+            return fallback;
+        }
+
+        std::string getString(const rapidjson::Value& object, const char* key)
+        {
+            auto it = object.FindMember(key);
+            return it != object.MemberEnd() && it->value.IsString() ? it->value.GetString() : std::string();
+        }
+
+        float getFloat(const rapidjson::Value& object, const char* key, float fallback)
+        {
+            auto it = object.FindMember(key);
+            return it != object.MemberEnd() && it->value.IsNumber() ? it->value.GetFloat() : fallback;
+        }
+
+        const rapidjson::Value* getArray(const rapidjson::Value& object, const char* key)
+        {
+            auto it = object.FindMember(key);
+            return it != object.MemberEnd() && it->value.IsArray() ? &it->value : nullptr;
+        }
+
+        bool isNumericType(AnimatorParameterType type)
+        {
+            return type == AnimatorParameterType::Float || type == AnimatorParameterType::Int;
+        }
+    }
+
+    bool AnimatorControllerDesc::saveToFile(const std::string& filePath) const
+    {
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            TEA_ERROR("Failed to open animator controller file for writing: {0}", filePath);
+            return false;
+        }
+
+        rapidjson::OStreamWrapper stream(file);
+        rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+
+        writer.StartObject();
+        writer.Key("Name");             writer.String(name.c_str());
+        writer.Key("DefaultState");     writer.String(defaultState.c_str());
+
+        writer.Key("Parameters");
+        writer.StartArray();
+        for (const auto& parameter : parameters)
+        {
+            writer.StartObject();
+            writer.Key("Name");         writer.String(parameter.name.c_str());
+            writer.Key("Type");         writer.String(s_parameterTypeNames[static_cast<size_t>(parameter.type)]);
+            writer.Key("Default");      writer.Double(parameter.defaultValue);
+            writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.Key("States");
+        writer.StartArray();
+        for (const auto& state : states)
+        {
+            writer.StartObject();
+            writer.Key("Name");         writer.String(state.name.c_str());
+            writer.Key("Clip");         writer.String(state.clip.c_str());
+            writer.Key("Speed");        writer.Double(state.speed);
+            writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.Key("Transitions");
+        writer.StartArray();
+        for (const auto& transition : transitions)
+        {
+            writer.StartObject();
+            writer.Key("From");         writer.String(transition.from.c_str());
+            writer.Key("To");           writer.String(transition.to.c_str());
+            writer.Key("BlendTime");    writer.Double(transition.blendTime);
+            writer.Key("ExitTime");     writer.Double(transition.exitTime);
+            writer.Key("Conditions");
+            writer.StartArray();
+            for (const auto& condition : transition.conditions)
+            {
+                writer.StartObject();
+                writer.Key("Parameter");    writer.String(condition.parameter.c_str());
+                writer.Key("Mode");         writer.String(s_conditionModeNames[static_cast<size_t>(condition.mode)]);
+                writer.Key("Threshold");    writer.Double(condition.threshold);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+
+        return file.good();
+    }
+
+    bool AnimatorControllerDesc::loadFromFile(const std::string& filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            TEA_ERROR("Failed to open animator controller file: {0}", filePath);
+            return false;
+        }
+
+        rapidjson::IStreamWrapper stream(file);
+        rapidjson::Document document;
+        document.ParseStream(stream);
+        if (document.HasParseError() || !document.IsObject())
+        {
+            TEA_ERROR("Failed to parse animator controller file: {0}", filePath);
+            return false;
+        }
+
+        AnimatorControllerDesc loaded;
+        loaded.name = getString(document, "Name");
+        loaded.defaultState = getString(document, "DefaultState");
+
+        if (const auto* parameterArray = getArray(document, "Parameters"))
+        {
+            for (const auto& value : parameterArray->GetArray())
+            {
+                if (!value.IsObject()) continue;
+
+                AnimatorParameterDesc parameter;
+                parameter.name = getString(value, "Name");
+                if (value.HasMember("Type")) parameter.type = parseEnum(value["Type"], s_parameterTypeNames, AnimatorParameterType::Float);
+                parameter.defaultValue = getFloat(value, "Default", 0.0f);
+                loaded.parameters.push_back(std::move(parameter));
+            }
+        }
+
+        if (const auto* stateArray = getArray(document, "States"))
+        {
+            for (const auto& value : stateArray->GetArray())
+            {
+                if (!value.IsObject()) continue;
+
+                AnimatorStateDesc state;
+                state.name = getString(value, "Name");
+                state.clip = getString(value, "Clip");
+                state.speed = getFloat(value, "Speed", 1.0f);
+                loaded.states.push_back(std::move(state));
+            }
+        }
+
+        if (const auto* transitionArray = getArray(document, "Transitions"))
+        {
+            for (const auto& value : transitionArray->GetArray())
+            {
+                if (!value.IsObject()) continue;
+
+                AnimatorTransitionDesc transition;
+                transition.from = getString(value, "From");
+                transition.to = getString(value, "To");
+                transition.blendTime = getFloat(value, "BlendTime", 0.1f);
+                transition.exitTime = getFloat(value, "ExitTime", -1.0f);
+                if (const auto* conditionArray = getArray(value, "Conditions"))
+                {
+                    for (const auto& conditionValue : conditionArray->GetArray())
+                    {
+                        if (!conditionValue.IsObject()) continue;
+
+                        AnimatorConditionDesc condition;
+                        condition.parameter = getString(conditionValue, "Parameter");
+                        if (conditionValue.HasMember("Mode")) condition.mode = parseEnum(conditionValue["Mode"], s_conditionModeNames, AnimatorConditionMode::If);
+                        condition.threshold = getFloat(conditionValue, "Threshold", 0.0f);
+                        transition.conditions.push_back(std::move(condition));
+                    }
+                }
+                loaded.transitions.push_back(std::move(transition));
+            }
+        }
+
+        *this = std::move(loaded);
+        return true;
+    }
+
+    bool AnimatorControllerDesc::renameState(const std::string& oldName, const std::string& newName)
+    {
+        auto stateIt = std::find_if(states.begin(), states.end(),
+            [&oldName](const AnimatorStateDesc& state) { return state.name == oldName; });
+        if (stateIt == states.end()) return false;
+
+        stateIt->name = newName;
+        if (defaultState == oldName)
+        {
+            defaultState = newName;
+        }
+
+        // Empty sources are any state transitions, never a renamed state
+        for (auto& transition : transitions)
+        {
+            if (!oldName.empty() && transition.from == oldName) transition.from = newName;
+            if (transition.to == oldName) transition.to = newName;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const AnimatorStateMachine> AnimatorStateMachine::compile(const AnimatorControllerDesc& desc, std::string& error)
+    {
+        auto machine = std::make_shared<AnimatorStateMachine>();
+        machine->m_name = desc.name;
+
+        if (desc.states.empty())
+        {
+            error = "Controller has no states";
+            return nullptr;
+        }
+        if (desc.states.size() >= InvalidIndex || desc.parameters.size() >= InvalidIndex)
+        {
+            error = "Controller has too many states or parameters";
+            return nullptr;
+        }
+
+        // Parameters
+        std::unordered_set<std::string> seen;
+        for (const auto& parameter : desc.parameters)
+        {
+            if (parameter.name.empty() || !seen.insert(parameter.name).second)
+            {
+                error = "Parameter name is empty or duplicated: '" + parameter.name + "'";
+                return nullptr;
+            }
+            machine->m_parameterNames.push_back(parameter.name);
+            machine->m_parameterTypes.push_back(parameter.type);
+            machine->m_defaultParameters.push_back(parameter.type == AnimatorParameterType::Trigger ? 0.0f : parameter.defaultValue);
+        }
+
+        // States
+        seen.clear();
+        for (const auto& state : desc.states)
+        {
+            if (state.name.empty() || !seen.insert(state.name).second)
+            {
+                error = "State name is empty or duplicated: '" + state.name + "'";
+                return nullptr;
+            }
+            machine->m_stateNames.push_back(state.name);
+            machine->m_stateClips.push_back(state.clip);
+            machine->m_stateSpeeds.push_back(state.speed);
+        }
+
+        const uint16_t stateCount = machine->getStateCount();
+        machine->m_defaultState = desc.defaultState.empty() ? 0 : machine->getStateIndex(desc.defaultState);
+        if (machine->m_defaultState == InvalidIndex)
+        {
+            error = "Unknown default state '" + desc.defaultState + "'";
+            return nullptr;
+        }
+
+        // Transitions, resolved first then laid out row by row (source states, then any state)
+        struct ResolvedTransition
+        {
+            uint16_t row;
+            const AnimatorTransitionDesc* desc;
+            Transition transition;
+            std::vector<Condition> conditions;
+        };
+
+        std::vector<ResolvedTransition> resolved;
+        resolved.reserve(desc.transitions.size());
+        for (const auto& transitionDesc : desc.transitions)
+        {
+            ResolvedTransition entry{};
+            entry.desc = &transitionDesc;
+            entry.row = transitionDesc.from.empty() ? stateCount : machine->getStateIndex(transitionDesc.from);
+            entry.transition.target = machine->getStateIndex(transitionDesc.to);
+            entry.transition.blendTime = std::max(0.0f, transitionDesc.blendTime);
+            entry.transition.exitTime = transitionDesc.exitTime;
+
+            if (entry.row == InvalidIndex || entry.transition.target == InvalidIndex)
+            {
+                error = "Transition '" + transitionDesc.from + "' -> '" + transitionDesc.to + "' references an unknown state";
+                return nullptr;
+            }
+            if (transitionDesc.conditions.size() >= InvalidIndex)
+            {
+                error = "Transition '" + transitionDesc.from + "' -> '" + transitionDesc.to + "' has too many conditions";
+                return nullptr;
+            }
+
+            for (const auto& conditionDesc : transitionDesc.conditions)
+            {
+                Condition condition{};
+                condition.parameter = machine->getParameterIndex(conditionDesc.parameter);
+                if (condition.parameter == InvalidIndex)
+                {
+                    error = "Condition references unknown parameter '" + conditionDesc.parameter + "'";
+                    return nullptr;
+                }
+
+                condition.type = machine->m_parameterTypes[condition.parameter];
+                condition.mode = conditionDesc.mode;
+                condition.threshold = conditionDesc.threshold;
+
+                bool comparison = condition.mode == AnimatorConditionMode::Greater || condition.mode == AnimatorConditionMode::Less ||
+                    condition.mode == AnimatorConditionMode::Equals || condition.mode == AnimatorConditionMode::NotEquals;
+                if (comparison != isNumericType(condition.type) ||
+                    (condition.type == AnimatorParameterType::Trigger && condition.mode == AnimatorConditionMode::IfNot))
+                {
+                    error = "Condition mode '" + std::string(s_conditionModeNames[static_cast<size_t>(condition.mode)]) +
+                        "' does not fit parameter '" + conditionDesc.parameter + "'";
+                    return nullptr;
+                }
+                entry.conditions.push_back(condition);
+            }
+
+            if (entry.conditions.empty() && entry.transition.exitTime < 0.0f)
+            {
+                TEA_WARNING("Animator controller {0}: transition '{1}' -> '{2}' has no condition and no exit time, it fires immediately",
+                    desc.name, transitionDesc.from, transitionDesc.to);
+            }
+            resolved.push_back(std::move(entry));
+        }
+
+        // Stable so transitions keep their authored priority inside a row
+        std::stable_sort(resolved.begin(), resolved.end(),
+            [](const ResolvedTransition& a, const ResolvedTransition& b) { return a.row < b.row; });
+
+        machine->m_transitionOffsets.assign(static_cast<size_t>(stateCount) + 2, 0);
+        for (auto& entry : resolved)
+        {
+            machine->m_transitionOffsets[entry.row + 1]++;
+
+            entry.transition.firstCondition = static_cast<uint32_t>(machine->m_conditions.size());
+            entry.transition.conditionCount = static_cast<uint16_t>(entry.conditions.size());
+            machine->m_conditions.insert(machine->m_conditions.end(), entry.conditions.begin(), entry.conditions.end());
+            machine->m_transitions.push_back(entry.transition);
+        }
+        for (size_t row = 1; row < machine->m_transitionOffsets.size(); row++)
+        {
+            machine->m_transitionOffsets[row] += machine->m_transitionOffsets[row - 1];
+        }
+
+        error.clear();
+        return machine;
+    }
+
+    bool AnimatorStateMachine::conditionsPass(const Transition& transition, const float* parameters) const
+    {
+        const Condition* condition = m_conditions.data() + transition.firstCondition;
+        const Condition* end = condition + transition.conditionCount;
+        for (; condition != end; ++condition)
+        {
+            const float value = parameters[condition->parameter];
+            bool passed = false;
+            switch (condition->mode)
+            {
+            case AnimatorConditionMode::Greater:    passed = value > condition->threshold; break;
+            case AnimatorConditionMode::Less:       passed = value < condition->threshold; break;
+            case AnimatorConditionMode::Equals:     passed = value == condition->threshold; break;
+            case AnimatorConditionMode::NotEquals:  passed = value != condition->threshold; break;
+            case AnimatorConditionMode::If:         passed = value != 0.0f; break;
+            case AnimatorConditionMode::IfNot:      passed = value == 0.0f; break;
+            }
+            if (!passed) return false;
+        }
+        return true;
+    }
+
+    uint32_t AnimatorStateMachine::findTransition(uint16_t state, float stateTime, const float* parameters) const
+    {
+        // Any state transitions first, they never re-enter the current state
+        const uint16_t anyRow = getStateCount();
+        for (uint32_t i = m_transitionOffsets[anyRow]; i < m_transitionOffsets[anyRow + 1]; i++)
+        {
+            const Transition& transition = m_transitions[i];
+            if (transition.target != state && stateTime >= transition.exitTime && conditionsPass(transition, parameters))
+            {
+                return i;
+            }
+        }
+
+        for (uint32_t i = m_transitionOffsets[state]; i < m_transitionOffsets[state + 1]; i++)
+        {
+            const Transition& transition = m_transitions[i];
+            if (stateTime >= transition.exitTime && conditionsPass(transition, parameters))
+            {
+                return i;
+            }
+        }
+        return NoTransition;
+    }
+
+    void AnimatorStateMachine::consumeTriggers(uint32_t transition, float* parameters) const
+    {
+        const Transition& fired = m_transitions[transition];
+        for (uint32_t i = fired.firstCondition; i < fired.firstCondition + fired.conditionCount; i++)
+        {
+            if (m_conditions[i].type == AnimatorParameterType::Trigger)
+            {
+                parameters[m_conditions[i].parameter] = 0.0f;
+            }
+        }
+    }
+
+    uint16_t AnimatorStateMachine::getParameterIndex(std::string_view parameterName) const
+    {
+        auto it = std::find(m_parameterNames.begin(), m_parameterNames.end(), parameterName);
+        return it == m_parameterNames.end() ? InvalidIndex : static_cast<uint16_t>(it - m_parameterNames.begin());
+    }
+
+    uint16_t AnimatorStateMachine::getStateIndex(std::string_view stateName) const
+    {
+        auto it = std::find(m_stateNames.begin(), m_stateNames.end(), stateName);
+        return it == m_stateNames.end() ? InvalidIndex : static_cast<uint16_t>(it - m_stateNames.begin());
+    }
+
+    void AnimatorStateMachineSystem::bind(entt::entity entity, std::shared_ptr<const AnimatorStateMachine> machine)
+    {
+        bindInstance(entity, std::move(machine), std::string());
+    }
+
+    void AnimatorStateMachineSystem::bindInstance(entt::entity entity, std::shared_ptr<const AnimatorStateMachine> machine, const std::string& controllerPath)
+    {
+        if (!machine) return;
+
+        unbind(entity);
+
+        uint32_t batchIndex = findOrCreateBatch(machine);
+        MachineBatch& batch = m_batches[batchIndex];
+        const auto& defaults = machine->getDefaultParameters();
+
+        m_slots[entity] = { batchIndex, static_cast<uint32_t>(batch.entities.size()), controllerPath };
+        batch.entities.push_back(entity);
+        batch.states.push_back(machine->getDefaultState());
+        batch.stateTimes.push_back(0.0f);
+        batch.blendTimes.push_back(0.0f);
+        batch.blendElapsed.push_back(0.0f);
+        batch.blendFrom.emplace_back();
+        batch.pending.push_back(EnterDefaultState);
+        batch.parameters.insert(batch.parameters.end(), defaults.begin(), defaults.end());
+    }
+
+    void AnimatorStateMachineSystem::unbind(entt::entity entity)
+    {
+        auto slotIt = m_slots.find(entity);
+        if (slotIt == m_slots.end()) return;
+
+        const InstanceSlot slot = slotIt->second;
+        m_slots.erase(slotIt);
+
+        // Swap the last instance into the freed slot so the arrays stay packed
+        MachineBatch& batch = m_batches[slot.batch];
+        const uint32_t last = static_cast<uint32_t>(batch.entities.size()) - 1;
+        if (slot.index != last)
+        {
+            batch.entities[slot.index] = batch.entities[last];
+            batch.states[slot.index] = batch.states[last];
+            batch.stateTimes[slot.index] = batch.stateTimes[last];
+            batch.blendTimes[slot.index] = batch.blendTimes[last];
+            batch.blendElapsed[slot.index] = batch.blendElapsed[last];
+            batch.blendFrom[slot.index] = batch.blendFrom[last];
+            batch.pending[slot.index] = batch.pending[last];
+            std::copy_n(batch.parameters.begin() + static_cast<size_t>(last) * batch.parameterCount, batch.parameterCount,
+                batch.parameters.begin() + static_cast<size_t>(slot.index) * batch.parameterCount);
+            m_slots[batch.entities[slot.index]].index = slot.index;
+        }
+
+        batch.entities.pop_back();
+        batch.states.pop_back();
+        batch.stateTimes.pop_back();
+        batch.blendTimes.pop_back();
+        batch.blendElapsed.pop_back();
+        batch.blendFrom.pop_back();
+        batch.pending.pop_back();
+        batch.parameters.resize(batch.parameters.size() - batch.parameterCount);
+
+        // The batch holds the last reference to a replaced machine, drop both with the last instance
+        if (batch.entities.empty())
+        {
+            eraseBatch(slot.batch);
+        }
+    }
+
+    void AnimatorStateMachineSystem::clear()
+    {
+        m_batches.clear();
+        m_batchLookup.clear();
+        m_slots.clear();
+        m_stateChanges.clear();
+        m_controllers.clear();
+        m_failedControllers.clear();
+    }
+
+    void AnimatorStateMachineSystem::setController(const std::string& controllerPath, std::shared_ptr<const AnimatorStateMachine> machine)
+    {
+        if (!machine) return;
+
+        m_controllers[controllerPath] = machine;
+        m_failedControllers.erase(controllerPath);
+
+        std::vector<entt::entity> bound;
+        for (const auto& [entity, slot] : m_slots)
+        {
+            if (slot.controllerPath == controllerPath) bound.push_back(entity);
+        }
+        for (auto entity : bound)
+        {
+            bindInstance(entity, machine, controllerPath);
+        }
+    }
+
+    void AnimatorStateMachineSystem::syncBindings(entt::registry& registry)
+    {
+        for (auto [entity, controller] : registry.view<TeaComponents::AnimatorControllerComponent>().each())
+        {
+            auto slotIt = m_slots.find(entity);
+            if (slotIt != m_slots.end() && slotIt->second.controllerPath == controller.controllerPath) continue;
+
+            if (controller.controllerPath.empty())
+            {
+                unbind(entity);
+                continue;
+            }
+
+            // The component wins over a binding made from code
+            if (auto machine = loadController(controller.controllerPath))
+            {
+                bindInstance(entity, std::move(machine), controller.controllerPath);
+            }
+        }
+
+        // Entities whose component was removed, bindings made from code are left alone
+        std::vector<entt::entity> removed;
+        for (const auto& [entity, slot] : m_slots)
+        {
+            if (!slot.controllerPath.empty() && registry.valid(entity) && !registry.all_of<TeaComponents::AnimatorControllerComponent>(entity))
+            {
+                removed.push_back(entity);
+            }
+        }
+        for (auto entity : removed)
+        {
+            unbind(entity);
+        }
+    }
+
+    std::shared_ptr<const AnimatorStateMachine> AnimatorStateMachineSystem::loadController(const std::string& controllerPath)
+    {
+        auto it = m_controllers.find(controllerPath);
+        if (it != m_controllers.end())
+        {
+            if (auto machine = it->second.lock()) return machine;
+            m_controllers.erase(it);
+        }
+        if (m_failedControllers.count(controllerPath)) return nullptr;
+
+        AnimatorControllerDesc desc;
+        std::string error;
+        std::shared_ptr<const AnimatorStateMachine> machine;
+        if (!desc.loadFromFile(controllerPath) || !(machine = AnimatorStateMachine::compile(desc, error)))
+        {
+            TEA_ERROR("Failed to bind animator controller {0}: {1}", controllerPath, error.empty() ? "cannot load file" : error);
+            m_failedControllers.insert(controllerPath);
+            return nullptr;
+        }
+
+        m_controllers.emplace(controllerPath, machine);
+        return machine;
+    }
+
+    void AnimatorStateMachineSystem::setParameter(entt::entity entity, uint16_t parameter, float value)
+    {
+        auto slotIt = m_slots.find(entity);
+        if (slotIt == m_slots.end()) return;
+
+        MachineBatch& batch = m_batches[slotIt->second.batch];
+        if (parameter >= batch.parameterCount) return;
+
+        batch.parameters[static_cast<size_t>(slotIt->second.index) * batch.parameterCount + parameter] = value;
+    }
+
+    void AnimatorStateMachineSystem::setParameter(entt::entity entity, std::string_view parameterName, float value)
+    {
+        if (const AnimatorStateMachine* machine = getStateMachine(entity))
+        {
+            setParameter(entity, machine->getParameterIndex(parameterName), value);
+        }
+    }
+
+    float AnimatorStateMachineSystem::getParameter(entt::entity entity, uint16_t parameter) const
+    {
+        auto slotIt = m_slots.find(entity);
+        if (slotIt == m_slots.end()) return 0.0f;
+
+        const MachineBatch& batch = m_batches[slotIt->second.batch];
+        if (parameter >= batch.parameterCount) return 0.0f;
+
+        return batch.parameters[static_cast<size_t>(slotIt->second.index) * batch.parameterCount + parameter];
+    }
+
+    uint16_t AnimatorStateMachineSystem::getCurrentState(entt::entity entity) const
+    {
+        auto slotIt = m_slots.find(entity);
+        if (slotIt == m_slots.end()) return AnimatorStateMachine::InvalidIndex;
+
+        return m_batches[slotIt->second.batch].states[slotIt->second.index];
+    }
+
+    float AnimatorStateMachineSystem::getBlendWeight(entt::entity entity) const
+    {
+        auto slotIt = m_slots.find(entity);
+        if (slotIt == m_slots.end()) return 1.0f;
+
+        const MachineBatch& batch = m_batches[slotIt->second.batch];
+        const float blendTime = batch.blendTimes[slotIt->second.index];
+        return blendTime > 0.0f ? std::min(1.0f, batch.blendElapsed[slotIt->second.index] / blendTime) : 1.0f;
+    }
+
+    bool AnimatorStateMachineSystem::blendPose(entt::entity entity, TeaComponents::Transform& transform) const
+    {
+        const float weight = getBlendWeight(entity);
+        if (weight >= 1.0f) return false;
+
+        const auto slotIt = m_slots.find(entity);
+        const BlendPose& from = m_batches[slotIt->second.batch].blendFrom[slotIt->second.index];
+
+        // Rotations go through quaternions so the blend takes the short way around
+        const glm::quat fromRotation(glm::radians(from.rotation));
+        const glm::quat toRotation(glm::radians(transform.getRotation()));
+        transform.setPosition(glm::mix(from.position, transform.getPosition(), weight));
+        transform.setRotation(glm::degrees(glm::eulerAngles(glm::slerp(fromRotation, toRotation, weight))));
+        transform.setScale(glm::mix(from.scale, transform.getScale(), weight));
+        return true;
+    }
+
+    const AnimatorStateMachine* AnimatorStateMachineSystem::getStateMachine(entt::entity entity) const
+    {
+        auto slotIt = m_slots.find(entity);
+        return slotIt == m_slots.end() ? nullptr : m_batches[slotIt->second.batch].machine.get();
+    }
+
+    void AnimatorStateMachineSystem::evaluateRange(MachineBatch& batch, uint32_t begin, uint32_t end, float deltaTime)
+    {
+        const AnimatorStateMachine& machine = *batch.machine;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            if (batch.pending[i] == EnterDefaultState) continue;
+
+            const uint16_t state = batch.states[i];
+            batch.stateTimes[i] += deltaTime * machine.getStateSpeed(state);
+            batch.blendElapsed[i] += deltaTime;
+            batch.pending[i] = machine.findTransition(state, batch.stateTimes[i],
+                batch.parameters.data() + static_cast<size_t>(i) * batch.parameterCount);
+        }
+    }
+
+    void AnimatorStateMachineSystem::update(entt::registry& registry, float deltaTime, btEngine::JobSystem* jobSystem)
+    {
+        m_stateChanges.clear();
+        syncBindings(registry);
+
+        // Evaluation pass, every instance only touches its own entries so ranges run in parallel
+        std::vector<btEngine::JobHandle> evaluations;
+        for (auto& batch : m_batches)
+        {
+            const uint32_t count = static_cast<uint32_t>(batch.entities.size());
+            if (jobSystem && count > InstancesPerJob)
+            {
+                const uint32_t groupCount = btEngine::JobSystem::getGroupCount(count, InstancesPerJob);
+                evaluations.push_back(jobSystem->dispatch(groupCount, 1, [this, &batch, count, deltaTime](btEngine::JobArgs args)
+                {
+                    const uint32_t begin = args.jobIndex * InstancesPerJob;
+                    evaluateRange(batch, begin, std::min(begin + InstancesPerJob, count), deltaTime);
+                }));
+            }
+            else
+            {
+                evaluateRange(batch, 0, count, deltaTime);
+            }
+        }
+        for (const auto& evaluation : evaluations)
+        {
+            jobSystem->wait(evaluation);
+        }
+
+        // Apply pass on the calling thread
+        std::vector<entt::entity> destroyed;
+        for (auto& batch : m_batches)
+        {
+            const AnimatorStateMachine& machine = *batch.machine;
+            for (uint32_t i = 0; i < batch.entities.size(); i++)
+            {
+                if (!registry.valid(batch.entities[i]))
+                {
+                    destroyed.push_back(batch.entities[i]);
+                    continue;
+                }
+
+                const uint32_t pending = batch.pending[i];
+                if (pending == AnimatorStateMachine::NoTransition) continue;
+
+                batch.pending[i] = AnimatorStateMachine::NoTransition;
+
+                AnimatorStateChange change{ batch.entities[i], AnimatorStateMachine::InvalidIndex, batch.states[i], 0.0f };
+                if (pending != EnterDefaultState)
+                {
+                    const auto& transition = machine.getTransition(pending);
+                    machine.consumeTriggers(pending, batch.parameters.data() + static_cast<size_t>(i) * batch.parameterCount);
+                    change.previousState = batch.states[i];
+                    change.state = transition.target;
+                    change.blendTime = transition.blendTime;
+                }
+
+                // The crossfade starts from the pose the entity holds right before the new clip plays
+                float blendTime = change.blendTime;
+                if (blendTime > 0.0f)
+                {
+                    if (const auto* transform = registry.try_get<TeaComponents::Transform>(batch.entities[i]))
+                    {
+                        batch.blendFrom[i] = { transform->getPosition(), transform->getRotation(), transform->getScale() };
+                    }
+                    else
+                    {
+                        blendTime = 0.0f;
+                    }
+                }
+
+                batch.states[i] = change.state;
+                batch.stateTimes[i] = 0.0f;
+                batch.blendTimes[i] = blendTime;
+                batch.blendElapsed[i] = 0.0f;
+                m_stateChanges.push_back(change);
+            }
+        }
+
+        for (auto entity : destroyed)
+        {
+            unbind(entity);
+        }
+
+        // Only the instances that switched state touch their animator
+        for (const auto& change : m_stateChanges)
+        {
+            auto* animator = registry.try_get<TeaComponents::BjornAnimator>(change.entity);
+            const AnimatorStateMachine* machine = getStateMachine(change.entity);
+            if (!animator || !machine) continue;
+
+            const std::string& clip = machine->getStateClip(change.state);
+            if (!clip.empty())
+            {
+                Animator::PlayClip(*animator, clip);
+            }
+        }
+    }
+
+    uint32_t AnimatorStateMachineSystem::findOrCreateBatch(const std::shared_ptr<const AnimatorStateMachine>& machine)
+    {
+        auto it = m_batchLookup.find(machine.get());
+        if (it != m_batchLookup.end())
+        {
+            return it->second;
+        }
+
+        uint32_t batchIndex = static_cast<uint32_t>(m_batches.size());
+        MachineBatch& batch = m_batches.emplace_back();
+        batch.machine = machine;
+        batch.parameterCount = machine->getParameterCount();
+        m_batchLookup.emplace(machine.get(), batchIndex);
+        return batchIndex;
+    }
+
+    void AnimatorStateMachineSystem::eraseBatch(uint32_t batchIndex)
+    {
+        m_batchLookup.erase(m_batches[batchIndex].machine.get());
+
+        // Swap the last batch into the freed index and repoint its instances
+        const uint32_t last = static_cast<uint32_t>(m_batches.size()) - 1;
+        if (batchIndex != last)
+        {
+            m_batches[batchIndex] = std::move(m_batches[last]);
+            m_batchLookup[m_batches[batchIndex].machine.get()] = batchIndex;
+            for (auto entity : m_batches[batchIndex].entities)
+            {
+                m_slots[entity].batch = batchIndex;
+            }
+        }
+        m_batches.pop_back();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      AnimatorStateMachine.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- AnimatorControllerDesc authoring data (parameters, states, transitions, conditions)
+- AnimatorStateMachine compiled into flat index based transition tables
+- AnimatorStateMachineSystem evaluating every bound animator in one batched pass
+- AnimatorControllerComponent saving the controller binding of an entity with the scene
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include "../Graphics/Animator.hpp"
+#include "../Core/JobSystem.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAnimation
+{
+    enum class AnimatorParameterType : uint8_t
+    {
+        Float,
+        Int,
+        Bool,
+        Trigger     // Bool that is reset by the transition that consumes it
+    };
+
+    enum class AnimatorConditionMode : uint8_t
+    {
+        Greater,    // Float / Int
+        Less,       // Float / Int
+        Equals,     // Float / Int, exact compare so mostly meant for Int
+        NotEquals,  // Float / Int, exact compare so mostly meant for Int
+        If,         // Bool / Trigger is set
+        IfNot       // Bool is not set
+    };
+
+    struct AnimatorParameterDesc
+    {
+        std::string name;
+        AnimatorParameterType type = AnimatorParameterType::Float;
+        float defaultValue = 0.0f;
+    };
+
+    struct AnimatorConditionDesc
+    {
+        std::string parameter;
+        AnimatorConditionMode mode = AnimatorConditionMode::If;
+        float threshold = 0.0f;
+    };
+
+    struct AnimatorStateDesc
+    {
+        std::string name;
+        std::string clip;           // Key of the clip in BjornAnimator::animationClips
+        float speed = 1.0f;         // Scales the state time used by exit times
+    };
+
+    struct AnimatorTransitionDesc
+    {
+        std::string from;           // Empty for a transition from any state
+        std::string to;
+        float blendTime = 0.1f;     // Seconds
+        float exitTime = -1.0f;     // Seconds in the source state before the transition can fire, negative for none
+        std::vector<AnimatorConditionDesc> conditions;  // Every condition must pass
+    };
+
+    /**
+     * @brief Animator controller graph as authored in the editor and saved to disk
+     *
+     * Names are only used here, compiling turns every reference into an index.
+    */
+    struct AnimatorControllerDesc
+    {
+        std::string name;
+        std::string defaultState;   // First state when empty
+        std::vector<AnimatorParameterDesc> parameters;
+        std::vector<AnimatorStateDesc> states;
+        std::vector<AnimatorTransitionDesc> transitions;
+
+        bool saveToFile(const std::string& filePath) const;
+        bool loadFromFile(const std::string& filePath);
+
+        /**
+         * @brief Renames a state along with the default state and every transition pointing at it
+         * @param oldName Current name of the state
+         * @param newName New name of the state
+         * @return False if no state has the old name
+        */
+        bool renameState(const std::string& oldName, const std::string& newName);
+    };
+
+    /**
+     * @brief Immutable state machine compiled from an AnimatorControllerDesc
+     *
+     * This class handles:
+     * 1. Validating the authored graph and resolving every name to an index
+     * 2. Storing transitions per source state as one flat array with a row offset table
+     * 3. Storing every condition of every transition in one flat array
+     * 4. Finding the transition that fires for one instance's state, time and parameters
+     *
+     * Row i of the offset table holds the transitions of state i, the last row holds the
+     * any state transitions which are checked first.
+    */
+    class AnimatorStateMachine
+    {
+    public:
+        static constexpr uint16_t InvalidIndex = 0xFFFF;
+        static constexpr uint32_t NoTransition = 0xFFFFFFFF;
+
+        struct Condition
+        {
+            uint16_t parameter;
+            AnimatorConditionMode mode;
+            AnimatorParameterType type;
+            float threshold;
+        };
+
+        struct Transition
+        {
+            uint32_t firstCondition;
+            uint16_t conditionCount;
+            uint16_t target;
+            float blendTime;
+            float exitTime;
+        };
+
+        /**
+         * @brief Compiles an authored controller
+         * @param desc Controller to compile
+         * @param error Set to the reason when compiling fails
+         * @return Compiled state machine, nullptr if the controller is invalid
+        */
+        static std::shared_ptr<const AnimatorStateMachine> compile(const AnimatorControllerDesc& desc, std::string& error);
+
+        /**
+         * @brief Finds the first transition that fires for one instance
+         * @param state Current state of the instance
+         * @param stateTime Scaled time spent in the current state
+         * @param parameters Parameter values of the instance, getParameterCount() floats
+         * @return Index of the transition, NoTransition if none fires
+        */
+        uint32_t findTransition(uint16_t state, float stateTime, const float* parameters) const;
+
+        /**
+         * @brief Resets the trigger parameters tested by a transition that fired
+         * @param transition Index of the transition
+         * @param parameters Parameter values of the instance
+        */
+        void consumeTriggers(uint32_t transition, float* parameters) const;
+
+        uint16_t getParameterIndex(std::string_view parameterName) const;
+        uint16_t getStateIndex(std::string_view stateName) const;
+
+        const std::string& getName() const { return m_name; }
+        uint16_t getDefaultState() const { return m_defaultState; }
+        uint16_t getStateCount() const { return static_cast<uint16_t>(m_stateNames.size()); }
+        uint16_t getParameterCount() const { return static_cast<uint16_t>(m_parameterNames.size()); }
+        const std::string& getStateName(uint16_t state) const { return m_stateNames[state]; }
+        const std::string& getStateClip(uint16_t state) const { return m_stateClips[state]; }
+        float getStateSpeed(uint16_t state) const { return m_stateSpeeds[state]; }
+        const std::string& getParameterName(uint16_t parameter) const { return m_parameterNames[parameter]; }
+        AnimatorParameterType getParameterType(uint16_t parameter) const { return m_parameterTypes[parameter]; }
+        const std::vector<float>& getDefaultParameters() const { return m_defaultParameters; }
+        const Transition& getTransition(uint32_t transition) const { return m_transitions[transition]; }
+
+    private:
+        bool conditionsPass(const Transition& transition, const float* parameters) const;
+
+        std::string                         m_name;
+        uint16_t                            m_defaultState = 0;
+        std::vector<std::string>            m_stateNames;
+        std::vector<std::string>            m_stateClips;
+        std::vector<float>                  m_stateSpeeds;
+        std::vector<std::string>            m_parameterNames;
+        std::vector<AnimatorParameterType>  m_parameterTypes;
+        std::vector<float>                  m_defaultParameters;
+        std::vector<uint32_t>               m_transitionOffsets;   // stateCount + 2 entries, any state row last
+        std::vector<Transition>             m_transitions;
+        std::vector<Condition>              m_conditions;
+    };
+
+    /**
+     * @brief State switch produced by the last update
+    */
+    struct AnimatorStateChange
+    {
+        entt::entity entity;
+        uint16_t previousState;     // InvalidIndex when entering the default state
+        uint16_t state;
+        float blendTime;
+    };
+
+}
+
+namespace TeaComponents
+{
+    /**
+     * @brief Controller file an entity's animator runs, saved with the scene
+     *
+     * AnimatorStateMachineSystem binds every entity holding it on its next update, so the
+     * binding survives scene reloads. Registered with the component reflection as
+     * "Animator Controller" with a "Controller Path" property.
+    */
+    struct AnimatorControllerComponent
+    {
+        std::string controllerPath;
+    };
+}
+
+namespace TeaAnimation
+{
+    /**
+     * @brief Runs the state machines of every bound animator
+     *
+     * This class handles:
+     * 1. Grouping bound entities by compiled state machine, with per batch parallel arrays
+     *    for the current state, state time, blend time and parameter values
+     * 2. Setting parameters by index (resolved once with getParameterIndex) or by name
+     * 3. Evaluating every instance in one pass, split over the job system for large counts
+     * 4. Applying the state switches on the main thread, calling Animator::PlayClip only
+     *    when the state actually changes
+     * 5. Crossfading from the pose held at the switch over the transition's blend time,
+     *    through blendPose once the animator wrote the new clip's pose
+     * 6. Binding the entities holding an AnimatorControllerComponent, one compiled machine per
+     *    controller file, and rebinding them when the controller is recompiled
+     *
+     * A machine is only kept alive by its batch, the batch is erased with its last instance.
+    */
+    class AnimatorStateMachineSystem
+    {
+    public:
+        /**
+         * @brief Binds a state machine to an entity, which enters the default state on the next update
+         * @param entity Entity with a BjornAnimator
+         * @param machine Compiled state machine, rebinding moves the entity to the new machine
+        */
+        void bind(entt::entity entity, std::shared_ptr<const AnimatorStateMachine> machine);
+        void unbind(entt::entity entity);
+
+        /**
+         * @brief Replaces the compiled machine of a controller file (hot reload)
+         *
+         * Every entity bound to the file moves to the new machine and enters its default state,
+         * the old machine is freed along with its batch.
+         *
+         * @param controllerPath File the AnimatorControllerComponent of the entities points at
+         * @param machine Newly compiled state machine
+        */
+        void setController(const std::string& controllerPath, std::shared_ptr<const AnimatorStateMachine> machine);
+
+        /**
+         * @brief Binds the entities whose AnimatorControllerComponent changed, and unbinds the ones that lost it
+         * @param registry Registry the entities live in
+        */
+        void syncBindings(entt::registry& registry);
+        void clear();
+
+        bool isBound(entt::entity entity) const { return m_slots.find(entity) != m_slots.end(); }
+
+        /**
+         * @brief Sets a parameter of one instance
+         * @param entity Bound entity
+         * @param parameter Index from AnimatorStateMachine::getParameterIndex
+         * @param value New value, bools and triggers use 0 / 1
+        */
+        void setParameter(entt::entity entity, uint16_t parameter, float value);
+        void setParameter(entt::entity entity, std::string_view parameterName, float value);
+        void setTrigger(entt::entity entity, uint16_t parameter) { setParameter(entity, parameter, 1.0f); }
+
+        float getParameter(entt::entity entity, uint16_t parameter) const;
+        uint16_t getCurrentState(entt::entity entity) const;
+        float getBlendWeight(entt::entity entity) const;    // 1 once the last transition finished blending
+        const AnimatorStateMachine* getStateMachine(entt::entity entity) const;
+
+        /**
+         * @brief Crossfades the pose the animator just wrote with the pose held when the state switched
+         *
+         * Call after the animator sampled the clip of the current state this frame. Does nothing
+         * once the blend weight reaches 1.
+         *
+         * @param entity Bound entity
+         * @param transform Transform of the entity, holding the pose of the new clip
+         * @return true if the transform was blended
+        */
+        bool blendPose(entt::entity entity, TeaComponents::Transform& transform) const;
+
+        /**
+         * @brief Syncs the component bindings, advances and evaluates every bound instance, then switches
+         *        the clips of the ones that changed state
+         * @param registry Registry the bound entities live in
+         * @param deltaTime Frame time in seconds
+         * @param jobSystem Job system to evaluate on, nullptr evaluates on the calling thread
+        */
+        void update(entt::registry& registry, float deltaTime, btEngine::JobSystem* jobSystem = nullptr);
+
+        const std::vector<AnimatorStateChange>& getStateChanges() const { return m_stateChanges; }
+        size_t getInstanceCount() const { return m_slots.size(); }
+
+    private:
+        static constexpr uint32_t EnterDefaultState = 0xFFFFFFFE;
+        static constexpr uint32_t InstancesPerJob = 256;
+
+        // Transform held when the last transition started, the crossfade starts from it
+        struct BlendPose
+        {
+            glm::vec3 position{ 0.0f };
+            glm::vec3 rotation{ 0.0f };     // Euler degrees, like Transform
+            glm::vec3 scale{ 1.0f };
+        };
+
+        struct MachineBatch
+        {
+            std::shared_ptr<const AnimatorStateMachine> machine;
+            uint32_t parameterCount = 0;
+            std::vector<entt::entity> entities;
+            std::vector<uint16_t> states;
+            std::vector<float> stateTimes;
+            std::vector<float> blendTimes;          // Blend duration of the last transition
+            std::vector<float> blendElapsed;
+            std::vector<BlendPose> blendFrom;
+            std::vector<uint32_t> pending;          // Transition found by the evaluation pass
+            std::vector<float> parameters;          // parameterCount floats per instance
+        };
+
+        struct InstanceSlot
+        {
+            uint32_t batch;
+            uint32_t index;
+            std::string controllerPath;             // Empty when bound from code rather than from the component
+        };
+
+        void bindInstance(entt::entity entity, std::shared_ptr<const AnimatorStateMachine> machine, const std::string& controllerPath);
+        void evaluateRange(MachineBatch& batch, uint32_t begin, uint32_t end, float deltaTime);
+        uint32_t findOrCreateBatch(const std::shared_ptr<const AnimatorStateMachine>& machine);
+        void eraseBatch(uint32_t batchIndex);
+        std::shared_ptr<const AnimatorStateMachine> loadController(const std::string& controllerPath);
+
+        std::vector<MachineBatch>                                   m_batches;
+        std::unordered_map<const AnimatorStateMachine*, uint32_t>   m_batchLookup;
+        std::unordered_map<entt::entity, InstanceSlot>              m_slots;
+        std::vector<AnimatorStateChange>                            m_stateChanges;
+
+        // Compiled controller files, weak so the machine goes with its last batch
+        std::unordered_map<std::string, std::weak_ptr<const AnimatorStateMachine>>  m_controllers;
+        std::unordered_set<std::string>                                             m_failedControllers;   // Not retried until recompiled
+    };
+}
@@ -0,0 +1,135 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      Archetype.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Archetype pool reservation and batched component insertion
+- ArchetypeLibrary registration and entity creation
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Archetype.hpp"
+
+/*                                                              function definitions
+====================================================================================*/
+namespace SceneManager
+{
+    std::unordered_map<std::string, std::shared_ptr<const Archetype>>   ArchetypeLibrary::s_archetypes;
+    std::mutex                                                          ArchetypeLibrary::s_mutex;
+
+    void Archetype::reserve(entt::registry& registry, size_t additional) const
+    {
+        for (const auto& component : m_components)
+        {
+            component.reserve(registry, additional);
+        }
+    }
+
+    void Archetype::apply(btEngine::Entity* entities, size_t count) const
+    {
+        if (count == 0) return;
+
+        // One pass per pool, so each sparse set and packed array stays hot for the whole range
+        for (const auto& component : m_components)
+        {
+            component.insert(entities, count);
+        }
+    }
+
+    void ArchetypeLibrary::registerArchetype(Archetype archetype)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::string name = archetype.getName();
+        s_archetypes[name] = std::make_shared<const Archetype>(std::move(archetype));
+    }
+
+    bool ArchetypeLibrary::unregisterArchetype(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_archetypes.erase(name) > 0;
+    }
+
+    std::shared_ptr<const Archetype> ArchetypeLibrary::find(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_archetypes.find(name);
+        return it != s_archetypes.end() ? it->second : nullptr;
+    }
+
+    std::vector<std::string> ArchetypeLibrary::getNames()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::vector<std::string> names;
+        names.reserve(s_archetypes.size());
+        for (const auto& [name, archetype] : s_archetypes)
+        {
+            names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    void ArchetypeLibrary::clear()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_archetypes.clear();
+    }
+
+    btEngine::Entity ArchetypeLibrary::instantiate(sceneManager* sceneManager, const std::string& name)
+    {
+        auto archetype = find(name);
+        if (!archetype)
+        {
+            TEA_WARNING("Unknown archetype: {0}", name);
+            return {};
+        }
+
+        btEngine::Entity entity = sceneManager->createEntity();
+        archetype->apply(&entity, 1);
+        return entity;
+    }
+
+    size_t ArchetypeLibrary::instantiate(sceneManager* sceneManager, const std::string& name, size_t count,
+        std::vector<btEngine::Entity>& outEntities)
+    {
+        auto archetype = find(name);
+        if (!archetype)
+        {
+            TEA_WARNING("Unknown archetype: {0}", name);
+            return 0;
+        }
+        if (count == 0) return 0;
+
+        auto* registry = sceneManager->getRegistry();
+        archetype->reserve(*registry, count);
+
+        // The scene manager still creates each entity (UUID, scene bookkeeping),
+        // the archetype components are then added pool by pool for the whole batch
+        const size_t first = outEntities.size();
+        outEntities.reserve(first + count);
+        for (size_t i = 0; i < count; i++)
+        {
+            outEntities.push_back(sceneManager->createEntity());
+        }
+
+        archetype->apply(outEntities.data() + first, count);
+        return count;
+    }
+
+    bool ArchetypeLibrary::applyTo(sceneManager* sceneManager, btEngine::Entity& entity, const std::string& name)
+    {
+        auto archetype = find(name);
+        if (!archetype)
+        {
+            TEA_WARNING("Unknown archetype: {0}", name);
+            return false;
+        }
+
+        archetype->apply(&entity, 1);
+        return true;
+    }
+}
@@ -0,0 +1,172 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      Archetype.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Archetype class describing a named component set with default values
+- ArchetypeLibrary class creating entities from archetypes, one at a time or in batches
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "../Core/entity.hpp"
+#include "../Core/Scenemanager.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace SceneManager
+{
+    /**
+     * @brief Named set of components with default values, the template of an entity kind
+     *
+     * This class handles:
+     * 1. Remembering each component type and its default value, in the order they were added
+     * 2. Reserving room in every pool it touches ahead of a spawn wave
+     * 3. Adding all of its components to a range of entities, one pool at a time
+    */
+    class Archetype
+    {
+    public:
+        explicit Archetype(std::string name) : m_name(std::move(name)) {}
+
+        /**
+         * @brief Adds a component to the archetype, replacing the defaults if it is already part of it
+         * @param defaults Value every created entity starts with
+         * @return This archetype, for chaining
+        */
+        template<typename Component>
+        Archetype& add(Component defaults = Component{})
+        {
+            ComponentEntry entry;
+            entry.type = entt::type_hash<Component>::value();
+            entry.reserve = [](entt::registry& registry, size_t additional)
+            {
+                auto& storage = registry.storage<Component>();
+                storage.reserve(storage.size() + additional);
+            };
+            entry.insert = [value = std::move(defaults)](btEngine::Entity* entities, size_t count)
+            {
+                // Through the entity so the scene manager's add hooks run, reserve grows the
+                // pools ahead of a batch so it still fills each one without reallocating.
+                // Entities the scene manager already gave this component (e.g. a Transform) get
+                // the archetype defaults instead
+                for (size_t i = 0; i < count; i++)
+                {
+                    btEngine::Entity& entity = entities[i];
+                    if (entity.hasComponent<Component>())
+                    {
+                        entity.getComponent<Component>() = value;
+                    }
+                    else
+                    {
+                        entity.addComponent<Component>() = value;
+                    }
+                }
+            };
+
+            auto it = std::find_if(m_components.begin(), m_components.end(),
+                [&entry](const ComponentEntry& existing) { return existing.type == entry.type; });
+            if (it != m_components.end())
+            {
+                *it = std::move(entry);
+            }
+            else
+            {
+                m_components.push_back(std::move(entry));
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Grows every pool of the archetype so the next spawns do not reallocate
+         * @param registry Registry to reserve in
+         * @param additional Number of entities about to be created
+        */
+        void reserve(entt::registry& registry, size_t additional) const;
+
+        /**
+         * @brief Adds every component of the archetype to existing entities, one pool at a time
+         * @param entities Entities to fill
+         * @param count Number of entities
+        */
+        void apply(btEngine::Entity* entities, size_t count) const;
+
+        const std::string& getName() const { return m_name; }
+        size_t getComponentCount() const { return m_components.size(); }
+
+    private:
+        struct ComponentEntry
+        {
+            entt::id_type type = 0;
+            std::function<void(entt::registry&, size_t)> reserve;
+            std::function<void(btEngine::Entity*, size_t)> insert;
+        };
+
+        std::string                 m_name;
+        std::vector<ComponentEntry> m_components;
+    };
+
+    /**
+     * @brief Registered archetypes, looked up by name by the editor, commands and gameplay spawns
+     *
+     * This class handles:
+     * 1. Registering, replacing and finding archetypes by name
+     * 2. Creating one entity, or a batch of them, from an archetype
+     * 3. Re-applying an archetype when an undone creation is redone
+    */
+    class ArchetypeLibrary
+    {
+    public:
+        static void registerArchetype(Archetype archetype);
+        static bool unregisterArchetype(const std::string& name);
+        static std::shared_ptr<const Archetype> find(const std::string& name);
+        static std::vector<std::string> getNames();
+        static void clear();
+
+        /**
+         * @brief Creates an entity with every component of an archetype
+         * @param sceneManager Scene to create the entity in
+         * @param name Archetype name
+         * @return Created entity, an empty entity if the archetype is unknown
+        */
+        static btEngine::Entity instantiate(sceneManager* sceneManager, const std::string& name);
+
+        /**
+         * @brief Creates count entities from an archetype, filling each pool once for the whole batch
+         * @param sceneManager Scene to create the entities in
+         * @param name Archetype name
+         * @param count Number of entities
+         * @param outEntities Receives the created entities (appended)
+         * @return Number of entities created, 0 if the archetype is unknown
+        */
+        static size_t instantiate(sceneManager* sceneManager, const std::string& name, size_t count,
+            std::vector<btEngine::Entity>& outEntities);
+
+        /**
+         * @brief Adds the components of an archetype to an entity that already exists
+         * @param sceneManager Scene owning the entity
+         * @param entity Entity to fill
+         * @param name Archetype name
+         * @return False if the archetype is unknown
+        */
+        static bool applyTo(sceneManager* sceneManager, btEngine::Entity& entity, const std::string& name);
+
+    private:
+        static std::unordered_map<std::string, std::shared_ptr<const Archetype>>    s_archetypes;
+        static std::mutex                                                           s_mutex;
+    };
+}
@@ -0,0 +1,527 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      BlockCompression.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- LZ4 block format compressor and bounds checked decompressor
+- CRC32 checksums
+- Block container packing, parallel unpacking and transparent file reads
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "BlockCompression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace btEngine
+{
+    JobSystem* BlockCompression::s_jobSystem = nullptr;
+    std::atomic<bool> BlockCompression::s_compressSaves{ false };
+
+    namespace
+    {
+        constexpr size_t MinMatch = 4;
+        constexpr size_t LastLiterals = 5;          // The format ends every block with at least this many literals
+        constexpr size_t MatchSearchLimit = 12;     // No match may start closer than this to the end
+        constexpr size_t MaxOffset = 65535;
+        constexpr uint32_t HashLog = 14;
+        constexpr uint32_t RawBlockFlag = 0x80000000u;
+
+        struct BlockEntry
+        {
+            size_t srcOffset = 0;       // Stored bytes, after the block header
+            uint32_t storedSize = 0;
+            uint32_t rawSize = 0;
+            uint32_t checksum = 0;
+            bool stored = false;        // Kept uncompressed
+            size_t dstOffset = 0;
+        };
+
+        uint32_t read32(const char* ptr)
+        {
+            uint32_t value;
+            std::memcpy(&value, ptr, sizeof(value));
+            return value;
+        }
+
+        void append32(std::vector<char>& output, uint32_t value)
+        {
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            output.insert(output.end(), bytes, bytes + sizeof(value));
+        }
+
+        uint32_t hashSequence(uint32_t sequence)
+        {
+            return (sequence * 2654435761u) >> (32 - HashLog);
+        }
+
+        // Slice-by-8 tables, table[k][b] is the CRC of byte b followed by k zero bytes
+        using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+        CrcTables makeCrcTables()
+        {
+            CrcTables tables{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                }
+                tables[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (size_t k = 1; k < tables.size(); k++)
+                {
+                    tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+                }
+            }
+            return tables;
+        }
+
+        // Token, literal run, then offset and match length unless it is the last sequence
+        bool emitSequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength,
+            unsigned char*& op, const unsigned char* opEnd)
+        {
+            const size_t needed = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+            if (static_cast<size_t>(opEnd - op) < needed) return false;
+
+            unsigned char* token = op++;
+            *token = static_cast<unsigned char>(std::min<size_t>(literalLength, 15) << 4);
+            if (literalLength >= 15)
+            {
+                size_t remaining = literalLength - 15;
+                for (; remaining >= 255; remaining -= 255) *op++ = 255;
+                *op++ = static_cast<unsigned char>(remaining);
+            }
+            std::memcpy(op, literals, literalLength);
+            op += literalLength;
+
+            if (matchLength == 0) return true;
+
+            *op++ = static_cast<unsigned char>(offset & 0xFF);
+            *op++ = static_cast<unsigned char>(offset >> 8);
+
+            const size_t matchCode = matchLength - MinMatch;
+            *token |= static_cast<unsigned char>(std::min<size_t>(matchCode, 15));
+            if (matchCode >= 15)
+            {
+                size_t remaining = matchCode - 15;
+                for (; remaining >= 255; remaining -= 255) *op++ = 255;
+                *op++ = static_cast<unsigned char>(remaining);
+            }
+            return true;
+        }
+
+        bool decodeBlock(const char* data, const BlockEntry& block, char* output)
+        {
+            const char* src = data + block.srcOffset;
+            char* dst = output + block.dstOffset;
+            if (block.stored)
+            {
+                std::memcpy(dst, src, block.rawSize);
+            }
+            else if (!BlockCompression::decompressBlock(src, block.storedSize, dst, block.rawSize))
+            {
+                return false;
+            }
+            return BlockCompression::crc32(dst, block.rawSize) == block.checksum;
+        }
+
+        // Shared by the caller and the helper jobs, helpers that start late find nothing left to claim
+        struct ParallelDecode
+        {
+            const char* data = nullptr;
+            const BlockEntry* blocks = nullptr;
+            char* output = nullptr;
+            uint32_t count = 0;
+            std::atomic<uint32_t> next{ 0 };
+            std::atomic<uint32_t> done{ 0 };
+            std::atomic<int64_t> failedBlock{ -1 };
+        };
+
+        void runBlocks(ParallelDecode& state)
+        {
+            for (uint32_t index = state.next.fetch_add(1, std::memory_order_relaxed); index < state.count;
+                index = state.next.fetch_add(1, std::memory_order_relaxed))
+            {
+                if (!decodeBlock(state.data, state.blocks[index], state.output))
+                {
+                    int64_t expected = -1;
+                    state.failedBlock.compare_exchange_strong(expected, index, std::memory_order_relaxed);
+                }
+                state.done.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        bool fail(std::string* error, const std::string& message)
+        {
+            if (error) *error = message;
+            return false;
+        }
+    }
+
+    bool BlockCompression::isCompressed(std::string_view data)
+    {
+        return data.size() >= FileHeaderSize && read32(data.data()) == FileMagic;
+    }
+
+    uint32_t BlockCompression::crc32(const void* data, size_t size, uint32_t crc)
+    {
+        static const CrcTables tables = makeCrcTables();
+
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        crc = ~crc;
+
+        // Eight bytes per step on little endian loads, the byte loop only handles the tail
+        for (; size >= 8; size -= 8, bytes += 8)
+        {
+            const uint32_t low = read32(reinterpret_cast<const char*>(bytes)) ^ crc;
+            const uint32_t high = read32(reinterpret_cast<const char*>(bytes) + 4);
+            crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24] ^
+                tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^ tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+        }
+        for (; size > 0; size--, bytes++)
+        {
+            crc = tables[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    size_t BlockCompression::compressBlock(const char* src, size_t srcSize, char* dst, size_t dstCapacity)
+    {
+        const unsigned char* input = reinterpret_cast<const unsigned char*>(src);
+        unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+        const unsigned char* opEnd = op + dstCapacity;
+
+        size_t anchor = 0;
+        if (srcSize > MatchSearchLimit)
+        {
+            // Positions of the last 4 byte sequences seen, per hash. Reused per thread, blocks are compressed one after another
+            thread_local std::vector<uint32_t> table;
+            table.assign(size_t(1) << HashLog, 0);
+
+            const size_t matchLimit = srcSize - LastLiterals;
+            const size_t searchEnd = srcSize - MatchSearchLimit;
+            size_t pos = 0;
+            while (pos <= searchEnd)
+            {
+                const uint32_t sequence = read32(src + pos);
+                const uint32_t hash = hashSequence(sequence);
+                const size_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(pos);
+
+                if (candidate >= pos || pos - candidate > MaxOffset || read32(src + candidate) != sequence)
+                {
+                    // Step further the longer nothing matched, incompressible data goes through quickly
+                    pos += 1 + ((pos - anchor) >> 6);
+                    continue;
+                }
+
+                size_t start = pos;
+                size_t match = candidate;
+                while (start > anchor && match > 0 && input[start - 1] == input[match - 1])
+                {
+                    start--;
+                    match--;
+                }
+
+                size_t matchLength = pos - start + MinMatch;
+                while (start + matchLength < matchLimit && input[start + matchLength] == input[match + matchLength])
+                {
+                    matchLength++;
+                }
+
+                if (!emitSequence(input + anchor, start - anchor, start - match, matchLength, op, opEnd)) return 0;
+
+                pos = start + matchLength;
+                anchor = pos;
+                if (pos - 2 <= searchEnd)
+                {
+                    table[hashSequence(read32(src + pos - 2))] = static_cast<uint32_t>(pos - 2);
+                }
+            }
+        }
+
+        if (!emitSequence(input + anchor, srcSize - anchor, 0, 0, op, opEnd)) return 0;
+        return static_cast<size_t>(op - reinterpret_cast<unsigned char*>(dst));
+    }
+
+    bool BlockCompression::decompressBlock(const char* src, size_t srcSize, char* dst, size_t dstSize)
+    {
+        const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+        const unsigned char* ipEnd = ip + srcSize;
+        unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+        unsigned char* const opStart = op;
+        unsigned char* const opEnd = op + dstSize;
+
+        auto readLength = [&ip, ipEnd](size_t& length)
+        {
+            unsigned char byte = 255;
+            while (byte == 255)
+            {
+                if (ip >= ipEnd) return false;
+                byte = *ip++;
+                length += byte;
+            }
+            return true;
+        };
+
+        while (ip < ipEnd)
+        {
+            const unsigned char token = *ip++;
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(literalLength)) return false;
+            if (literalLength > static_cast<size_t>(ipEnd - ip) || literalLength > static_cast<size_t>(opEnd - op)) return false;
+
+            std::memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // The last sequence has no match
+            if (ip == ipEnd) break;
+
+            if (ipEnd - ip < 2) return false;
+            const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - opStart)) return false;
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(matchLength)) return false;
+            matchLength += MinMatch;
+            if (matchLength > static_cast<size_t>(opEnd - op)) return false;
+
+            const unsigned char* match = op - offset;
+            if (offset >= matchLength)
+            {
+                std::memcpy(op, match, matchLength);
+                op += matchLength;
+            }
+            else
+            {
+                // Overlapping copy repeats the last offset bytes
+                for (size_t i = 0; i < matchLength; i++) *op++ = match[i];
+            }
+        }
+        return op == opEnd;
+    }
+
+    void BlockCompression::writeFileHeader(uint32_t blockSize, std::vector<char>& output)
+    {
+        append32(output, FileMagic);
+        append32(output, static_cast<uint32_t>(FileVersion));      // u16 version, u16 flags
+        append32(output, blockSize);
+        append32(output, 0);
+    }
+
+    size_t BlockCompression::encodeBlock(const char* raw, size_t rawSize, std::vector<char>& output)
+    {
+        const size_t start = output.size();
+        output.resize(start + BlockHeaderSize + getMaxCompressedSize(rawSize));
+
+        char* payload = output.data() + start + BlockHeaderSize;
+        size_t storedSize = compressBlock(raw, rawSize, payload, getMaxCompressedSize(rawSize));
+        uint32_t sizeField = static_cast<uint32_t>(storedSize);
+        if (storedSize == 0 || storedSize >= rawSize)
+        {
+            std::memcpy(payload, raw, rawSize);
+            storedSize = rawSize;
+            sizeField = static_cast<uint32_t>(rawSize) | RawBlockFlag;
+        }
+
+        const uint32_t header[3] = { sizeField, static_cast<uint32_t>(rawSize), crc32(raw, rawSize) };
+        std::memcpy(output.data() + start, header, sizeof(header));
+        output.resize(start + BlockHeaderSize + storedSize);
+        return BlockHeaderSize + storedSize;
+    }
+
+    std::string BlockCompression::compress(std::string_view data, uint32_t blockSize)
+    {
+        blockSize = std::clamp<uint32_t>(blockSize, 1024, MaxBlockSize);
+
+        std::vector<char> output;
+        output.reserve(FileHeaderSize + data.size() / 2);
+        writeFileHeader(blockSize, output);
+        for (size_t offset = 0; offset < data.size(); offset += blockSize)
+        {
+            encodeBlock(data.data() + offset, std::min<size_t>(blockSize, data.size() - offset), output);
+        }
+        append32(output, 0);
+        return std::string(output.begin(), output.end());
+    }
+
+    bool BlockCompression::decompress(std::string_view data, std::string& output, JobSystem* jobSystem, std::string* error)
+    {
+        if (!isCompressed(data)) return fail(error, "Not a block compressed file");
+
+        const uint32_t version = read32(data.data() + 4) & 0xFFFF;
+        const uint32_t blockSize = read32(data.data() + 8);
+        if (version > FileVersion) return fail(error, "Unsupported block compression version " + std::to_string(version));
+        if (blockSize == 0 || blockSize > MaxBlockSize) return fail(error, "Invalid block size");
+
+        // Walk the block headers first, every block's position is known before any is decoded
+        std::vector<BlockEntry> blocks;
+        size_t offset = FileHeaderSize;
+        size_t rawTotal = 0;
+        bool ended = false;
+        while (offset + sizeof(uint32_t) <= data.size())
+        {
+            const uint32_t sizeField = read32(data.data() + offset);
+            if (sizeField == 0)
+            {
+                offset += sizeof(uint32_t);
+                ended = true;
+                break;
+            }
+            if (offset + BlockHeaderSize > data.size()) break;
+
+            BlockEntry block;
+            block.stored = (sizeField & RawBlockFlag) != 0;
+            block.storedSize = sizeField & ~RawBlockFlag;
+            block.rawSize = read32(data.data() + offset + 4);
+            block.checksum = read32(data.data() + offset + 8);
+            block.srcOffset = offset + BlockHeaderSize;
+            block.dstOffset = rawTotal;
+
+            if (block.rawSize > blockSize || (block.stored && block.storedSize != block.rawSize))
+            {
+                return fail(error, "Malformed header of block " + std::to_string(blocks.size()));
+            }
+            if (block.storedSize > data.size() - block.srcOffset) break;
+
+            offset = block.srcOffset + block.storedSize;
+            rawTotal += block.rawSize;
+            blocks.push_back(block);
+        }
+        if (!ended) return fail(error, "Truncated block compressed file");
+        if (offset != data.size()) return fail(error, "Trailing data after the last block");
+
+        output.resize(rawTotal);
+
+        auto state = std::make_shared<ParallelDecode>();
+        state->data = data.data();
+        state->blocks = blocks.data();
+        state->output = output.data();
+        state->count = static_cast<uint32_t>(blocks.size());
+
+        if (jobSystem && blocks.size() > 1)
+        {
+            const uint32_t helpers = std::min<uint32_t>(jobSystem->getThreadCount() - 1, state->count - 1);
+            for (uint32_t i = 0; i < helpers; i++)
+            {
+                jobSystem->execute([state](JobArgs) { runBlocks(*state); });
+            }
+        }
+
+        // The caller works too and never waits on the pool, so this is safe from a worker thread
+        runBlocks(*state);
+        while (state->done.load(std::memory_order_acquire) < state->count)
+        {
+            std::this_thread::yield();
+        }
+
+        const int64_t failedBlock = state->failedBlock.load(std::memory_order_relaxed);
+        if (failedBlock >= 0)
+        {
+            output.clear();
+            return fail(error, "Checksum mismatch in block " + std::to_string(failedBlock));
+        }
+        return true;
+    }
+
+    bool BlockCompression::readFile(const std::filesystem::path& path, std::string& contents, std::string* error)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return fail(error, "Failed to open " + path.string());
+
+        const std::streamsize size = file.tellg();
+        file.seekg(0);
+        std::string data(static_cast<size_t>(std::max<std::streamsize>(size, 0)), '\0');
+        if (!file.read(data.data(), size)) return fail(error, "Failed to read " + path.string());
+
+        if (!isCompressed(data))
+        {
+            contents = std::move(data);
+            return true;
+        }
+        return decompress(data, contents, s_jobSystem, error);
+    }
+
+    bool BlockCompression::writeFile(const std::filesystem::path& path, std::string_view contents, bool compressed)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+
+        if (compressed)
+        {
+            const std::string packed = compress(contents);
+            file.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+        }
+        else
+        {
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+        return static_cast<bool>(file);
+    }
+
+    BlockCompressedWriter::BlockCompressedWriter(std::FILE* file, uint32_t blockSize)
+        : m_file(file), m_raw(std::clamp<uint32_t>(blockSize, 1024, BlockCompression::MaxBlockSize))
+    {
+        BlockCompression::writeFileHeader(static_cast<uint32_t>(m_raw.size()), m_encoded);
+    }
+
+    void BlockCompressedWriter::write(const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            if (m_used == m_raw.size())
+            {
+                writeBlock();
+            }
+            const size_t count = std::min(size, m_raw.size() - m_used);
+            std::memcpy(m_raw.data() + m_used, data, count);
+            m_used += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void BlockCompressedWriter::writeBlock()
+    {
+        if (m_used > 0)
+        {
+            BlockCompression::encodeBlock(m_raw.data(), m_used, m_encoded);
+            m_used = 0;
+        }
+        if (!m_encoded.empty())
+        {
+            m_good = m_good && std::fwrite(m_encoded.data(), 1, m_encoded.size(), m_file) == m_encoded.size();
+            m_encoded.clear();
+        }
+    }
+
+    bool BlockCompressedWriter::finish()
+    {
+        if (!m_finished)
+        {
+            writeBlock();
+            const uint32_t endMarker = 0;
+            m_good = m_good && std::fwrite(&endMarker, sizeof(endMarker), 1, m_file) == 1;
+            m_finished = true;
+        }
+        return m_good;
+    }
+}
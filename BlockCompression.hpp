@@ -0,0 +1,183 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      BlockCompression.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- BlockCompression class, LZ4 block codec and checksummed block container
+- Transparent file reading for plain and compressed asset files
+- BlockCompressedWriter streaming output into the container
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Core/JobSystem.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace btEngine
+{
+    /**
+     * @brief Optional fast compression for scene, prefab and clip files
+     *
+     * This class handles:
+     * 1. Compressing and decompressing single blocks in the LZ4 block format
+     * 2. Packing data into independent blocks, each with a CRC32 of its raw bytes
+     * 3. Decompressing blocks in parallel on the job system
+     * 4. Reading a file whether it is plain text or compressed, so loaders do not care
+     *
+     * File layout (native endianness):
+     * u32 magic, u16 version, u16 flags, u32 blockSize, u32 reserved, then per block:
+     * u32 storedSize (top bit set when stored uncompressed), u32 rawSize, u32 crc32, stored bytes,
+     * and a u32 0 after the last block.
+     *
+     * Blocks are read and checked sequentially only for their headers, so any number of
+     * threads can decompress them at once. Blocks that do not shrink are stored as is.
+    */
+    class BlockCompression
+    {
+    public:
+        static constexpr uint32_t FileMagic = 0x5A4C4254;          // "TBLZ"
+        static constexpr uint16_t FileVersion = 1;
+        static constexpr uint32_t DefaultBlockSize = 256 * 1024;
+        static constexpr uint32_t MaxBlockSize = 4 * 1024 * 1024;
+        static constexpr size_t FileHeaderSize = 16;
+        static constexpr size_t BlockHeaderSize = 12;
+
+        // True if the data starts with the container magic, plain JSON never does
+        static bool isCompressed(std::string_view data);
+
+        /**
+         * @brief Packs data into compressed blocks
+         * @param data Raw bytes
+         * @param blockSize Raw bytes per block, clamped to MaxBlockSize
+         * @return Container bytes
+        */
+        static std::string compress(std::string_view data, uint32_t blockSize = DefaultBlockSize);
+
+        /**
+         * @brief Unpacks a container, checking every block's checksum
+         * @param data Container bytes
+         * @param output Receives the raw bytes
+         * @param jobSystem Optional, blocks are shared out between its workers and the caller
+         * @param error Optional, receives the reason of a failure
+         * @return False if the container is truncated, malformed or corrupted
+        */
+        static bool decompress(std::string_view data, std::string& output, JobSystem* jobSystem = nullptr, std::string* error = nullptr);
+
+        /**
+         * @brief Reads a whole file, decompressing it if needed
+         *
+         * Uses the job system set with setJobSystem. Safe to call from worker threads, the
+         * caller decompresses blocks itself instead of waiting on the pool.
+         *
+         * @param path File to read
+         * @param contents Receives the raw file contents
+         * @param error Optional, receives the reason of a failure
+         * @return False if the file could not be read or decompressed
+        */
+        static bool readFile(const std::filesystem::path& path, std::string& contents, std::string* error = nullptr);
+
+        /**
+         * @brief Writes a whole file, plain or compressed
+         * @param path File to write
+         * @param contents Raw contents
+         * @param compressed Whether to write the compressed container
+         * @return False if the file could not be written
+        */
+        static bool writeFile(const std::filesystem::path& path, std::string_view contents, bool compressed);
+
+        static void setJobSystem(JobSystem* jobSystem) { s_jobSystem = jobSystem; }
+
+        // Whether saves write compressed files, off by default so files stay diffable in the editor.
+        // Leave it off until the scene and prefab loaders outside this tree (scene manager load,
+        // savePrefab's readers) read through readFile, they cannot open compressed files yet
+        static void setCompressSaves(bool compress) { s_compressSaves.store(compress, std::memory_order_relaxed); }
+        static bool getCompressSaves() { return s_compressSaves.load(std::memory_order_relaxed); }
+
+        static uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+        // Worst case size of a compressed block, compressBlock needs this much room
+        static size_t getMaxCompressedSize(size_t rawSize) { return rawSize + rawSize / 255 + 16; }
+
+        /**
+         * @brief Compresses one block in the LZ4 block format
+         * @return Compressed size, 0 if it does not fit in dstCapacity
+        */
+        static size_t compressBlock(const char* src, size_t srcSize, char* dst, size_t dstCapacity);
+
+        /**
+         * @brief Decompresses one LZ4 block, never reading or writing out of bounds
+         * @return False if the block is malformed or does not decompress to exactly dstSize bytes
+        */
+        static bool decompressBlock(const char* src, size_t srcSize, char* dst, size_t dstSize);
+
+        /**
+         * @brief Appends one block (header and stored bytes) to a buffer
+         * @return Bytes appended
+        */
+        static size_t encodeBlock(const char* raw, size_t rawSize, std::vector<char>& output);
+
+        static void writeFileHeader(uint32_t blockSize, std::vector<char>& output);
+
+    private:
+        static JobSystem*           s_jobSystem;
+        static std::atomic<bool>    s_compressSaves;
+    };
+
+    /**
+     * @brief Streams data into the block container as it is produced
+     *
+     * Satisfies rapidjson's output stream concept, so a Writer can write straight into it
+     * and only one block of raw output is ever held in memory.
+    */
+    class BlockCompressedWriter
+    {
+    public:
+        using Ch = char;
+
+        explicit BlockCompressedWriter(std::FILE* file, uint32_t blockSize = BlockCompression::DefaultBlockSize);
+
+        void Put(char c)
+        {
+            if (m_used == m_raw.size())
+            {
+                writeBlock();
+            }
+            m_raw[m_used++] = c;
+        }
+
+        // rapidjson flushes after every top level value, blocks are only cut when full
+        void Flush() {}
+
+        void write(const char* data, size_t size);
+
+        /**
+         * @brief Writes the last block and the end marker, call once after the last write
+         * @return False if any write failed
+        */
+        bool finish();
+
+        bool isGood() const { return m_good; }
+
+    private:
+        void writeBlock();
+
+        std::FILE*          m_file;
+        std::vector<char>   m_raw;
+        std::vector<char>   m_encoded;
+        size_t              m_used = 0;
+        bool                m_good = true;
+        bool                m_finished = false;
+    };
+}
@@ -0,0 +1,223 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      ClipLibrary.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- ClipLibrary implementation
+- Content hashing of clip files
+- Canonical clip bookkeeping
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "ClipLibrary.hpp"
+#include "../Core/BlockCompression.hpp"
+
+#include <algorithm>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaGraphics
+{
+    std::unordered_map<uint64_t, ClipLibrary::ClipGroup>                ClipLibrary::s_groups;
+    std::unordered_map<uint64_t, std::vector<uint64_t>>                 ClipLibrary::s_buckets;
+    std::unordered_map<std::string, uint64_t>                           ClipLibrary::s_pathGroups;
+    std::unordered_map<uint64_t, uint64_t>                              ClipLibrary::s_handleGroups;
+    uint64_t                                                            ClipLibrary::s_nextGroupId = 1;
+    std::mutex                                                          ClipLibrary::s_mutex;
+
+    namespace
+    {
+        // Top level keys naming the clip, two clips differing only by name are the same clip
+        const char* const s_nameKeys[] = { "name", "Name", "clipName" };
+
+        uint64_t fnv1a(const char* data, size_t size)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= static_cast<uint8_t>(data[i]);
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+    }
+
+    uint64_t ClipLibrary::hashClipFile(const std::string& filePath, std::string* canonical)
+    {
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(filePath, contents))
+        {
+            return 0;
+        }
+
+        rapidjson::Document document;
+        document.Parse(contents.c_str(), contents.size());
+        if (document.HasParseError() || !document.IsObject())
+        {
+            TEA_WARNING("ClipLibrary: failed to parse clip file {0}", filePath);
+            return 0;
+        }
+
+        for (const char* key : s_nameKeys)
+        {
+            document.RemoveMember(key);
+        }
+
+        // Compact form so whitespace and indentation never change the hash
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        document.Accept(writer);
+
+        if (canonical)
+        {
+            canonical->assign(buffer.GetString(), buffer.GetSize());
+        }
+
+        uint64_t hash = fnv1a(buffer.GetString(), buffer.GetSize());
+        return hash == 0 ? 1 : hash;
+    }
+
+    TeaAsset::AssetHandle ClipLibrary::import(const std::string& filePath)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return importLocked(filePath);
+    }
+
+    TeaAsset::AssetHandle ClipLibrary::reimport(const std::string& filePath)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        forgetLocked(filePath);
+        return importLocked(filePath);
+    }
+
+    void ClipLibrary::forget(const std::string& filePath)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        forgetLocked(filePath);
+    }
+
+    void ClipLibrary::clear()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_groups.clear();
+        s_buckets.clear();
+        s_pathGroups.clear();
+        s_handleGroups.clear();
+    }
+
+    TeaAsset::AssetHandle ClipLibrary::importLocked(const std::string& filePath)
+    {
+        TeaAsset::AssetHandle handle = TeaAsset::AssetManager::getAssetHandle(filePath);
+
+        auto known = s_pathGroups.find(filePath);
+        if (known != s_pathGroups.end())
+        {
+            return s_groups[known->second].canonical;
+        }
+
+        std::string content;
+        uint64_t hash = hashClipFile(filePath, &content);
+        if (hash == 0)
+        {
+            return handle;
+        }
+
+        // On a hash hit the canonical file is hashed again and compared, a collision gets its own group in the same bucket
+        std::vector<uint64_t>& bucket = s_buckets[hash];
+        uint64_t groupId = 0;
+        for (uint64_t candidate : bucket)
+        {
+            ClipGroup& group = s_groups[candidate];
+            if (group.size != content.size()) continue;
+
+            std::string groupContent;
+            if (hashClipFile(group.paths.front(), &groupContent) == hash && groupContent == content)
+            {
+                group.paths.push_back(filePath);
+                TEA_INFO("ClipLibrary: {0} has the same keys as {1}, sharing one copy", filePath, group.paths.front());
+                groupId = candidate;
+                break;
+            }
+        }
+
+        if (groupId == 0)
+        {
+            groupId = s_nextGroupId++;
+            ClipGroup& group = s_groups[groupId];
+            group.hash = hash;
+            group.size = content.size();
+            group.paths.push_back(filePath);
+            group.canonical = handle;
+            bucket.push_back(groupId);
+        }
+
+        s_pathGroups[filePath] = groupId;
+        s_handleGroups[static_cast<uint64_t>(handle)] = groupId;
+        return s_groups[groupId].canonical;
+    }
+
+    void ClipLibrary::forgetLocked(const std::string& filePath)
+    {
+        auto pathIt = s_pathGroups.find(filePath);
+        if (pathIt == s_pathGroups.end()) return;
+
+        const uint64_t groupId = pathIt->second;
+        s_pathGroups.erase(pathIt);
+        s_handleGroups.erase(static_cast<uint64_t>(TeaAsset::AssetManager::getAssetHandle(filePath)));
+
+        auto groupIt = s_groups.find(groupId);
+        if (groupIt == s_groups.end()) return;
+
+        ClipGroup& group = groupIt->second;
+        group.paths.erase(std::remove(group.paths.begin(), group.paths.end(), filePath), group.paths.end());
+        if (group.paths.empty())
+        {
+            // Only this group leaves the bucket, the groups it collided with stay reachable
+            auto bucketIt = s_buckets.find(group.hash);
+            if (bucketIt != s_buckets.end())
+            {
+                auto& bucket = bucketIt->second;
+                bucket.erase(std::remove(bucket.begin(), bucket.end(), groupId), bucket.end());
+                if (bucket.empty()) s_buckets.erase(bucketIt);
+            }
+            s_groups.erase(groupIt);
+            return;
+        }
+
+        // The canonical file changed, the next file with the old content takes over
+        group.canonical = TeaAsset::AssetManager::getAssetHandle(group.paths.front());
+    }
+
+    ClipLibrary::ClipGroup* ClipLibrary::findGroupLocked(const TeaAsset::AssetHandle& handle)
+    {
+        auto groupIt = s_handleGroups.find(static_cast<uint64_t>(handle));
+        if (groupIt == s_handleGroups.end()) return nullptr;
+
+        auto group = s_groups.find(groupIt->second);
+        return group == s_groups.end() ? nullptr : &group->second;
+    }
+
+    TeaAsset::AssetHandle ClipLibrary::getCanonicalHandle(const TeaAsset::AssetHandle& handle)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        const ClipGroup* group = findGroupLocked(handle);
+        return group ? group->canonical : handle;
+    }
+
+    ClipLibraryStats ClipLibrary::getStats()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        ClipLibraryStats stats;
+        stats.files = s_pathGroups.size();
+        stats.uniqueClips = s_groups.size();
+        return stats;
+    }
+}
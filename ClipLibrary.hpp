@@ -0,0 +1,110 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      ClipLibrary.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- ClipLibrary class deduplicating animation clips by content hash
+- Canonical clip lookup so every animator loads one copy of a clip content
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Asset/AssetManager.hpp"
+#include "../Graphics/AnimationClip.hpp"
+#include "../Graphics/Animator.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaGraphics
+{
+    struct ClipLibraryStats
+    {
+        size_t files = 0;           // Clip files imported
+        size_t uniqueClips = 0;     // Distinct clip contents
+    };
+
+    /**
+     * @brief Project wide table of animation clips keyed by content
+     *
+     * This class handles:
+     * 1. Hashing clip files at import (FNV-1a over the clip JSON without its name)
+     * 2. Mapping every clip file with the same content to one canonical clip asset, clips whose
+     *    hashes collide live side by side in the bucket of their hash
+     * 3. Resolving any clip handle to its canonical clip, which the asset manager loads once
+     *    and hands to every animator as the same read-only asset
+     *
+     * Only the hash and the size of each distinct content are kept, a hash hit is confirmed
+     * against the canonical file itself.
+     * Playback state (current frame, time, speed) lives in BjornAnimator, clips only hold keys
+     * and events, so any number of animators can play the same clip instance.
+     * The editor keeps editing a clip through its own file handle and reimports it on save.
+    */
+    class ClipLibrary
+    {
+    public:
+        /**
+         * @brief Hashes and registers a clip file
+         * @param filePath Path of the clip file
+         * @return Handle of the canonical clip with the same content
+        */
+        static TeaAsset::AssetHandle import(const std::string& filePath);
+
+        /**
+         * @brief Hashes a clip file again after it was saved
+         * @param filePath Path of the clip file
+         * @return Handle of the canonical clip with the new content
+        */
+        static TeaAsset::AssetHandle reimport(const std::string& filePath);
+
+        static void forget(const std::string& filePath);
+        static void clear();
+
+        /**
+         * @brief Gets the canonical clip of a clip, the handle itself if it was not imported
+         * @param handle Handle of a clip file
+         * @return Handle of the clip sharing its content that is actually loaded
+        */
+        static TeaAsset::AssetHandle getCanonicalHandle(const TeaAsset::AssetHandle& handle);
+
+        /**
+         * @brief Computes the content hash of a clip file
+         * @param filePath Path of the clip file
+         * @param canonical Receives the hashed form of the clip (compact JSON without its name)
+         * @return FNV-1a hash, 0 if the file cannot be read
+        */
+        static uint64_t hashClipFile(const std::string& filePath, std::string* canonical = nullptr);
+
+        static ClipLibraryStats getStats();
+
+    private:
+        struct ClipGroup
+        {
+            uint64_t hash = 0;
+            size_t size = 0;                                    // Length of the hashed form, checked before the file is read again
+            std::vector<std::string> paths;                     // Files with this content, the first one is canonical
+            TeaAsset::AssetHandle canonical;
+        };
+
+        static TeaAsset::AssetHandle importLocked(const std::string& filePath);
+        static void forgetLocked(const std::string& filePath);
+        static ClipGroup* findGroupLocked(const TeaAsset::AssetHandle& handle);
+
+        static std::unordered_map<uint64_t, ClipGroup>                  s_groups;       // Group id -> files
+        static std::unordered_map<uint64_t, std::vector<uint64_t>>      s_buckets;      // Content hash -> group ids
+        static std::unordered_map<std::string, uint64_t>                s_pathGroups;   // File -> group id
+        static std::unordered_map<uint64_t, uint64_t>                   s_handleGroups; // Clip handle -> group id
+        static uint64_t                                                 s_nextGroupId;
+        static std::mutex                                               s_mutex;
+    };
+}
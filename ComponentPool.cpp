@@ -0,0 +1,339 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      ComponentPool.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- ChunkPool implementation, arena mapping and size class free lists
+- Default / pooled storage creation and iteration benchmark
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "ComponentPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace SceneManager
+{
+    namespace
+    {
+        // Components only used by the benchmark, the pooled pair gets its storage swapped below
+        struct BenchPosition        { float x = 0.0f, y = 0.0f, z = 0.0f; };
+        struct BenchVelocity        { float x = 1.0f, y = 1.0f, z = 1.0f; };
+        struct PooledBenchPosition  { float x = 0.0f, y = 0.0f, z = 0.0f; };
+        struct PooledBenchVelocity  { float x = 1.0f, y = 1.0f, z = 1.0f; };
+    }
+}
+
+TEA_POOLED_COMPONENT(SceneManager::PooledBenchPosition)
+TEA_POOLED_COMPONENT(SceneManager::PooledBenchVelocity)
+
+/*                                                              function definitions
+====================================================================================*/
+namespace SceneManager
+{
+    std::array<void*, ChunkPool::ClassCount>    ChunkPool::s_freeLists{};
+    std::vector<ChunkPool::Arena>               ChunkPool::s_arenas;
+    char*                                       ChunkPool::s_cursor = nullptr;
+    size_t                                      ChunkPool::s_remaining = 0;
+    ChunkPoolStats                              ChunkPool::s_stats;
+    std::mutex                                  ChunkPool::s_mutex;
+
+    namespace
+    {
+        size_t roundUp(size_t value, size_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        template<typename Position, typename Velocity>
+        void measureStorage(size_t entityCount, int iterations, double& createMs, double& iterateNs)
+        {
+            entt::registry registry;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < entityCount; i++)
+            {
+                entt::entity entity = registry.create();
+                registry.emplace<Position>(entity);
+                registry.emplace<Velocity>(entity);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            createMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+            auto view = registry.view<Position, const Velocity>();
+            start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                view.each([](Position& position, const Velocity& velocity)
+                {
+                    position.x += velocity.x * 0.016f;
+                    position.y += velocity.y * 0.016f;
+                    position.z += velocity.z * 0.016f;
+                });
+            }
+            end = std::chrono::high_resolution_clock::now();
+
+            const double totalNs = std::chrono::duration<double, std::nano>(end - start).count();
+            iterateNs = entityCount > 0 ? totalNs / (static_cast<double>(entityCount) * iterations) : 0.0;
+        }
+    }
+
+    const std::array<size_t, ChunkPool::ClassCount>& ChunkPool::getClassSizes()
+    {
+        // Powers of two and the halfway steps between them, every size a multiple of 64
+        static const std::array<size_t, ClassCount> s_sizes = []
+        {
+            std::array<size_t, ClassCount> sizes{};
+            size_t count = 0;
+            sizes[count++] = MinChunkSize;
+            for (size_t size = MinChunkSize * 2; size <= MaxChunkSize; size *= 2)
+            {
+                sizes[count++] = size;
+                if (size + size / 2 <= MaxChunkSize) sizes[count++] = size + size / 2;
+            }
+            return sizes;
+        }();
+        return s_sizes;
+    }
+
+    size_t ChunkPool::getSizeClass(size_t bytes)
+    {
+        const auto& sizes = getClassSizes();
+        return static_cast<size_t>(std::lower_bound(sizes.begin(), sizes.end(), bytes) - sizes.begin());
+    }
+
+    void* ChunkPool::mapArena(size_t bytes)
+    {
+#if defined(_WIN32)
+        return _aligned_malloc(bytes, ArenaSize);
+#elif defined(__linux__)
+        // Over map by one arena and trim, mmap only guarantees page alignment
+        void* mapped = mmap(nullptr, bytes + ArenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) return nullptr;
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(mapped);
+        const uintptr_t aligned = roundUp(address, ArenaSize);
+        if (aligned > address) munmap(mapped, aligned - address);
+        if (ArenaSize - (aligned - address) > 0) munmap(reinterpret_cast<void*>(aligned + bytes), ArenaSize - (aligned - address));
+
+        void* arena = reinterpret_cast<void*>(aligned);
+        if (s_stats.hugePages && madvise(arena, bytes, MADV_HUGEPAGE) != 0)
+        {
+            TEA_WARNING("ChunkPool: transparent huge pages unavailable, using normal pages");
+            s_stats.hugePages = false;
+        }
+        return arena;
+#else
+        return std::aligned_alloc(ArenaSize, bytes);
+#endif
+    }
+
+    void ChunkPool::unmapArena(void* arena, size_t bytes)
+    {
+#if defined(_WIN32)
+        (void)bytes;
+        _aligned_free(arena);
+#elif defined(__linux__)
+        munmap(arena, bytes);
+#else
+        (void)bytes;
+        std::free(arena);
+#endif
+    }
+
+    void ChunkPool::carveRemainder()
+    {
+        // The tail is a multiple of 64, so the largest classes that fit use it up exactly
+        const auto& sizes = getClassSizes();
+        while (s_remaining >= MinChunkSize)
+        {
+            size_t sizeClass = getSizeClass(s_remaining);
+            if (sizeClass == ClassCount || sizes[sizeClass] > s_remaining) sizeClass--;
+
+            *reinterpret_cast<void**>(s_cursor) = s_freeLists[sizeClass];
+            s_freeLists[sizeClass] = s_cursor;
+            s_cursor += sizes[sizeClass];
+            s_remaining -= sizes[sizeClass];
+        }
+        s_cursor = nullptr;
+        s_remaining = 0;
+    }
+
+    void* ChunkPool::allocate(size_t bytes, size_t alignment)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.allocations++;
+
+        // Large or over aligned requests get arenas of their own
+        if (bytes > MaxChunkSize || alignment > ChunkAlignment)
+        {
+            const size_t arenaBytes = roundUp(std::max<size_t>(bytes, 1), ArenaSize);
+            void* arena = mapArena(arenaBytes);
+            if (!arena) return nullptr;
+
+            s_arenas.push_back({ arena, arenaBytes });
+            s_stats.arenaCount++;
+            s_stats.arenaBytes += arenaBytes;
+            s_stats.liveBytes += arenaBytes;
+            return arena;
+        }
+
+        const size_t sizeClass = getSizeClass(std::max(bytes, MinChunkSize));
+        const size_t chunkSize = getClassSizes()[sizeClass];
+        s_stats.liveBytes += chunkSize;
+
+        if (void* chunk = s_freeLists[sizeClass])
+        {
+            s_freeLists[sizeClass] = *static_cast<void**>(chunk);
+            s_stats.reusedChunks++;
+            return chunk;
+        }
+
+        if (s_remaining < chunkSize)
+        {
+            carveRemainder();
+
+            void* arena = mapArena(ArenaSize);
+            if (!arena)
+            {
+                s_stats.liveBytes -= chunkSize;
+                return nullptr;
+            }
+
+            s_arenas.push_back({ arena, ArenaSize });
+            s_stats.arenaCount++;
+            s_stats.arenaBytes += ArenaSize;
+            s_cursor = static_cast<char*>(arena);
+            s_remaining = ArenaSize;
+        }
+
+        void* chunk = s_cursor;
+        s_cursor += chunkSize;
+        s_remaining -= chunkSize;
+        return chunk;
+    }
+
+    void ChunkPool::deallocate(void* pointer, size_t bytes, size_t alignment)
+    {
+        if (!pointer) return;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        if (bytes > MaxChunkSize || alignment > ChunkAlignment)
+        {
+            auto it = std::find_if(s_arenas.begin(), s_arenas.end(), [pointer](const Arena& arena) { return arena.memory == pointer; });
+            if (it == s_arenas.end())
+            {
+                TEA_ERROR("ChunkPool: freeing {0} bytes that were not allocated by the pool", bytes);
+                return;
+            }
+
+            unmapArena(it->memory, it->bytes);
+            s_stats.arenaCount--;
+            s_stats.arenaBytes -= it->bytes;
+            s_stats.liveBytes -= it->bytes;
+            *it = s_arenas.back();
+            s_arenas.pop_back();
+            return;
+        }
+
+        const size_t sizeClass = getSizeClass(std::max(bytes, MinChunkSize));
+        *static_cast<void**>(pointer) = s_freeLists[sizeClass];
+        s_freeLists[sizeClass] = pointer;
+        s_stats.liveBytes -= getClassSizes()[sizeClass];
+    }
+
+    void ChunkPool::setHugePages(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stats.hugePages = enabled && isHugePageSupported();
+    }
+
+    bool ChunkPool::isHugePageSupported()
+    {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        // madvise succeeds even when the kernel never backs it, so read the selected mode: "always [madvise] never"
+        static const bool s_supported = []
+        {
+            std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+            std::string modes;
+            std::getline(file, modes);
+            return modes.find("[always]") != std::string::npos || modes.find("[madvise]") != std::string::npos;
+        }();
+        return s_supported;
+#else
+        return false;
+#endif
+    }
+
+    bool ChunkPool::releaseAll()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_stats.liveBytes > 0) return false;
+
+        for (const Arena& arena : s_arenas)
+        {
+            unmapArena(arena.memory, arena.bytes);
+        }
+        s_arenas.clear();
+        s_freeLists.fill(nullptr);
+        s_cursor = nullptr;
+        s_remaining = 0;
+
+        const bool hugePages = s_stats.hugePages;
+        s_stats = ChunkPoolStats{};
+        s_stats.hugePages = hugePages;
+        return true;
+    }
+
+    ChunkPoolStats ChunkPool::getStats()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_stats;
+    }
+
+    PoolBenchmarkResult ChunkPool::benchmark(size_t entityCount, int iterations)
+    {
+        PoolBenchmarkResult result;
+        result.entityCount = entityCount;
+
+        const bool hugePages = getStats().hugePages;
+
+        measureStorage<BenchPosition, BenchVelocity>(entityCount, iterations, result.defaultCreateMs, result.defaultIterateNs);
+
+        // Each pooled run starts from empty arenas so it pays for its own page faults
+        setHugePages(false);
+        releaseAll();
+        measureStorage<PooledBenchPosition, PooledBenchVelocity>(entityCount, iterations, result.pooledCreateMs, result.pooledIterateNs);
+
+        setHugePages(true);
+        releaseAll();
+        measureStorage<PooledBenchPosition, PooledBenchVelocity>(entityCount, iterations, result.hugePageCreateMs, result.hugePageIterateNs);
+        result.hugePagesSupported = getStats().hugePages;
+
+        releaseAll();
+        setHugePages(hugePages);
+
+        TEA_INFO("Pool benchmark {0} entities: create default {1:.1f} ms, pooled {2:.1f} ms, huge pages {3:.1f} ms",
+            result.entityCount, result.defaultCreateMs, result.pooledCreateMs, result.hugePageCreateMs);
+        TEA_INFO("Pool benchmark {0} entities: iterate default {1:.2f} ns, pooled {2:.2f} ns, huge pages {3:.2f} ns per entity{4}",
+            result.entityCount, result.defaultIterateNs, result.pooledIterateNs, result.hugePageIterateNs,
+            result.hugePagesSupported ? "" : " (huge pages unsupported)");
+
+        return result;
+    }
+}
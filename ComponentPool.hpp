@@ -0,0 +1,196 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      ComponentPool.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- ChunkPool class handing out aligned chunks carved from 2 MiB arenas
+- PooledAllocator standard allocator on top of the chunk pool
+- TEA_POOLED_COMPONENT macro switching a component's registry storage to the pool
+- Default / pooled storage creation and iteration benchmark
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+/*                                                             function declarations
+====================================================================================*/
+namespace SceneManager
+{
+    struct ChunkPoolStats
+    {
+        size_t arenaCount = 0;          // Arenas currently mapped
+        size_t arenaBytes = 0;          // Bytes of every mapped arena, dedicated ones included
+        size_t liveBytes = 0;           // Bytes handed out and not yet returned
+        size_t allocations = 0;         // Allocations since the last release
+        size_t reusedChunks = 0;        // Allocations served from a free list
+        bool hugePages = false;         // New arenas are advised as transparent huge pages
+    };
+
+    /**
+     * @brief Timings of SceneManager::ChunkPool::benchmark
+    */
+    struct PoolBenchmarkResult
+    {
+        size_t entityCount = 0;
+        double defaultCreateMs = 0.0;       // Create and emplace every entity, std::allocator storage
+        double pooledCreateMs = 0.0;        // Same with pooled storage
+        double hugePageCreateMs = 0.0;      // Same with pooled storage on huge page arenas
+        double defaultIterateNs = 0.0;      // Nanoseconds per entity of one view pass, std::allocator storage
+        double pooledIterateNs = 0.0;
+        double hugePageIterateNs = 0.0;
+        bool hugePagesSupported = false;    // False when the huge page run fell back to normal pages
+    };
+
+    /**
+     * @brief Process wide pool of aligned memory chunks for component storage
+     *
+     * This class handles:
+     * 1. Reserving memory in 2 MiB arenas aligned to 2 MiB, advised as transparent huge pages on Linux
+     * 2. Carving arenas into chunks of fixed size classes, 64 byte aligned
+     * 3. Keeping freed chunks in a free list per size class so pools growing and shrinking reuse them
+     * 4. Giving requests above the largest class a dedicated arena, returned to the system when freed
+     *
+     * Component pages are allocated rarely (once per 1024 components), so a single lock is enough.
+    */
+    class ChunkPool
+    {
+    public:
+        static constexpr size_t ArenaSize = size_t(2) << 20;
+        static constexpr size_t ChunkAlignment = 64;
+        static constexpr size_t MinChunkSize = 64;
+        static constexpr size_t MaxChunkSize = size_t(1) << 20;
+
+        /**
+         * @brief Allocates a chunk of at least bytes
+         * @param bytes Requested size
+         * @param alignment Requested alignment, above ChunkAlignment a dedicated arena is used
+         * @return Memory, nullptr if the system is out of memory
+        */
+        static void* allocate(size_t bytes, size_t alignment);
+
+        /**
+         * @brief Returns a chunk, bytes and alignment must match the allocate call
+        */
+        static void deallocate(void* pointer, size_t bytes, size_t alignment);
+
+        /**
+         * @brief Advises arenas mapped from now on as transparent huge pages, Linux only
+         * @param enabled True to request huge pages
+        */
+        static void setHugePages(bool enabled);
+        static bool isHugePageSupported();
+
+        /**
+         * @brief Returns every arena to the system
+         * @return False (and nothing is released) while any chunk is still in use
+        */
+        static bool releaseAll();
+
+        static ChunkPoolStats getStats();
+
+        /**
+         * @brief Compares std::allocator storage with pooled storage on a synthetic registry
+         *
+         * Every entity has a position and a velocity, creation covers create and emplace,
+         * iteration one integration pass over a view of both.
+         *
+         * @param entityCount Entities to create
+         * @param iterations Number of view passes averaged
+         * @return Creation and iteration timings of each storage
+        */
+        static PoolBenchmarkResult benchmark(size_t entityCount = 1000000, int iterations = 20);
+
+    private:
+        static constexpr size_t ClassCount = 28;    // 64, then 128, 192, 256, 384 ... 1 MiB
+
+        static const std::array<size_t, ClassCount>& getClassSizes();
+        static size_t getSizeClass(size_t bytes);
+        static void* mapArena(size_t bytes);
+        static void unmapArena(void* arena, size_t bytes);
+        static void carveRemainder();
+
+        struct Arena
+        {
+            void* memory;
+            size_t bytes;
+        };
+
+        static std::array<void*, ClassCount>    s_freeLists;        // Intrusive, the next pointer lives in the free chunk
+        static std::vector<Arena>               s_arenas;
+        static char*                            s_cursor;           // Unused tail of the newest arena
+        static size_t                           s_remaining;
+        static ChunkPoolStats                   s_stats;
+        static std::mutex                       s_mutex;
+    };
+
+    /**
+     * @brief Standard allocator handing out ChunkPool memory, stateless so every instance compares equal
+    */
+    template<typename T>
+    class PooledAllocator
+    {
+    public:
+        using value_type = T;
+
+        PooledAllocator() noexcept = default;
+
+        template<typename U>
+        PooledAllocator(const PooledAllocator<U>&) noexcept {}
+
+        T* allocate(size_t count)
+        {
+            if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+
+            void* memory = ChunkPool::allocate(count * sizeof(T), alignof(T));
+            if (!memory)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(memory);
+        }
+
+        void deallocate(T* pointer, size_t count) noexcept
+        {
+            ChunkPool::deallocate(pointer, count * sizeof(T), alignof(T));
+        }
+
+        template<typename U>
+        bool operator==(const PooledAllocator<U>&) const noexcept { return true; }
+
+        template<typename U>
+        bool operator!=(const PooledAllocator<U>&) const noexcept { return false; }
+    };
+}
+
+/**
+ * @brief Makes every entt::registry store a component in ChunkPool memory
+ *
+ * Use at global scope right after the component is declared, before any registry touches it,
+ * so every translation unit sees the same storage type. Signals and views work unchanged.
+*/
+#define TEA_POOLED_COMPONENT(Type)                                                                      \
+    namespace entt                                                                                      \
+    {                                                                                                   \
+        template<>                                                                                      \
+        struct storage_type<Type, entt::entity, std::allocator<Type>>                                   \
+        {                                                                                               \
+            using type = sigh_mixin<basic_storage<Type, entt::entity, SceneManager::PooledAllocator<Type>>>; \
+        };                                                                                              \
+    }
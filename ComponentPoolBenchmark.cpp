@@ -0,0 +1,132 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       ComponentPoolBenchmark.cpp
+@project    TeaEngine
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Headless component pool benchmark (entry point of the benchmark target)
+- Default, pooled and huge page storage at the entity counts given on the command line
+- JSON report with creation milliseconds and nanoseconds per entity of a view pass
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Core/ComponentPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    struct BenchmarkOptions
+    {
+        std::vector<size_t> entityCounts{ 100000, 1000000 };
+        int iterations = 20;
+        std::string outputPath;             // Report file, stdout when empty
+    };
+
+    void printUsage()
+    {
+        std::cerr << "Usage: ComponentPoolBenchmark [--counts N,N,...] [--iterations N] [--out FILE]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                return false;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << "\n";
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--counts")
+            {
+                options.entityCounts.clear();
+                std::stringstream list(value);
+                std::string count;
+                while (std::getline(list, count, ','))
+                {
+                    options.entityCounts.push_back(std::strtoull(count.c_str(), nullptr, 10));
+                }
+            }
+            else if (arg == "--iterations")     options.iterations = std::max(1, std::atoi(value));
+            else if (arg == "--out")            options.outputPath = value;
+            else
+            {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<SceneManager::PoolBenchmarkResult> results;
+    for (size_t entityCount : options.entityCounts)
+    {
+        results.push_back(SceneManager::ChunkPool::benchmark(entityCount, options.iterations));
+    }
+
+    // Machine readable report, one object per entity count so results can be diffed across commits
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("benchmark");            writer.String("component_pool");
+    writer.Key("iterations");           writer.Int(options.iterations);
+    writer.Key("hugePagesSupported");   writer.Bool(SceneManager::ChunkPool::isHugePageSupported());
+    writer.Key("runs");
+    writer.StartArray();
+    for (const auto& result : results)
+    {
+        writer.StartObject();
+        writer.Key("entities");             writer.Uint64(result.entityCount);
+        writer.Key("defaultCreateMs");      writer.Double(result.defaultCreateMs);
+        writer.Key("pooledCreateMs");       writer.Double(result.pooledCreateMs);
+        writer.Key("hugePageCreateMs");     writer.Double(result.hugePageCreateMs);
+        writer.Key("defaultIterateNs");     writer.Double(result.defaultIterateNs);
+        writer.Key("pooledIterateNs");      writer.Double(result.pooledIterateNs);
+        writer.Key("hugePageIterateNs");    writer.Double(result.hugePageIterateNs);
+        writer.Key("hugePages");            writer.Bool(result.hugePagesSupported);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    if (options.outputPath.empty())
+    {
+        std::cout << buffer.GetString() << std::endl;
+    }
+    else
+    {
+        std::ofstream(options.outputPath, std::ios::binary | std::ios::trunc) << buffer.GetString() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       CompressionBenchmark.cpp
+@project    TeaEngine
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Headless block compression benchmark (entry point of the benchmark target)
+- Compressed copies of every scene, prefab and clip file of a directory
+- JSON report with sizes and load times, plain against compressed
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Core/BlockCompression.hpp"
+#include "Core/JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    struct BenchmarkOptions
+    {
+        std::string directory = "../Assets";
+        uint32_t blockSize = btEngine::BlockCompression::DefaultBlockSize;
+        uint32_t iterations = 5;
+        uint32_t workers = 0;               // Job system workers, 0 picks hardware concurrency - 1
+        double bandwidthMBps = 200.0;       // Disk or network read speed used for the modelled load times
+        std::string outputPath;             // Report file, stdout when empty
+    };
+
+    // Totals per file extension
+    struct GroupResult
+    {
+        uint32_t files = 0;
+        uint64_t rawBytes = 0;
+        uint64_t compressedBytes = 0;
+        double compressMs = 0.0;
+        double plainLoadMs = 0.0;           // Read and parse, best of the iterations
+        double singleLoadMs = 0.0;          // Read, decompress on the calling thread and parse
+        double parallelLoadMs = 0.0;        // Read, decompress on the job system and parse
+        double plainDecodeMs = 0.0;         // CPU part of the loads above, without the read
+        double singleDecodeMs = 0.0;
+        double parallelDecodeMs = 0.0;
+    };
+
+    void printUsage()
+    {
+        std::cerr << "Usage: CompressionBenchmark [--dir DIR] [--block-size BYTES] [--iterations N] [--workers N]\n"
+                     "                            [--bandwidth MBPS] [--out FILE]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                return false;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << "\n";
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--dir")                 options.directory = value;
+            else if (arg == "--block-size")     options.blockSize = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--iterations")     options.iterations = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--workers")        options.workers = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--bandwidth")      options.bandwidthMBps = std::max(1.0, std::strtod(value, nullptr));
+            else if (arg == "--out")            options.outputPath = value;
+            else
+            {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Best time of a full load (read, decompress if needed, parse) and of its CPU part alone
+    bool timeLoad(const std::filesystem::path& path, btEngine::JobSystem* jobSystem, uint32_t iterations,
+        double& loadMs, double& decodeMs)
+    {
+        btEngine::BlockCompression::setJobSystem(jobSystem);
+
+        std::string contents;
+        std::string fileBytes;
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (!btEngine::BlockCompression::readFile(path, contents)) return false;
+            rapidjson::Document document;
+            document.Parse(contents.c_str(), contents.size());
+            const double ms = elapsedMs(start);
+            loadMs = iteration == 0 ? ms : std::min(loadMs, ms);
+        }
+
+        // Same work on bytes already in memory, the difference to the above is the read
+        std::ifstream file(path, std::ios::binary);
+        fileBytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (btEngine::BlockCompression::isCompressed(fileBytes))
+            {
+                if (!btEngine::BlockCompression::decompress(fileBytes, contents, jobSystem)) return false;
+            }
+            else
+            {
+                contents = fileBytes;
+            }
+            rapidjson::Document document;
+            document.Parse(contents.c_str(), contents.size());
+            const double ms = elapsedMs(start);
+            decodeMs = iteration == 0 ? ms : std::min(decodeMs, ms);
+        }
+        return true;
+    }
+
+    void writeGroup(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const std::string& name, const GroupResult& group,
+        const BenchmarkOptions& options)
+    {
+        // Cold loads are bound by the bytes read, modelled as size over bandwidth plus the CPU part
+        const double bytesPerMs = options.bandwidthMBps * 1024.0 * 1024.0 / 1000.0;
+        const double plainModelMs = group.rawBytes / bytesPerMs + group.plainDecodeMs;
+        const double compressedModelMs = group.compressedBytes / bytesPerMs + group.parallelDecodeMs;
+
+        writer.StartObject();
+        writer.Key("extension");            writer.String(name.c_str());
+        writer.Key("files");                writer.Uint(group.files);
+        writer.Key("rawBytes");             writer.Uint64(group.rawBytes);
+        writer.Key("compressedBytes");      writer.Uint64(group.compressedBytes);
+        writer.Key("ratio");                writer.Double(group.compressedBytes > 0 ? static_cast<double>(group.rawBytes) / group.compressedBytes : 0.0);
+        writer.Key("compressMs");           writer.Double(group.compressMs);
+        writer.Key("plainLoadMs");          writer.Double(group.plainLoadMs);
+        writer.Key("singleThreadLoadMs");   writer.Double(group.singleLoadMs);
+        writer.Key("jobSystemLoadMs");      writer.Double(group.parallelLoadMs);
+        writer.Key("plainDecodeMs");        writer.Double(group.plainDecodeMs);
+        writer.Key("singleThreadDecodeMs"); writer.Double(group.singleDecodeMs);
+        writer.Key("jobSystemDecodeMs");    writer.Double(group.parallelDecodeMs);
+        writer.Key("modelledPlainMs");      writer.Double(plainModelMs);
+        writer.Key("modelledCompressedMs"); writer.Double(compressedModelMs);
+        writer.EndObject();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(options.directory, error))
+    {
+        const std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".scene" || extension == ".prefab" || extension == ".clip"))
+        {
+            files.push_back(entry.path());
+        }
+    }
+    if (files.empty())
+    {
+        std::cerr << "No scene, prefab or clip files found in " << options.directory << "\n";
+        return 1;
+    }
+
+    btEngine::JobSystem jobSystem;
+    if (!jobSystem.initialize(options.workers))
+    {
+        std::cerr << "Failed to start the job system\n";
+        return 1;
+    }
+
+    // Compressed copies go to a scratch directory, the assets are never touched
+    const std::filesystem::path scratch = std::filesystem::temp_directory_path() / "TeaCompressionBenchmark";
+    std::filesystem::create_directories(scratch, error);
+
+    std::map<std::string, GroupResult> groups;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const auto& path = files[i];
+        std::string raw;
+        if (!btEngine::BlockCompression::readFile(path, raw))
+        {
+            std::cerr << "Skipping unreadable file " << path.string() << "\n";
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        const std::string packed = btEngine::BlockCompression::compress(raw, options.blockSize);
+        const double compressMs = elapsedMs(start);
+
+        const std::filesystem::path plainCopy = scratch / (std::to_string(i) + ".plain");
+        const std::filesystem::path packedCopy = scratch / (std::to_string(i) + ".packed");
+        if (!btEngine::BlockCompression::writeFile(plainCopy, raw, false) || !btEngine::BlockCompression::writeFile(packedCopy, raw, true))
+        {
+            std::cerr << "Failed to write scratch copies of " << path.string() << "\n";
+            continue;
+        }
+
+        double plainLoad = 0.0, plainDecode = 0.0, singleLoad = 0.0, singleDecode = 0.0, parallelLoad = 0.0, parallelDecode = 0.0;
+        if (!timeLoad(plainCopy, nullptr, options.iterations, plainLoad, plainDecode) ||
+            !timeLoad(packedCopy, nullptr, options.iterations, singleLoad, singleDecode) ||
+            !timeLoad(packedCopy, &jobSystem, options.iterations, parallelLoad, parallelDecode))
+        {
+            std::cerr << "Failed to load scratch copies of " << path.string() << "\n";
+            continue;
+        }
+
+        for (const std::string& name : { path.extension().string(), std::string("all") })
+        {
+            GroupResult& group = groups[name];
+            group.files++;
+            group.rawBytes += raw.size();
+            group.compressedBytes += packed.size();
+            group.compressMs += compressMs;
+            group.plainLoadMs += plainLoad;
+            group.singleLoadMs += singleLoad;
+            group.parallelLoadMs += parallelLoad;
+            group.plainDecodeMs += plainDecode;
+            group.singleDecodeMs += singleDecode;
+            group.parallelDecodeMs += parallelDecode;
+        }
+    }
+
+    btEngine::BlockCompression::setJobSystem(nullptr);
+    const uint32_t threadCount = jobSystem.getThreadCount();
+    jobSystem.shutdown();
+    std::filesystem::remove_all(scratch, error);
+
+    // Machine readable report, one object per extension so results can be diffed across commits
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("benchmark");        writer.String("block_compression");
+    writer.Key("options");
+    writer.StartObject();
+    writer.Key("directory");        writer.String(options.directory.c_str());
+    writer.Key("blockSize");        writer.Uint(options.blockSize);
+    writer.Key("iterations");       writer.Uint(options.iterations);
+    writer.Key("threads");          writer.Uint(threadCount);
+    writer.Key("bandwidthMBps");    writer.Double(options.bandwidthMBps);
+    writer.EndObject();
+    writer.Key("groups");
+    writer.StartArray();
+    for (const auto& [name, group] : groups)
+    {
+        writeGroup(writer, name, group, options);
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    if (options.outputPath.empty())
+    {
+        std::cout << buffer.GetString() << std::endl;
+    }
+    else
+    {
+        std::ofstream(options.outputPath, std::ios::binary | std::ios::trunc) << buffer.GetString() << "\n";
+    }
+    return 0;
+}
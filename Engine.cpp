@@ -6,7 +6,7 @@ All content (c) 2024 Digipen Institute of Technology Singapore. All rights reser
 
 Contents:
 - Engine class implementation
-- System management (Window, Physics, Audio, Graphics, etc.)
+- System management (Jobs, Window, Physics, Audio, Graphics, etc.)
 - Getter functions for various systems
 ====================================================================================*/
 
@@ -22,6 +22,14 @@ namespace btEngine
     { 
         TEA_INFO("-------------------- Engine Lib ---------------------");
         // Initialize system in order
+        if (!mJobSystem->initialize())
+        {
+            TEA_ERROR("Job System fail to initialze");
+        }
+        // Coroutines resume on the main loop queue and offload work to the job system
+        CoroutineScheduler::initialize(mJobSystem.get(), mTaskQueue.get());
+        // Compressed asset files are unpacked a block per worker
+        BlockCompression::setJobSystem(mJobSystem.get());
         if (!mWindow->initialize("GAM 300", "config.json"))
         {
 	     TEA_ERROR("Window System failed to initialize");          
@@ -54,17 +62,65 @@ namespace btEngine
 
 	TeaComponents::ComponentManager::registerComponentMap();
         TeaComponents::ComponentManager::printRegisteredComponents();
+
+        // Entity bound animation state is dropped in one call when scenes are cleared
+        SceneManager::SceneTeardown::registerReleaseHook("AnimatorStateMachines", 100,
+            [this](const SceneManager::TeardownBatch& batch)
+            {
+                if (batch.wholeRegistry)
+                {
+                    mAnimatorStateMachines->clear();
+                    return;
+                }
+                for (size_t i = 0; i < batch.count; i++)
+                {
+                    mAnimatorStateMachines->unbind(batch.entities[i]);
+                }
+            });
+        SceneManager::SceneTeardown::registerReleaseHook("AnimationEvents", 100,
+            [this](const SceneManager::TeardownBatch& batch)
+            {
+                if (batch.wholeRegistry)
+                {
+                    mAnimationEvents->clear();
+                    return;
+                }
+                for (size_t i = 0; i < batch.count; i++)
+                {
+                    mAnimationEvents->unsubscribeAll(batch.entities[i]);
+                }
+            });
+
+        // Entities destroyed one by one drop their event subscriptions, the cleared registry is attached again
+        if (auto* registry = sceneManager->getRegistry())
+        {
+            mAnimationEvents->attach(*registry);
+        }
+        SceneManager::SceneTeardown::registerResetListener("AnimationEvents",
+            [this](entt::registry& registry)
+            {
+                mAnimationEvents->attach(registry);
+            });
         return true;
     }
    
     void Engine::shutdown(entt::registry* registry) 
    {	
 	// Terminate system in reverse order relative to initializations
+        mWorldStreamer->unloadWorld();
         graphicsSystem->shutdown(registry);
         particleSystem->shutdown(registry);
         audioSystem->shutdown(registry);
 	physicsSystem->shutdown(registry);
         mScriptRuntime->shutdown(registry);
+        mAnimatorStateMachines->clear();
+        mAnimationEvents->detach();
+        mAnimationEvents->clear();
+        TeaAsset::PrefabUsageIndex::save();
+        SceneManager::SceneTeardown::clearHooks();
 	mScriptCore->shutdown(registry);
+        BlockCompression::setJobSystem(nullptr);
+        mJobSystem->shutdown();
+        CoroutineScheduler::shutdown();
     }
 }
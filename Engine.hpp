@@ -26,6 +26,15 @@ Contents:
 #include "Scripting/ScriptRuntime.hpp"
 #include "Components/ComponentManager.hpp"
 #include "../Core/AnimationTransform.hpp"
+#include "../Core/JobSystem.hpp"
+#include "../Core/TaskQueue.hpp"
+#include "../Core/Task.hpp"
+#include "../Core/BlockCompression.hpp"
+#include "../Graphics/AnimatorStateMachine.hpp"
+#include "../Graphics/AnimationEvents.hpp"
+#include "../Core/SceneTeardown.hpp"
+#include "../Core/WorldStreaming.hpp"
+#include "../Asset/PrefabUsageIndex.hpp"
 
 /*                                                             function declarations
 ====================================================================================*/
@@ -48,6 +57,11 @@ namespace btEngine
 	Scripting::ScriptCore&                  getScriptCore()         const { return *mScriptCore;    }
 	Scripting::ScriptRuntime&               getScriptRuntime()      const { return *mScriptRuntime; }
 	TeaAnimation::Animator&                 getAnimator()           const { return *mAnimator;      }
+	btEngine::JobSystem&                    getJobSystem()          const { return *mJobSystem;     }
+	btEngine::MainLoopTaskQueue&            getTaskQueue()          const { return *mTaskQueue;     }
+	TeaAnimation::AnimatorStateMachineSystem& getAnimatorStateMachines() const { return *mAnimatorStateMachines; }
+	TeaAnimation::AnimationEventDispatcher& getAnimationEvents()     const { return *mAnimationEvents;  }
+	SceneManager::WorldStreamer&            getWorldStreamer()      const { return *mWorldStreamer; }
 
     private:
 
@@ -61,5 +75,10 @@ namespace btEngine
 	std::unique_ptr<Scripting::ScriptCore>                  mScriptCore             = std::make_unique<Scripting::ScriptCore>();
 	std::unique_ptr<Scripting::ScriptRuntime>               mScriptRuntime          = std::make_unique<Scripting::ScriptRuntime>();
 	std::unique_ptr<TeaAnimation::Animator>                 mAnimator               = std::make_unique<TeaAnimation::Animator>();
+	std::unique_ptr<btEngine::JobSystem>                    mJobSystem              = std::make_unique<btEngine::JobSystem>();
+	std::unique_ptr<btEngine::MainLoopTaskQueue>            mTaskQueue              = std::make_unique<btEngine::MainLoopTaskQueue>();
+	std::unique_ptr<TeaAnimation::AnimatorStateMachineSystem> mAnimatorStateMachines = std::make_unique<TeaAnimation::AnimatorStateMachineSystem>();
+	std::unique_ptr<TeaAnimation::AnimationEventDispatcher> mAnimationEvents     = std::make_unique<TeaAnimation::AnimationEventDispatcher>();
+	std::unique_ptr<SceneManager::WorldStreamer>            mWorldStreamer          = std::make_unique<SceneManager::WorldStreamer>(*mTaskQueue);
     };
 }
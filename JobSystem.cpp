@@ -0,0 +1,186 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      JobSystem.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- JobSystem class implementation
+- Worker thread loop and job queue management
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    // 0 on the main thread, set once by every worker so nested waits keep their buffers apart
+    thread_local uint32_t t_threadIndex = 0;
+}
+
+namespace btEngine
+{
+    JobSystem::~JobSystem()
+    {
+        shutdown();
+    }
+
+    bool JobSystem::initialize(uint32_t workerCount)
+    {
+        if (m_running) return true;
+
+        // Leave one core for the main thread, it helps out while waiting anyway
+        if (workerCount == 0)
+        {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        m_running = true;
+        m_workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            // Worker indices start at 1, index 0 belongs to the main thread
+            m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+        }
+
+        TEA_INFO("Job System started with {} worker threads", workerCount);
+        return true;
+    }
+
+    void JobSystem::shutdown()
+    {
+        if (!m_running) return;
+
+        // Workers finish whatever is still queued before they exit
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_running = false;
+        }
+        m_wakeCondition.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+        m_workers.clear();
+    }
+
+    JobHandle JobSystem::execute(std::function<void(JobArgs)> job)
+    {
+        JobHandle handle;
+        handle.m_counter = std::make_shared<std::atomic<uint32_t>>(1);
+        m_pendingJobs.fetch_add(1, std::memory_order_acq_rel);
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_queue.push_back({ [job = std::move(job)](uint32_t threadIndex)
+            {
+                JobArgs args;
+                args.threadIndex = threadIndex;
+                job(args);
+            }, handle.m_counter });
+        }
+        m_wakeCondition.notify_one();
+        return handle;
+    }
+
+    JobHandle JobSystem::dispatch(uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& job)
+    {
+        JobHandle handle;
+        if (jobCount == 0 || groupSize == 0) return handle;
+
+        const uint32_t groupCount = getGroupCount(jobCount, groupSize);
+        handle.m_counter = std::make_shared<std::atomic<uint32_t>>(groupCount);
+        m_pendingJobs.fetch_add(groupCount, std::memory_order_acq_rel);
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            for (uint32_t groupIndex = 0; groupIndex < groupCount; groupIndex++)
+            {
+                // Every group runs its slice of the range on whichever thread picks it up
+                m_queue.push_back({ [job, groupIndex, groupSize, jobCount](uint32_t threadIndex)
+                {
+                    const uint32_t groupBegin = groupIndex * groupSize;
+                    const uint32_t groupEnd = std::min(groupBegin + groupSize, jobCount);
+
+                    JobArgs args;
+                    args.groupIndex = groupIndex;
+                    args.threadIndex = threadIndex;
+                    for (uint32_t i = groupBegin; i < groupEnd; i++)
+                    {
+                        args.jobIndex = i;
+                        job(args);
+                    }
+                }, handle.m_counter });
+            }
+        }
+        m_wakeCondition.notify_all();
+        return handle;
+    }
+
+    void JobSystem::wait(const JobHandle& handle)
+    {
+        // Help with this submission only, jobs already picked up by workers are just waited out
+        while (!handle.isDone())
+        {
+            if (!runJobOf(handle, t_threadIndex))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool JobSystem::runJobOf(const JobHandle& handle, uint32_t threadIndex)
+    {
+        QueuedJob job;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            auto it = std::find_if(m_queue.begin(), m_queue.end(),
+                [&handle](const QueuedJob& queued) { return queued.counter == handle.m_counter; });
+            if (it == m_queue.end()) return false;
+
+            job = std::move(*it);
+            m_queue.erase(it);
+        }
+
+        finishJob(job, threadIndex);
+        return true;
+    }
+
+    void JobSystem::finishJob(QueuedJob& job, uint32_t threadIndex)
+    {
+        job.run(threadIndex);
+        job.counter->fetch_sub(1, std::memory_order_acq_rel);
+        m_pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void JobSystem::workerLoop(uint32_t threadIndex)
+    {
+        t_threadIndex = threadIndex;
+        while (true)
+        {
+            QueuedJob job;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_wakeCondition.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+
+                if (!m_running && m_queue.empty()) return;
+
+                job = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            finishJob(job, threadIndex);
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      JobSystem.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- JobSystem class definition
+- Worker thread pool with a shared job queue
+- Range dispatch helper for splitting data parallel work into groups
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*                                                             function declarations
+====================================================================================*/
+namespace btEngine
+{
+    /**
+     * @brief Arguments handed to every job that is run by the job system
+     *
+     * threadIndex is 0 for the main thread (when it helps out inside wait())
+     * and 1..N for the workers, so callers can index per-thread buffers with it.
+     * A worker helping inside a nested wait() keeps its own index.
+    */
+    struct JobArgs
+    {
+        uint32_t jobIndex = 0;     // Index of the item inside the dispatched range
+        uint32_t groupIndex = 0;   // Index of the group the item belongs to
+        uint32_t threadIndex = 0;  // Index of the thread running the job
+    };
+
+    /**
+     * @brief Completion counter of the jobs queued by one execute() or dispatch() call
+     *
+     * Default constructed handles (and handles of empty ranges) are already done.
+    */
+    class JobHandle
+    {
+    public:
+        bool isDone() const { return !m_counter || m_counter->load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+        std::shared_ptr<std::atomic<uint32_t>> m_counter;
+    };
+
+    /**
+     * @brief Small fixed-size worker pool used by engine systems for data parallel work
+     *
+     * This class handles:
+     * 1. Spawning and joining the worker threads
+     * 2. Queueing single jobs and ranges split into groups
+     * 3. Waiting for the jobs of one submission, with the calling thread running only those jobs,
+     *    so a frame never stalls on or executes unrelated long jobs queued by someone else
+    */
+    class JobSystem
+    {
+    public:
+        JobSystem() = default;
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        /**
+         * @brief Starts the worker threads
+         * @param workerCount Number of workers to spawn, 0 picks hardware concurrency - 1
+         * @return true if the pool is running
+        */
+        bool initialize(uint32_t workerCount = 0);
+        void shutdown();
+
+        /**
+         * @brief Queues a single job
+         * @param job Function to run on a worker thread
+         * @return Handle to wait on, may be dropped for fire and forget jobs
+        */
+        JobHandle execute(std::function<void(JobArgs)> job);
+
+        /**
+         * @brief Splits a range of jobCount items into groups of groupSize and queues one job per group
+         * @param jobCount Number of items in the range
+         * @param groupSize Number of items processed by one group
+         * @param job Function called once per item
+         * @return Handle to wait on for the whole range
+        */
+        JobHandle dispatch(uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& job);
+
+        /**
+         * @brief Blocks until the jobs of one submission have finished
+         *
+         * The calling thread runs that submission's queued jobs meanwhile, jobs queued by
+         * anyone else are left to the workers. Safe to call from a worker thread.
+         *
+         * @param handle Handle returned by execute() or dispatch()
+        */
+        void wait(const JobHandle& handle);
+
+        bool isBusy() const { return m_pendingJobs.load(std::memory_order_acquire) > 0; }
+
+        // Number of threads that can run jobs (workers + the waiting main thread)
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+        // Number of groups dispatch() would create for the given range
+        static uint32_t getGroupCount(uint32_t jobCount, uint32_t groupSize)
+        {
+            return groupSize == 0 ? 0 : (jobCount + groupSize - 1) / groupSize;
+        }
+
+    private:
+        struct QueuedJob
+        {
+            std::function<void(uint32_t)>               run;
+            std::shared_ptr<std::atomic<uint32_t>>      counter;
+        };
+
+        void workerLoop(uint32_t threadIndex);
+        bool runJobOf(const JobHandle& handle, uint32_t threadIndex);
+        void finishJob(QueuedJob& job, uint32_t threadIndex);
+
+        std::vector<std::thread>                        m_workers;
+        std::deque<QueuedJob>                           m_queue;
+        std::mutex                                      m_queueMutex;
+        std::condition_variable                         m_wakeCondition;
+        std::atomic<uint64_t>                           m_pendingJobs{ 0 };
+        bool                                            m_running = false;
+    };
+}
@@ -0,0 +1,739 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      OfflinePrefabPropagation.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SAX handler streaming a scene file one entity at a time
+- Offline prefab propagation over the scene files of a project
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "OfflinePrefabPropagation.hpp"
+#include "PrefabUsageIndex.hpp"
+#include "../Core/BlockCompression.hpp"
+#include "../Components/ComponentManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <rapidjson/error/en.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    // Output stream for dry runs, the writer goes through the same steps but nothing is kept
+    struct NullOutputStream
+    {
+        typedef char Ch;
+        void Put(Ch) {}
+        void Flush() {}
+    };
+
+    bool keyEquals(const char* str, rapidjson::SizeType length, const char* key)
+    {
+        return std::strlen(key) == length && std::memcmp(str, key, length) == 0;
+    }
+
+    /**
+     * @brief Forwards a scene file from a SAX reader to a writer, buffering one entity at a time
+     *
+     * Everything outside the "Entities" array is written straight through. Each entity object is
+     * written to a small buffer instead while its master prefab handle is picked up on the way,
+     * then handed to onEntity which writes either the buffer as is or an updated copy.
+    */
+    template<typename OutputWriter, typename EntityFunc>
+    class SceneStreamHandler
+    {
+    public:
+        SceneStreamHandler(OutputWriter& output, EntityFunc& onEntity)
+            : m_output(output), m_onEntity(onEntity), m_entityWriter(m_buffer)
+        {
+        }
+
+        bool Null()                 { return route([](auto& writer) { return writer.Null(); }); }
+        bool Bool(bool b)           { return route([b](auto& writer) { return writer.Bool(b); }); }
+        bool Int(int i)             { noteHandle(static_cast<uint64_t>(i)); return route([i](auto& writer) { return writer.Int(i); }); }
+        bool Uint(unsigned u)       { noteHandle(u); return route([u](auto& writer) { return writer.Uint(u); }); }
+        bool Int64(int64_t i)       { noteHandle(static_cast<uint64_t>(i)); return route([i](auto& writer) { return writer.Int64(i); }); }
+        bool Uint64(uint64_t u)     { noteHandle(u); return route([u](auto& writer) { return writer.Uint64(u); }); }
+        bool Double(double d)       { return route([d](auto& writer) { return writer.Double(d); }); }
+
+        bool RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+        {
+            return route([=](auto& writer) { return writer.RawNumber(str, length, copy); });
+        }
+
+        bool String(const char* str, rapidjson::SizeType length, bool copy)
+        {
+            // Handles may be written as strings, the prefilter matches both forms
+            if (isHandleValue())
+            {
+                m_masterHandle = std::strtoull(std::string(str, length).c_str(), nullptr, 10);
+            }
+            return route([=](auto& writer) { return writer.String(str, length, copy); });
+        }
+
+        bool Key(const char* str, rapidjson::SizeType length, bool copy)
+        {
+            if (m_depth == 1)
+            {
+                m_pendingEntities = keyEquals(str, length, TeaAsset::SceneFileSchema::EntitiesKey);
+            }
+            else if (m_buffering && m_depth == m_entityDepth)
+            {
+                m_inOverride = keyEquals(str, length, TeaAsset::SceneFileSchema::OverrideComponent);
+            }
+            else if (m_buffering && m_depth == m_entityDepth + 1)
+            {
+                m_isHandleKey = m_inOverride && keyEquals(str, length, TeaAsset::SceneFileSchema::MasterPrefabHandle);
+            }
+            return route([=](auto& writer) { return writer.Key(str, length, copy); });
+        }
+
+        bool StartObject()
+        {
+            // An object directly inside the "Entities" array is an entity, start buffering it
+            if (!m_buffering && m_entitiesDepth != 0 && m_depth == m_entitiesDepth)
+            {
+                m_buffering = true;
+                m_entityDepth = m_depth + 1;
+                m_masterHandle = 0;
+                m_inOverride = false;
+                m_isHandleKey = false;
+            }
+            m_depth++;
+            return route([](auto& writer) { return writer.StartObject(); });
+        }
+
+        bool EndObject(rapidjson::SizeType memberCount)
+        {
+            m_depth--;
+            if (!route([memberCount](auto& writer) { return writer.EndObject(memberCount); }))
+            {
+                return false;
+            }
+
+            // The entity is complete, let the caller decide what gets written
+            if (m_buffering && m_depth + 1 == m_entityDepth)
+            {
+                m_buffering = false;
+                m_onEntity(m_masterHandle, m_buffer.GetString(), m_buffer.GetSize(), m_output);
+                m_buffer.Clear();
+                m_entityWriter.Reset(m_buffer);
+            }
+            return true;
+        }
+
+        bool StartArray()
+        {
+            if (!m_buffering && m_depth == 1 && m_pendingEntities)
+            {
+                m_entitiesDepth = m_depth + 1;
+            }
+            m_depth++;
+            return route([](auto& writer) { return writer.StartArray(); });
+        }
+
+        bool EndArray(rapidjson::SizeType elementCount)
+        {
+            if (!m_buffering && m_depth == m_entitiesDepth)
+            {
+                m_entitiesDepth = 0;
+            }
+            m_depth--;
+            return route([elementCount](auto& writer) { return writer.EndArray(elementCount); });
+        }
+
+    private:
+        template<typename Func>
+        bool route(Func&& func)
+        {
+            return m_buffering ? func(m_entityWriter) : func(m_output);
+        }
+
+        bool isHandleValue() const
+        {
+            return m_buffering && m_isHandleKey && m_depth == m_entityDepth + 1;
+        }
+
+        void noteHandle(uint64_t value)
+        {
+            if (isHandleValue())
+            {
+                m_masterHandle = value;
+            }
+        }
+
+        OutputWriter&                                   m_output;
+        EntityFunc&                                     m_onEntity;
+        rapidjson::StringBuffer                         m_buffer;
+        rapidjson::Writer<rapidjson::StringBuffer>      m_entityWriter;
+
+        uint32_t    m_depth = 0;
+        uint32_t    m_entitiesDepth = 0;    // Depth inside the "Entities" array, 0 when outside of it
+        uint32_t    m_entityDepth = 0;      // Depth inside the buffered entity object
+        uint64_t    m_masterHandle = 0;
+        bool        m_pendingEntities = false;
+        bool        m_buffering = false;
+        bool        m_inOverride = false;
+        bool        m_isHandleKey = false;
+    };
+
+    template<typename InputStream, typename OutputWriter, typename EntityFunc>
+    bool streamScene(InputStream& input, OutputWriter& output, EntityFunc& onEntity, std::string& error)
+    {
+        SceneStreamHandler<OutputWriter, EntityFunc> handler(output, onEntity);
+        rapidjson::Reader reader;
+
+        rapidjson::ParseResult parseResult = reader.Parse<rapidjson::kParseFullPrecisionFlag>(input, handler);
+        if (!parseResult)
+        {
+            error = std::string(rapidjson::GetParseError_En(parseResult.Code())) + " at offset " + std::to_string(parseResult.Offset());
+            return false;
+        }
+        return true;
+    }
+}
+
+namespace TeaAsset
+{
+    std::set<std::filesystem::path> OfflinePrefabPropagation::s_openScenes;
+    std::mutex OfflinePrefabPropagation::s_openScenesMutex;
+
+    uint32_t OfflinePropagationReport::getInstancesChanged() const
+    {
+        uint32_t total = 0;
+        for (const auto& scene : scenes)
+        {
+            total += scene.instancesChanged;
+        }
+        return total;
+    }
+
+    size_t OfflinePropagationReport::getFilesChanged() const
+    {
+        return static_cast<size_t>(std::count_if(scenes.begin(), scenes.end(),
+            [](const ScenePropagationResult& scene) { return scene.instancesChanged > 0; }));
+    }
+
+    OfflinePropagationReport OfflinePrefabPropagation::run(const AssetHandle& handle, const OfflinePropagationOptions& options,
+        btEngine::JobSystem* jobSystem)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        OfflinePropagationReport report;
+        report.dryRun = options.dryRun;
+
+        AffectedPrefabs affected = collectAffectedPrefabs(handle, options.projectDirectory);
+        if (affected.empty())
+        {
+            TEA_ERROR("Failed to resolve the prefab to propagate, no scene was touched");
+            return report;
+        }
+
+        std::vector<std::string> needles;
+        for (const auto& [handleKey, prefab] : affected)
+        {
+            needles.push_back(std::to_string(handleKey));
+        }
+
+        std::vector<std::string> componentNames;
+        for (const auto& componentType : TeaComponents::ComponentManager::getAllComponentTypes())
+        {
+            componentNames.push_back(componentType.get_name().to_string());
+        }
+
+        // Gather the scene files, leaving out the ones the editor has open
+        std::error_code error;
+        std::vector<std::filesystem::path> excluded;
+        for (const auto& path : options.excludedFiles)
+        {
+            excluded.push_back(std::filesystem::weakly_canonical(path, error));
+        }
+        if (!options.includeOpenScenes)
+        {
+            std::vector<std::filesystem::path> openScenes = getOpenScenes();
+            excluded.insert(excluded.end(), openScenes.begin(), openScenes.end());
+        }
+
+        auto isExcluded = [&excluded, &error](const std::filesystem::path& path)
+        {
+            return std::find(excluded.begin(), excluded.end(), std::filesystem::weakly_canonical(path, error)) != excluded.end();
+        };
+
+        // The usage index knows which scenes reference the prefabs, without it every scene gets a text scan
+        const bool useIndex = PrefabUsageIndex::isLoaded();
+        std::vector<std::filesystem::path> sceneFiles;
+        if (useIndex)
+        {
+            std::unordered_set<std::string> seen;
+            for (const auto& [handleKey, prefab] : affected)
+            {
+                for (const auto& usage : PrefabUsageIndex::findUsages(handleKey))
+                {
+                    std::filesystem::path scenePath = usage.filePath;
+                    if (scenePath.extension() != SceneFileSchema::SceneExtension || isExcluded(scenePath)) continue;
+                    if (seen.insert(usage.filePath).second)
+                    {
+                        sceneFiles.push_back(scenePath);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(options.projectDirectory, error))
+            {
+                if (!entry.is_regular_file() || entry.path().extension() != SceneFileSchema::SceneExtension) continue;
+                if (isExcluded(entry.path())) continue;
+
+                sceneFiles.push_back(entry.path());
+            }
+        }
+        report.filesScanned = sceneFiles.size();
+
+        // One job per file, each job only touches its own result slot
+        std::vector<ScenePropagationResult> results(sceneFiles.size());
+        std::vector<uint8_t> matched(sceneFiles.size(), 0);
+        auto processFile = [&](btEngine::JobArgs args)
+        {
+            const auto& scenePath = sceneFiles[args.jobIndex];
+            if (!useIndex && !fileMentionsAny(scenePath, needles)) return;
+
+            matched[args.jobIndex] = 1;
+            results[args.jobIndex] = processScene(scenePath, affected, componentNames, options.dryRun);
+        };
+
+        if (jobSystem)
+        {
+            jobSystem->wait(jobSystem->dispatch(static_cast<uint32_t>(sceneFiles.size()), 1, processFile));
+        }
+        else
+        {
+            for (uint32_t i = 0; i < sceneFiles.size(); i++)
+            {
+                processFile(btEngine::JobArgs{ i, i, 0 });
+            }
+        }
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (matched[i])
+            {
+                report.scenes.push_back(std::move(results[i]));
+            }
+        }
+
+        report.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        return report;
+    }
+
+    OfflinePrefabPropagation::AffectedPrefabs OfflinePrefabPropagation::collectAffectedPrefabs(const AssetHandle& handle,
+        const std::filesystem::path& projectDirectory)
+    {
+        AffectedPrefabs affected;
+        const uint64_t handleKey = static_cast<uint64_t>(handle);
+
+        auto prefab = PrefabResolver::resolve(handle);
+        if (!prefab)
+        {
+            return affected;
+        }
+        affected.emplace(handleKey, prefab);
+
+        // Variant prefab files are recorded in the usage index as users of their base
+        if (PrefabUsageIndex::isLoaded())
+        {
+            std::vector<uint64_t> pending{ handleKey };
+            while (!pending.empty())
+            {
+                uint64_t baseKey = pending.back();
+                pending.pop_back();
+
+                for (const auto& usage : PrefabUsageIndex::findUsages(baseKey))
+                {
+                    if (std::filesystem::path(usage.filePath).extension() != SceneFileSchema::PrefabExtension) continue;
+
+                    AssetHandle variantHandle = AssetManager::getAssetHandle(usage.filePath);
+                    const uint64_t variantKey = static_cast<uint64_t>(variantHandle);
+                    auto variant = PrefabResolver::resolve(variantHandle);
+                    if (variant && variant->derivesFrom(handleKey) && affected.emplace(variantKey, variant).second)
+                    {
+                        pending.push_back(variantKey);
+                    }
+                }
+            }
+            return affected;
+        }
+
+        // Only prefab files naming a base can be variants, the rest are never parsed here
+        const std::vector<std::string> variantNeedle{ PrefabResolver::BasePrefabKey };
+        std::error_code error;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(projectDirectory, error))
+        {
+            if (!entry.is_regular_file() || entry.path().extension() != SceneFileSchema::PrefabExtension) continue;
+            if (!fileMentionsAny(entry.path(), variantNeedle)) continue;
+
+            AssetHandle prefabHandle = AssetManager::getAssetHandle(entry.path().string());
+            auto variant = PrefabResolver::resolve(prefabHandle);
+            if (variant && variant->derivesFrom(handleKey))
+            {
+                affected.emplace(static_cast<uint64_t>(prefabHandle), variant);
+            }
+        }
+
+        return affected;
+    }
+
+    ScenePropagationResult OfflinePrefabPropagation::processScene(const std::filesystem::path& scenePath,
+        const AffectedPrefabs& affected, const std::vector<std::string>& componentNames, bool dryRun)
+    {
+        ScenePropagationResult result;
+        result.scenePath = scenePath.string();
+
+        std::ifstream input(scenePath, std::ios::binary);
+        if (!input.is_open())
+        {
+            result.error = "Failed to open scene file";
+            return result;
+        }
+
+        // Compressed scenes are unpacked up front, plain ones keep streaming from disk
+        std::string header(btEngine::BlockCompression::FileHeaderSize, '\0');
+        input.read(header.data(), static_cast<std::streamsize>(header.size()));
+        header.resize(static_cast<size_t>(input.gcount()));
+        input.clear();
+        input.seekg(0);
+
+        const bool compressed = btEngine::BlockCompression::isCompressed(header);
+        std::string contents;
+        if (compressed && !btEngine::BlockCompression::readFile(scenePath, contents, &result.error))
+        {
+            return result;
+        }
+
+        // Entities that are not instances of an affected prefab are copied through untouched
+        auto onEntity = [&](uint64_t masterHandle, const char* json, size_t length, auto& output)
+        {
+            auto it = affected.find(masterHandle);
+            if (masterHandle == 0 || it == affected.end())
+            {
+                output.RawValue(json, length, rapidjson::kObjectType);
+                return;
+            }
+            result.instancesFound++;
+
+            rapidjson::Document entityDoc;
+            entityDoc.Parse<rapidjson::kParseFullPrecisionFlag>(json, length);
+            if (entityDoc.HasParseError() ||
+                !applyToEntity(entityDoc, it->second->getEntityData(), componentNames, entityDoc.GetAllocator(), result))
+            {
+                output.RawValue(json, length, rapidjson::kObjectType);
+                return;
+            }
+
+            result.instancesChanged++;
+            entityDoc.Accept(output);
+        };
+
+        auto parseScene = [&](auto& output)
+        {
+            if (compressed)
+            {
+                rapidjson::StringStream stream(contents.c_str());
+                return streamScene(stream, output, onEntity, result.error);
+            }
+            rapidjson::IStreamWrapper isw(input);
+            return streamScene(isw, output, onEntity, result.error);
+        };
+
+        if (dryRun)
+        {
+            NullOutputStream nullStream;
+            rapidjson::Writer<NullOutputStream> output(nullStream);
+            parseScene(output);
+            return result;
+        }
+
+        // Write next to the scene and swap it in only once the whole file streamed through
+        std::filesystem::path tempPath = scenePath;
+        tempPath += ".tmp";
+
+        bool streamed = false;
+        if (compressed)
+        {
+            // Rewritten scenes stay compressed
+            std::FILE* outputFile = std::fopen(tempPath.string().c_str(), "wb");
+            if (!outputFile)
+            {
+                result.error = "Failed to create temporary scene file";
+                return result;
+            }
+
+            btEngine::BlockCompressedWriter blockWriter(outputFile);
+            rapidjson::PrettyWriter<btEngine::BlockCompressedWriter> output(blockWriter);
+            streamed = parseScene(output);
+
+            // Closed whether or not the last block made it out
+            const bool finished = blockWriter.finish();
+            const bool closed = std::fclose(outputFile) == 0;
+            if (streamed && !(finished && closed))
+            {
+                result.error = "Failed to write temporary scene file";
+                streamed = false;
+            }
+        }
+        else
+        {
+            std::ofstream outputFile(tempPath, std::ios::binary | std::ios::trunc);
+            if (!outputFile.is_open())
+            {
+                result.error = "Failed to create temporary scene file";
+                return result;
+            }
+
+            rapidjson::OStreamWrapper osw(outputFile);
+            rapidjson::PrettyWriter<rapidjson::OStreamWrapper> output(osw);
+            streamed = parseScene(output);
+
+            outputFile.flush();
+            if (streamed && !outputFile)
+            {
+                result.error = "Failed to write temporary scene file";
+                streamed = false;
+            }
+        }
+        input.close();
+
+        std::error_code fsError;
+        if (!streamed || result.instancesChanged == 0)
+        {
+            std::filesystem::remove(tempPath, fsError);
+            return result;
+        }
+
+        std::filesystem::rename(tempPath, scenePath, fsError);
+        if (fsError)
+        {
+            result.error = "Failed to replace scene file: " + fsError.message();
+            std::filesystem::remove(tempPath, fsError);
+            return result;
+        }
+
+        result.rewritten = true;
+        return result;
+    }
+
+    bool OfflinePrefabPropagation::applyToEntity(rapidjson::Value& entity, const rapidjson::Value& prefabEntity,
+        const std::vector<std::string>& componentNames, rapidjson::Document::AllocatorType& allocator,
+        ScenePropagationResult& result)
+    {
+        if (!entity.IsObject() || !prefabEntity.IsObject())
+        {
+            return false;
+        }
+
+        const rapidjson::Value* overrideData = nullptr;
+        auto overrideMember = entity.FindMember(SceneFileSchema::OverrideComponent);
+        if (overrideMember != entity.MemberEnd() && overrideMember->value.IsObject())
+        {
+            overrideData = &overrideMember->value;
+        }
+
+        // Looks for name under key in the override arrays ("components" / "properties")
+        auto overrideListContains = [overrideData](const char* listKey, const char* fieldKey, const std::string& name)
+        {
+            if (!overrideData) return false;
+
+            auto list = overrideData->FindMember(listKey);
+            if (list == overrideData->MemberEnd() || !list->value.IsArray()) return false;
+
+            for (const auto& item : list->value.GetArray())
+            {
+                if (!item.IsObject()) continue;
+                auto field = item.FindMember(fieldKey);
+                if (field != item.MemberEnd() && field->value.IsString() && name == field->value.GetString())
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // Same rules as HierarchyPanel::updatePrefabInstance, on the serialized entity
+        bool changed = false;
+        for (const auto& typeName : componentNames)
+        {
+            if (typeName == "Scene ID") continue;
+
+            bool existsInPrefabAsset = prefabEntity.HasMember(typeName.c_str());
+            bool existsInPrefabInstance = entity.HasMember(typeName.c_str());
+            bool isLocallyAdded = overrideListContains(SceneFileSchema::AddedComponents, SceneFileSchema::ComponentName, typeName);
+
+            // Case 1: Component exists in the prefab asset but not in the instance and was not removed on purpose
+            if (existsInPrefabAsset && !existsInPrefabInstance && !isLocallyAdded)
+            {
+                if (typeName == "Child" || typeName == "Parent") continue;
+
+                entity.AddMember(rapidjson::Value(typeName.c_str(), allocator), rapidjson::Value(rapidjson::kObjectType), allocator);
+                result.componentsAdded++;
+                changed = true;
+            }
+            // Case 2: Component exists in the instance but not in the prefab asset
+            else if (!existsInPrefabAsset && existsInPrefabInstance)
+            {
+                if (typeName == "UUIDComponent" || typeName == "OverrideComponent") continue;
+
+                if (!isLocallyAdded)
+                {
+                    entity.RemoveMember(typeName.c_str());
+                    result.componentsRemoved++;
+                    changed = true;
+                }
+                continue;
+            }
+
+            if (!existsInPrefabAsset) continue;
+
+            auto componentMember = entity.FindMember(typeName.c_str());
+            const auto& prefabComponent = prefabEntity[typeName.c_str()];
+            if (componentMember == entity.MemberEnd() || !componentMember->value.IsObject() || !prefabComponent.IsObject()) continue;
+
+            // Copy every property that is not overridden and differs from the prefab
+            auto& component = componentMember->value;
+            for (auto prop = prefabComponent.MemberBegin(); prop != prefabComponent.MemberEnd(); ++prop)
+            {
+                std::string propName = prop->name.GetString();
+                if (propName == "Scene ID" || propName == "Parent") continue;
+                if (overrideListContains(SceneFileSchema::OverriddenProperties, SceneFileSchema::PropertyPath, typeName + "/" + propName)) continue;
+
+                auto existing = component.FindMember(prop->name);
+                if (existing == component.MemberEnd())
+                {
+                    component.AddMember(rapidjson::Value(prop->name, allocator), rapidjson::Value(prop->value, allocator), allocator);
+                }
+                else if (existing->value != prop->value)
+                {
+                    existing->value.CopyFrom(prop->value, allocator);
+                }
+                else
+                {
+                    continue;
+                }
+
+                result.propertiesChanged++;
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+
+    void OfflinePrefabPropagation::logReport(const OfflinePropagationReport& report)
+    {
+        TEA_INFO("{0}Prefab propagation: {1} scene files scanned, {2} mention the prefab, {3} would change ({4} instances) in {5} ms",
+            report.dryRun ? "[Dry run] " : "", report.filesScanned, report.scenes.size(), report.getFilesChanged(),
+            report.getInstancesChanged(), report.elapsedMs);
+
+        for (const auto& scene : report.scenes)
+        {
+            if (!scene.error.empty())
+            {
+                TEA_ERROR("  {0}: {1}", scene.scenePath, scene.error);
+                continue;
+            }
+
+            TEA_INFO("  {0}: {1}/{2} instances changed, {3} properties, +{4}/-{5} components{6}",
+                scene.scenePath, scene.instancesChanged, scene.instancesFound, scene.propertiesChanged,
+                scene.componentsAdded, scene.componentsRemoved, scene.rewritten ? ", rewritten" : "");
+        }
+    }
+
+    void OfflinePrefabPropagation::setSceneOpen(const std::filesystem::path& scenePath, bool open)
+    {
+        std::error_code error;
+        std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(scenePath, error);
+
+        std::lock_guard<std::mutex> lock(s_openScenesMutex);
+        if (open)
+        {
+            s_openScenes.insert(canonicalPath);
+        }
+        else
+        {
+            s_openScenes.erase(canonicalPath);
+        }
+    }
+
+    std::vector<std::filesystem::path> OfflinePrefabPropagation::getOpenScenes()
+    {
+        std::lock_guard<std::mutex> lock(s_openScenesMutex);
+        return std::vector<std::filesystem::path>(s_openScenes.begin(), s_openScenes.end());
+    }
+
+    bool OfflinePrefabPropagation::fileMentionsAny(const std::filesystem::path& path, const std::vector<std::string>& needles)
+    {
+        constexpr size_t ChunkSize = 64 * 1024;
+
+        size_t longestNeedle = 0;
+        for (const auto& needle : needles)
+        {
+            longestNeedle = std::max(longestNeedle, needle.size());
+        }
+        if (longestNeedle == 0) return false;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        // The text of a compressed file only shows up once it is unpacked
+        std::string header(btEngine::BlockCompression::FileHeaderSize, '\0');
+        file.read(header.data(), static_cast<std::streamsize>(header.size()));
+        header.resize(static_cast<size_t>(file.gcount()));
+        if (btEngine::BlockCompression::isCompressed(header))
+        {
+            std::string contents;
+            if (!btEngine::BlockCompression::readFile(path, contents)) return false;
+
+            return std::any_of(needles.begin(), needles.end(),
+                [&contents](const std::string& needle) { return contents.find(needle) != std::string::npos; });
+        }
+        file.clear();
+        file.seekg(0);
+
+        // Read in chunks, keeping the tail of the previous chunk so matches across the boundary are found
+        std::vector<char> chunk(ChunkSize);
+        std::string window;
+        while (file.read(chunk.data(), ChunkSize) || file.gcount() > 0)
+        {
+            window.append(chunk.data(), static_cast<size_t>(file.gcount()));
+            for (const auto& needle : needles)
+            {
+                if (window.find(needle) != std::string::npos)
+                {
+                    return true;
+                }
+            }
+
+            if (window.size() >= longestNeedle)
+            {
+                window.erase(0, window.size() - (longestNeedle - 1));
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,180 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      OfflinePrefabPropagation.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SceneFileSchema constants describing how scenes are written to disk
+- OfflinePrefabPropagation class streaming prefab changes into unloaded scene files
+- Per scene and project wide propagation reports (also produced by dry runs)
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "../Asset/AssetManager.hpp"
+#include "../Asset/PrefabVariant.hpp"
+#include "../Core/JobSystem.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief Layout of a scene file as written by the scene serializer
+     *
+     * { "Entities": [ { "<Component>": { "<Property>": ... }, ... }, ... ], "SchemaVersions": { "<Component>": n } }
+     *
+     * The OverrideComponent keys follow its rttr registration, keep them in sync.
+    */
+    struct SceneFileSchema
+    {
+        static constexpr const char* EntitiesKey = "Entities";
+        static constexpr const char* OverrideComponent = "OverrideComponent";
+        static constexpr const char* MasterPrefabHandle = "masterPrefabHandle";
+        static constexpr const char* AddedComponents = "components";
+        static constexpr const char* ComponentName = "componentName";
+        static constexpr const char* OverriddenProperties = "properties";
+        static constexpr const char* PropertyPath = "path";
+        static constexpr const char* UUIDComponent = "UUIDComponent";
+        static constexpr const char* UUIDKey = "uuid";
+        static constexpr const char* ParentComponent = "Parent";
+        static constexpr const char* ParentKey = "Parent";          // UUID of the parent entity
+        static constexpr const char* SubSceneInstanceKey = "SubSceneInstance";     // Written by SceneWriter, not an rttr component
+        static constexpr const char* SubScenePath = "scene";
+        static constexpr const char* SubSceneOverrides = "overrides";
+        static constexpr const char* SubSceneEntityIndex = "entity";
+        static constexpr const char* SubSceneComponent = "component";
+        static constexpr const char* SubSceneProperty = "property";
+        static constexpr const char* SubSceneValue = "value";
+        static constexpr const char* SchemaVersionsKey = "SchemaVersions";
+        static constexpr const char* SceneExtension = ".scene";
+        static constexpr const char* PrefabExtension = ".prefab";
+    };
+
+    /**
+     * @brief What propagation did (or would do, on a dry run) to one scene file
+    */
+    struct ScenePropagationResult
+    {
+        std::string scenePath;
+        uint32_t instancesFound = 0;        // Instances of the prefab or one of its variants
+        uint32_t instancesChanged = 0;      // Instances with at least one change
+        uint32_t propertiesChanged = 0;
+        uint32_t componentsAdded = 0;
+        uint32_t componentsRemoved = 0;
+        bool rewritten = false;             // File was replaced on disk
+        std::string error;                  // Empty on success
+    };
+
+    /**
+     * @brief Summary of a project wide propagation
+    */
+    struct OfflinePropagationReport
+    {
+        bool dryRun = false;
+        size_t filesScanned = 0;                        // Candidate scene files (from the usage index or the text scan)
+        std::vector<ScenePropagationResult> scenes;     // Scene files that mention an affected prefab
+        double elapsedMs = 0.0;
+
+        uint32_t getInstancesChanged() const;
+        size_t getFilesChanged() const;
+    };
+
+    struct OfflinePropagationOptions
+    {
+        std::filesystem::path projectDirectory;                 // Searched recursively for scenes and prefabs
+        bool dryRun = false;                                    // Report only, nothing is written
+        std::vector<std::filesystem::path> excludedFiles;       // Extra scene files to leave alone
+        bool includeOpenScenes = false;                         // Also rewrite the scenes marked open with setSceneOpen
+    };
+
+    /**
+     * @brief Propagates a prefab change into scene files that are not loaded
+     *
+     * This class handles:
+     * 1. Finding the prefab and every variant derived from it in the project
+     * 2. Picking the scene files to visit from the prefab usage index, or with a raw text scan without one
+     * 3. Streaming each remaining scene through a SAX reader/writer pair, holding one entity at a time
+     * 4. Applying the same add/remove/override rules as HierarchyPanel::updatePrefabInstance on the JSON
+     * 5. Rewriting the files in parallel on the job system, through a temp file and a rename
+     * 6. Leaving out the scenes open in the editor, which are updated in memory instead. The scene
+     *    loader marks them with setSceneOpen, saving a scene through SceneWriter marks it too
+    */
+    class OfflinePrefabPropagation
+    {
+    public:
+        using AffectedPrefabs = std::unordered_map<uint64_t, std::shared_ptr<const ResolvedPrefab>>;
+
+        /**
+         * @brief Runs the propagation over every scene file of the project
+         * @param handle Asset handle of the changed prefab
+         * @param options Project directory, dry run flag and excluded files
+         * @param jobSystem Job system to process the files on, nullptr runs them on the calling thread
+         * @return Report of every scene file that mentions an affected prefab
+        */
+        static OfflinePropagationReport run(const AssetHandle& handle, const OfflinePropagationOptions& options,
+            btEngine::JobSystem* jobSystem);
+
+        /**
+         * @brief Resolves the prefab and every prefab file in the project that is a variant of it
+         * @param handle Asset handle of the changed prefab
+         * @param projectDirectory Directory searched for prefab files
+         * @return Flattened data per affected prefab handle
+        */
+        static AffectedPrefabs collectAffectedPrefabs(const AssetHandle& handle, const std::filesystem::path& projectDirectory);
+
+        /**
+         * @brief Streams one scene file and updates the instances of the affected prefabs
+         * @param scenePath Scene file to process
+         * @param affected Flattened data per affected prefab handle
+         * @param componentNames Names of every registered component type
+         * @param dryRun Count the changes without writing the file
+         * @return What was (or would be) changed in the file
+        */
+        static ScenePropagationResult processScene(const std::filesystem::path& scenePath, const AffectedPrefabs& affected,
+            const std::vector<std::string>& componentNames, bool dryRun);
+
+        /**
+         * @brief Applies the prefab data to one serialized prefab instance
+         * @param entity Entity object from the scene file
+         * @param prefabEntity Flattened "Entity" object of the instance's prefab
+         * @param componentNames Names of every registered component type
+         * @param allocator Allocator owning the entity
+         * @param result Change counters to update
+         * @return true if anything in the entity changed
+        */
+        static bool applyToEntity(rapidjson::Value& entity, const rapidjson::Value& prefabEntity,
+            const std::vector<std::string>& componentNames, rapidjson::Document::AllocatorType& allocator,
+            ScenePropagationResult& result);
+
+        static void logReport(const OfflinePropagationReport& report);
+
+        /**
+         * @brief Marks a scene file as loaded in the editor, so no pass rewrites it behind its back
+         * @param scenePath Scene file
+         * @param open False once the scene is unloaded
+        */
+        static void setSceneOpen(const std::filesystem::path& scenePath, bool open);
+
+        static std::vector<std::filesystem::path> getOpenScenes();
+
+    private:
+        static bool fileMentionsAny(const std::filesystem::path& path, const std::vector<std::string>& needles);
+
+        static std::set<std::filesystem::path>  s_openScenes;   // Canonical paths
+        static std::mutex                       s_openScenesMutex;
+    };
+}
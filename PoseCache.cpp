@@ -0,0 +1,220 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PoseCache.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- PoseCache implementation
+- Lazy baking on the main loop task queue
+- Per track invalidation and LRU eviction
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "PoseCache.hpp"
+
+#include <algorithm>
+#include <memory>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAnimation
+{
+    PoseCache::PoseCache(btEngine::MainLoopTaskQueue& taskQueue, size_t memoryBudget)
+        : m_taskQueue(taskQueue), m_memoryBudget(memoryBudget)
+    {
+    }
+
+    PoseCache::~PoseCache()
+    {
+        clear();
+    }
+
+    size_t PoseCache::getClipBytes(uint32_t frameCount)
+    {
+        return static_cast<size_t>(frameCount) * (3 * sizeof(glm::vec3) + sizeof(uint8_t));
+    }
+
+    bool PoseCache::apply(const TeaComponents::BjornAnimator& animator, uint64_t clipHandle, int startFrame, int endFrame, int frame,
+        TeaComponents::Transform& transform)
+    {
+        if (animator.currentClip.empty() || clipHandle == 0 || frame < startFrame || frame > endFrame)
+        {
+            return false;
+        }
+
+        ClipCache* cache = findOrCreate(clipHandle, startFrame, static_cast<uint32_t>(endFrame - startFrame + 1));
+        if (!cache)
+        {
+            m_stats.misses++;
+            return false;
+        }
+
+        const uint32_t index = static_cast<uint32_t>(frame - startFrame);
+        if (cache->bakedTracks[index] != PoseTrackAll)
+        {
+            m_stats.misses++;
+            queueBake(clipHandle, *cache, animator);
+            return false;
+        }
+
+        transform.setPosition(cache->positions[index]);
+        transform.setRotation(cache->rotations[index]);
+        transform.setScale(cache->scales[index]);
+        m_stats.hits++;
+        return true;
+    }
+
+    void PoseCache::invalidate(uint64_t clipHandle, uint8_t trackMask, int firstFrame, int lastFrame)
+    {
+        auto it = m_clips.find(clipHandle);
+        if (it == m_clips.end()) return;
+
+        ClipCache& cache = it->second;
+        const int64_t first = std::max<int64_t>(0, static_cast<int64_t>(firstFrame) - cache.startFrame);
+        const int64_t last = std::min<int64_t>(static_cast<int64_t>(cache.frameCount) - 1, static_cast<int64_t>(lastFrame) - cache.startFrame);
+        for (int64_t i = first; i <= last; i++)
+        {
+            uint8_t& baked = cache.bakedTracks[static_cast<size_t>(i)];
+            if (baked == PoseTrackAll && (trackMask & PoseTrackAll))
+            {
+                cache.bakedFrames--;
+            }
+            baked &= static_cast<uint8_t>(~trackMask);
+        }
+        // Baking resumes on the next miss
+    }
+
+    void PoseCache::evict(uint64_t clipHandle)
+    {
+        auto it = m_clips.find(clipHandle);
+        if (it == m_clips.end()) return;
+
+        if (it->second.bakeTask != 0)
+        {
+            m_taskQueue.cancel(it->second.bakeTask);
+        }
+        m_memoryUsage -= it->second.bytes;
+        m_lru.erase(it->second.lruEntry);
+        m_clips.erase(it);
+    }
+
+    void PoseCache::clear()
+    {
+        for (auto& [clipHandle, cache] : m_clips)
+        {
+            if (cache.bakeTask != 0)
+            {
+                m_taskQueue.cancel(cache.bakeTask);
+            }
+        }
+        m_clips.clear();
+        m_lru.clear();
+        m_memoryUsage = 0;
+    }
+
+    void PoseCache::setMemoryBudget(size_t memoryBudget)
+    {
+        m_memoryBudget = memoryBudget;
+        while (m_memoryUsage > m_memoryBudget && !m_lru.empty())
+        {
+            evict(m_lru.back());
+            m_stats.evictions++;
+        }
+    }
+
+    float PoseCache::getBakedFraction(uint64_t clipHandle) const
+    {
+        auto it = m_clips.find(clipHandle);
+        if (it == m_clips.end() || it->second.frameCount == 0) return 0.0f;
+
+        return static_cast<float>(it->second.bakedFrames) / static_cast<float>(it->second.frameCount);
+    }
+
+    PoseCache::ClipCache* PoseCache::findOrCreate(uint64_t clipHandle, int startFrame, uint32_t frameCount)
+    {
+        auto it = m_clips.find(clipHandle);
+        if (it != m_clips.end())
+        {
+            // A changed frame range makes every baked frame useless
+            if (it->second.startFrame == startFrame && it->second.frameCount == frameCount)
+            {
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lruEntry);
+                return &it->second;
+            }
+            evict(clipHandle);
+        }
+
+        const size_t bytes = getClipBytes(frameCount);
+        if (bytes > m_memoryBudget)
+        {
+            return nullptr;
+        }
+        while (m_memoryUsage + bytes > m_memoryBudget && !m_lru.empty())
+        {
+            evict(m_lru.back());
+            m_stats.evictions++;
+        }
+
+        ClipCache& cache = m_clips[clipHandle];
+        cache.startFrame = startFrame;
+        cache.frameCount = frameCount;
+        cache.positions.resize(frameCount);
+        cache.rotations.resize(frameCount);
+        cache.scales.resize(frameCount);
+        cache.bakedTracks.assign(frameCount, 0);
+        cache.bytes = bytes;
+        m_lru.push_front(clipHandle);
+        cache.lruEntry = m_lru.begin();
+        m_memoryUsage += bytes;
+        return &cache;
+    }
+
+    void PoseCache::queueBake(uint64_t clipHandle, ClipCache& cache, const TeaComponents::BjornAnimator& animator)
+    {
+        if (cache.bakeTask != 0) return;
+
+        // The task samples its own copy of the animator, the component may move or be removed meanwhile.
+        // The copy keeps the clip name the handle was looked up with
+        auto bakeAnimator = std::make_shared<TeaComponents::BjornAnimator>(animator);
+        const std::string clipName = animator.currentClip;
+
+        uint32_t cursor = 0;
+        cache.bakeTask = m_taskQueue.enqueue("Bake poses: " + clipName,
+            [this, clipHandle, clipName, bakeAnimator, cursor](btEngine::TaskProgress& progress) mutable
+            {
+                auto it = m_clips.find(clipHandle);
+                if (it == m_clips.end()) return true;
+
+                ClipCache& clip = it->second;
+                TeaComponents::Transform scratch;
+                uint32_t budget = FramesPerStep;
+                for (; cursor < clip.frameCount && budget > 0; cursor++)
+                {
+                    if (clip.bakedTracks[cursor] == PoseTrackAll) continue;
+
+                    // Keys are evaluated for every track at once, only the stale tracks are written
+                    Animator::ApplyKeyframeAtTime(*bakeAnimator, scratch, clip.startFrame + static_cast<int>(cursor));
+                    const uint8_t stale = static_cast<uint8_t>(~clip.bakedTracks[cursor]);
+                    if (stale & PoseTrackPosition)  clip.positions[cursor] = scratch.getPosition();
+                    if (stale & PoseTrackRotation)  clip.rotations[cursor] = scratch.getRotation();
+                    if (stale & PoseTrackScale)     clip.scales[cursor] = scratch.getScale();
+                    clip.bakedTracks[cursor] = PoseTrackAll;
+                    clip.bakedFrames++;
+                    m_stats.framesBaked++;
+                    budget--;
+                }
+
+                progress.label = clipName;
+                progress.completed = cursor;
+                progress.total = clip.frameCount;
+                if (cursor < clip.frameCount) return false;
+
+                // Frames invalidated behind the cursor are picked up by the next miss
+                clip.bakeTask = 0;
+                return true;
+            });
+    }
+}
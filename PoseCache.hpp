@@ -0,0 +1,145 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PoseCache.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- BakedPose track flags
+- PoseCache class baking the transform of every frame of a clip for timeline scrubbing, keyed by clip asset handle
+- LRU eviction under a memory cap
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <climits>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../Components/ComponentManager.hpp"
+#include "../Graphics/Animator.hpp"
+#include "../Core/TaskQueue.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAnimation
+{
+    // Transform channels baked by the cache, used as a bit mask
+    enum PoseTrack : uint8_t
+    {
+        PoseTrackPosition = 1 << 0,
+        PoseTrackRotation = 1 << 1,
+        PoseTrackScale = 1 << 2,
+        PoseTrackAll = PoseTrackPosition | PoseTrackRotation | PoseTrackScale
+    };
+
+    struct PoseCacheStats
+    {
+        uint64_t hits = 0;              // Frames copied from the cache
+        uint64_t misses = 0;            // Frames that had to be evaluated from the keys
+        uint64_t framesBaked = 0;
+        uint32_t evictions = 0;
+    };
+
+    /**
+     * @brief Optional per clip cache of the transform evaluated at every frame
+     *
+     * This class handles:
+     * 1. Baking the frames of a clip lazily on the main loop task queue, a few frames per step
+     * 2. Copying a baked frame straight into a Transform when scrubbing
+     * 3. Invalidating a track (position / rotation / scale) over a frame range when keys change
+     * 4. Keeping the baked clips under a memory cap, evicting the least recently used clip
+     *
+     * A frame is only served from the cache once every track of it is baked, until then
+     * apply() returns false and the caller evaluates the keys as before.
+     *
+     * Clips are keyed by asset handle rather than by the animator's clip name, so animators
+     * using the same name for different clips never read each other's poses, and clips
+     * deduplicated by the ClipLibrary share one bake.
+    */
+    class PoseCache
+    {
+    public:
+        static constexpr size_t DefaultMemoryBudget = 32ull * 1024 * 1024;
+        static constexpr uint32_t FramesPerStep = 32;
+
+        explicit PoseCache(btEngine::MainLoopTaskQueue& taskQueue, size_t memoryBudget = DefaultMemoryBudget);
+        ~PoseCache();
+
+        PoseCache(const PoseCache&) = delete;
+        PoseCache& operator=(const PoseCache&) = delete;
+
+        /**
+         * @brief Copies the baked pose of a frame of the animator's current clip into a transform
+         *
+         * Queues the clip for baking when the frame is not baked yet.
+         * @param animator Animator whose current clip is sampled
+         * @param clipHandle Asset handle of the animator's current clip
+         * @param startFrame First frame of the clip
+         * @param endFrame Last frame of the clip
+         * @param frame Frame to sample
+         * @param transform Transform to write the pose to
+         * @return true if the pose came from the cache
+        */
+        bool apply(const TeaComponents::BjornAnimator& animator, uint64_t clipHandle, int startFrame, int endFrame, int frame,
+            TeaComponents::Transform& transform);
+
+        /**
+         * @brief Marks tracks of a clip as stale so they are baked again
+         * @param clipHandle Asset handle of the clip
+         * @param trackMask PoseTrack bits to invalidate
+         * @param firstFrame First frame to invalidate
+         * @param lastFrame Last frame to invalidate
+        */
+        void invalidate(uint64_t clipHandle, uint8_t trackMask = PoseTrackAll, int firstFrame = INT_MIN, int lastFrame = INT_MAX);
+
+        void evict(uint64_t clipHandle);
+        void clear();
+
+        void setMemoryBudget(size_t memoryBudget);
+        size_t getMemoryBudget() const { return m_memoryBudget; }
+        size_t getMemoryUsage() const { return m_memoryUsage; }
+
+        /**
+         * @brief Gets how much of a clip is baked
+         * @param clipHandle Asset handle of the clip
+         * @return Fraction of frames with every track baked, 0 if the clip is not cached
+        */
+        float getBakedFraction(uint64_t clipHandle) const;
+
+        const PoseCacheStats& getStats() const { return m_stats; }
+
+    private:
+        struct ClipCache
+        {
+            int startFrame = 0;
+            uint32_t frameCount = 0;
+            uint32_t bakedFrames = 0;                   // Frames with every track baked
+            std::vector<glm::vec3> positions;
+            std::vector<glm::vec3> rotations;
+            std::vector<glm::vec3> scales;
+            std::vector<uint8_t> bakedTracks;           // PoseTrack bits per frame
+            uint64_t bakeTask = 0;                      // Queued bake task, 0 if none
+            size_t bytes = 0;
+            std::list<uint64_t>::iterator lruEntry;
+        };
+
+        static size_t getClipBytes(uint32_t frameCount);
+
+        ClipCache* findOrCreate(uint64_t clipHandle, int startFrame, uint32_t frameCount);
+        void queueBake(uint64_t clipHandle, ClipCache& cache, const TeaComponents::BjornAnimator& animator);
+
+        btEngine::MainLoopTaskQueue&                    m_taskQueue;
+        std::unordered_map<uint64_t, ClipCache>         m_clips;
+        std::list<uint64_t>                             m_lru;          // Most recently used first
+        size_t                                          m_memoryBudget;
+        size_t                                          m_memoryUsage = 0;
+        PoseCacheStats                                  m_stats;
+    };
+}
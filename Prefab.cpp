@@ -6,6 +6,11 @@ All content (c) 2024 Digipen Institute of Technology Singapore. All rights reser
 
 Contents:
 - Prefab instance updating functionality
+- Lightweight prefab instantiation and inspector property access through PrefabFlyweight
+- Variant-aware propagation through the flattened prefab cache
+- Budgeted background propagation through the main loop task queue
+- Coroutine propagation for multi-step editor workflows
+- Project wide propagation into scene files that are not loaded
 ====================================================================================*/
 
 /*                                                                          includes
@@ -15,157 +20,511 @@ Contents:
 #include "../../TeaEngine/Src/Core/Serializer.hpp"
 #include "Asset/MetadataSerializer.hpp"
 #include "Asset/Prefab.hpp"
+#include "Core/SceneQuery.hpp"
+#include "Core/BlockCompression.hpp"
+#include "Asset/PrefabFlyweight.hpp"
+#include "Asset/PrefabVariant.hpp"
+#include "Asset/OfflinePrefabPropagation.hpp"
+#include "Asset/PrefabUsageIndex.hpp"
+#include "Asset/SchemaMigration.hpp"
+#include <chrono>
 #include <random>
 
 /*                                                              function definitions
 ====================================================================================*/
+namespace
+{
+    // Adds the time since construction to a stats field, does nothing when stats are off
+    class ScopedStatTimer
+    {
+    public:
+        explicit ScopedStatTimer(double* target)
+            : m_target(target), m_start(target ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+        {
+        }
+
+        ~ScopedStatTimer()
+        {
+            if (m_target)
+            {
+                *m_target += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+            }
+        }
+
+    private:
+        double* m_target;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // Pushes a finished propagation as a single undo entry, the command manager keeps an overflowed one off the stack
+    void pushPropagationUndo(Cmd::CommandManager* commandManager, SceneManager::sceneManager* sceneManager,
+        const TeaAsset::AssetHandle& handle, std::shared_ptr<Cmd::PropagationRecorder> recorder)
+    {
+        if (!commandManager || !recorder) return;
+        if (recorder->empty() && !recorder->hasOverflowed()) return;
+
+        std::string prefabName = TeaAsset::AssetManager::getSourceFilePath(handle).filename().string();
+        commandManager->executeCommand(std::make_unique<Cmd::PrefabPropagationCommand>(sceneManager, prefabName, std::move(recorder)));
+    }
+}
+
 namespace TeaEditor
 { 
+    thread_local PrefabPropagationStats* HierarchyPanel::s_propagationStats = nullptr;
+    Cmd::CommandManager* HierarchyPanel::s_commandManager = nullptr;
+
+    void PrefabPropagationStats::reset()
+    {
+        *this = PrefabPropagationStats{};
+    }
+
     rapidjson::Document HierarchyPanel::loadPrefab(const std::string& prefabPath)
     {
-        // Open the file
-        std::ifstream prefabFile(prefabPath);
-        if (!prefabFile.is_open())
+        // Read the file, plain or block compressed
+        std::string prefabContents;
+        if (!btEngine::BlockCompression::readFile(prefabPath, prefabContents))
         {
             TEA_INFO("Failed to open prefab file: {0}", prefabPath);
             return {};
         }
 
         // Parse the JSON file
-        rapidjson::IStreamWrapper isw(prefabFile);
         rapidjson::Document prefabDoc;
-        prefabDoc.ParseStream(isw);
+        prefabDoc.Parse(prefabContents.c_str(), prefabContents.size());
 
         if (prefabDoc.HasParseError()) 
         {
             TEA_INFO("Failed to parse prefab file: {0}", prefabPath);
         }
+        else if (!TeaAsset::SchemaMigration::checkOnLoad(prefabDoc, prefabPath))
+        {
+            return {};
+        }
 
         return prefabDoc;
     }
-    void HierarchyPanel::updateAllPrefabInstance(TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager)
+    void HierarchyPanel::onPrefabSaved(const TeaAsset::AssetHandle& handle)
     {
-        // Get the path to the master prefab
-        std::string prefabPath = TeaAsset::AssetManager::getSourceFilePath(handle).string();
+        TeaAsset::PrefabResolver::invalidate(handle);
+
+        // A variant may have been pointed at a different base
+        if (TeaAsset::PrefabUsageIndex::isLoaded())
+        {
+            TeaAsset::PrefabUsageIndex::updateFile(TeaAsset::AssetManager::getSourceFilePath(handle));
+        }
+    }
+
+    btEngine::Entity HierarchyPanel::instantiatePrefab(const TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager,
+        const glm::vec3& position)
+    {
+        if (!s_commandManager)
+        {
+            return TeaAsset::PrefabFlyweight::instantiate(sceneManager, handle, position);
+        }
+
+        // The command stays on the undo stack, so it can still be asked for the entity it created
+        auto command = std::make_unique<Cmd::InstantiatePrefabCommand>(sceneManager, handle, position);
+        auto* instantiateCommand = command.get();
+        s_commandManager->executeCommand(std::move(command));
+        return instantiateCommand->getEntity();
+    }
+
+    rttr::variant HierarchyPanel::getEntityProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName)
+    {
+        return TeaAsset::PrefabFlyweight::readProperty(entity, typeName, propName);
+    }
+
+    bool HierarchyPanel::setEntityProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName,
+        const rttr::variant& value)
+    {
+        if (!s_commandManager)
+        {
+            return TeaAsset::PrefabFlyweight::writeProperty(entity, typeName, propName, value);
+        }
+
+        auto command = std::make_unique<Cmd::ChangeComponentPropertyCommand>(entity, typeName, propName, value);
+        auto* changeCommand = command.get();
+        s_commandManager->executeCommand(std::move(command));
+        return changeCommand->succeeded();
+    }
+
+    void HierarchyPanel::onSceneLoaded(SceneManager::sceneManager* sceneManager)
+    {
+        size_t restored = TeaAsset::PrefabFlyweight::restoreInstances(*sceneManager->getRegistry());
+        if (restored > 0)
+        {
+            TEA_INFO("Restored {0} lightweight prefab instances", restored);
+        }
+    }
+
+    std::vector<HierarchyPanel::PrefabInstanceUpdate> HierarchyPanel::collectPrefabInstances(const TeaAsset::AssetHandle& handle,
+        entt::registry& registry, Cmd::PropagationRecorder* recorder)
+    {
+        const uint64_t handleKey = static_cast<uint64_t>(handle);
+        std::vector<PrefabInstanceUpdate> updates;
+
+        // Each prefab referenced by an instance is resolved once, null when it does not derive from the changed prefab
+        std::unordered_map<uint64_t, std::shared_ptr<const TeaAsset::ResolvedPrefab>> affected;
+        std::vector<std::pair<TeaAsset::AssetHandle, std::shared_ptr<const TeaAsset::ResolvedPrefab>>> affectedPrefabs;
+
+        // One pass over the prefab instances covers the prefab and every variant built on it
+        auto& prefabGroup = SceneManager::SceneQueryCache::get(registry).prefabInstances();
+        for (auto entityHandle : prefabGroup)
+        {
+            const auto& masterHandle = prefabGroup.get<TeaComponents::OverrideComponent>(entityHandle).masterPrefabHandle;
+            const uint64_t masterKey = static_cast<uint64_t>(masterHandle);
+
+            auto it = affected.find(masterKey);
+            if (it == affected.end())
+            {
+                auto resolved = TeaAsset::PrefabResolver::resolve(masterHandle);
+                if (resolved && !resolved->derivesFrom(handleKey))
+                {
+                    resolved.reset();
+                }
+                if (resolved)
+                {
+                    affectedPrefabs.emplace_back(masterHandle, resolved);
+                }
+                it = affected.emplace(masterKey, std::move(resolved)).first;
+            }
 
-        // Load the prefab JSON using the helper function
-        rapidjson::Document prefabDoc = loadPrefab(prefabPath);
-        if (prefabDoc.IsNull()) 
+            if (it->second)
+            {
+                updates.push_back({ entityHandle, it->second });
+            }
+        }
+
+        // Lightweight instances only need to be pointed at the new shared data
+        for (const auto& [masterHandle, resolved] : affectedPrefabs)
+        {
+            std::shared_ptr<const TeaAsset::SharedPrefabData> previous, current;
+            if (TeaAsset::PrefabFlyweight::refresh(masterHandle, resolved->getEntityData(), registry, &previous, &current) > 0 && recorder)
+            {
+                recorder->recordSharedData(std::move(previous), std::move(current));
+            }
+        }
+
+        return updates;
+    }
+
+    void HierarchyPanel::updateAllPrefabInstance(TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager,
+        Cmd::CommandManager* commandManager)
+    {
+        // The prefab was saved, drop its flattened data and that of every variant built on it
+        PrefabPropagationStats* stats = s_propagationStats;
+        std::shared_ptr<const TeaAsset::ResolvedPrefab> prefab;
+        {
+            ScopedStatTimer timer(stats ? &stats->loadMs : nullptr);
+            onPrefabSaved(handle);
+            prefab = TeaAsset::PrefabResolver::resolve(handle);
+        }
+        if (!prefab) 
         {
             // Exit if loading failed
             return; 
         }
 
-        // Getting the registry and all entities with UUIDComponent and OverrideComponent (basically prefab instances in the scene)
+        // Get all registered component types
+        std::vector<rttr::type> componentTypes = TeaComponents::ComponentManager::getAllComponentTypes();
+
+        // Getting the registry and every prefab instance of this prefab or of one of its variants
+        // The group is cached per registry so it is not rebuilt on every call
         auto* registry = sceneManager->getRegistry();
-        auto view = registry->view<TeaComponents::UUIDComponent, TeaComponents::OverrideComponent>();
+        commandManager = commandManager ? commandManager : s_commandManager;
+        auto recorder = std::make_shared<Cmd::PropagationRecorder>();
+        Cmd::PropagationRecorder* activeRecorder = commandManager ? recorder.get() : nullptr;
+        std::vector<PrefabInstanceUpdate> updates;
+        {
+            ScopedStatTimer timer(stats ? &stats->scanMs : nullptr);
+            updates = collectPrefabInstances(handle, *registry, activeRecorder);
+        }
 
-        // Iterate tthrough the entities with UUIDComponent and OverrideComponent
-        for (auto entityHandle : view)
         {
-            btEngine::Entity entity(entityHandle, registry);
+            // Timed once for the whole pass, a timer per component would weigh on what it measures
+            ScopedStatTimer timer(stats ? &stats->updateMs : nullptr);
+            for (const auto& update : updates)
+            {
+                btEngine::Entity entity(update.entity, registry);
+                updatePrefabInstance(entity, update.prefab->getEntityData(), componentTypes, activeRecorder);
+                TeaAsset::PrefabFlyweight::updateRenderProxy(*registry, update.entity);
+            }
+        }
+
+        // Pushed once everything is applied, so the entry always covers the whole propagation
+        pushPropagationUndo(commandManager, sceneManager, handle, std::move(recorder));
+    }
+
+    uint64_t HierarchyPanel::queuePrefabPropagation(TeaAsset::AssetHandle handle, SceneManager::sceneManager* sceneManager,
+        btEngine::MainLoopTaskQueue& taskQueue, uint32_t instancesPerStep, Cmd::CommandManager* commandManager)
+    {
+        // State shared by every step of the task
+        struct PropagationState
+        {
+            std::vector<rttr::type> componentTypes;
+            std::vector<PrefabInstanceUpdate> instances;
+            std::shared_ptr<Cmd::PropagationRecorder> recorder;
+            size_t nextInstance = 0;
+            bool collected = false;
+        };
+
+        onPrefabSaved(handle);
+        if (!TeaAsset::PrefabResolver::resolve(handle))
+        {
+            return 0;
+        }
 
-            auto& overrideComp = entity.getComponent<TeaComponents::OverrideComponent>();
-            if (overrideComp.masterPrefabHandle == handle) 
+        std::string prefabPath = TeaAsset::AssetManager::getSourceFilePath(handle).string();
+        instancesPerStep = std::max(instancesPerStep, 1u);
+        auto state = std::make_shared<PropagationState>();
+        state->componentTypes = TeaComponents::ComponentManager::getAllComponentTypes();
+
+        // Recorded while the task runs, the undo entry is only pushed once the last step is done
+        commandManager = commandManager ? commandManager : s_commandManager;
+        if (commandManager)
+        {
+            state->recorder = std::make_shared<Cmd::PropagationRecorder>();
+        }
+
+        auto step = [state, handle, sceneManager, instancesPerStep](btEngine::TaskProgress& progress) -> bool
+        {
+            auto* registry = sceneManager->getRegistry();
+
+            // First step only gathers the instances of this prefab and its variants, the rest update them a slice at a time
+            if (!state->collected)
             {
-                const auto& entityData = prefabDoc["Entity"];
-                if (!entityData.IsObject()) 
+                state->instances = collectPrefabInstances(handle, *registry, state->recorder.get());
+                state->collected = true;
+                progress.total = static_cast<uint32_t>(state->instances.size());
+                return state->instances.empty();
+            }
+
+            size_t stepEnd = std::min(state->nextInstance + instancesPerStep, state->instances.size());
+            for (; state->nextInstance < stepEnd; state->nextInstance++)
+            {
+                // The user may have deleted the instance since the task was queued
+                const auto& update = state->instances[state->nextInstance];
+                if (!registry->valid(update.entity) || !registry->all_of<TeaComponents::OverrideComponent>(update.entity))
                 {
                     continue;
                 }
 
-                // Get all registered component types
-                std::vector<rttr::type> componentTypes = TeaComponents::ComponentManager::getAllComponentTypes();
+                btEngine::Entity entity(update.entity, registry);
+                updatePrefabInstance(entity, update.prefab->getEntityData(), state->componentTypes, state->recorder.get());
+                TeaAsset::PrefabFlyweight::updateRenderProxy(*registry, update.entity);
+            }
+
+            progress.completed = static_cast<uint32_t>(state->nextInstance);
+            return state->nextInstance >= state->instances.size();
+        };
+
+        // A cancelled task never completes, so a partial recording is never pushed
+        auto onComplete = [state, handle, sceneManager, commandManager]()
+        {
+            pushPropagationUndo(commandManager, sceneManager, handle, state->recorder);
+        };
+
+        return taskQueue.enqueue("Propagating " + std::filesystem::path(prefabPath).filename().string(), step, onComplete);
+    }
+
+    btEngine::Task<void> HierarchyPanel::propagatePrefabAsync(TeaAsset::AssetHandle handle, SceneManager::sceneManager* sceneManager,
+        uint32_t instancesPerFrame, Cmd::CommandManager* commandManager)
+    {
+        // Resolve the variant chain on a worker, only files that are not already flattened get parsed.
+        // The asset manager is main thread only, so its lookups happen here between the worker passes
+        onPrefabSaved(handle);
+        TeaAsset::PrefabSources sources = TeaAsset::PrefabResolver::collectSources(handle);
+        std::shared_ptr<const TeaAsset::ResolvedPrefab> prefab;
+        std::string missingBase;
+        while (true)
+        {
+            missingBase.clear();
+            prefab = co_await btEngine::runOnWorker([&sources, &missingBase]
+            {
+                return TeaAsset::PrefabResolver::resolve(sources, &missingBase);
+            });
+            if (prefab || missingBase.empty() || sources.handles.count(missingBase))
+            {
+                break;
+            }
+            sources.addBase(missingBase);
+        }
+        if (!prefab)
+        {
+            co_return;
+        }
+
+        // Back on the main thread, gather the instances of this prefab and its variants
+        std::vector<rttr::type> componentTypes = TeaComponents::ComponentManager::getAllComponentTypes();
+        auto* registry = sceneManager->getRegistry();
+
+        // Recorded across the slices, the undo entry is only pushed once every instance is updated
+        commandManager = commandManager ? commandManager : s_commandManager;
+        std::shared_ptr<Cmd::PropagationRecorder> recorder;
+        if (commandManager)
+        {
+            recorder = std::make_shared<Cmd::PropagationRecorder>();
+        }
+        std::vector<PrefabInstanceUpdate> instances = collectPrefabInstances(handle, *registry, recorder.get());
+
+        // Update the instances a slice per frame
+        instancesPerFrame = std::max(instancesPerFrame, 1u);
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            if (i > 0 && i % instancesPerFrame == 0)
+            {
+                co_await btEngine::nextFrame();
+            }
+
+            // The user may have deleted the instance while we were waiting for the next frame
+            if (!registry->valid(instances[i].entity) || !registry->all_of<TeaComponents::OverrideComponent>(instances[i].entity))
+            {
+                continue;
+            }
+
+            btEngine::Entity entity(instances[i].entity, registry);
+            updatePrefabInstance(entity, instances[i].prefab->getEntityData(), componentTypes, recorder.get());
+            TeaAsset::PrefabFlyweight::updateRenderProxy(*registry, instances[i].entity);
+        }
+
+        pushPropagationUndo(commandManager, sceneManager, handle, std::move(recorder));
+    }
+
+    TeaAsset::OfflinePropagationReport HierarchyPanel::propagatePrefabToProject(TeaAsset::AssetHandle handle,
+        const std::filesystem::path& projectDirectory, btEngine::JobSystem* jobSystem, bool dryRun,
+        const std::vector<std::filesystem::path>& excludedScenes)
+    {
+        // The usage index picks the scenes to visit, it is only walked against the disk the first time it is opened
+        TeaAsset::PrefabUsageIndex::open(projectDirectory);
+        onPrefabSaved(handle);
 
-                // Iterate through each registered component type
-                for (const auto& componentType : componentTypes)
+        TeaAsset::OfflinePropagationOptions options;
+        options.projectDirectory = projectDirectory;
+        options.dryRun = dryRun;
+        options.excludedFiles = excludedScenes;
+
+        TeaAsset::OfflinePropagationReport report = TeaAsset::OfflinePrefabPropagation::run(handle, options, jobSystem);
+        TeaAsset::OfflinePrefabPropagation::logReport(report);
+
+        // A dry run leaves every file as it was, the index included
+        if (!dryRun)
+        {
+            TeaAsset::PrefabUsageIndex::save();
+        }
+        return report;
+    }
+
+    void HierarchyPanel::updatePrefabInstance(btEngine::Entity& entity, const rapidjson::Value& entityData,
+        const std::vector<rttr::type>& componentTypes, Cmd::PropagationRecorder* recorder)
+    {
+        // Lightweight instances read every other component from the shared prefab data, refreshing
+        // it already updated those, so only the components they own (their Transform) are updated here
+        const bool lightweight = TeaAsset::PrefabFlyweight::isLightweight(entity);
+
+        auto& overrideComp = entity.getComponent<TeaComponents::OverrideComponent>();
+        const uint64_t instanceUUID = recorder ? static_cast<uint64_t>(entity.getUUID()) : 0;
+
+        PrefabPropagationStats* stats = s_propagationStats;
+        if (stats) stats->instances++;
+
+        // Iterate through each registered component type
+        for (const auto& componentType : componentTypes)
+        {
+            std::string typeName = componentType.get_name().to_string();
+            if (typeName == "Scene ID") continue;
+
+            // Check if component exists in prefab
+            bool existsInPrefabAsset = entityData.HasMember(typeName.c_str());
+            bool existsInPrefabInstance = entity.hasComponent(typeName);
+            if (lightweight && !existsInPrefabInstance) continue;
+
+            // Check if the component was added locally via the OverrideComponent Vector that stores the component name
+            bool isLocallyAdded = false; 
+            for (size_t i = 0; i < overrideComp.components.size(); i++)
+            {
+                if (overrideComp.components[i].componentName == typeName)
                 {
-                    std::string typeName = componentType.get_name().to_string();
-                    if (typeName == "Scene ID") continue;
+                    // If we find the component in the overrideComp vector, it means it was added locally by the user
+                    isLocallyAdded = true; 
+                    break;
+                }
+            }
 
-                    // Check if component exists in prefab
-                    bool existsInPrefabAsset = entityData.HasMember(typeName.c_str());
-                    bool existsInPrefabInstance = entity.hasComponent(typeName);
+            // Case 1: Component exists in prefab asset but not in prefab instance neighter was it added locally by the user, can go ahead and add it
+            if (existsInPrefabAsset && !existsInPrefabInstance && !isLocallyAdded)
+            {
+                if (typeName == "Child" || typeName == "Parent") continue;
 
-                    // Check if the component was added locally via the OverrideComponent Vector that stores the component name
-                    bool isLocallyAdded = false; 
-                    for (size_t i = 0; i < overrideComp.components.size(); i++)
-                    {
-                        if (overrideComp.components[i].componentName == typeName)
-                        {
-                            // If we find the component in the overrideComp vector, it means it was added locally by the user
-                            isLocallyAdded = true; 
-                            break;
-                        }
-                    }
+                // Add the component from prefab
+                entity.addComponent(typeName);
+                if (stats) stats->componentsAdded++;
+                if (recorder) recorder->recordComponentAdded(instanceUUID, typeName);
+            }
+            // Case 2: Component exists in prefab instance but not in prefab asset
+            else if (!existsInPrefabAsset && existsInPrefabInstance)
+            {
+                if (typeName == "UUIDComponent" || typeName == "OverrideComponent") continue;
 
-                    // Case 1: Component exists in prefab asset but not in prefab instance neighter was it added locally by the user, can go ahead and add it
-                    if (existsInPrefabAsset && !existsInPrefabInstance && !isLocallyAdded)
-                    {
-                        if (typeName == "Child" || typeName == "Parent") continue;
+                // Only keep the component if it was locally added by the user. Meaning the user intentionally added it
+                if (!isLocallyAdded)
+                {
+                    if (recorder) recorder->recordComponentRemoved(entity, componentType);
 
-                        // Add the component from prefab
-                        entity.addComponent(typeName);
-                    }
-                    // Case 2: Component exists in prefab instance but not in prefab asset
-                    else if (!existsInPrefabAsset && existsInPrefabInstance)
-                    {
-                        if (typeName == "UUIDComponent" || typeName == "OverrideComponent") continue;
+                    entity.removeComponent(typeName);
+                    if (stats) stats->componentsRemoved++;
+                }
+            }
 
-                        // Only keep the component if it was locally added by the user. Meaning the user intentionally added it
-                        if (!isLocallyAdded)
-                        {
-                            entity.removeComponent(typeName);
-                        }
-                    }
+            // Checking if the entity in the prefab has this component
+            if (entityData.HasMember(typeName.c_str()))
+            {
+                const auto& componentData = entityData[typeName.c_str()];
+
+                // Get component 
+                rttr::variant componentVar = entity.getComponent(typeName);
+                if (!componentVar.is_valid()) {
+                    TEA_WARNING("Entity does not have component {0}. Skipping.", typeName);
+                    continue; // Skip to the next component type
+                }
+                rttr::instance component = componentVar;
+
+                // Iterate through each property of the component
+                for (auto& prop : componentType.get_properties())
+                {
+                    std::string propName = prop.get_name().to_string();
+                    std::string propertyPath = typeName + "/" + propName;
+                    if (propName == "Scene ID") continue;
+                    if (propName == "Parent") continue;
 
-                    // Checking if the entity in the prefab has this component
-                    if (entityData.HasMember(typeName.c_str()))
+                    // Check if this property has been overridden
+                    auto overrideIt = std::find_if(overrideComp.properties.begin(), overrideComp.properties.end(),
+                        [&propertyPath](const TeaComponents::OverrideComponent::Property& overrideProp) {
+                            return overrideProp.path == propertyPath;
+                        });
+
+                    // If the property is not overridden and exists in the prefab data, update it
+                    if (overrideIt == overrideComp.properties.end() && componentData.HasMember(propName.c_str()))
                     {
-                        const auto& componentData = entityData[typeName.c_str()];
+                        const rapidjson::Value& propValue = componentData[propName.c_str()];
+                        rttr::variant propObj = prop.get_value(component);
+                        rttr::type propType = prop.get_type();
+                        bool success = false;
 
-                        // Get component 
-                        rttr::variant componentVar = entity.getComponent(typeName);
-                        if (!componentVar.is_valid()) {
-                            TEA_WARNING("Entity does not have component {0}. Skipping.", typeName);
-                            continue; // Skip to the next component type
-                        }
-                        rttr::instance component = componentVar;
+                        // Keep the old value only when recording, and only if the prefab actually changed it
+                        rttr::variant oldValue = recorder ? propObj : rttr::variant();
+
+                        // Update the property based on its type
+                        Serialize::deserializeEachProperty(propValue, propObj, propType);
+                        success = prop.set_value(component, propObj);
+                        if (stats && success) stats->propertiesWritten++;
 
-                        // Iterate through each property of the component
-                        for (auto& prop : componentType.get_properties())
+                        if (recorder && success && !(oldValue == propObj))
                         {
-                            std::string propName = prop.get_name().to_string();
-                            std::string propertyPath = typeName + "/" + propName;
-                            if (propName == "Scene ID") continue;
-                            if (propName == "Parent") continue;
-
-                            // Check if this property has been overridden
-                            auto overrideIt = std::find_if(overrideComp.properties.begin(), overrideComp.properties.end(),
-                                [&propertyPath](const TeaComponents::OverrideComponent::Property& overrideProp) {
-                                    return overrideProp.path == propertyPath;
-                                });
-
-                            // If the property is not overridden and exists in the prefab data, update it
-                            if (overrideIt == overrideComp.properties.end() && componentData.HasMember(propName.c_str()))
-                            {
-                                const rapidjson::Value& propValue = componentData[propName.c_str()];
-                                rttr::variant propObj = prop.get_value(component);
-                                rttr::type propType = prop.get_type();
-                                bool success = false;
-
-                                // Update the property based on its type
-                                Serialize::deserializeEachProperty(propValue, propObj, propType);
-                                success = prop.set_value(component, propObj);
-                            }
+                            recorder->recordProperty(instanceUUID, typeName, prop, std::move(oldValue), propObj);
                         }
                     }
                 }
             }
-            else
-            {
-                TEA_INFO("Entity is not a prefab instance of {0}, so skip and check the next entity", prefabPath);
-            }
         }
     }
 }
\ No newline at end of file
@@ -7,6 +7,12 @@ All content (c) 2024 Digipen Institute of Technology Singapore. All rights reser
 
 Contents:
 - Prefab instance updating functionality
+- Lightweight prefab instantiation and inspector property access through PrefabFlyweight
+- Variant-aware propagation through the flattened prefab cache
+- Budgeted background propagation through the main loop task queue
+- Coroutine propagation for multi-step editor workflows
+- Project wide propagation into scene files that are not loaded
+- Propagation timing counters
 ====================================================================================*/
 #pragma once
 
@@ -24,14 +30,39 @@ Contents:
 #include "Assetbrowser.hpp"
 #include "Graphics/AnimationClip.hpp"
 #include "UndoRedo.hpp"
+#include "Asset/PrefabVariant.hpp"
+#include "Asset/OfflinePrefabPropagation.hpp"
 
 /*                                                             function declarations
 ====================================================================================*/
 namespace TeaEditor
 {
+    /**
+     * @brief Time and work counters of prefab propagation, filled while set through HierarchyPanel::setPropagationStats
+    */
+    struct PrefabPropagationStats
+    {
+        double loadMs = 0.0;            // Reading and flattening the prefab
+        double scanMs = 0.0;            // Finding the instances to update
+        double updateMs = 0.0;          // Adding and removing components, deserializing and writing properties
+        uint64_t instances = 0;
+        uint64_t componentsAdded = 0;
+        uint64_t componentsRemoved = 0;
+        uint64_t propertiesWritten = 0;
+
+        void reset();
+    };
+
     class HierarchyPanel
     {
     public:    
+       // Prefab instance to update and the flattened prefab (or variant) it is an instance of
+       struct PrefabInstanceUpdate
+       {
+           entt::entity entity = entt::null;
+           std::shared_ptr<const TeaAsset::ResolvedPrefab> prefab;
+       };
+
        /**
        * @brief Loads and parses a prefab file from the given path
        *
@@ -50,15 +81,171 @@ namespace TeaEditor
         * @brief Updates all prefab instances in the scene based on their master prefab
         *
         * This function manages prefab instance synchronization, including:
-        * 1. Loading the master prefab data from file
-        * 2. Identifying all prefab instances in the scene
+        * 1. Invalidating and re-resolving the flattened data of the prefab and its variants
+        * 2. Identifying all instances of the prefab and of its variants in one pass
         * 3. Handling component additions and removals
         * 4. Managing property overrides and synchronization
         * 5. Preserving local modifications while updating from master
         *
         * @param handle Asset handle reference to the master prefab
         * @param sceneManager Pointer to the scene manager containing the prefab instances
+        * @param commandManager Command manager to push one undo entry for the whole propagation to, nullptr for the editor's one
+        */
+       static void updateAllPrefabInstance(TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager,
+           Cmd::CommandManager* commandManager = nullptr);
+       /**
+        * @brief Queues the propagation of a prefab as a background task instead of running it to completion
+        *
+        * This function splits the propagation into resumable steps, including:
+        * 1. Resolving the master prefab once when the task is queued
+        * 2. Collecting the instances of the prefab and its variants in the first step
+        * 3. Updating a fixed number of instances per step until all are done
+        * 4. Skipping instances that were deleted while the task was waiting
+        *
+        * @param handle Asset handle of the master prefab
+        * @param sceneManager Pointer to the scene manager containing the prefab instances
+        * @param taskQueue Main loop task queue to run the steps on
+        * @param instancesPerStep Number of instances updated per step, at least 1
+        * @param commandManager Command manager to push one undo entry to when the task completes, nullptr for the editor's one
+        * @return Id of the queued task, 0 if the prefab could not be loaded
+        */
+       static uint64_t queuePrefabPropagation(TeaAsset::AssetHandle handle, SceneManager::sceneManager* sceneManager,
+           btEngine::MainLoopTaskQueue& taskQueue, uint32_t instancesPerStep = 64, Cmd::CommandManager* commandManager = nullptr);
+       /**
+        * @brief Coroutine version of the prefab propagation for multi-step editor workflows
+        *
+        * This coroutine handles:
+        * 1. Resolving the master prefab chain on a worker thread
+        * 2. Collecting the instances of the prefab and its variants on the main thread
+        * 3. Updating a slice of instances per frame, yielding in between
+        *
+        * Callers co_await it and continue with the next step, for example saving the scene.
+        *
+        * @param handle Asset handle of the master prefab
+        * @param sceneManager Pointer to the scene manager containing the prefab instances
+        * @param instancesPerFrame Number of instances updated before yielding to the next frame, at least 1
+        * @param commandManager Command manager to push one undo entry to after the last slice, nullptr for the editor's one
+        * @return Task that finishes once every instance is updated
+        */
+       static btEngine::Task<void> propagatePrefabAsync(TeaAsset::AssetHandle handle, SceneManager::sceneManager* sceneManager,
+           uint32_t instancesPerFrame = 64, Cmd::CommandManager* commandManager = nullptr);
+       /**
+        * @brief Propagates a prefab into every scene file of the project that is not loaded
+        *
+        * This function handles:
+        * 1. Invalidating the flattened data of the prefab and its variants
+        * 2. Streaming the affected scene files on the job system (see OfflinePrefabPropagation)
+        * 3. Logging a per scene report, which is all a dry run does
+        *
+        * Loaded scenes are updated in memory by updateAllPrefabInstance. The scenes marked open with
+        * OfflinePrefabPropagation::setSceneOpen are always left alone, so saving them does not race
+        * with the rewrite.
+        *
+        * @param handle Asset handle of the master prefab
+        * @param projectDirectory Directory searched recursively for scenes and prefab variants
+        * @param jobSystem Job system to rewrite the files on
+        * @param dryRun Only report what would change
+        * @param excludedScenes Scene files to leave alone on top of the open ones
+        * @return Report of every scene file that mentions the prefab or one of its variants
+        */
+       static TeaAsset::OfflinePropagationReport propagatePrefabToProject(TeaAsset::AssetHandle handle,
+           const std::filesystem::path& projectDirectory, btEngine::JobSystem* jobSystem, bool dryRun,
+           const std::vector<std::filesystem::path>& excludedScenes = {});
+       /**
+        * @brief Drops the cached data of a saved prefab and updates its entry in the usage index
+        *
+        * Also run by every propagation, so it never writes the prefab. The save itself stamps
+        * the schema right after serializing (see SchemaMigration::stampFile).
+        *
+        * @param handle Asset handle of the saved prefab
+        */
+       static void onPrefabSaved(const TeaAsset::AssetHandle& handle);
+       /**
+        * @brief Places a prefab in the scene, called when a prefab is dropped into the scene or hierarchy
+        *
+        * The instance is lightweight (see PrefabFlyweight) and undoable through the editor's command manager.
+        *
+        * @param handle Asset handle of the prefab
+        * @param sceneManager Pointer to the scene manager to create the instance in
+        * @param position World position of the instance
+        * @return The new instance, invalid if the prefab could not be loaded
+        */
+       static btEngine::Entity instantiatePrefab(const TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager,
+           const glm::vec3& position);
+       /**
+        * @brief Reads a component property shown in the inspector, from the entity or from its shared prefab data
+        *
+        * @param entity Entity being inspected
+        * @param typeName Registered component name
+        * @param propName Property name
+        * @return Property value, invalid if the entity has no such property
+        */
+       static rttr::variant getEntityProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName);
+       /**
+        * @brief Writes a component property edited in the inspector
+        *
+        * A lightweight prefab instance is materialized on its first write and the edit is recorded as
+        * an override, undoable through the editor's command manager.
+        *
+        * @param entity Entity being edited
+        * @param typeName Registered component name
+        * @param propName Property name
+        * @param value New value
+        * @return true if the value was written
+        */
+       static bool setEntityProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName,
+           const rttr::variant& value);
+       /**
+        * @brief Turns the prefab instances of a scene that was just loaded back into lightweight instances
+        *
+        * @param sceneManager Pointer to the scene manager the scene was loaded into
         */
-       static void updateAllPrefabInstance(TeaAsset::AssetHandle& handle, SceneManager::sceneManager* sceneManager);
+       static void onSceneLoaded(SceneManager::sceneManager* sceneManager);
+       /**
+        * @brief Collects the instances of a prefab and of every variant derived from it
+        *
+        * This function handles:
+        * 1. Resolving each prefab referenced by an instance once
+        * 2. Keeping the instances whose prefab chain contains the changed prefab
+        * 3. Repointing the lightweight instances of every affected prefab
+        *
+        * @param handle Asset handle of the changed prefab
+        * @param registry Registry holding the instances
+        * @param recorder Collects the repointed shared data for undo, nullptr when the update is not undoable
+        * @return Instances to update, each with the flattened data of its own prefab
+        */
+       static std::vector<PrefabInstanceUpdate> collectPrefabInstances(const TeaAsset::AssetHandle& handle, entt::registry& registry,
+           Cmd::PropagationRecorder* recorder = nullptr);
+       /**
+        * @brief Updates a single prefab instance from the master prefab entity data
+        *
+        * Lightweight instances only get the components they own (their Transform) updated, the
+        * rest is read from the shared data. Callers refresh their render proxy afterwards.
+        *
+        * @param entity Prefab instance to update
+        * @param entityData Flattened "Entity" object of the master prefab
+        * @param componentTypes All registered component types
+        * @param recorder Collects the changes for undo, nullptr when the update is not undoable
+        */
+       static void updatePrefabInstance(btEngine::Entity& entity, const rapidjson::Value& entityData,
+           const std::vector<rttr::type>& componentTypes, Cmd::PropagationRecorder* recorder = nullptr);
+       /**
+        * @brief Starts or stops collecting propagation timings, used by the propagation benchmark
+        *
+        * Only propagations running on the calling thread add to the counters.
+        *
+        * @param stats Counters to add to, nullptr to stop collecting
+        */
+       static void setPropagationStats(PrefabPropagationStats* stats) { s_propagationStats = stats; }
+       /**
+        * @brief Sets the command manager propagations push their undo entry to when the caller passes none
+        *
+        * @param commandManager The editor's command manager, nullptr to stop recording
+        */
+       static void setCommandManager(Cmd::CommandManager* commandManager) { s_commandManager = commandManager; }
+
+   private:
+       static thread_local PrefabPropagationStats* s_propagationStats;
+       static Cmd::CommandManager* s_commandManager;
    };
 }
\ No newline at end of file
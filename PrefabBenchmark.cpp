@@ -0,0 +1,331 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       PrefabBenchmark.cpp
+@project    TeaEditor
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Headless prefab propagation benchmark (entry point of the benchmark target)
+- Synthetic prefab documents and registries built from command line options
+- Propagation run through HierarchyPanel::updateAllPrefabInstance, as on a prefab save in the editor
+- JSON report with load / scan / update timings per phase
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Asset/Prefab.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    struct BenchmarkOptions
+    {
+        uint32_t instances = 10000;         // Prefab instances in the registry
+        uint32_t components = 4;            // Components in the prefab
+        double overrideDensity = 0.1;       // Chance that an instance overrides a given property
+        uint32_t depth = 1;                 // Entities per instance hierarchy (root + descendants)
+        uint32_t iterations = 5;
+        uint32_t seed = 1234;
+        std::string outputPath;             // Report file, stdout when empty
+    };
+
+    // Work and time of one phase, summed over every iteration
+    struct PhaseResult
+    {
+        std::string name;
+        double totalMs = 0.0;
+        double minTotalMs = 0.0;
+        TeaEditor::PrefabPropagationStats stats;
+    };
+
+    void printUsage()
+    {
+        std::cerr << "Usage: PrefabBenchmark [--instances N] [--components N] [--override-density F]\n"
+                     "                       [--depth N] [--iterations N] [--seed N] [--out FILE]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                return false;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << "\n";
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--instances")               options.instances = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--components")         options.components = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--override-density")   options.overrideDensity = std::clamp(std::strtod(value, nullptr), 0.0, 1.0);
+            else if (arg == "--depth")              options.depth = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--iterations")         options.iterations = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--seed")               options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--out")                options.outputPath = value;
+            else
+            {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isSyntheticProperty(const rttr::property& prop)
+    {
+        rttr::type type = prop.get_type();
+        std::string propName = prop.get_name().to_string();
+        if (propName == "Scene ID" || propName == "Parent") return false;
+
+        return type == rttr::type::get<float>() || type == rttr::type::get<double>() || type == rttr::type::get<int>() ||
+            type == rttr::type::get<uint32_t>() || type == rttr::type::get<bool>() || type == rttr::type::get<std::string>();
+    }
+
+    // Registered components the prefab can hold, identity and hierarchy components are left out
+    std::vector<rttr::type> pickComponentTypes(uint32_t count)
+    {
+        std::vector<rttr::type> picked;
+        for (const auto& componentType : TeaComponents::ComponentManager::getAllComponentTypes())
+        {
+            std::string typeName = componentType.get_name().to_string();
+            if (typeName == "UUIDComponent" || typeName == "OverrideComponent" || typeName == "Child" || typeName == "Parent") continue;
+
+            picked.push_back(componentType);
+            if (picked.size() == count) break;
+        }
+        return picked;
+    }
+
+    /**
+     * @brief Writes a prefab document holding the given components
+     *
+     * Only plain value properties (numbers, bools, strings) get a value, their format does not
+     * depend on the serializer. Each version writes different values so propagation has work to do.
+    */
+    std::string makePrefabJson(const std::vector<rttr::type>& componentTypes, int version)
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+        writer.StartObject();
+        writer.Key("Entity");
+        writer.StartObject();
+        for (const auto& componentType : componentTypes)
+        {
+            writer.Key(componentType.get_name().to_string().c_str());
+            writer.StartObject();
+
+            int propIndex = 0;
+            for (auto& prop : componentType.get_properties())
+            {
+                if (!isSyntheticProperty(prop)) continue;
+
+                rttr::type type = prop.get_type();
+                writer.Key(prop.get_name().to_string().c_str());
+                if (type == rttr::type::get<bool>())                writer.Bool((version + propIndex) % 2 == 0);
+                else if (type == rttr::type::get<std::string>())    writer.String(("value_" + std::to_string(version)).c_str());
+                else if (type == rttr::type::get<int>())            writer.Int(version * 10 + propIndex);
+                else if (type == rttr::type::get<uint32_t>())       writer.Uint(static_cast<unsigned>(version * 10 + propIndex));
+                else                                                writer.Double(version + propIndex * 0.5);
+                propIndex++;
+            }
+
+            writer.EndObject();
+        }
+        writer.EndObject();
+        writer.EndObject();
+
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+
+    /**
+     * @brief Fills a registry with prefab instance hierarchies
+     *
+     * Every entity of a hierarchy carries an OverrideComponent like the children of an instantiated
+     * prefab do. Parent links are not created, propagation skips the hierarchy components anyway.
+    */
+    void buildRegistry(entt::registry& registry, const TeaAsset::AssetHandle& handle, const std::vector<rttr::type>& componentTypes,
+        const BenchmarkOptions& options, std::mt19937& rng)
+    {
+        std::bernoulli_distribution overrideChance(options.overrideDensity);
+
+        for (uint32_t i = 0; i < options.instances; i++)
+        {
+            for (uint32_t level = 0; level < options.depth; level++)
+            {
+                btEngine::Entity entity(registry.create(), &registry);
+                entity.addComponent<TeaComponents::UUIDComponent>();
+
+                auto& overrideComp = entity.addComponent<TeaComponents::OverrideComponent>();
+                overrideComp.masterPrefabHandle = handle;
+
+                for (const auto& componentType : componentTypes)
+                {
+                    std::string typeName = componentType.get_name().to_string();
+                    for (auto& prop : componentType.get_properties())
+                    {
+                        if (!isSyntheticProperty(prop) || !overrideChance(rng)) continue;
+
+                        TeaComponents::OverrideComponent::Property overrideProp;
+                        overrideProp.path = typeName + "/" + prop.get_name().to_string();
+                        overrideComp.properties.push_back(overrideProp);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Runs one propagation through the same path a prefab save takes in the editor
+     *
+     * updateAllPrefabInstance drops the flattened prefab, resolves it again with PrefabResolver and
+     * collects the instances with collectPrefabInstances, each step timed once by the stats.
+    */
+    double runPhase(TeaAsset::AssetHandle& handle, SceneManager::sceneManager& sceneManager, TeaEditor::PrefabPropagationStats& stats)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        TeaEditor::HierarchyPanel::setPropagationStats(&stats);
+        auto phaseStart = Clock::now();
+        TeaEditor::HierarchyPanel::updateAllPrefabInstance(handle, &sceneManager);
+        double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - phaseStart).count();
+        TeaEditor::HierarchyPanel::setPropagationStats(nullptr);
+        return totalMs;
+    }
+
+    void writePhase(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const PhaseResult& phase, uint32_t iterations)
+    {
+        const double perIteration = 1.0 / iterations;
+
+        writer.StartObject();
+        writer.Key("name");                 writer.String(phase.name.c_str());
+        writer.Key("totalMs");              writer.Double(phase.totalMs * perIteration);
+        writer.Key("minTotalMs");           writer.Double(phase.minTotalMs);
+        writer.Key("loadMs");               writer.Double(phase.stats.loadMs * perIteration);
+        writer.Key("scanMs");               writer.Double(phase.stats.scanMs * perIteration);
+        writer.Key("updateMs");             writer.Double(phase.stats.updateMs * perIteration);
+        writer.Key("instances");            writer.Uint64(phase.stats.instances / iterations);
+        writer.Key("componentsAdded");      writer.Uint64(phase.stats.componentsAdded / iterations);
+        writer.Key("componentsRemoved");    writer.Uint64(phase.stats.componentsRemoved / iterations);
+        writer.Key("propertiesWritten");    writer.Uint64(phase.stats.propertiesWritten / iterations);
+        writer.EndObject();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<rttr::type> prefabComponents = pickComponentTypes(options.components);
+    if (prefabComponents.empty())
+    {
+        std::cerr << "No registered component types to build the prefab from\n";
+        return 1;
+    }
+
+    // Three versions of the prefab: every component, new values, and half of the components removed
+    std::vector<rttr::type> reducedComponents(prefabComponents.begin(), prefabComponents.begin() + (prefabComponents.size() + 1) / 2);
+    std::filesystem::path tempDirectory = std::filesystem::temp_directory_path();
+    const std::vector<std::pair<std::string, std::string>> phases = {
+        { "add", makePrefabJson(prefabComponents, 1) },
+        { "modify", makePrefabJson(prefabComponents, 2) },
+        { "remove", makePrefabJson(reducedComponents, 3) },
+    };
+
+    // One prefab file rewritten before each phase, like saving it in the editor. It goes through
+    // the asset manager like any project file so resolving takes the same path as in the editor
+    const std::filesystem::path prefabPath = tempDirectory / "prefab_benchmark.prefab";
+    std::ofstream(prefabPath, std::ios::binary | std::ios::trunc) << phases.front().second;
+    TeaAsset::AssetHandle handle = TeaAsset::AssetManager::getAssetHandle(prefabPath.string());
+
+    std::vector<PhaseResult> results(phases.size());
+    for (size_t p = 0; p < phases.size(); p++)
+    {
+        results[p].name = phases[p].first;
+    }
+
+    // Each iteration starts from a fresh registry so the structural phases always have work to do
+    std::mt19937 rng(options.seed);
+    size_t entityCount = 0;
+    for (uint32_t iteration = 0; iteration < options.iterations; iteration++)
+    {
+        auto sceneManager = std::make_unique<SceneManager::sceneManager>();
+        entt::registry& registry = *sceneManager->getRegistry();
+        buildRegistry(registry, handle, prefabComponents, options, rng);
+        entityCount = registry.storage<entt::entity>().size();
+
+        for (size_t p = 0; p < phases.size(); p++)
+        {
+            std::ofstream(prefabPath, std::ios::binary | std::ios::trunc) << phases[p].second;
+
+            double totalMs = runPhase(handle, *sceneManager, results[p].stats);
+            results[p].totalMs += totalMs;
+            results[p].minTotalMs = iteration == 0 ? totalMs : std::min(results[p].minTotalMs, totalMs);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::remove(prefabPath, error);
+
+    // Machine readable report, one object per run so results can be diffed across commits
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("benchmark");        writer.String("prefab_propagation");
+    writer.Key("options");
+    writer.StartObject();
+    writer.Key("instances");        writer.Uint(options.instances);
+    writer.Key("components");       writer.Uint(static_cast<unsigned>(prefabComponents.size()));
+    writer.Key("overrideDensity");  writer.Double(options.overrideDensity);
+    writer.Key("depth");            writer.Uint(options.depth);
+    writer.Key("iterations");       writer.Uint(options.iterations);
+    writer.Key("seed");             writer.Uint(options.seed);
+    writer.EndObject();
+    writer.Key("entities");         writer.Uint64(entityCount);
+    writer.Key("phases");
+    writer.StartArray();
+    for (const auto& result : results)
+    {
+        writePhase(writer, result, options.iterations);
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    if (options.outputPath.empty())
+    {
+        std::cout << buffer.GetString() << std::endl;
+    }
+    else
+    {
+        std::ofstream(options.outputPath, std::ios::binary | std::ios::trunc) << buffer.GetString() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,398 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabFlyweight.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Shared prefab data building and caching
+- Lightweight prefab instance creation, property resolution and materialization
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "PrefabFlyweight.hpp"
+#include "PrefabVariant.hpp"
+#include "../Core/Serializer.hpp"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAsset
+{
+    std::unordered_map<uint64_t, std::weak_ptr<const SharedPrefabData>> PrefabFlyweight::s_sharedData;
+    PrefabFlyweight::RenderProxyBuilder PrefabFlyweight::s_renderProxyBuilder;
+
+    const SharedPrefabData::SharedComponent* SharedPrefabData::findComponent(const std::string& typeName) const
+    {
+        for (const auto& component : components)
+        {
+            if (component.typeName == typeName)
+            {
+                return &component;
+            }
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<SharedPrefabData> PrefabFlyweight::build(uint64_t handleKey, const rapidjson::Value& entityData)
+    {
+        auto shared = std::make_shared<SharedPrefabData>();
+        shared->prefabHandle = handleKey;
+
+        for (const auto& componentType : TeaComponents::ComponentManager::getAllComponentTypes())
+        {
+            std::string typeName = componentType.get_name().to_string();
+
+            // Identity and override data always belongs to the instance
+            if (typeName == "UUIDComponent" || typeName == "OverrideComponent") continue;
+            if (!entityData.HasMember(typeName.c_str())) continue;
+
+            SharedPrefabData::SharedComponent component;
+            component.type = componentType;
+            component.typeName = typeName;
+            component.prototype = componentType.create();
+            if (!component.prototype.is_valid())
+            {
+                TEA_WARNING("Component {0} has no default constructor, it cannot be shared", typeName);
+                continue;
+            }
+
+            // Apply the prefab values the same way propagation does
+            const auto& componentData = entityData[typeName.c_str()];
+            rttr::instance prototype = component.prototype;
+            for (auto& prop : componentType.get_properties())
+            {
+                std::string propName = prop.get_name().to_string();
+                if (propName == "Scene ID" || propName == "Parent") continue;
+                if (!componentData.HasMember(propName.c_str())) continue;
+
+                rttr::variant propObj = prop.get_value(prototype);
+                Serialize::deserializeEachProperty(componentData[propName.c_str()], propObj, prop.get_type());
+                prop.set_value(prototype, propObj);
+            }
+
+            shared->components.push_back(std::move(component));
+        }
+
+        return shared;
+    }
+
+    std::shared_ptr<const SharedPrefabData> PrefabFlyweight::acquire(const AssetHandle& handle)
+    {
+        const uint64_t handleKey = static_cast<uint64_t>(handle);
+        auto it = s_sharedData.find(handleKey);
+        if (it != s_sharedData.end())
+        {
+            if (auto shared = it->second.lock())
+            {
+                return shared;
+            }
+        }
+        pruneExpired();
+
+        // First live instance of this prefab, use its flattened data so variants carry their base components
+        auto resolved = PrefabResolver::resolve(handle);
+        if (!resolved)
+        {
+            return nullptr;
+        }
+
+        auto shared = build(handleKey, resolved->getEntityData());
+        buildRenderProxy(*shared);
+        s_sharedData[handleKey] = shared;
+        return shared;
+    }
+
+    void PrefabFlyweight::pruneExpired()
+    {
+        for (auto it = s_sharedData.begin(); it != s_sharedData.end();)
+        {
+            it = it->second.expired() ? s_sharedData.erase(it) : std::next(it);
+        }
+    }
+
+    size_t PrefabFlyweight::getSharedCount()
+    {
+        return static_cast<size_t>(std::count_if(s_sharedData.begin(), s_sharedData.end(),
+            [](const auto& entry) { return !entry.second.expired(); }));
+    }
+
+    void PrefabFlyweight::buildRenderProxy(SharedPrefabData& shared)
+    {
+        shared.hasRenderProxy = s_renderProxyBuilder && s_renderProxyBuilder(shared, shared.renderProxy);
+    }
+
+    void PrefabFlyweight::updateRenderProxy(entt::registry& registry, entt::entity entity)
+    {
+        const auto* flyweight = registry.try_get<TeaComponents::FlyweightPrefabComponent>(entity);
+        if (!flyweight || !flyweight->shared) return;
+
+        if (!flyweight->shared->hasRenderProxy)
+        {
+            registry.remove<TeaGraphics::RenderProxy>(entity);
+            return;
+        }
+
+        // Lightweight instances are always roots, their local transform is their world transform
+        TeaGraphics::RenderProxy proxy = flyweight->shared->renderProxy;
+        if (auto* transform = registry.try_get<TeaComponents::Transform>(entity))
+        {
+            const glm::mat4 world = glm::translate(glm::mat4(1.0f), transform->getPosition())
+                * glm::mat4_cast(glm::quat(glm::radians(transform->getRotation())))
+                * glm::scale(glm::mat4(1.0f), transform->getScale());
+            proxy.setWorldMatrix(world);
+        }
+
+        // Replacing fires the update signal, so instance batches pick the change up
+        registry.emplace_or_replace<TeaGraphics::RenderProxy>(entity, proxy);
+    }
+
+    size_t PrefabFlyweight::restoreInstances(entt::registry& registry)
+    {
+        std::vector<entt::entity> candidates;
+        for (auto entityHandle : registry.view<TeaComponents::OverrideComponent>(entt::exclude<TeaComponents::FlyweightPrefabComponent>))
+        {
+            candidates.push_back(entityHandle);
+        }
+
+        // Held for the whole pass, the cache alone would drop the data of prefabs with only regular instances
+        std::unordered_map<uint64_t, std::shared_ptr<const SharedPrefabData>> held;
+        size_t restored = 0;
+        for (auto entityHandle : candidates)
+        {
+            const AssetHandle masterHandle = registry.get<TeaComponents::OverrideComponent>(entityHandle).masterPrefabHandle;
+            auto heldIt = held.find(static_cast<uint64_t>(masterHandle));
+            if (heldIt == held.end())
+            {
+                heldIt = held.emplace(static_cast<uint64_t>(masterHandle), acquire(masterHandle)).first;
+            }
+            const auto& shared = heldIt->second;
+            if (!shared) continue;
+
+            // Regular instances own the prefab's components, lightweight ones were saved without them
+            btEngine::Entity entity(entityHandle, &registry);
+            const bool ownsShared = std::any_of(shared->components.begin(), shared->components.end(),
+                [&entity](const SharedPrefabData::SharedComponent& component)
+                {
+                    return component.typeName != "Transform" && entity.hasComponent(component.typeName);
+                });
+            if (ownsShared) continue;
+
+            attach(registry, entityHandle, shared);
+            restored++;
+        }
+        return restored;
+    }
+
+    size_t PrefabFlyweight::refresh(const AssetHandle& handle, const rapidjson::Value& entityData, entt::registry& registry,
+        std::shared_ptr<const SharedPrefabData>* previous, std::shared_ptr<const SharedPrefabData>* current)
+    {
+        const uint64_t handleKey = static_cast<uint64_t>(handle);
+
+        // Nothing to do if no lightweight instance of this prefab is alive
+        auto it = s_sharedData.find(handleKey);
+        std::shared_ptr<const SharedPrefabData> oldShared = it != s_sharedData.end() ? it->second.lock() : nullptr;
+        if (!oldShared)
+        {
+            if (it != s_sharedData.end()) s_sharedData.erase(it);
+            return 0;
+        }
+
+        auto shared = build(handleKey, entityData);
+        buildRenderProxy(*shared);
+        if (previous) *previous = oldShared;
+        if (current) *current = shared;
+
+        // Instances still holding the old data release it as they are repointed
+        return repoint(registry, oldShared, shared);
+    }
+
+    size_t PrefabFlyweight::repoint(entt::registry& registry, const std::shared_ptr<const SharedPrefabData>& from,
+        const std::shared_ptr<const SharedPrefabData>& to)
+    {
+        if (!from || !to || from == to) return 0;
+        s_sharedData[to->prefabHandle] = to;
+
+        size_t repointed = 0;
+        auto view = registry.view<TeaComponents::FlyweightPrefabComponent>();
+        for (auto entityHandle : view)
+        {
+            auto& flyweight = view.get<TeaComponents::FlyweightPrefabComponent>(entityHandle);
+            if (flyweight.shared == from)
+            {
+                flyweight.shared = to;
+                updateRenderProxy(registry, entityHandle);
+                repointed++;
+            }
+        }
+        return repointed;
+    }
+
+    void PrefabFlyweight::attach(entt::registry& registry, entt::entity entityHandle, std::shared_ptr<const SharedPrefabData> shared)
+    {
+        const bool drawable = shared->hasRenderProxy;
+        registry.emplace_or_replace<TeaComponents::FlyweightPrefabComponent>(entityHandle).shared = std::move(shared);
+
+        // Nothing would draw an instance without a proxy, give it its own components instead
+        if (drawable)
+        {
+            updateRenderProxy(registry, entityHandle);
+        }
+        else
+        {
+            btEngine::Entity entity(entityHandle, &registry);
+            materialize(entity);
+        }
+    }
+
+    btEngine::Entity PrefabFlyweight::instantiate(SceneManager::sceneManager* sceneManager, const AssetHandle& handle,
+        const glm::vec3& position, const btEngine::UUID* uuid)
+    {
+        auto shared = acquire(handle);
+        if (!shared)
+        {
+            return {};
+        }
+
+        btEngine::Entity entity = uuid ? sceneManager->createEntityWithUUID(*uuid) : sceneManager->createEntity();
+
+        // The transform is the one component every instance owns, start it from the prefab values
+        if (!entity.hasComponent("Transform"))
+        {
+            entity.addComponent("Transform");
+        }
+        if (const auto* prefabTransform = shared->findComponent("Transform"))
+        {
+            rttr::variant transformVar = entity.getComponent("Transform");
+            copyProperties(prefabTransform->type, prefabTransform->prototype, transformVar);
+        }
+        entity.getComponent<TeaComponents::Transform>().setPosition(position);
+
+        auto& overrideComp = entity.addComponent<TeaComponents::OverrideComponent>();
+        overrideComp.masterPrefabHandle = handle;
+        TeaComponents::OverrideComponent::Property positionOverride;
+        positionOverride.path = "Transform/Position";
+        overrideComp.properties.push_back(positionOverride);
+
+        attach(*sceneManager->getRegistry(), entity, std::move(shared));
+        return entity;
+    }
+
+    bool PrefabFlyweight::isLightweight(btEngine::Entity& entity)
+    {
+        return entity.hasComponent<TeaComponents::FlyweightPrefabComponent>();
+    }
+
+    rttr::variant PrefabFlyweight::readProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName)
+    {
+        rttr::type componentType = rttr::type::get_by_name(typeName);
+        rttr::property prop = componentType.get_property(propName);
+        if (!prop.is_valid())
+        {
+            return {};
+        }
+
+        // Components the instance owns win over the shared data
+        if (entity.hasComponent(typeName))
+        {
+            rttr::variant componentVar = entity.getComponent(typeName);
+            return prop.get_value(rttr::instance(componentVar));
+        }
+
+        if (isLightweight(entity))
+        {
+            const auto& flyweight = entity.getComponent<TeaComponents::FlyweightPrefabComponent>();
+            if (const auto* sharedComponent = flyweight.shared->findComponent(typeName))
+            {
+                return prop.get_value(rttr::instance(sharedComponent->prototype));
+            }
+        }
+        return {};
+    }
+
+    bool PrefabFlyweight::writeProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName,
+        const rttr::variant& value)
+    {
+        // The shared data is immutable, the first write gives the instance its own copy
+        if (isLightweight(entity))
+        {
+            materialize(entity);
+        }
+
+        rttr::variant componentVar = entity.getComponent(typeName);
+        if (!componentVar.is_valid())
+        {
+            TEA_WARNING("Entity does not have component {0}. Cannot write {1}.", typeName, propName);
+            return false;
+        }
+
+        rttr::type componentType = rttr::type::get_by_name(typeName);
+        rttr::property prop = componentType.get_property(propName);
+        rttr::instance component = componentVar;
+        if (!prop.is_valid() || !prop.set_value(component, value))
+        {
+            TEA_WARNING("Failed to write property {0}/{1}", typeName, propName);
+            return false;
+        }
+
+        // Record the override so propagation keeps the local value
+        if (entity.hasComponent<TeaComponents::OverrideComponent>())
+        {
+            auto& overrideComp = entity.getComponent<TeaComponents::OverrideComponent>();
+            std::string propertyPath = typeName + "/" + propName;
+            auto overrideIt = std::find_if(overrideComp.properties.begin(), overrideComp.properties.end(),
+                [&propertyPath](const TeaComponents::OverrideComponent::Property& overrideProp) {
+                    return overrideProp.path == propertyPath;
+                });
+            if (overrideIt == overrideComp.properties.end())
+            {
+                TeaComponents::OverrideComponent::Property overrideProp;
+                overrideProp.path = propertyPath;
+                overrideComp.properties.push_back(overrideProp);
+            }
+        }
+        return true;
+    }
+
+    void PrefabFlyweight::materialize(btEngine::Entity& entity)
+    {
+        if (!isLightweight(entity)) return;
+
+        // Keep the shared data alive while the flyweight component is removed
+        auto shared = entity.getComponent<TeaComponents::FlyweightPrefabComponent>().shared;
+        for (const auto& sharedComponent : shared->components)
+        {
+            if (sharedComponent.typeName == "Child" || sharedComponent.typeName == "Parent") continue;
+
+            // Components the instance already owns keep their local values
+            if (entity.hasComponent(sharedComponent.typeName)) continue;
+
+            entity.addComponent(sharedComponent.typeName);
+            rttr::variant componentVar = entity.getComponent(sharedComponent.typeName);
+            if (!componentVar.is_valid())
+            {
+                TEA_WARNING("Failed to materialize component {0}", sharedComponent.typeName);
+                continue;
+            }
+            copyProperties(sharedComponent.type, sharedComponent.prototype, componentVar);
+        }
+
+        entity.removeComponent<TeaComponents::FlyweightPrefabComponent>();
+    }
+
+    void PrefabFlyweight::copyProperties(const rttr::type& type, rttr::instance source, rttr::instance destination)
+    {
+        for (auto& prop : type.get_properties())
+        {
+            std::string propName = prop.get_name().to_string();
+            if (propName == "Scene ID" || propName == "Parent") continue;
+
+            prop.set_value(destination, prop.get_value(source));
+        }
+    }
+}
@@ -0,0 +1,223 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabFlyweight.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SharedPrefabData holding the immutable component data of a prefab
+- FlyweightPrefabComponent marking lightweight prefab instances
+- PrefabFlyweight class for creating, reading, writing and materializing
+  lightweight prefab instances
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <rapidjson/document.h>
+#include <rttr/type>
+
+#include "../Core/entity.hpp"
+#include "../Core/Scenemanager.hpp"
+#include "../Asset/AssetManager.hpp"
+#include "../Graphics/RenderExtraction.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief Immutable component data of a prefab, shared by all of its lightweight instances
+    */
+    struct SharedPrefabData
+    {
+        struct SharedComponent
+        {
+            rttr::type type = rttr::type::get<void>();
+            std::string typeName;
+            rttr::variant prototype;    // Component built from the prefab values, never written after load
+        };
+
+        uint64_t prefabHandle = 0;
+        std::vector<SharedComponent> components;
+
+        // Mesh, material and local bounds every lightweight instance is drawn with, world matrix unused
+        TeaGraphics::RenderProxy renderProxy;
+        bool hasRenderProxy = false;
+
+        const SharedComponent* findComponent(const std::string& typeName) const;
+    };
+}
+
+namespace TeaComponents
+{
+    /**
+     * @brief Marks a lightweight prefab instance and points it at the shared prefab data
+     *
+     * A lightweight instance only owns its UUIDComponent, Transform, OverrideComponent, this
+     * component and a RenderProxy built from the shared data. Every other component is read
+     * from the shared data until the instance is written to, at which point it is
+     * materialized into a regular prefab instance.
+    */
+    struct FlyweightPrefabComponent
+    {
+        std::shared_ptr<const TeaAsset::SharedPrefabData> shared;
+    };
+}
+
+namespace TeaAsset
+{
+    /**
+     * @brief Lightweight prefab instances that share unmodified component data
+     *
+     * This class handles:
+     * 1. Building and caching the shared component data of a prefab
+     * 2. Creating lightweight instances that only own their transform and overrides
+     * 3. Resolving reads to the instance or to the shared data
+     * 4. Materializing an instance into a full copy on its first write
+     * 5. Repointing every lightweight instance when the prefab changes
+     * 6. Keeping a RenderProxy on every lightweight instance so the renderer draws it
+     * 7. Turning saved instances back into lightweight ones after a scene is loaded
+     *
+     * Shared data is only cached while an instance holds it, the last instance to go frees it.
+    */
+    class PrefabFlyweight
+    {
+    public:
+        // Fills the mesh, material and local bounds of a proxy from the components of a prefab
+        using RenderProxyBuilder = std::function<bool(const SharedPrefabData& shared, TeaGraphics::RenderProxy& proxy)>;
+
+        /**
+         * @brief Installs the function building render proxies from shared data
+         *
+         * Set by the graphics system, which builds the proxies of regular entities from the
+         * same components. Without it, or when it finds nothing to draw, instances are created
+         * materialized so the graphics system draws them like any other entity.
+         *
+         * @param builder Proxy builder, nullptr to remove it
+        */
+        static void setRenderProxyBuilder(RenderProxyBuilder builder) { s_renderProxyBuilder = std::move(builder); }
+
+        /**
+         * @brief Gets the shared data of a prefab, loading it the first time
+         * @param handle Asset handle of the prefab
+         * @return Shared data, nullptr if the prefab could not be loaded
+        */
+        static std::shared_ptr<const SharedPrefabData> acquire(const AssetHandle& handle);
+
+        /**
+         * @brief Rebuilds the shared data of a prefab and repoints its lightweight instances
+         *
+         * Called by prefab propagation, lightweight instances cost one pointer swap each.
+         *
+         * @param handle Asset handle of the prefab
+         * @param entityData "Entity" object of the prefab document
+         * @param registry Registry holding the instances
+         * @param previous Optional, receives the data the instances held before, for undo
+         * @param current Optional, receives the data the instances hold now, for undo
+         * @return Number of lightweight instances repointed
+        */
+        static size_t refresh(const AssetHandle& handle, const rapidjson::Value& entityData, entt::registry& registry,
+            std::shared_ptr<const SharedPrefabData>* previous = nullptr, std::shared_ptr<const SharedPrefabData>* current = nullptr);
+
+        /**
+         * @brief Points every lightweight instance holding one shared data at another, used by undo and redo
+         * @param registry Registry holding the instances
+         * @param from Shared data to replace
+         * @param to Shared data of the same prefab to point the instances at
+         * @return Number of lightweight instances repointed
+        */
+        static size_t repoint(entt::registry& registry, const std::shared_ptr<const SharedPrefabData>& from,
+            const std::shared_ptr<const SharedPrefabData>& to);
+
+        /**
+         * @brief Creates a lightweight instance of a prefab
+         * @param sceneManager Scene manager to create the entity in
+         * @param handle Asset handle of the prefab
+         * @param position World position of the instance
+         * @param uuid UUID to create the entity with, used by redo, nullptr for a new one
+         * @return The new entity, invalid if the prefab could not be loaded
+        */
+        static btEngine::Entity instantiate(SceneManager::sceneManager* sceneManager, const AssetHandle& handle,
+            const glm::vec3& position, const btEngine::UUID* uuid = nullptr);
+
+        static bool isLightweight(btEngine::Entity& entity);
+
+        /**
+         * @brief Refreshes the RenderProxy of a lightweight instance from its shared data and Transform
+         * @param registry Registry holding the instance
+         * @param entity Lightweight instance, must be a root entity
+        */
+        static void updateRenderProxy(entt::registry& registry, entt::entity entity);
+
+        /**
+         * @brief Turns prefab instances loaded from a scene file back into lightweight instances
+         *
+         * Lightweight instances are saved with only the components they own. Call right after a
+         * scene is deserialized: every prefab instance that owns none of its prefab's components
+         * other than the Transform gets its shared data and render proxy back, or is materialized
+         * when its prefab has no render proxy.
+         *
+         * @param registry Registry the scene was loaded into
+         * @return Number of instances restored
+        */
+        static size_t restoreInstances(entt::registry& registry);
+
+        /**
+         * @brief Reads a property from the instance if it owns the component, otherwise from the shared data
+         * @param entity Prefab instance
+         * @param typeName Registered component name
+         * @param propName Property name
+         * @return Property value, invalid if neither has it
+        */
+        static rttr::variant readProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName);
+
+        /**
+         * @brief Writes a property, materializing a lightweight instance first and recording the override
+         * @param entity Prefab instance
+         * @param typeName Registered component name
+         * @param propName Property name
+         * @param value New value
+         * @return true if the value was written
+        */
+        static bool writeProperty(btEngine::Entity& entity, const std::string& typeName, const std::string& propName,
+            const rttr::variant& value);
+
+        /**
+         * @brief Turns a lightweight instance into a regular prefab instance owning all of its components
+         * @param entity Lightweight instance
+        */
+        static void materialize(btEngine::Entity& entity);
+
+        // Number of prefabs with shared data held by at least one instance
+        static size_t getSharedCount();
+
+        /**
+         * @brief Builds immutable component prototypes from a serialized entity, also used by sub-scene instancing
+         * @param handleKey Prefab handle stored in the result, 0 for entities that are not prefabs
+         * @param entityData Serialized entity, one member per component
+         * @return Shared component data
+        */
+        static std::shared_ptr<SharedPrefabData> build(uint64_t handleKey, const rapidjson::Value& entityData);
+
+        // Copies every property except the scene bookkeeping ones
+        static void copyProperties(const rttr::type& type, rttr::instance source, rttr::instance destination);
+
+    private:
+        static void buildRenderProxy(SharedPrefabData& shared);
+        static void attach(entt::registry& registry, entt::entity entityHandle, std::shared_ptr<const SharedPrefabData> shared);
+        static void pruneExpired();
+
+        static std::unordered_map<uint64_t, std::weak_ptr<const SharedPrefabData>>  s_sharedData;
+        static RenderProxyBuilder                                                   s_renderProxyBuilder;
+    };
+}
@@ -0,0 +1,614 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabUsageIndex.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SAX scanner collecting the prefab references of a scene or prefab file
+- PrefabUsageIndex implementation (incremental updates, binary storage, queries)
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "PrefabUsageIndex.hpp"
+#include "OfflinePrefabPropagation.hpp"
+#include "PrefabVariant.hpp"
+#include "../Core/SceneQuery.hpp"
+#include "../Core/BlockCompression.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <rapidjson/reader.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    bool keyEquals(const char* str, rapidjson::SizeType length, const char* key)
+    {
+        return std::strlen(key) == length && std::memcmp(str, key, length) == 0;
+    }
+
+    /**
+     * @brief Collects (master prefab, instance uuid) per entity, and the base of a prefab variant
+     *
+     * Only the OverrideComponent handle, the UUIDComponent value and the root "BasePrefab" key
+     * are looked at, everything else is skipped without being stored.
+    */
+    class UsageScanHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, UsageScanHandler>
+    {
+    public:
+        enum class Watched { None, MasterHandle, InstanceUUID, BasePrefab };
+
+        bool Default()
+        {
+            m_watched = Watched::None;
+            return true;
+        }
+
+        bool Int(int i)             { return number(static_cast<uint64_t>(i)); }
+        bool Uint(unsigned u)       { return number(u); }
+        bool Int64(int64_t i)       { return number(static_cast<uint64_t>(i)); }
+        bool Uint64(uint64_t u)     { return number(u); }
+
+        bool String(const char* str, rapidjson::SizeType length, bool)
+        {
+            if (m_watched == Watched::BasePrefab)
+            {
+                basePrefabPath.assign(str, length);
+            }
+            else if (m_watched != Watched::None)
+            {
+                number(std::strtoull(std::string(str, length).c_str(), nullptr, 10));
+            }
+            m_watched = Watched::None;
+            return true;
+        }
+
+        bool Key(const char* str, rapidjson::SizeType length, bool)
+        {
+            m_watched = Watched::None;
+            if (m_depth == 1)
+            {
+                m_pendingEntities = keyEquals(str, length, TeaAsset::SceneFileSchema::EntitiesKey);
+                if (keyEquals(str, length, TeaAsset::PrefabResolver::BasePrefabKey))
+                {
+                    m_watched = Watched::BasePrefab;
+                }
+            }
+            else if (m_entityDepth != 0 && m_depth == m_entityDepth)
+            {
+                m_component = keyEquals(str, length, TeaAsset::SceneFileSchema::OverrideComponent) ? 1
+                    : keyEquals(str, length, TeaAsset::SceneFileSchema::UUIDComponent) ? 2 : 0;
+            }
+            else if (m_entityDepth != 0 && m_depth == m_entityDepth + 1)
+            {
+                if (m_component == 1 && keyEquals(str, length, TeaAsset::SceneFileSchema::MasterPrefabHandle))
+                {
+                    m_watched = Watched::MasterHandle;
+                }
+                else if (m_component == 2 && keyEquals(str, length, TeaAsset::SceneFileSchema::UUIDKey))
+                {
+                    m_watched = Watched::InstanceUUID;
+                }
+            }
+            return true;
+        }
+
+        bool StartObject()
+        {
+            m_watched = Watched::None;
+            if (m_entityDepth == 0 && m_entitiesDepth != 0 && m_depth == m_entitiesDepth)
+            {
+                m_entityDepth = m_depth + 1;
+                m_masterHandle = 0;
+                m_instanceUUID = 0;
+                m_component = 0;
+            }
+            m_depth++;
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType)
+        {
+            m_depth--;
+            if (m_entityDepth != 0 && m_depth + 1 == m_entityDepth)
+            {
+                if (m_masterHandle != 0)
+                {
+                    entries.emplace_back(m_masterHandle, m_instanceUUID);
+                }
+                m_entityDepth = 0;
+            }
+            return true;
+        }
+
+        bool StartArray()
+        {
+            m_watched = Watched::None;
+            if (m_depth == 1 && m_pendingEntities)
+            {
+                m_entitiesDepth = m_depth + 1;
+            }
+            m_depth++;
+            return true;
+        }
+
+        bool EndArray(rapidjson::SizeType)
+        {
+            if (m_depth == m_entitiesDepth)
+            {
+                m_entitiesDepth = 0;
+            }
+            m_depth--;
+            return true;
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t>> entries;
+        std::string basePrefabPath;
+
+    private:
+        bool number(uint64_t value)
+        {
+            if (m_watched == Watched::MasterHandle)
+            {
+                m_masterHandle = value;
+            }
+            else if (m_watched == Watched::InstanceUUID)
+            {
+                m_instanceUUID = value;
+            }
+            m_watched = Watched::None;
+            return true;
+        }
+
+        uint32_t    m_depth = 0;
+        uint32_t    m_entitiesDepth = 0;
+        uint32_t    m_entityDepth = 0;
+        uint32_t    m_component = 0;        // 1 = OverrideComponent, 2 = UUIDComponent
+        uint64_t    m_masterHandle = 0;
+        uint64_t    m_instanceUUID = 0;
+        bool        m_pendingEntities = false;
+        Watched     m_watched = Watched::None;
+    };
+
+    template<typename T>
+    void writeValue(std::ostream& stream, const T& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool readValue(std::istream& stream, T& value)
+    {
+        return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    // True if a file key lies inside a directory key, "Assets2/a.scene" is not inside "Assets"
+    bool isInsideDirectory(const std::string& key, const std::string& directoryKey)
+    {
+        if (directoryKey.empty() || key.size() <= directoryKey.size()) return false;
+        if (key.compare(0, directoryKey.size(), directoryKey) != 0) return false;
+        return directoryKey.back() == '/' || key[directoryKey.size()] == '/';
+    }
+}
+
+namespace TeaAsset
+{
+    std::vector<PrefabUsageIndex::FileRecord>                   PrefabUsageIndex::s_files;
+    std::unordered_map<std::string, uint32_t>                   PrefabUsageIndex::s_fileIds;
+    std::unordered_map<uint64_t, std::vector<uint32_t>>         PrefabUsageIndex::s_prefabFiles;
+    std::vector<uint32_t>                                       PrefabUsageIndex::s_freeIds;
+    std::filesystem::path                                       PrefabUsageIndex::s_indexPath;
+    bool                                                        PrefabUsageIndex::s_loaded = false;
+    bool                                                        PrefabUsageIndex::s_dirty = false;
+    std::mutex                                                  PrefabUsageIndex::s_mutex;
+
+    bool PrefabUsageIndex::load(const std::filesystem::path& indexPath)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_files.clear();
+        s_fileIds.clear();
+        s_prefabFiles.clear();
+        s_freeIds.clear();
+        s_indexPath = indexPath;
+        s_loaded = true;
+        s_dirty = false;
+
+        std::ifstream file(indexPath, std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        // Counts read from the file are checked against what is left of it before anything is allocated
+        std::error_code sizeError;
+        const uintmax_t fileSize = std::filesystem::file_size(indexPath, sizeError);
+        if (sizeError)
+        {
+            return false;
+        }
+
+        uint32_t magic = 0, byteOrder = 0, version = 0, fileCount = 0;
+        if (!readValue(file, magic) || !readValue(file, byteOrder) || !readValue(file, version) || !readValue(file, fileCount) ||
+            magic != FileMagic || byteOrder != ByteOrderMark || version != FileVersion)
+        {
+            TEA_WARNING("Prefab usage index {0} is outdated, it will be rebuilt", indexPath.string());
+            s_dirty = true;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < fileCount; i++)
+        {
+            uint16_t pathLength = 0;
+            int64_t writeTime = 0;
+            uint32_t entryCount = 0;
+            std::string path;
+
+            bool ok = readValue(file, pathLength);
+            if (ok)
+            {
+                path.resize(pathLength);
+                ok = static_cast<bool>(file.read(path.data(), pathLength));
+            }
+            ok = ok && readValue(file, writeTime) && readValue(file, entryCount);
+            if (ok)
+            {
+                const uintmax_t remaining = fileSize - static_cast<uintmax_t>(file.tellg());
+                ok = entryCount <= remaining / sizeof(UsageEntries::value_type);
+            }
+
+            UsageEntries entries(ok ? entryCount : 0);
+            if (ok && entryCount > 0)
+            {
+                ok = static_cast<bool>(file.read(reinterpret_cast<char*>(entries.data()),
+                    static_cast<std::streamsize>(entryCount * sizeof(UsageEntries::value_type))));
+            }
+
+            if (!ok)
+            {
+                TEA_WARNING("Prefab usage index {0} is truncated or corrupt, the missing files will be rescanned", indexPath.string());
+                s_dirty = true;
+                break;
+            }
+            setFileEntries(path, writeTime, std::move(entries));
+        }
+
+        return true;
+    }
+
+    bool PrefabUsageIndex::save()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_loaded || s_indexPath.empty()) return false;
+        if (!s_dirty) return true;
+
+        std::filesystem::path tempPath = s_indexPath;
+        tempPath += ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                TEA_ERROR("Failed to write prefab usage index: {0}", tempPath.string());
+                return false;
+            }
+
+            uint32_t fileCount = static_cast<uint32_t>(s_fileIds.size());
+            writeValue(file, FileMagic);
+            writeValue(file, ByteOrderMark);
+            writeValue(file, FileVersion);
+            writeValue(file, fileCount);
+
+            for (const auto& record : s_files)
+            {
+                if (record.path.empty()) continue;
+
+                writeValue(file, static_cast<uint16_t>(record.path.size()));
+                file.write(record.path.data(), static_cast<std::streamsize>(record.path.size()));
+                writeValue(file, record.writeTime);
+                writeValue(file, static_cast<uint32_t>(record.entries.size()));
+                file.write(reinterpret_cast<const char*>(record.entries.data()),
+                    static_cast<std::streamsize>(record.entries.size() * sizeof(UsageEntries::value_type)));
+            }
+
+            if (!file)
+            {
+                TEA_ERROR("Failed to write prefab usage index: {0}", tempPath.string());
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, s_indexPath, error);
+        if (error)
+        {
+            TEA_ERROR("Failed to replace prefab usage index: {0}", error.message());
+            return false;
+        }
+
+        s_dirty = false;
+        return true;
+    }
+
+    size_t PrefabUsageIndex::open(const std::filesystem::path& projectDirectory)
+    {
+        const std::filesystem::path indexPath = projectDirectory / IndexFileName;
+        {
+            // Saves keep an open index current, only a newly opened one has to be checked against the disk
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_loaded && s_indexPath == indexPath)
+            {
+                return 0;
+            }
+        }
+
+        load(indexPath);
+        return refresh(projectDirectory);
+    }
+
+    bool PrefabUsageIndex::isLoaded()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_loaded;
+    }
+
+    size_t PrefabUsageIndex::refresh(const std::filesystem::path& projectDirectory)
+    {
+        // Find what is on disk first, without holding the lock while walking the directory
+        std::vector<std::pair<std::filesystem::path, int64_t>> onDisk;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(projectDirectory, error))
+        {
+            if (!entry.is_regular_file()) continue;
+
+            auto extension = entry.path().extension();
+            if (extension != SceneFileSchema::SceneExtension && extension != SceneFileSchema::PrefabExtension) continue;
+
+            onDisk.emplace_back(entry.path(), getWriteTime(entry.path()));
+        }
+
+        std::vector<std::filesystem::path> changed;
+        {
+            const std::string projectKey = makeKey(projectDirectory);
+            std::lock_guard<std::mutex> lock(s_mutex);
+            std::unordered_map<std::string, bool> seen;
+            for (const auto& [path, writeTime] : onDisk)
+            {
+                std::string key = makeKey(path);
+                seen[key] = true;
+
+                auto it = s_fileIds.find(key);
+                if (it == s_fileIds.end() || s_files[it->second].writeTime != writeTime)
+                {
+                    changed.push_back(path);
+                }
+            }
+
+            // Files deleted since they were indexed
+            std::vector<std::string> deleted;
+            for (const auto& [key, id] : s_fileIds)
+            {
+                if (seen.find(key) == seen.end() && isInsideDirectory(key, projectKey))
+                {
+                    deleted.push_back(key);
+                }
+            }
+            for (const auto& key : deleted)
+            {
+                removeFileLocked(key);
+            }
+        }
+
+        for (const auto& path : changed)
+        {
+            updateFile(path);
+        }
+        return changed.size();
+    }
+
+    void PrefabUsageIndex::updateScene(const std::filesystem::path& scenePath, entt::registry& registry, uint64_t sceneID)
+    {
+        // The registry already holds what was written, no need to read the file back
+        UsageEntries entries;
+        auto& prefabGroup = SceneManager::SceneQueryCache::get(registry).prefabInstances();
+        for (auto entityHandle : prefabGroup)
+        {
+            if (!SceneManager::isInScene(registry, entityHandle, sceneID)) continue;
+
+            const auto& overrideComp = prefabGroup.get<TeaComponents::OverrideComponent>(entityHandle);
+            btEngine::Entity entity(entityHandle, &registry);
+            entries.emplace_back(static_cast<uint64_t>(overrideComp.masterPrefabHandle), static_cast<uint64_t>(entity.getUUID()));
+        }
+
+        updateScene(scenePath, std::move(entries));
+    }
+
+    void PrefabUsageIndex::updateScene(const std::filesystem::path& scenePath, std::vector<std::pair<uint64_t, uint64_t>> instances)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        setFileEntries(makeKey(scenePath), getWriteTime(scenePath), std::move(instances));
+    }
+
+    bool PrefabUsageIndex::updateFile(const std::filesystem::path& path)
+    {
+        UsageEntries entries;
+        if (!scanFile(path, entries))
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        setFileEntries(makeKey(path), getWriteTime(path), std::move(entries));
+        return true;
+    }
+
+    void PrefabUsageIndex::removeFile(const std::filesystem::path& path)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        removeFileLocked(makeKey(path));
+    }
+
+    std::vector<PrefabUsage> PrefabUsageIndex::findUsages(const AssetHandle& handle)
+    {
+        return findUsages(static_cast<uint64_t>(handle));
+    }
+
+    std::vector<PrefabUsage> PrefabUsageIndex::findUsages(uint64_t handleKey)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::vector<PrefabUsage> usages;
+
+        auto it = s_prefabFiles.find(handleKey);
+        if (it == s_prefabFiles.end())
+        {
+            return usages;
+        }
+
+        for (uint32_t fileId : it->second)
+        {
+            const FileRecord& record = s_files[fileId];
+            PrefabUsage usage;
+            usage.filePath = record.path;
+
+            // Entries are sorted by prefab, so the instances of this prefab are one range
+            auto range = std::equal_range(record.entries.begin(), record.entries.end(), std::make_pair(handleKey, uint64_t{ 0 }),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (auto entry = range.first; entry != range.second; ++entry)
+            {
+                if (entry->second != 0)
+                {
+                    usage.instanceUUIDs.push_back(entry->second);
+                }
+            }
+            usages.push_back(std::move(usage));
+        }
+        return usages;
+    }
+
+    bool PrefabUsageIndex::isReferenced(const AssetHandle& handle)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_prefabFiles.find(static_cast<uint64_t>(handle));
+        return it != s_prefabFiles.end() && !it->second.empty();
+    }
+
+    void PrefabUsageIndex::setFileEntries(const std::string& path, int64_t writeTime, UsageEntries entries)
+    {
+        removeFileLocked(path);
+
+        std::sort(entries.begin(), entries.end());
+
+        uint32_t fileId;
+        if (!s_freeIds.empty())
+        {
+            fileId = s_freeIds.back();
+            s_freeIds.pop_back();
+        }
+        else
+        {
+            fileId = static_cast<uint32_t>(s_files.size());
+            s_files.emplace_back();
+        }
+
+        FileRecord& record = s_files[fileId];
+        record.path = path;
+        record.writeTime = writeTime;
+        record.entries = std::move(entries);
+        s_fileIds[path] = fileId;
+
+        // One reverse entry per distinct prefab in the file
+        for (size_t i = 0; i < record.entries.size(); i++)
+        {
+            if (i > 0 && record.entries[i].first == record.entries[i - 1].first) continue;
+            s_prefabFiles[record.entries[i].first].push_back(fileId);
+        }
+        s_dirty = true;
+    }
+
+    void PrefabUsageIndex::removeFileLocked(const std::string& path)
+    {
+        auto it = s_fileIds.find(path);
+        if (it == s_fileIds.end()) return;
+
+        uint32_t fileId = it->second;
+        FileRecord& record = s_files[fileId];
+        for (size_t i = 0; i < record.entries.size(); i++)
+        {
+            if (i > 0 && record.entries[i].first == record.entries[i - 1].first) continue;
+
+            auto prefabIt = s_prefabFiles.find(record.entries[i].first);
+            if (prefabIt == s_prefabFiles.end()) continue;
+
+            auto& fileIds = prefabIt->second;
+            fileIds.erase(std::remove(fileIds.begin(), fileIds.end(), fileId), fileIds.end());
+            if (fileIds.empty())
+            {
+                s_prefabFiles.erase(prefabIt);
+            }
+        }
+
+        record = FileRecord{};
+        s_freeIds.push_back(fileId);
+        s_fileIds.erase(it);
+        s_dirty = true;
+    }
+
+    bool PrefabUsageIndex::scanFile(const std::filesystem::path& path, UsageEntries& entries)
+    {
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(path, contents))
+        {
+            TEA_WARNING("Failed to open {0} for the prefab usage index", path.string());
+            return false;
+        }
+
+        rapidjson::StringStream stream(contents.c_str());
+        UsageScanHandler handler;
+        rapidjson::Reader reader;
+        if (!reader.Parse(stream, handler))
+        {
+            TEA_WARNING("Failed to parse {0} for the prefab usage index", path.string());
+            return false;
+        }
+
+        entries = std::move(handler.entries);
+
+        // A variant references its base prefab, recorded without an instance
+        if (!handler.basePrefabPath.empty())
+        {
+            AssetHandle baseHandle = AssetManager::getAssetHandle(handler.basePrefabPath);
+            entries.emplace_back(static_cast<uint64_t>(baseHandle), 0);
+        }
+        return true;
+    }
+
+    int64_t PrefabUsageIndex::getWriteTime(const std::filesystem::path& path)
+    {
+        std::error_code error;
+        auto writeTime = std::filesystem::last_write_time(path, error);
+        return error ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+    }
+
+    std::string PrefabUsageIndex::makeKey(const std::filesystem::path& path)
+    {
+        // Canonical so a file reached through a relative and an absolute path is one entry,
+        // weakly so deleted files still get the key they were indexed under
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        if (error)
+        {
+            canonical = std::filesystem::absolute(path, error).lexically_normal();
+        }
+
+        std::string key = canonical.generic_string();
+        if (key.size() > 1 && key.back() == '/')
+        {
+            key.pop_back();
+        }
+        return key;
+    }
+}
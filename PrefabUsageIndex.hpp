@@ -0,0 +1,160 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabUsageIndex.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- PrefabUsage describing one file that references a prefab
+- PrefabUsageIndex class keeping a persistent prefab -> files -> instances table
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "../Asset/AssetManager.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief One scene or prefab file that references a prefab
+    */
+    struct PrefabUsage
+    {
+        std::string filePath;
+        std::vector<uint64_t> instanceUUIDs;    // Instances in a scene, empty for a variant prefab file
+    };
+
+    /**
+     * @brief Project wide index from prefab handle to the files and instances using it
+     *
+     * This class handles:
+     * 1. Recording the prefab instances of a scene when it is saved, straight from its registry
+     * 2. Scanning scene and prefab files that changed on disk since they were indexed
+     * 3. Storing the table in a compact binary file next to the project
+     * 4. Answering "find usages" and "is this prefab referenced" without opening any file
+     *
+     * Index file layout, in the byte order of the machine that wrote it:
+     * u32 magic, u32 byteOrder, u32 version, u32 fileCount, then per file:
+     * u16 pathLength, path bytes, i64 writeTime, u32 entryCount, entryCount x (u64 prefab, u64 uuid)
+     * The index is only a cache, a file from a machine of the other byte order is rebuilt, never swapped.
+    */
+    class PrefabUsageIndex
+    {
+    public:
+        static constexpr uint32_t FileMagic = 0x49555054;   // "TPUI"
+        static constexpr uint32_t ByteOrderMark = 0x01020304;
+        static constexpr uint32_t FileVersion = 3;         // 3: canonical file paths
+        static constexpr const char* IndexFileName = ".prefabusage";
+
+        /**
+         * @brief Loads the index of a project and rescans what changed on disk, does nothing if it is already open
+         *
+         * Saves from the editor keep an open index current through updateScene and updateFile,
+         * call refresh to pick up files changed outside of the editor.
+         *
+         * @param projectDirectory Project root, the index file lives there as IndexFileName
+         * @return Number of files rescanned
+        */
+        static size_t open(const std::filesystem::path& projectDirectory);
+
+        /**
+         * @brief Loads the index file, starting an empty index if it is missing or outdated
+         * @param indexPath Path of the index file, also used by save()
+         * @return true if an existing index was loaded
+        */
+        static bool load(const std::filesystem::path& indexPath);
+
+        /**
+         * @brief Writes the index file if anything changed since the last save
+         * @return true if the index file is up to date
+        */
+        static bool save();
+
+        static bool isLoaded();
+
+        /**
+         * @brief Rescans the files that changed on disk and drops the ones that were deleted
+         * @param projectDirectory Directory searched recursively for scene and prefab files
+         * @return Number of files rescanned
+        */
+        static size_t refresh(const std::filesystem::path& projectDirectory);
+
+        /**
+         * @brief Records the prefab instances of a scene that was just saved
+         * @param scenePath Path the scene was saved to
+         * @param registry Registry shared by every loaded scene
+         * @param sceneID Scene ID of the saved scene, instances of other scenes are left out
+        */
+        static void updateScene(const std::filesystem::path& scenePath, entt::registry& registry, uint64_t sceneID);
+
+        /**
+         * @brief Records the prefab instances of a scene saved from a snapshot, safe to call off the registry's thread
+         * @param scenePath Path the scene was saved to
+         * @param instances (prefab handle, instance UUID) pairs captured with the snapshot
+        */
+        static void updateScene(const std::filesystem::path& scenePath, std::vector<std::pair<uint64_t, uint64_t>> instances);
+
+        /**
+         * @brief Rescans a single scene or prefab file
+         * @param path File to scan
+         * @return true if the file was read
+        */
+        static bool updateFile(const std::filesystem::path& path);
+
+        static void removeFile(const std::filesystem::path& path);
+
+        /**
+         * @brief Gets every file referencing a prefab, with the instance UUIDs in each scene
+         * @param handle Asset handle of the prefab
+         * @return One entry per referencing file
+        */
+        static std::vector<PrefabUsage> findUsages(const AssetHandle& handle);
+        static std::vector<PrefabUsage> findUsages(uint64_t handleKey);
+
+        /**
+         * @brief Checks if any scene or prefab references a prefab, used before deleting it
+         * @param handle Asset handle of the prefab
+         * @return true if the prefab is used somewhere
+        */
+        static bool isReferenced(const AssetHandle& handle);
+
+    private:
+        // (prefab handle, instance uuid) pairs of one file, sorted by prefab handle
+        using UsageEntries = std::vector<std::pair<uint64_t, uint64_t>>;
+
+        struct FileRecord
+        {
+            std::string path;               // Empty for a free slot
+            int64_t writeTime = 0;
+            UsageEntries entries;
+        };
+
+        static void setFileEntries(const std::string& path, int64_t writeTime, UsageEntries entries);
+        static void removeFileLocked(const std::string& path);
+        static bool scanFile(const std::filesystem::path& path, UsageEntries& entries);
+        static int64_t getWriteTime(const std::filesystem::path& path);
+        static std::string makeKey(const std::filesystem::path& path);
+
+        static std::vector<FileRecord>                              s_files;
+        static std::unordered_map<std::string, uint32_t>            s_fileIds;
+        static std::unordered_map<uint64_t, std::vector<uint32_t>>  s_prefabFiles;   // Prefab -> ids of the files using it
+        static std::vector<uint32_t>                                s_freeIds;
+        static std::filesystem::path                                s_indexPath;
+        static bool                                                 s_loaded;
+        static bool                                                 s_dirty;
+        static std::mutex                                           s_mutex;
+    };
+}
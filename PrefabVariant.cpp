@@ -0,0 +1,314 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabVariant.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- PrefabSources lookups gathered on the main thread
+- PrefabResolver implementation (chain loading, flattening, invalidation)
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "PrefabVariant.hpp"
+#include "SchemaMigration.hpp"
+#include "../Core/BlockCompression.hpp"
+
+#include <algorithm>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAsset
+{
+    std::unordered_map<uint64_t, PrefabResolver::CacheEntry> PrefabResolver::s_cache;
+    std::mutex PrefabResolver::s_mutex;
+    uint64_t PrefabResolver::s_generation = 0;
+
+    bool ResolvedPrefab::derivesFrom(uint64_t ancestor) const
+    {
+        return std::find(chain.begin(), chain.end(), ancestor) != chain.end();
+    }
+
+    void PrefabSources::add(const AssetHandle& prefabHandle)
+    {
+        paths[static_cast<uint64_t>(prefabHandle)] = AssetManager::getSourceFilePath(prefabHandle).string();
+    }
+
+    void PrefabSources::addBase(const std::string& basePath)
+    {
+        AssetHandle baseHandle = AssetManager::getAssetHandle(basePath);
+        handles[basePath] = static_cast<uint64_t>(baseHandle);
+        add(baseHandle);
+    }
+
+    std::shared_ptr<const ResolvedPrefab> PrefabResolver::resolve(const AssetHandle& handle)
+    {
+        PrefabSources sources = collectSources(handle);
+
+        // Each pass discovers at most one more base, only variants never flattened before need more than one
+        std::string missingBase;
+        while (true)
+        {
+            missingBase.clear();
+            auto resolved = resolve(sources, &missingBase);
+            if (resolved || missingBase.empty() || sources.handles.count(missingBase))
+            {
+                return resolved;
+            }
+            sources.addBase(missingBase);
+        }
+    }
+
+    PrefabSources PrefabResolver::collectSources(const AssetHandle& handle)
+    {
+        PrefabSources sources;
+        sources.handle = static_cast<uint64_t>(handle);
+        sources.add(handle);
+
+        // Flattened prefabs remember their base, follow them down the chain
+        std::lock_guard<std::mutex> lock(s_mutex);
+        uint64_t handleKey = sources.handle;
+        for (size_t depth = 0; depth < s_cache.size(); depth++)
+        {
+            auto cached = s_cache.find(handleKey);
+            if (cached == s_cache.end()) break;
+
+            const ResolvedPrefab& prefab = *cached->second.prefab;
+            sources.paths.emplace(handleKey, prefab.sources.front().first);
+            if (prefab.basePath.empty() || prefab.chain.size() < 2) break;
+
+            handleKey = prefab.chain[1];
+            sources.handles.emplace(prefab.basePath, handleKey);
+            sources.paths.emplace(handleKey, prefab.sources[1].first);
+        }
+        return sources;
+    }
+
+    std::shared_ptr<const ResolvedPrefab> PrefabResolver::resolve(const PrefabSources& sources, std::string* missingBase)
+    {
+        std::vector<uint64_t> visiting;
+        return resolveChain(sources.handle, sources, visiting, missingBase);
+    }
+
+    size_t PrefabResolver::invalidate(const AssetHandle& handle)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const uint64_t handleKey = static_cast<uint64_t>(handle);
+        s_generation++;
+
+        // Every entry whose chain goes through the changed prefab was flattened from stale data
+        size_t dropped = 0;
+        for (auto it = s_cache.begin(); it != s_cache.end();)
+        {
+            if (it->second.prefab->derivesFrom(handleKey))
+            {
+                it = s_cache.erase(it);
+                dropped++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return dropped;
+    }
+
+    void PrefabResolver::clear()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_generation++;
+        s_cache.clear();
+    }
+
+    std::shared_ptr<const ResolvedPrefab> PrefabResolver::findCachedLocked(uint64_t handleKey)
+    {
+        auto cached = s_cache.find(handleKey);
+        if (cached == s_cache.end())
+        {
+            return nullptr;
+        }
+
+        // Saves from the editor invalidate explicitly, the files are only checked for outside edits
+        auto now = std::chrono::steady_clock::now();
+        if (now - cached->second.checkedAt < StaleCheckInterval)
+        {
+            return cached->second.prefab;
+        }
+        if (isStale(*cached->second.prefab))
+        {
+            s_cache.erase(cached);
+            return nullptr;
+        }
+
+        cached->second.checkedAt = now;
+        return cached->second.prefab;
+    }
+
+    bool PrefabResolver::isStale(const ResolvedPrefab& resolved)
+    {
+        for (const auto& [path, writeTime] : resolved.sources)
+        {
+            std::error_code error;
+            auto currentTime = std::filesystem::last_write_time(path, error);
+            if (error || currentTime != writeTime)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void PrefabResolver::mergeInto(rapidjson::Value& target, const rapidjson::Value& source, rapidjson::Document::AllocatorType& allocator)
+    {
+        // Objects merge member by member, anything else is replaced by the variant's value
+        for (auto member = source.MemberBegin(); member != source.MemberEnd(); ++member)
+        {
+            auto existing = target.FindMember(member->name);
+            if (existing == target.MemberEnd())
+            {
+                target.AddMember(rapidjson::Value(member->name, allocator), rapidjson::Value(member->value, allocator), allocator);
+            }
+            else if (existing->value.IsObject() && member->value.IsObject())
+            {
+                mergeInto(existing->value, member->value, allocator);
+            }
+            else
+            {
+                existing->value.CopyFrom(member->value, allocator);
+            }
+        }
+    }
+
+    std::shared_ptr<const ResolvedPrefab> PrefabResolver::resolveChain(uint64_t handleKey, const PrefabSources& sources,
+        std::vector<uint64_t>& visiting, std::string* missingBase)
+    {
+        // Only the cache is guarded, reading and flattening run unlocked so workers resolve side by side
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (auto cached = findCachedLocked(handleKey))
+            {
+                return cached;
+            }
+            generation = s_generation;
+        }
+
+        if (std::find(visiting.begin(), visiting.end(), handleKey) != visiting.end())
+        {
+            TEA_ERROR("Prefab variant chain loops back on itself, cannot resolve it");
+            return nullptr;
+        }
+
+        auto sourcePath = sources.paths.find(handleKey);
+        if (sourcePath == sources.paths.end())
+        {
+            TEA_ERROR("No source file was looked up for prefab {0}", handleKey);
+            return nullptr;
+        }
+
+        // Load the prefab's own file, its write time is taken first so a save during the read shows as stale
+        const std::string& prefabPath = sourcePath->second;
+        std::error_code timeError;
+        const auto writeTime = std::filesystem::last_write_time(prefabPath, timeError);
+        std::string prefabContents;
+        if (!btEngine::BlockCompression::readFile(prefabPath, prefabContents))
+        {
+            TEA_ERROR("Failed to open prefab file: {0}", prefabPath);
+            return nullptr;
+        }
+
+        rapidjson::Document prefabDoc;
+        prefabDoc.Parse(prefabContents.c_str(), prefabContents.size());
+        if (prefabDoc.HasParseError() || !prefabDoc.IsObject())
+        {
+            TEA_ERROR("Failed to parse prefab file: {0}", prefabPath);
+            return nullptr;
+        }
+        if (!SchemaMigration::checkOnLoad(prefabDoc, prefabPath))
+        {
+            return nullptr;
+        }
+
+        auto resolved = std::make_shared<ResolvedPrefab>();
+        resolved->handle = handleKey;
+        resolved->chain.push_back(handleKey);
+        resolved->sources.emplace_back(prefabPath, writeTime);
+
+        auto& allocator = resolved->document.GetAllocator();
+        resolved->document.SetObject();
+
+        // Variants start from the flattened data of their base
+        auto baseMember = prefabDoc.FindMember(BasePrefabKey);
+        if (baseMember != prefabDoc.MemberEnd() && baseMember->value.IsString())
+        {
+            std::string basePath = baseMember->value.GetString();
+            auto baseHandle = sources.handles.find(basePath);
+            if (baseHandle == sources.handles.end())
+            {
+                // The caller looks the base up on the main thread and resolves again
+                if (missingBase)
+                {
+                    *missingBase = basePath;
+                }
+                return nullptr;
+            }
+
+            visiting.push_back(handleKey);
+            auto base = resolveChain(baseHandle->second, sources, visiting, missingBase);
+            visiting.pop_back();
+
+            if (!base)
+            {
+                if (!missingBase || missingBase->empty())
+                {
+                    TEA_ERROR("Failed to resolve base prefab {0} of variant {1}", basePath, prefabPath);
+                }
+                return nullptr;
+            }
+
+            resolved->basePath = basePath;
+            resolved->document.CopyFrom(base->document, allocator);
+            resolved->chain.insert(resolved->chain.end(), base->chain.begin(), base->chain.end());
+            resolved->sources.insert(resolved->sources.end(), base->sources.begin(), base->sources.end());
+        }
+        else
+        {
+            resolved->document.AddMember("Entity", rapidjson::Value(rapidjson::kObjectType), allocator);
+        }
+
+        // Apply this prefab's own components and properties on top
+        auto entityMember = prefabDoc.FindMember("Entity");
+        if (entityMember != prefabDoc.MemberEnd() && entityMember->value.IsObject())
+        {
+            mergeInto(resolved->document["Entity"], entityMember->value, allocator);
+        }
+
+        // Components the variant removed from its base
+        auto removedMember = prefabDoc.FindMember(RemovedComponentsKey);
+        if (removedMember != prefabDoc.MemberEnd() && removedMember->value.IsArray())
+        {
+            auto& entityData = resolved->document["Entity"];
+            for (const auto& removed : removedMember->value.GetArray())
+            {
+                if (removed.IsString())
+                {
+                    entityData.RemoveMember(removed.GetString());
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        // Invalidated while the files were read, hand the result out but do not cache what may be stale
+        if (s_generation != generation)
+        {
+            return resolved;
+        }
+
+        // Another worker may have flattened the same prefab meanwhile, share the copy already cached
+        auto entry = s_cache.try_emplace(handleKey, CacheEntry{ resolved, std::chrono::steady_clock::now() }).first;
+        return entry->second.prefab;
+    }
+}
@@ -0,0 +1,156 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      PrefabVariant.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- ResolvedPrefab holding the flattened effective data of a prefab or prefab variant
+- PrefabSources holding the asset manager lookups of a chain, so it can be resolved off the main thread
+- PrefabResolver class resolving base -> variant chains through a flattened cache
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "../Asset/AssetManager.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief Effective data of a prefab after its whole variant chain has been applied
+    */
+    struct ResolvedPrefab
+    {
+        uint64_t handle = 0;
+        std::vector<uint64_t> chain;    // This prefab first, then its base, up to the root prefab
+        std::string basePath;           // "BasePrefab" value of a variant, empty for a root prefab
+        std::vector<std::pair<std::string, std::filesystem::file_time_type>> sources; // Files the data was flattened from
+        rapidjson::Document document;   // {"Entity": {...}} with every ancestor merged in
+
+        /**
+         * @brief Checks if this prefab is, or is a variant of, the given prefab
+         * @param ancestor Handle of the possible ancestor
+         * @return true if the handle is anywhere in the chain
+        */
+        bool derivesFrom(uint64_t ancestor) const;
+
+        const rapidjson::Value& getEntityData() const { return document["Entity"]; }
+    };
+
+    /**
+     * @brief Source files and handles of the prefabs in a variant chain
+     *
+     * The asset manager is only safe to use on the main thread, so the lookups a resolve needs are
+     * gathered there and the files themselves are read and flattened on a worker.
+    */
+    struct PrefabSources
+    {
+        uint64_t handle = 0;                                    // Prefab being resolved
+        std::unordered_map<uint64_t, std::string> paths;        // Handle -> source file
+        std::unordered_map<std::string, uint64_t> handles;      // "BasePrefab" value -> handle
+
+        /**
+         * @brief Adds the asset manager lookups of a prefab, main thread only
+         * @param prefabHandle Handle of the prefab
+        */
+        void add(const AssetHandle& prefabHandle);
+
+        /**
+         * @brief Adds the asset manager lookups of a base prefab named by a variant, main thread only
+         * @param basePath "BasePrefab" value of the variant
+        */
+        void addBase(const std::string& basePath);
+    };
+
+    /**
+     * @brief Resolves prefab variant chains (base -> variant -> instance) through a flattened cache
+     *
+     * This class handles:
+     * 1. Loading a prefab and, for variants, the chain of base prefabs it derives from
+     * 2. Merging the chain into one flattened document, cached per prefab handle
+     * 3. Invalidating a prefab and every cached variant built on top of it
+     * 4. Detecting files changed on disk since they were flattened, at most once per StaleCheckInterval
+     *    per entry since saves from the editor invalidate explicitly
+     *
+     * A variant file names its base and only stores what it changes:
+     * { "BasePrefab": "../Asset/Prefabs/Tree.prefab", "Entity": { ... }, "RemovedComponents": [ ... ] }
+    */
+    class PrefabResolver
+    {
+    public:
+        static constexpr const char* BasePrefabKey = "BasePrefab";
+        static constexpr const char* RemovedComponentsKey = "RemovedComponents";
+
+        /**
+         * @brief Gets the flattened data of a prefab, resolving and caching its chain if needed
+         * @param handle Asset handle of the prefab or variant
+         * @return Flattened prefab, nullptr if any file in the chain could not be loaded
+        */
+        static std::shared_ptr<const ResolvedPrefab> resolve(const AssetHandle& handle);
+
+        /**
+         * @brief Gathers the lookups needed to resolve a prefab, main thread only
+         *
+         * Prefabs already flattened bring the sources of their whole chain, so a warm cache needs no
+         * second pass. Otherwise each base prefab is only discovered when its variant is read.
+         *
+         * @param handle Asset handle of the prefab or variant
+         * @return Lookups to pass to resolve(const PrefabSources&, std::string*)
+        */
+        static PrefabSources collectSources(const AssetHandle& handle);
+
+        /**
+         * @brief Resolves a prefab with pre-gathered lookups, safe to call on any thread
+         * @param sources Lookups gathered on the main thread
+         * @param missingBase Receives the "BasePrefab" value of a variant whose base is not in sources.
+         *        Add it on the main thread with PrefabSources::addBase and resolve again
+         * @return Flattened prefab, nullptr on failure or when a base is missing
+        */
+        static std::shared_ptr<const ResolvedPrefab> resolve(const PrefabSources& sources, std::string* missingBase);
+
+        /**
+         * @brief Drops the flattened data of a prefab and of every cached variant derived from it
+         * @param handle Asset handle of the changed prefab
+         * @return Number of cache entries dropped
+        */
+        static size_t invalidate(const AssetHandle& handle);
+
+        static void clear();
+
+        // Cached entries are checked against the files on disk at most this often
+        static constexpr std::chrono::milliseconds StaleCheckInterval{ 1000 };
+
+    private:
+        struct CacheEntry
+        {
+            std::shared_ptr<const ResolvedPrefab> prefab;
+            std::chrono::steady_clock::time_point checkedAt;
+        };
+
+        // Reads and flattens without holding s_mutex, which is only taken to look up and insert cache entries
+        static std::shared_ptr<const ResolvedPrefab> resolveChain(uint64_t handleKey, const PrefabSources& sources,
+            std::vector<uint64_t>& visiting, std::string* missingBase);
+        static std::shared_ptr<const ResolvedPrefab> findCachedLocked(uint64_t handleKey);
+        static bool isStale(const ResolvedPrefab& resolved);
+        static void mergeInto(rapidjson::Value& target, const rapidjson::Value& source, rapidjson::Document::AllocatorType& allocator);
+
+        static std::unordered_map<uint64_t, CacheEntry> s_cache;
+        static std::mutex s_mutex;
+        static uint64_t s_generation;   // Bumped by invalidate and clear, guarded by s_mutex
+    };
+}
@@ -0,0 +1,219 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      RenderBatching.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- InstanceBatchCache implementation
+- Incremental batch maintenance through registry signals
+- Batched submission and render counters
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "RenderBatching.hpp"
+
+#include <chrono>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaGraphics
+{
+    InstanceBatchCache::~InstanceBatchCache()
+    {
+        detach();
+    }
+
+    void InstanceBatchCache::attach(entt::registry& registry)
+    {
+        detach();
+        m_registry = &registry;
+
+        registry.on_construct<RenderProxy>().connect<&InstanceBatchCache::onProxyConstruct>(*this);
+        registry.on_update<RenderProxy>().connect<&InstanceBatchCache::onProxyUpdate>(*this);
+        registry.on_destroy<RenderProxy>().connect<&InstanceBatchCache::onProxyDestroy>(*this);
+
+        // Batch everything that was created before the cache was attached
+        auto view = registry.view<RenderProxy>();
+        for (auto entity : view)
+        {
+            const auto& proxy = view.get<RenderProxy>(entity);
+            if (proxy.visible)
+            {
+                addInstance(entity, proxy);
+            }
+        }
+    }
+
+    void InstanceBatchCache::detach()
+    {
+        if (m_registry)
+        {
+            m_registry->on_construct<RenderProxy>().disconnect<&InstanceBatchCache::onProxyConstruct>(*this);
+            m_registry->on_update<RenderProxy>().disconnect<&InstanceBatchCache::onProxyUpdate>(*this);
+            m_registry->on_destroy<RenderProxy>().disconnect<&InstanceBatchCache::onProxyDestroy>(*this);
+            m_registry = nullptr;
+        }
+
+        m_batches.clear();
+        m_batchLookup.clear();
+        m_slots.clear();
+        m_stats = {};
+    }
+
+    void InstanceBatchCache::onProxyConstruct(entt::registry& registry, entt::entity entity)
+    {
+        const auto& proxy = registry.get<RenderProxy>(entity);
+        if (proxy.visible)
+        {
+            addInstance(entity, proxy);
+        }
+    }
+
+    void InstanceBatchCache::onProxyUpdate(entt::registry& registry, entt::entity entity)
+    {
+        const auto& proxy = registry.get<RenderProxy>(entity);
+        auto slotIt = m_slots.find(entity);
+
+        // Hidden entities leave their batch, shown ones join one
+        if (!proxy.visible)
+        {
+            if (slotIt != m_slots.end())
+            {
+                removeInstance(entity);
+            }
+            return;
+        }
+        if (slotIt == m_slots.end())
+        {
+            addInstance(entity, proxy);
+            return;
+        }
+
+        InstanceBatch& batch = m_batches[slotIt->second.batch];
+        if (batch.meshKey == proxy.meshKey && batch.materialKey == proxy.materialKey)
+        {
+            // Same batch, only the transform moved
+            batch.transforms[slotIt->second.index] = proxy.worldMatrix;
+            batch.dirty = true;
+        }
+        else
+        {
+            // Mesh or material instance changed, move the instance to its new batch
+            removeInstance(entity);
+            addInstance(entity, proxy);
+        }
+    }
+
+    void InstanceBatchCache::onProxyDestroy(entt::registry&, entt::entity entity)
+    {
+        if (m_slots.find(entity) != m_slots.end())
+        {
+            removeInstance(entity);
+        }
+    }
+
+    uint32_t InstanceBatchCache::findOrCreateBatch(uint64_t meshKey, uint64_t materialKey)
+    {
+        BatchKey key{ meshKey, materialKey };
+        auto it = m_batchLookup.find(key);
+        if (it != m_batchLookup.end())
+        {
+            return it->second;
+        }
+
+        uint32_t batchIndex = static_cast<uint32_t>(m_batches.size());
+        InstanceBatch& batch = m_batches.emplace_back();
+        batch.meshKey = meshKey;
+        batch.materialKey = materialKey;
+        m_batchLookup.emplace(key, batchIndex);
+        return batchIndex;
+    }
+
+    void InstanceBatchCache::addInstance(entt::entity entity, const RenderProxy& proxy)
+    {
+        uint32_t batchIndex = findOrCreateBatch(proxy.meshKey, proxy.materialKey);
+        InstanceBatch& batch = m_batches[batchIndex];
+
+        m_slots[entity] = { batchIndex, static_cast<uint32_t>(batch.entities.size()) };
+        batch.transforms.push_back(proxy.worldMatrix);
+        batch.entities.push_back(entity);
+        batch.dirty = true;
+    }
+
+    void InstanceBatchCache::removeInstance(entt::entity entity)
+    {
+        auto slotIt = m_slots.find(entity);
+        BatchSlot slot = slotIt->second;
+        m_slots.erase(slotIt);
+
+        InstanceBatch& batch = m_batches[slot.batch];
+        const uint32_t lastIndex = static_cast<uint32_t>(batch.entities.size()) - 1;
+
+        // Swap the last instance into the hole so the arrays stay packed
+        if (slot.index != lastIndex)
+        {
+            entt::entity movedEntity = batch.entities[lastIndex];
+            batch.entities[slot.index] = movedEntity;
+            batch.transforms[slot.index] = batch.transforms[lastIndex];
+            m_slots[movedEntity].index = slot.index;
+        }
+
+        batch.entities.pop_back();
+        batch.transforms.pop_back();
+        batch.dirty = true;
+
+        if (batch.entities.empty())
+        {
+            eraseBatch(slot.batch);
+        }
+    }
+
+    void InstanceBatchCache::eraseBatch(uint32_t batchIndex)
+    {
+        m_batchLookup.erase(BatchKey{ m_batches[batchIndex].meshKey, m_batches[batchIndex].materialKey });
+
+        // Swap the last batch into the hole, its instances have to learn their new batch index
+        const uint32_t lastIndex = static_cast<uint32_t>(m_batches.size()) - 1;
+        if (batchIndex != lastIndex)
+        {
+            m_batches[batchIndex] = std::move(m_batches[lastIndex]);
+            InstanceBatch& moved = m_batches[batchIndex];
+            m_batchLookup[BatchKey{ moved.meshKey, moved.materialKey }] = batchIndex;
+            for (entt::entity movedEntity : moved.entities)
+            {
+                m_slots[movedEntity].batch = batchIndex;
+            }
+        }
+        m_batches.pop_back();
+    }
+
+    void InstanceBatchCache::submit(const std::function<void(InstanceBatch&)>& drawInstanced)
+    {
+        auto submitStart = std::chrono::high_resolution_clock::now();
+
+        RenderStats stats;
+        stats.batches = static_cast<uint32_t>(m_batches.size());
+
+        for (auto& batch : m_batches)
+        {
+            if (batch.dirty)
+            {
+                stats.dirtyBatches++;
+            }
+
+            // The callback uploads the instance buffer if the batch is dirty, then draws it
+            drawInstanced(batch);
+            batch.dirty = false;
+
+            stats.drawCalls++;
+            stats.instances += static_cast<uint32_t>(batch.entities.size());
+        }
+
+        auto submitEnd = std::chrono::high_resolution_clock::now();
+        stats.cpuSubmitMs = std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+        m_stats = stats;
+    }
+}
@@ -0,0 +1,141 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      RenderBatching.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- InstanceBatch definition (instances sharing one mesh and one material instance)
+- InstanceBatchCache class keeping persistent batches in sync with the registry
+- RenderStats counters for draw calls and CPU submit time
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include "../Graphics/RenderExtraction.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaGraphics
+{
+    /**
+     * @brief All instances drawn with the same mesh and the same material instance
+     *
+     * transforms and entities are parallel arrays, removal swaps the last instance
+     * into the freed slot so the transform array can be uploaded as one block.
+    */
+    struct InstanceBatch
+    {
+        uint64_t meshKey = 0;
+        uint64_t materialKey = 0;
+        std::vector<glm::mat4> transforms;    // Instance world matrices, uploaded as the instance buffer
+        std::vector<entt::entity> entities;   // Owner of each instance
+        bool dirty = true;                    // Instance buffer needs to be re-uploaded
+    };
+
+    /**
+     * @brief Per frame rendering counters
+    */
+    struct RenderStats
+    {
+        uint32_t drawCalls = 0;          // Instanced draw calls issued last frame
+        uint32_t instances = 0;          // Instances submitted last frame
+        uint32_t batches = 0;            // Live batches, a batch is erased with its last instance
+        uint32_t dirtyBatches = 0;       // Batches whose instance buffer changed last frame
+        double cpuSubmitMs = 0.0;        // CPU time spent submitting last frame
+    };
+
+    /**
+     * @brief Persistent instance batches keyed by mesh and material instance
+     *
+     * This class handles:
+     * 1. Listening to RenderProxy construction, updates and destruction on the registry
+     * 2. Moving an entity between batches when its mesh or material instance changes
+     * 3. Updating the instance transform in place when only the world matrix changes
+     * 4. Submitting one draw per batch and tracking the counters, batches are erased once empty
+     *
+     * Changes must go through registry.patch/replace on RenderProxy so the cache sees them.
+     * Material swaps done by Cmd::ChangeMaterialInstanceCommand reach the cache the same way,
+     * once the graphics system refreshes the proxy of the edited entity.
+    */
+    class InstanceBatchCache
+    {
+    public:
+        InstanceBatchCache() = default;
+        ~InstanceBatchCache();
+
+        InstanceBatchCache(const InstanceBatchCache&) = delete;
+        InstanceBatchCache& operator=(const InstanceBatchCache&) = delete;
+
+        /**
+         * @brief Connects the cache to a registry and batches every existing RenderProxy
+         * @param registry Registry to observe
+        */
+        void attach(entt::registry& registry);
+
+        /**
+         * @brief Disconnects from the registry and drops every batch
+        */
+        void detach();
+
+        /**
+         * @brief Issues one draw per batch and updates the counters
+         * @param drawInstanced Called once per batch with the batch to draw
+        */
+        void submit(const std::function<void(InstanceBatch&)>& drawInstanced);
+
+        const std::vector<InstanceBatch>& getBatches() const { return m_batches; }
+        const RenderStats& getStats() const { return m_stats; }
+
+    private:
+        struct BatchKey
+        {
+            uint64_t meshKey;
+            uint64_t materialKey;
+
+            bool operator==(const BatchKey& other) const
+            {
+                return meshKey == other.meshKey && materialKey == other.materialKey;
+            }
+        };
+
+        struct BatchKeyHash
+        {
+            size_t operator()(const BatchKey& key) const
+            {
+                return std::hash<uint64_t>{}(key.meshKey * 0x9E3779B97F4A7C15ull ^ key.materialKey);
+            }
+        };
+
+        // Location of an entity inside the batches
+        struct BatchSlot
+        {
+            uint32_t batch;
+            uint32_t index;
+        };
+
+        void onProxyConstruct(entt::registry& registry, entt::entity entity);
+        void onProxyUpdate(entt::registry& registry, entt::entity entity);
+        void onProxyDestroy(entt::registry& registry, entt::entity entity);
+
+        void addInstance(entt::entity entity, const RenderProxy& proxy);
+        void removeInstance(entt::entity entity);
+        uint32_t findOrCreateBatch(uint64_t meshKey, uint64_t materialKey);
+        void eraseBatch(uint32_t batchIndex);
+
+        entt::registry*                                             m_registry = nullptr;
+        std::vector<InstanceBatch>                                  m_batches;
+        std::unordered_map<BatchKey, uint32_t, BatchKeyHash>        m_batchLookup;
+        std::unordered_map<entt::entity, BatchSlot>                 m_slots;
+        RenderStats                                                 m_stats;
+    };
+}
@@ -0,0 +1,254 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      RenderExtraction.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Bounding box and frustum helpers
+- RenderExtractor implementation (parallel cull pass, merge and radix sort)
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "RenderExtraction.hpp"
+
+#include <chrono>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaGraphics
+{
+    AABB AABB::transform(const AABB& local, const glm::mat4& world)
+    {
+        // Arvo's method, start from the translation and grow by every matrix entry
+        AABB result;
+        result.min = glm::vec3(world[3]);
+        result.max = glm::vec3(world[3]);
+
+        for (int column = 0; column < 3; column++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                float a = world[column][row] * local.min[column];
+                float b = world[column][row] * local.max[column];
+                result.min[row] += std::min(a, b);
+                result.max[row] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+
+    Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection)
+    {
+        // Gribb/Hartmann plane extraction, glm is column major so rows are read across columns
+        const glm::mat4& m = viewProjection;
+        auto row = [&m](int r) { return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+
+        Frustum frustum;
+        frustum.planes[0] = row(3) + row(0); // Left
+        frustum.planes[1] = row(3) - row(0); // Right
+        frustum.planes[2] = row(3) + row(1); // Bottom
+        frustum.planes[3] = row(3) - row(1); // Top
+        frustum.planes[4] = row(3) + row(2); // Near
+        frustum.planes[5] = row(3) - row(2); // Far
+
+        for (auto& plane : frustum.planes)
+        {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f)
+            {
+                plane /= length;
+            }
+        }
+        return frustum;
+    }
+
+    bool Frustum::intersects(const AABB& box) const
+    {
+        for (const auto& plane : planes)
+        {
+            // Pick the corner furthest along the plane normal
+            glm::vec3 positive(
+                plane.x >= 0.0f ? box.max.x : box.min.x,
+                plane.y >= 0.0f ? box.max.y : box.min.y,
+                plane.z >= 0.0f ? box.max.z : box.min.z);
+
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RenderProxy::setWorldMatrix(const glm::mat4& world)
+    {
+        worldMatrix = world;
+        worldBounds = AABB::transform(localBounds, world);
+    }
+
+    uint64_t RenderExtractor::makeSortKey(uint64_t materialKey, uint64_t meshKey)
+    {
+        // Fold each 64 bit key into 32 bits so both fit, material decides the major order
+        uint64_t material = (materialKey ^ (materialKey >> 32)) & 0xFFFFFFFFull;
+        uint64_t mesh = (meshKey ^ (meshKey >> 32)) & 0xFFFFFFFFull;
+        return (material << 32) | mesh;
+    }
+
+    void RenderExtractor::radixSort(std::vector<RenderPacket>& packets, std::vector<RenderPacket>& scratch)
+    {
+        const size_t count = packets.size();
+        if (count < 2) return;
+
+        scratch.resize(count);
+        RenderPacket* source = packets.data();
+        RenderPacket* destination = scratch.data();
+
+        // 8 passes of 8 bits, least significant byte first
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256] = {};
+            for (size_t i = 0; i < count; i++)
+            {
+                histogram[(source[i].sortKey >> shift) & 0xFF]++;
+            }
+
+            // Every key shares this byte, the pass would not move anything
+            if (histogram[(source[0].sortKey >> shift) & 0xFF] == count)
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t& bucket : histogram)
+            {
+                size_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[histogram[(source[i].sortKey >> shift) & 0xFF]++] = source[i];
+            }
+            std::swap(source, destination);
+        }
+
+        // An odd number of executed passes leaves the result in the scratch buffer
+        if (source != packets.data())
+        {
+            std::copy(source, source + count, packets.data());
+        }
+    }
+
+    const std::vector<RenderPacket>& RenderExtractor::extract(entt::registry& registry, const Frustum& frustum,
+        uint32_t layerMask, btEngine::JobSystem* jobSystem)
+    {
+        using clock = std::chrono::high_resolution_clock;
+        auto extractStart = clock::now();
+
+        m_stats = {};
+        m_packets.clear();
+
+        // Walk the pool directly, the component and entity iterators of a storage share one order
+        // so each proxy is read in place instead of going through a sparse lookup
+        auto& storage = registry.storage<RenderProxy>();
+        const entt::sparse_set& entitySet = storage;
+        const uint32_t proxyCount = static_cast<uint32_t>(storage.size());
+        const auto proxies = storage.cbegin();
+        const auto entities = entitySet.begin();
+
+        // One packet buffer per thread that may run a chunk, reused across frames
+        const uint32_t threadCount = jobSystem ? jobSystem->getThreadCount() : 1;
+        if (m_threadPackets.size() < threadCount)
+        {
+            m_threadPackets.resize(threadCount);
+        }
+        for (auto& buffer : m_threadPackets)
+        {
+            buffer.clear();
+        }
+
+        // Proxies skipped before culling, one counter per chunk so threads never share one
+        const uint32_t chunkCount = btEngine::JobSystem::getGroupCount(proxyCount, m_chunkSize);
+        m_chunkHidden.assign(chunkCount, 0);
+
+        // Cull one chunk of the pool and append the survivors to the buffer of the running thread
+        auto extractChunk = [&](uint32_t chunkIndex, uint32_t threadIndex)
+        {
+            const uint32_t begin = chunkIndex * m_chunkSize;
+            const uint32_t end = std::min(begin + m_chunkSize, proxyCount);
+            auto& buffer = m_threadPackets[threadIndex];
+            uint32_t hidden = 0;
+
+            for (uint32_t i = begin; i < end; i++)
+            {
+                const RenderProxy& proxy = proxies[i];
+                if (!proxy.visible || (proxy.layerMask & layerMask) == 0)
+                {
+                    hidden++;
+                    continue;
+                }
+                if (!frustum.intersects(proxy.worldBounds)) continue;
+
+                RenderPacket packet;
+                packet.sortKey = makeSortKey(proxy.materialKey, proxy.meshKey);
+                packet.meshKey = proxy.meshKey;
+                packet.materialKey = proxy.materialKey;
+                packet.worldMatrix = &proxy.worldMatrix;
+                packet.entity = entities[i];
+                buffer.push_back(packet);
+            }
+            m_chunkHidden[chunkIndex] = hidden;
+        };
+
+        if (jobSystem && chunkCount > 1)
+        {
+            btEngine::JobHandle extraction = jobSystem->dispatch(chunkCount, 1, [&](btEngine::JobArgs args)
+            {
+                extractChunk(args.jobIndex, args.threadIndex);
+            });
+            jobSystem->wait(extraction);
+        }
+        else
+        {
+            for (uint32_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+            {
+                extractChunk(chunkIndex, 0);
+            }
+        }
+
+        auto sortStart = clock::now();
+
+        // Merge the per thread buffers into one list
+        size_t totalPackets = 0;
+        for (const auto& buffer : m_threadPackets)
+        {
+            totalPackets += buffer.size();
+        }
+        m_packets.reserve(totalPackets);
+        for (const auto& buffer : m_threadPackets)
+        {
+            m_packets.insert(m_packets.end(), buffer.begin(), buffer.end());
+        }
+
+        radixSort(m_packets, m_sortScratch);
+
+        auto sortEnd = clock::now();
+
+        m_stats.candidates = proxyCount;
+        m_stats.visible = static_cast<uint32_t>(m_packets.size());
+        for (uint32_t hidden : m_chunkHidden)
+        {
+            m_stats.hidden += hidden;
+        }
+        m_stats.culled = proxyCount - m_stats.visible - m_stats.hidden;
+        m_stats.chunks = chunkCount;
+        m_stats.extractMs = std::chrono::duration<double, std::milli>(sortStart - extractStart).count();
+        m_stats.sortMs = std::chrono::duration<double, std::milli>(sortEnd - sortStart).count();
+
+        return m_packets;
+    }
+}
@@ -0,0 +1,176 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      RenderExtraction.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- RenderProxy component caching the world matrix and world bounds of a renderable, stored in the chunk pool
+- Frustum and bounding box helpers used for culling
+- RenderExtractor class that builds the sorted render packet list from the registry
+  in parallel per-chunk passes
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include "../Core/JobSystem.hpp"
+#include "../Core/ComponentPool.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaGraphics
+{
+    /**
+     * @brief Axis aligned bounding box
+    */
+    struct AABB
+    {
+        glm::vec3 min{ 0.0f };
+        glm::vec3 max{ 0.0f };
+
+        /**
+         * @brief Transforms a local space box into a world space box that encloses it
+         * @param local Box in local space
+         * @param world World matrix of the owner
+         * @return Enclosing world space box
+        */
+        static AABB transform(const AABB& local, const glm::mat4& world);
+    };
+
+    /**
+     * @brief View frustum stored as six normalized planes (xyz = normal, w = distance)
+    */
+    struct Frustum
+    {
+        glm::vec4 planes[6];
+
+        /**
+         * @brief Extracts the frustum planes from a combined view projection matrix
+         * @param viewProjection Projection * view matrix of the camera
+         * @return Frustum of the camera
+        */
+        static Frustum fromViewProjection(const glm::mat4& viewProjection);
+
+        /**
+         * @brief Tests a world space box against the frustum
+         * @param box Box to test
+         * @return false only if the box is fully outside of one plane
+        */
+        bool intersects(const AABB& box) const;
+    };
+
+    /**
+     * @brief Per entity render data kept in sync by the graphics system
+     *
+     * The graphics system refreshes the proxy whenever the transform, mesh or material
+     * of an entity changes, so extraction only reads flat data and never touches the
+     * asset manager or the component reflection.
+    */
+    struct RenderProxy
+    {
+        uint64_t meshKey = 0;           // Mesh asset handle of the renderable
+        uint64_t materialKey = 0;       // Material instance UUID of the renderable
+        glm::mat4 worldMatrix{ 1.0f };  // Cached world matrix
+        AABB localBounds;               // Mesh bounds in local space
+        AABB worldBounds;               // Cached world space bounds
+        uint32_t layerMask = ~0u;       // Layers the renderable is drawn on
+        bool visible = true;            // Hidden renderables are skipped by extraction
+
+        /**
+         * @brief Updates the world matrix and refreshes the cached world bounds
+         * @param world New world matrix
+        */
+        void setWorldMatrix(const glm::mat4& world);
+    };
+
+    /**
+     * @brief Compact draw submission produced by extraction
+    */
+    struct RenderPacket
+    {
+        uint64_t sortKey = 0;                       // Material in the high bits, mesh in the low bits
+        uint64_t meshKey = 0;
+        uint64_t materialKey = 0;
+        const glm::mat4* worldMatrix = nullptr;     // Points into the RenderProxy pool, valid until the registry changes
+        entt::entity entity = entt::null;
+    };
+
+    /**
+     * @brief Statistics of the last extraction
+    */
+    struct ExtractionStats
+    {
+        uint32_t candidates = 0;     // Proxies considered
+        uint32_t visible = 0;        // Packets produced
+        uint32_t hidden = 0;         // Proxies skipped as hidden or outside the layer mask
+        uint32_t culled = 0;         // Proxies rejected by the frustum test
+        uint32_t chunks = 0;         // Chunks the pool was split into
+        double extractMs = 0.0;      // Time spent in the parallel cull pass
+        double sortMs = 0.0;         // Time spent merging and sorting
+    };
+
+    /**
+     * @brief Builds the per frame draw list from the registry
+     *
+     * This class handles:
+     * 1. Splitting the RenderProxy pool into chunks processed on the job system
+     * 2. Frustum culling against the cached world bounds
+     * 3. Writing render packets into per thread buffers
+     * 4. Merging the buffers and radix sorting them by material and mesh key
+     *
+     * It does not depend on any graphics API so it can be run headless.
+    */
+    class RenderExtractor
+    {
+    public:
+        /**
+         * @brief Extracts, culls and sorts the render packets of a registry
+         * @param registry Registry holding RenderProxy components
+         * @param frustum Camera frustum to cull against
+         * @param layerMask Layers that are drawn by the camera
+         * @param jobSystem Job system to run the chunks on, nullptr runs everything on the calling thread
+         * @return Sorted packets, valid until the next call
+        */
+        const std::vector<RenderPacket>& extract(entt::registry& registry, const Frustum& frustum,
+            uint32_t layerMask = ~0u, btEngine::JobSystem* jobSystem = nullptr);
+
+        const std::vector<RenderPacket>& getPackets() const { return m_packets; }
+        const ExtractionStats& getStats() const { return m_stats; }
+
+        // Number of proxies handed to a single job
+        void setChunkSize(uint32_t chunkSize) { m_chunkSize = chunkSize > 0 ? chunkSize : 1; }
+
+        /**
+         * @brief Builds the sort key of a packet, material first so state changes are minimized
+         * @param materialKey Material instance UUID
+         * @param meshKey Mesh asset handle
+         * @return 64 bit sort key
+        */
+        static uint64_t makeSortKey(uint64_t materialKey, uint64_t meshKey);
+
+        /**
+         * @brief Stable LSD radix sort of packets by sortKey
+         * @param packets Packets to sort
+         * @param scratch Scratch buffer, resized as needed
+        */
+        static void radixSort(std::vector<RenderPacket>& packets, std::vector<RenderPacket>& scratch);
+
+    private:
+        std::vector<std::vector<RenderPacket>>  m_threadPackets;    // One buffer per job system thread
+        std::vector<RenderPacket>               m_packets;          // Merged and sorted output
+        std::vector<RenderPacket>               m_sortScratch;      // Scratch for the radix sort
+        std::vector<uint32_t>                   m_chunkHidden;      // Hidden proxies counted by each chunk
+        ExtractionStats                         m_stats;
+        uint32_t                                m_chunkSize = 1024;
+    };
+}
+
+// Extraction and batching walk every proxy each frame, keep their pages in the 2 MiB arenas
+TEA_POOLED_COMPONENT(TeaGraphics::RenderProxy)
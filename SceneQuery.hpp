@@ -0,0 +1,162 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SceneQuery.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- CachedQuery class keeping a persistent entity list for a component combination
+- SceneQueryCache class owning the persistent groups and queries of a registry
+- Scene membership check for registries shared by several scenes
+- View / group / cached query iteration benchmark
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "../Components/ComponentManager.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace SceneManager
+{
+    /**
+     * @brief Persistent list of the entities that have every component in Components
+     *
+     * This class handles:
+     * 1. Keeping the matching entities packed in a non-owning group, so no pool is reordered
+     *    and any system can still own these components in a group of its own
+     * 2. Iterating the cached entities without probing the candidate pools, through the
+     *    storages the group holds instead of a registry lookup per component
+     *
+     * The group's signal connections belong to the registry, so a query can be destroyed at
+     * any time without leaving a connection behind, and dies with the registry otherwise.
+    */
+    template<typename... Components>
+    class CachedQuery
+    {
+    public:
+        using Group = decltype(std::declval<entt::registry&>().group<>(entt::get<Components...>));
+
+        explicit CachedQuery(entt::registry& registry) : m_group(registry.group<>(entt::get<Components...>))
+        {
+        }
+
+        size_t size() const { return m_group.size(); }
+        bool contains(entt::entity entity) const { return m_group.contains(entity); }
+
+        /**
+         * @brief Calls func(entity, Components&...) for every cached entity
+         * @param func Function to call
+        */
+        template<typename Func>
+        void each(Func&& func)
+        {
+            m_group.each(std::forward<Func>(func));
+        }
+
+    private:
+        Group m_group;
+    };
+
+    // Registered name of the component, and of its property, recording the scene an entity belongs to
+    constexpr const char* SceneIDComponentName = "Scene ID";
+
+    /**
+     * @brief Checks the scene an entity belongs to, every loaded scene shares one registry
+     * @param registry Registry of the entity
+     * @param entity Entity to check
+     * @param sceneID Scene to compare against
+     * @return true if the entity's Scene ID is sceneID, false for entities without one
+    */
+    bool isInScene(entt::registry& registry, entt::entity entity, uint64_t sceneID);
+
+    /**
+     * @brief Timings of one entity count in SceneQueryCache::benchmark
+    */
+    struct QueryBenchmarkResult
+    {
+        size_t entityCount = 0;     // Entities in the registry
+        size_t matchCount = 0;      // Entities matching the query
+        double viewNs = 0.0;        // Nanoseconds per matching entity, entt::view
+        double groupNs = 0.0;       // Nanoseconds per matching entity, owning entt::group
+        double cachedNs = 0.0;      // Nanoseconds per matching entity, CachedQuery (non-owning group)
+    };
+
+    /**
+     * @brief Persistent groups and queries for the hot component combinations of a registry
+     *
+     * This class handles:
+     * 1. Living in the registry context so every system shares the same instance
+     * 2. A non-owning group for the hottest combination (prefab instances), which leaves the
+     *    OverrideComponent pool free for an owning group elsewhere and its order untouched
+     * 3. Lazily creating CachedQuery objects for any other combination
+     *
+     * Systems call SceneQueryCache::get(registry) instead of building a view every call.
+    */
+    class SceneQueryCache
+    {
+    public:
+        using PrefabInstanceGroup = decltype(std::declval<entt::registry&>().group<>(
+            entt::get<TeaComponents::OverrideComponent, TeaComponents::UUIDComponent>));
+
+        explicit SceneQueryCache(entt::registry& registry);
+
+        SceneQueryCache(const SceneQueryCache&) = delete;
+        SceneQueryCache& operator=(const SceneQueryCache&) = delete;
+
+        /**
+         * @brief Gets the cache of a registry, creating it in the registry context on first use
+         * @param registry Registry to get the cache of
+         * @return Cache of the registry
+        */
+        static SceneQueryCache& get(entt::registry& registry);
+
+        /**
+         * @brief Every entity with an OverrideComponent and a UUIDComponent (prefab instances)
+         * @return Non-owning group of the prefab instances
+        */
+        PrefabInstanceGroup& prefabInstances() { return m_prefabInstances; }
+
+        /**
+         * @brief Gets the persistent query for a component combination, creating it on first use
+         * @return Cached query of the combination
+        */
+        template<typename... Components>
+        CachedQuery<Components...>& query()
+        {
+            const entt::id_type key = entt::type_hash<CachedQuery<Components...>>::value();
+            auto it = m_queries.find(key);
+            if (it == m_queries.end())
+            {
+                it = m_queries.emplace(key, std::make_shared<CachedQuery<Components...>>(m_registry)).first;
+            }
+            return *static_cast<CachedQuery<Components...>*>(it->second.get());
+        }
+
+        /**
+         * @brief Compares view, owning group and cached query iteration on synthetic registries
+         *
+         * Every entity has a position, half of them a velocity and a third a tag that the query
+         * ignores, so the view has to skip non matching candidates like it does in real scenes.
+         *
+         * @param entityCounts Entity counts to measure
+         * @param iterations Number of passes averaged per measurement
+         * @return One result per entity count
+        */
+        static std::vector<QueryBenchmarkResult> benchmark(const std::vector<size_t>& entityCounts, int iterations = 20);
+
+    private:
+        entt::registry&                                         m_registry;
+        PrefabInstanceGroup                                     m_prefabInstances;
+        std::unordered_map<entt::id_type, std::shared_ptr<void>> m_queries;
+    };
+}
@@ -0,0 +1,188 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SceneTeardown.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SceneTeardown hook registration
+- Whole registry and per scene bulk removal
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "SceneTeardown.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace SceneManager
+{
+    std::vector<SceneTeardown::Hook>    SceneTeardown::s_hooks;
+    std::mutex                          SceneTeardown::s_mutex;
+
+    namespace
+    {
+        double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    void SceneTeardown::registerReleaseHook(const std::string& name, int order, ReleaseHook hook)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_hooks.erase(std::remove_if(s_hooks.begin(), s_hooks.end(),
+            [&name](const Hook& existing) { return existing.name == name && existing.release; }), s_hooks.end());
+
+        Hook entry;
+        entry.name = name;
+        entry.order = order;
+        entry.release = std::move(hook);
+
+        // Keep the list sorted, hooks with the same order run in registration order
+        auto it = std::upper_bound(s_hooks.begin(), s_hooks.end(), order,
+            [](int value, const Hook& existing) { return value < existing.order; });
+        s_hooks.insert(it, std::move(entry));
+    }
+
+    void SceneTeardown::registerResetListener(const std::string& name, ResetListener listener)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_hooks.erase(std::remove_if(s_hooks.begin(), s_hooks.end(),
+            [&name](const Hook& existing) { return existing.name == name && existing.reset; }), s_hooks.end());
+
+        Hook entry;
+        entry.name = name;
+        entry.reset = std::move(listener);
+        s_hooks.push_back(std::move(entry));
+    }
+
+    void SceneTeardown::unregister(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_hooks.erase(std::remove_if(s_hooks.begin(), s_hooks.end(),
+            [&name](const Hook& existing) { return existing.name == name; }), s_hooks.end());
+    }
+
+    void SceneTeardown::clearHooks()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_hooks.clear();
+    }
+
+    void SceneTeardown::runReleaseHooks(const TeardownBatch& batch)
+    {
+        // Copied so a hook may register or unregister without deadlocking
+        std::vector<Hook> hooks;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            hooks = s_hooks;
+        }
+
+        for (const Hook& hook : hooks)
+        {
+            if (hook.release)
+            {
+                hook.release(batch);
+            }
+        }
+    }
+
+    TeardownStats SceneTeardown::clearAll(entt::registry& registry)
+    {
+        TeardownStats stats;
+
+        std::vector<entt::entity> entities;
+        auto& entityStorage = registry.storage<entt::entity>();
+        entities.reserve(entityStorage.size());
+        for (auto [entity] : entityStorage.each())
+        {
+            entities.push_back(entity);
+        }
+        stats.entityCount = entities.size();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        runReleaseHooks({ registry, entities.data(), entities.size(), true });
+        stats.releaseMs = elapsedMs(start);
+
+        // Storages are cleared in place so the registry's groups, context (SceneQueryCache) and
+        // signal connections (InstanceBatchCache) survive. A pool only publishes its destruction
+        // signal when something listens to it, the others drop their entities in one go
+        start = std::chrono::high_resolution_clock::now();
+        registry.clear();
+        stats.clearMs = elapsedMs(start);
+
+        std::vector<Hook> hooks;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            hooks = s_hooks;
+        }
+        for (const Hook& hook : hooks)
+        {
+            if (hook.reset)
+            {
+                hook.reset(registry);
+            }
+        }
+
+        TEA_INFO("Cleared {0} entities: release {1:.2f} ms, pools {2:.2f} ms", stats.entityCount, stats.releaseMs, stats.clearMs);
+        return stats;
+    }
+
+    TeardownStats SceneTeardown::clearEntities(entt::registry& registry, std::vector<entt::entity> entities)
+    {
+        TeardownStats stats;
+
+        entities.erase(std::remove_if(entities.begin(), entities.end(),
+            [&registry](entt::entity entity) { return !registry.valid(entity); }), entities.end());
+        std::sort(entities.begin(), entities.end());
+        entities.erase(std::unique(entities.begin(), entities.end()), entities.end());
+        stats.entityCount = entities.size();
+        if (entities.empty()) return stats;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        runReleaseHooks({ registry, entities.data(), entities.size(), false });
+        stats.releaseMs = elapsedMs(start);
+
+        // Pools smaller than the batch are walked instead of the batch, so the sparse lookups
+        // are bounded by whichever side is smaller and empty pools cost nothing
+        start = std::chrono::high_resolution_clock::now();
+        entt::sparse_set batch;
+        batch.push(entities.begin(), entities.end());
+
+        const entt::id_type entityStorageID = entt::type_hash<entt::entity>::value();
+        std::vector<entt::entity> matches;
+        for (auto [id, storage] : registry.storage())
+        {
+            if (id == entityStorageID || storage.empty()) continue;
+
+            if (storage.size() < entities.size())
+            {
+                matches.clear();
+                for (entt::entity entity : storage)
+                {
+                    if (batch.contains(entity))
+                    {
+                        matches.push_back(entity);
+                    }
+                }
+                storage.remove(matches.begin(), matches.end());
+            }
+            else
+            {
+                storage.remove(entities.begin(), entities.end());
+            }
+        }
+
+        // Every component is gone, releasing the identifiers only runs the entity listeners
+        registry.destroy(entities.begin(), entities.end());
+        stats.clearMs = elapsedMs(start);
+
+        TEA_INFO("Removed {0} entities: release {1:.2f} ms, pools {2:.2f} ms", stats.entityCount, stats.releaseMs, stats.clearMs);
+        return stats;
+    }
+}
@@ -0,0 +1,119 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SceneTeardown.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- TeardownBatch describing the entities being released
+- SceneTeardown class releasing subsystem resources in batches and clearing pools wholesale
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+/*                                                             function declarations
+====================================================================================*/
+namespace SceneManager
+{
+    /**
+     * @brief Entities a release hook has to free the resources of
+    */
+    struct TeardownBatch
+    {
+        entt::registry& registry;
+        const entt::entity* entities;   // Every entity being removed
+        size_t count;
+        bool wholeRegistry;             // True when every entity of the registry goes, hooks may drop everything at once
+    };
+
+    struct TeardownStats
+    {
+        size_t entityCount = 0;
+        double releaseMs = 0.0;         // Time spent in the release hooks
+        double clearMs = 0.0;           // Time spent clearing the pools
+    };
+
+    /**
+     * @brief Bulk removal of a whole registry or of one scene's entities
+     *
+     * This class handles:
+     * 1. Calling each subsystem's release hook once with every entity going away, so physics
+     *    bodies, audio voices and script instances are released in one call per subsystem
+     * 2. Clearing the component pools in place, so groups, context data and signal connections
+     *    (SceneQueryCache, InstanceBatchCache) stay valid. Only pools something listens to
+     *    publish a destruction signal per entity
+     * 3. Removing one scene's entities pool by pool, walking whichever of the pool and the batch
+     *    is smaller
+     * 4. Telling registry bound systems (context data) to set themselves up again
+     *
+     * Hooks run before any component is removed, in ascending order. Destruction signal handlers
+     * still run for the pools they listen to, so they must accept entities whose resources a hook
+     * already released.
+    */
+    class SceneTeardown
+    {
+    public:
+        using ReleaseHook = std::function<void(const TeardownBatch& batch)>;
+        using ResetListener = std::function<void(entt::registry& registry)>;
+
+        /**
+         * @brief Registers a subsystem's batch release, replacing any hook with the same name
+         * @param name Subsystem name
+         * @param order Hooks run from the lowest order up, e.g. scripts before the physics they use
+         * @param hook Releases the resources of the batch's entities
+        */
+        static void registerReleaseHook(const std::string& name, int order, ReleaseHook hook);
+
+        /**
+         * @brief Registers a callback run after clearAll emptied a registry
+         * @param name Listener name, replaces any listener with the same name
+         * @param listener Resets context data of the registry, signal connections are kept
+        */
+        static void registerResetListener(const std::string& name, ResetListener listener);
+
+        static void unregister(const std::string& name);
+        static void clearHooks();
+
+        /**
+         * @brief Removes every entity of a registry
+         *
+         * Hooks run once with every entity, then every pool is cleared in place. Pools without
+         * listeners drop their entities without a signal per entity. Reset listeners run last.
+         *
+         * @param registry Registry to clear
+         * @return Entity count and timings
+        */
+        static TeardownStats clearAll(entt::registry& registry);
+
+        /**
+         * @brief Removes a set of entities, e.g. every entity of one scene in a shared registry
+         * @param registry Registry owning the entities
+         * @param entities Entities to remove, invalid ones are skipped
+         * @return Entity count and timings
+        */
+        static TeardownStats clearEntities(entt::registry& registry, std::vector<entt::entity> entities);
+
+    private:
+        struct Hook
+        {
+            std::string name;
+            int order = 0;
+            ReleaseHook release;
+            ResetListener reset;
+        };
+
+        static void runReleaseHooks(const TeardownBatch& batch);
+
+        static std::vector<Hook>    s_hooks;        // Sorted by order
+        static std::mutex           s_mutex;
+    };
+}
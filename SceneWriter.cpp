@@ -0,0 +1,457 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SceneWriter.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Per scene snapshot of every component property
+- SAX writer turning rttr values into scene file JSON
+- Background scene save with status bar progress and usage index update
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "SceneWriter.hpp"
+#include "OfflinePrefabPropagation.hpp"
+#include "PrefabUsageIndex.hpp"
+#include "SchemaMigration.hpp"
+#include "../Core/SceneQuery.hpp"
+#include "../Core/BlockCompression.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAsset
+{
+    std::atomic<uint32_t> SceneWriter::s_pendingSaves{ 0 };
+    std::atomic<uint64_t> SceneWriter::s_nextGeneration{ 1 };
+    std::unordered_map<std::string, uint64_t> SceneWriter::s_writtenGenerations;
+    std::multiset<uint64_t> SceneWriter::s_inFlightGenerations;
+    std::mutex SceneWriter::s_writeMutex;
+
+    namespace
+    {
+        double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        template<typename Writer>
+        bool writeString(Writer& writer, const std::string& text)
+        {
+            return writer.String(text.c_str(), static_cast<rapidjson::SizeType>(text.size()));
+        }
+
+        template<typename Writer>
+        bool writeArithmetic(Writer& writer, const rttr::type& type, const rttr::variant& value)
+        {
+            if (type == rttr::type::get<bool>()) return writer.Bool(value.to_bool());
+            if (type == rttr::type::get<float>() || type == rttr::type::get<double>())
+            {
+                // JSON has no NaN or infinity, a broken value must not fail the whole save
+                const double number = value.to_double();
+                return writer.Double(std::isfinite(number) ? number : 0.0);
+            }
+            if (type == rttr::type::get<int64_t>()) return writer.Int64(value.to_int64());
+            if (type == rttr::type::get<uint64_t>()) return writer.Uint64(value.to_uint64());
+            if (type == rttr::type::get<uint8_t>() || type == rttr::type::get<uint16_t>() || type == rttr::type::get<uint32_t>())
+            {
+                return writer.Uint(value.to_uint32());
+            }
+            return writer.Int(value.to_int32());
+        }
+
+        // Same layout Serialize::deserializeEachProperty reads: classes as objects of their
+        // properties, enums by name, maps as arrays of { "key", "value" }
+        template<typename Writer>
+        bool writeValue(Writer& writer, const rttr::variant& input)
+        {
+            if (!input.is_valid()) return writer.Null();
+
+            const rttr::variant value = input.get_type().is_wrapper() ? input.extract_wrapped_value() : input;
+            const rttr::type type = value.get_type();
+
+            if (type.is_arithmetic()) return writeArithmetic(writer, type, value);
+            if (type.is_enumeration())
+            {
+                bool converted = false;
+                std::string name = value.to_string(&converted);
+                return converted && !name.empty() ? writeString(writer, name) : writer.Uint64(value.to_uint64());
+            }
+            if (type == rttr::type::get<std::string>()) return writeString(writer, value.get_value<std::string>());
+            if (type.is_pointer()) return writer.Null();
+
+            if (value.is_sequential_container())
+            {
+                writer.StartArray();
+                for (const auto& item : value.create_sequential_view())
+                {
+                    if (!writeValue(writer, item)) return false;
+                }
+                return writer.EndArray();
+            }
+
+            if (value.is_associative_container())
+            {
+                auto view = value.create_associative_view();
+                writer.StartArray();
+                for (const auto& [key, item] : view)
+                {
+                    if (view.is_key_only_type())
+                    {
+                        if (!writeValue(writer, key)) return false;
+                        continue;
+                    }
+
+                    writer.StartObject();
+                    writer.Key("key");
+                    if (!writeValue(writer, key)) return false;
+                    writer.Key("value");
+                    if (!writeValue(writer, item)) return false;
+                    writer.EndObject();
+                }
+                return writer.EndArray();
+            }
+
+            // Handles and other wrappers without properties convert to a number or a string
+            auto properties = type.get_properties();
+            if (properties.empty())
+            {
+                if (value.can_convert<uint64_t>()) return writer.Uint64(value.to_uint64());
+
+                bool converted = false;
+                std::string text = value.to_string(&converted);
+                return converted ? writeString(writer, text) : writer.Null();
+            }
+
+            rttr::instance object = value;
+            writer.StartObject();
+            for (auto& prop : properties)
+            {
+                std::string propName = prop.get_name().to_string();
+                writer.Key(propName.c_str(), static_cast<rapidjson::SizeType>(propName.size()));
+                if (!writeValue(writer, prop.get_value(object))) return false;
+            }
+            return writer.EndObject();
+        }
+
+        // { "scene": path, "overrides": [ { "entity", "component", "property", "value" } ] }, read back by SubSceneInstancing::restoreInstances
+        template<typename Writer>
+        bool writeSubSceneInstance(Writer& writer, const TeaComponents::SubSceneInstanceComponent& instance)
+        {
+            bool written = true;
+            writer.Key(SceneFileSchema::SubSceneInstanceKey);
+            writer.StartObject();
+            writer.Key(SceneFileSchema::SubScenePath);
+            writeString(writer, instance.scenePath);
+            writer.Key(SceneFileSchema::SubSceneOverrides);
+            writer.StartArray();
+            for (const auto& entry : instance.overrides)
+            {
+                writer.StartObject();
+                writer.Key(SceneFileSchema::SubSceneEntityIndex);   writer.Uint(entry.entityIndex);
+                writer.Key(SceneFileSchema::SubSceneComponent);     writeString(writer, entry.typeName);
+                writer.Key(SceneFileSchema::SubSceneProperty);      writeString(writer, entry.propName);
+                writer.Key(SceneFileSchema::SubSceneValue);
+                written = written && writeValue(writer, entry.value);
+                writer.EndObject();
+            }
+            writer.EndArray();
+            return writer.EndObject() && written;
+        }
+
+        template<typename Writer>
+        bool writeEntities(Writer& writer, const SceneSnapshot& snapshot, SceneSaveProgress* progress)
+        {
+            bool written = writer.StartObject() && writer.Key(SceneFileSchema::EntitiesKey) && writer.StartArray();
+            auto subScene = snapshot.subSceneInstances.begin();
+            for (size_t i = 0; written && i < snapshot.entities.size(); i++)
+            {
+                const SceneSnapshot::EntityRecord& entity = snapshot.entities[i];
+                writer.StartObject();
+                for (uint32_t c = entity.firstComponent; c < entity.firstComponent + entity.componentCount; c++)
+                {
+                    const SceneSnapshot::ComponentRecord& component = snapshot.components[c];
+                    const SceneSnapshot::ComponentLayout& layout = snapshot.layouts[component.layout];
+                    writer.Key(layout.typeName.c_str(), static_cast<rapidjson::SizeType>(layout.typeName.size()));
+                    writer.StartObject();
+                    for (size_t p = 0; p < layout.propNames.size(); p++)
+                    {
+                        const std::string& propName = layout.propNames[p];
+                        writer.Key(propName.c_str(), static_cast<rapidjson::SizeType>(propName.size()));
+                        written = written && writeValue(writer, snapshot.values[component.firstValue + p]);
+                    }
+                    writer.EndObject();
+                }
+                if (subScene != snapshot.subSceneInstances.end() && subScene->first == i)
+                {
+                    written = writeSubSceneInstance(writer, subScene->second) && written;
+                    ++subScene;
+                }
+                writer.EndObject();
+
+                if (progress) progress->entitiesWritten.store(static_cast<uint32_t>(i + 1), std::memory_order_relaxed);
+            }
+            if (!written || !writer.EndArray()) return false;
+
+            SchemaMigration::writeVersions(writer);
+            return writer.EndObject();
+        }
+    }
+
+    SceneSnapshot SceneWriter::takeSnapshot(entt::registry& registry, uint64_t sceneID)
+    {
+        SceneSnapshot snapshot;
+        const std::vector<rttr::type> componentTypes = TeaComponents::ComponentManager::getAllComponentTypes();
+
+        // Property names are stored once per type, the records only hold values
+        std::vector<std::vector<rttr::property>> properties;
+        properties.reserve(componentTypes.size());
+        snapshot.layouts.reserve(componentTypes.size());
+        for (const auto& componentType : componentTypes)
+        {
+            SceneSnapshot::ComponentLayout& layout = snapshot.layouts.emplace_back();
+            layout.typeName = componentType.get_name().to_string();
+
+            std::vector<rttr::property>& typeProperties = properties.emplace_back();
+            for (auto& prop : componentType.get_properties())
+            {
+                layout.propNames.push_back(prop.get_name().to_string());
+                typeProperties.push_back(prop);
+            }
+        }
+
+        for (auto [entityHandle] : registry.storage<entt::entity>().each())
+        {
+            // Every loaded scene shares the registry, only this scene's entities go in its file
+            if (!SceneManager::isInScene(registry, entityHandle, sceneID)) continue;
+
+            btEngine::Entity entity(entityHandle, &registry);
+            SceneSnapshot::EntityRecord& record = snapshot.entities.emplace_back();
+            record.firstComponent = static_cast<uint32_t>(snapshot.components.size());
+
+            for (uint32_t layoutIndex = 0; layoutIndex < snapshot.layouts.size(); layoutIndex++)
+            {
+                const std::string& typeName = snapshot.layouts[layoutIndex].typeName;
+                if (!entity.hasComponent(typeName)) continue;
+
+                rttr::variant componentVar = entity.getComponent(typeName);
+                if (!componentVar.is_valid()) continue;
+
+                // get_value copies, nothing in the snapshot points back into the registry
+                rttr::instance component = componentVar;
+                snapshot.components.push_back({ layoutIndex, static_cast<uint32_t>(snapshot.values.size()) });
+                for (const auto& prop : properties[layoutIndex])
+                {
+                    snapshot.values.push_back(prop.get_value(component));
+                }
+                record.componentCount++;
+            }
+
+            if (const auto* subSceneInstance = registry.try_get<TeaComponents::SubSceneInstanceComponent>(entityHandle))
+            {
+                snapshot.subSceneInstances.emplace_back(static_cast<uint32_t>(snapshot.entities.size() - 1), *subSceneInstance);
+            }
+        }
+
+        auto& prefabGroup = SceneManager::SceneQueryCache::get(registry).prefabInstances();
+        for (auto entityHandle : prefabGroup)
+        {
+            if (!SceneManager::isInScene(registry, entityHandle, sceneID)) continue;
+
+            const auto& overrideComp = prefabGroup.get<TeaComponents::OverrideComponent>(entityHandle);
+            btEngine::Entity entity(entityHandle, &registry);
+            snapshot.prefabInstances.emplace_back(static_cast<uint64_t>(overrideComp.masterPrefabHandle), static_cast<uint64_t>(entity.getUUID()));
+        }
+        return snapshot;
+    }
+
+    void SceneWriter::pruneWrittenGenerations()
+    {
+        // An entry only has to outlive the older snapshots of its file still being written,
+        // so files saved once and never again do not stay in the map. Called with s_writeMutex held
+        const uint64_t oldestInFlight = s_inFlightGenerations.empty() ? UINT64_MAX : *s_inFlightGenerations.begin();
+        for (auto it = s_writtenGenerations.begin(); it != s_writtenGenerations.end();)
+        {
+            it = it->second < oldestInFlight ? s_writtenGenerations.erase(it) : std::next(it);
+        }
+    }
+
+    SceneSaveResult SceneWriter::writeSnapshot(const SceneSnapshot& snapshot, const std::filesystem::path& scenePath,
+        SceneSaveProgress* progress)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        SceneSaveResult result;
+        result.entityCount = snapshot.entities.size();
+
+        std::error_code fsError;
+        const std::string key = std::filesystem::weakly_canonical(scenePath, fsError).generic_string();
+        auto isSuperseded = [&key, &snapshot]()
+        {
+            auto it = s_writtenGenerations.find(key);
+            return snapshot.generation != 0 && it != s_writtenGenerations.end() && it->second > snapshot.generation;
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(s_writeMutex);
+            if (isSuperseded())
+            {
+                result.superseded = true;
+                return result;
+            }
+        }
+
+        // Each save streams into its own temporary file, only the swap is serialized
+        std::filesystem::path tempPath = scenePath;
+        tempPath += ".tmp" + std::to_string(snapshot.generation);
+
+        std::FILE* file = std::fopen(tempPath.string().c_str(), "wb");
+        if (!file)
+        {
+            result.error = "Failed to create temporary scene file";
+            return result;
+        }
+
+        bool written = false;
+        if (btEngine::BlockCompression::getCompressSaves())
+        {
+            // Blocks are compressed as the writer fills them, the whole text is never held either
+            btEngine::BlockCompressedWriter stream(file);
+            rapidjson::PrettyWriter<btEngine::BlockCompressedWriter> writer(stream);
+            written = writeEntities(writer, snapshot, progress);
+            written = stream.finish() && written;
+        }
+        else
+        {
+            std::vector<char> buffer(WriteBufferSize);
+            rapidjson::FileWriteStream stream(file, buffer.data(), buffer.size());
+            rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(stream);
+            written = writeEntities(writer, snapshot, progress);
+            stream.Flush();
+        }
+
+        written = written && std::ferror(file) == 0;
+        written = (std::fclose(file) == 0) && written;
+
+        if (!written)
+        {
+            result.error = "Failed to write temporary scene file";
+            std::filesystem::remove(tempPath, fsError);
+            return result;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_writeMutex);
+            if (isSuperseded())
+            {
+                result.superseded = true;
+                std::filesystem::remove(tempPath, fsError);
+                return result;
+            }
+
+            std::filesystem::rename(tempPath, scenePath, fsError);
+            if (fsError)
+            {
+                result.error = "Failed to replace scene file: " + fsError.message();
+                std::filesystem::remove(tempPath, fsError);
+                return result;
+            }
+            if (snapshot.generation != 0)
+            {
+                s_writtenGenerations[key] = snapshot.generation;
+            }
+        }
+
+        result.bytesWritten = std::filesystem::file_size(scenePath, fsError);
+        result.writeMs = elapsedMs(start);
+        result.success = true;
+        return result;
+    }
+
+    btEngine::Task<SceneSaveResult> SceneWriter::saveAsync(entt::registry& registry, uint64_t sceneID, std::filesystem::path scenePath,
+        btEngine::MainLoopTaskQueue* taskQueue)
+    {
+        // Tasks are lazy, the registry is only read once the caller starts this one.
+        // A scene the editor saves is open in it, offline passes must not rewrite the file
+        OfflinePrefabPropagation::setSceneOpen(scenePath, true);
+        auto start = std::chrono::high_resolution_clock::now();
+        auto snapshot = std::make_shared<SceneSnapshot>(takeSnapshot(registry, sceneID));
+        snapshot->generation = s_nextGeneration.fetch_add(1, std::memory_order_relaxed);
+        const double snapshotMs = elapsedMs(start);
+        {
+            std::lock_guard<std::mutex> lock(s_writeMutex);
+            s_inFlightGenerations.insert(snapshot->generation);
+        }
+
+        auto progress = std::make_shared<SceneSaveProgress>();
+        progress->entityCount = static_cast<uint32_t>(snapshot->entities.size());
+        s_pendingSaves.fetch_add(1, std::memory_order_acq_rel);
+
+        if (taskQueue)
+        {
+            // Only mirrors the worker's progress. The count is refreshed at most every
+            // ProgressInterval, in between the step reports no change so the queue sees it
+            // waiting and stops polling it for the rest of the frame
+            constexpr auto ProgressInterval = std::chrono::milliseconds(50);
+            taskQueue->enqueue("Saving " + scenePath.filename().string(),
+                [progress, lastRefresh = std::chrono::steady_clock::time_point{}](btEngine::TaskProgress& taskProgress) mutable
+            {
+                if (progress->finished.load(std::memory_order_acquire)) return true;
+
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastRefresh < ProgressInterval) return false;
+
+                lastRefresh = now;
+                taskProgress.label = "Writing entities";
+                taskProgress.completed = progress->entitiesWritten.load(std::memory_order_relaxed);
+                taskProgress.total = progress->entityCount;
+                return false;
+            });
+        }
+
+        SceneSaveResult result;
+        try
+        {
+            result = co_await btEngine::runOnWorker([snapshot, scenePath, progress]
+            {
+                return writeSnapshot(*snapshot, scenePath, progress.get());
+            });
+        }
+        catch (const std::exception& e)
+        {
+            result.error = e.what();
+        }
+
+        // Back on the main thread
+        progress->finished.store(true, std::memory_order_release);
+        s_pendingSaves.fetch_sub(1, std::memory_order_acq_rel);
+        {
+            std::lock_guard<std::mutex> lock(s_writeMutex);
+            s_inFlightGenerations.erase(s_inFlightGenerations.find(snapshot->generation));
+            pruneWrittenGenerations();
+        }
+        result.snapshotMs = snapshotMs;
+
+        if (result.success)
+        {
+            PrefabUsageIndex::updateScene(scenePath, std::move(snapshot->prefabInstances));
+            TEA_INFO("Saved scene {0}: {1} entities, {2} bytes, snapshot {3} ms, write {4} ms", scenePath.string(),
+                result.entityCount, result.bytesWritten, result.snapshotMs, result.writeMs);
+        }
+        else if (!result.superseded)
+        {
+            TEA_ERROR("Failed to save scene {0}: {1}", scenePath.string(), result.error);
+        }
+        co_return result;
+    }
+}
@@ -0,0 +1,158 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SceneWriter.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SceneSnapshot holding a copy of every component value of a registry
+- SceneWriter class streaming a snapshot to a scene file on a worker thread
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <rttr/type>
+
+#include "../Core/Task.hpp"
+#include "../Core/TaskQueue.hpp"
+#include "SubSceneInstancing.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief Copy of the serializable state of one scene, owned by nothing but itself
+     *
+     * Property values are copied out of the components, so the editor can keep changing
+     * the registry while the snapshot is written. Records are flat arrays indexing into each
+     * other and property names are kept once per component type, so the snapshot costs about
+     * one rttr::variant per property value on top of the values themselves.
+    */
+    struct SceneSnapshot
+    {
+        struct ComponentLayout
+        {
+            std::string typeName;
+            std::vector<std::string> propNames;     // Registration order
+        };
+
+        struct ComponentRecord
+        {
+            uint32_t layout = 0;                    // Index in layouts
+            uint32_t firstValue = 0;                // Index in values of the first property, then one per propName
+        };
+
+        struct EntityRecord
+        {
+            uint32_t firstComponent = 0;            // Index in components
+            uint32_t componentCount = 0;
+        };
+
+        std::vector<ComponentLayout> layouts;                                   // One per registered component type
+        std::vector<EntityRecord> entities;
+        std::vector<ComponentRecord> components;
+        std::vector<rttr::variant> values;
+        std::vector<std::pair<uint32_t, TeaComponents::SubSceneInstanceComponent>> subSceneInstances;   // (entity index, instance), entity order, not rttr components
+        std::vector<std::pair<uint64_t, uint64_t>> prefabInstances;            // (prefab handle, instance UUID) for the usage index
+        uint64_t generation = 0;                                               // Newer snapshots of the same file win
+    };
+
+    /**
+     * @brief Progress of a running save, written by the worker and read by the status bar
+    */
+    struct SceneSaveProgress
+    {
+        std::atomic<uint32_t> entitiesWritten{ 0 };
+        uint32_t entityCount = 0;
+        std::atomic<bool> finished{ false };
+    };
+
+    struct SceneSaveResult
+    {
+        bool success = false;
+        bool superseded = false;        // A newer save of the same file was written first, nothing was written
+        std::string error;
+        size_t entityCount = 0;
+        uintmax_t bytesWritten = 0;
+        double snapshotMs = 0.0;        // Main thread time
+        double writeMs = 0.0;           // Worker time
+    };
+
+    /**
+     * @brief Scene saving that does not block the editor
+     *
+     * This class handles:
+     * 1. Taking a snapshot of every component property of one scene on the main thread, every
+     *    loaded scene shares the registry
+     * 2. Streaming the snapshot with a SAX writer through a large file buffer on a worker,
+     *    without building a document, into a temporary file swapped in once complete.
+     *    Blocks are compressed on the fly when BlockCompression::getCompressSaves() is on.
+     *    The current component schema versions are stamped after the entities
+     * 3. Reporting progress in the status bar and recording the saved prefab instances
+     *    in the usage index once the file is on disk
+    */
+    class SceneWriter
+    {
+    public:
+        static constexpr size_t WriteBufferSize = 1 << 20;
+
+        /**
+         * @brief Copies the components of every entity of one scene
+         * @param registry Registry holding the scene, only read on the calling thread
+         * @param sceneID Scene to copy, entities of the other loaded scenes are left out
+         * @return Snapshot independent of the registry
+        */
+        static SceneSnapshot takeSnapshot(entt::registry& registry, uint64_t sceneID);
+
+        /**
+         * @brief Writes a snapshot as a scene file, safe to call from any thread
+         * @param snapshot Snapshot to write
+         * @param scenePath Destination scene file
+         * @param progress Optional progress updated per entity
+         * @return Outcome and timing of the write
+        */
+        static SceneSaveResult writeSnapshot(const SceneSnapshot& snapshot, const std::filesystem::path& scenePath,
+            SceneSaveProgress* progress = nullptr);
+
+        /**
+         * @brief Saves a registry without blocking the frame
+         *
+         * The snapshot is taken before the first suspension, so the registry may change as soon
+         * as the coroutine is started. The rest runs on a worker and the coroutine finishes on
+         * the main thread.
+         *
+         * @param registry Registry holding the scene
+         * @param sceneID Scene to save
+         * @param scenePath Destination scene file
+         * @param taskQueue Optional queue showing the save in the status bar until it finishes
+         * @return Task producing the outcome of the save
+        */
+        static btEngine::Task<SceneSaveResult> saveAsync(entt::registry& registry, uint64_t sceneID, std::filesystem::path scenePath,
+            btEngine::MainLoopTaskQueue* taskQueue = nullptr);
+
+        // Saves started and not finished yet
+        static uint32_t getPendingSaves() { return s_pendingSaves.load(std::memory_order_acquire); }
+
+    private:
+        static std::atomic<uint32_t>                        s_pendingSaves;
+        static std::atomic<uint64_t>                        s_nextGeneration;
+        static void pruneWrittenGenerations();
+
+        static std::unordered_map<std::string, uint64_t>    s_writtenGenerations;  // Scene file -> newest snapshot written
+        static std::multiset<uint64_t>                      s_inFlightGenerations; // Snapshots saveAsync has not finished writing
+        static std::mutex                                   s_writeMutex;          // One file swap at a time, guards both
+    };
+}
@@ -0,0 +1,414 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SchemaMigration.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Versioned component schemas with registered upgrade steps
+- Offline migration pass upgrading scene and prefab files once, at cook time
+- Load gate letting loaders assume the current schema
+- Schema stamp of files written without one
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "SchemaMigration.hpp"
+#include "../Core/BlockCompression.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <tuple>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    const char* PrefabEntityKey = "Entity";
+
+    // Version of a component in a file, 0 when the file or the component has no stamp
+    uint32_t getFileVersion(const rapidjson::Value& document, const std::string& componentName)
+    {
+        auto versions = document.FindMember(TeaAsset::SceneFileSchema::SchemaVersionsKey);
+        if (versions == document.MemberEnd() || !versions->value.IsObject()) return 0;
+
+        auto version = versions->value.FindMember(componentName.c_str());
+        if (version == versions->value.MemberEnd() || !version->value.IsUint()) return 0;
+        return version->value.GetUint();
+    }
+
+    // Calls func on every serialized entity of a scene ("Entities" array) or prefab ("Entity" object)
+    template<typename EntityFunc>
+    bool forEachEntity(rapidjson::Value& document, EntityFunc&& func)
+    {
+        auto entities = document.FindMember(TeaAsset::SceneFileSchema::EntitiesKey);
+        if (entities != document.MemberEnd() && entities->value.IsArray())
+        {
+            for (auto& entity : entities->value.GetArray())
+            {
+                if (entity.IsObject() && !func(entity)) return false;
+            }
+        }
+
+        auto prefabEntity = document.FindMember(PrefabEntityKey);
+        if (prefabEntity != document.MemberEnd() && prefabEntity->value.IsObject())
+        {
+            return func(prefabEntity->value);
+        }
+        return true;
+    }
+}
+
+namespace TeaAsset
+{
+    std::unordered_map<std::string, std::vector<MigrationStep>> SchemaMigration::s_steps;
+    std::atomic<bool> SchemaMigration::s_migrateOnLoad{ true };
+
+    void SchemaMigration::registerStep(const std::string& componentName, uint32_t fromVersion, MigrationStep step)
+    {
+        auto& steps = s_steps[componentName];
+        if (fromVersion != steps.size())
+        {
+            TEA_ERROR("Schema step {0} -> {1} of {2} registered out of order, expected a step from version {3}",
+                fromVersion, fromVersion + 1, componentName, steps.size());
+            return;
+        }
+        steps.push_back(std::move(step));
+    }
+
+    uint32_t SchemaMigration::getCurrentVersion(const std::string& componentName)
+    {
+        auto it = s_steps.find(componentName);
+        return it == s_steps.end() ? 0 : static_cast<uint32_t>(it->second.size());
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> SchemaMigration::getCurrentVersions()
+    {
+        std::vector<std::pair<std::string, uint32_t>> versions;
+        for (const auto& [componentName, steps] : s_steps)
+        {
+            if (!steps.empty())
+            {
+                versions.emplace_back(componentName, static_cast<uint32_t>(steps.size()));
+            }
+        }
+        std::sort(versions.begin(), versions.end());
+        return versions;
+    }
+
+    void SchemaMigration::clear()
+    {
+        s_steps.clear();
+    }
+
+    MigrationStep SchemaMigration::renameProperty(const std::string& oldName, const std::string& newName)
+    {
+        return [oldName, newName](MigrationContext& context)
+        {
+            auto member = context.component.FindMember(oldName.c_str());
+            if (member != context.component.MemberEnd())
+            {
+                member->name.SetString(newName.c_str(), static_cast<rapidjson::SizeType>(newName.size()), context.allocator);
+            }
+
+            // Prefab instances refer to overridden properties by "<Component>/<Property>"
+            auto overrides = context.entity.FindMember(SceneFileSchema::OverrideComponent);
+            if (overrides == context.entity.MemberEnd() || !overrides->value.IsObject()) return true;
+
+            auto properties = overrides->value.FindMember(SceneFileSchema::OverriddenProperties);
+            if (properties == overrides->value.MemberEnd() || !properties->value.IsArray()) return true;
+
+            const std::string oldPath = context.componentName + "/" + oldName;
+            const std::string newPath = context.componentName + "/" + newName;
+            for (auto& property : properties->value.GetArray())
+            {
+                if (!property.IsObject()) continue;
+                auto path = property.FindMember(SceneFileSchema::PropertyPath);
+                if (path != property.MemberEnd() && path->value.IsString() && oldPath == path->value.GetString())
+                {
+                    path->value.SetString(newPath.c_str(), static_cast<rapidjson::SizeType>(newPath.size()), context.allocator);
+                }
+            }
+            return true;
+        };
+    }
+
+    MigrationStep SchemaMigration::removeProperty(const std::string& propName)
+    {
+        return [propName](MigrationContext& context)
+        {
+            context.component.RemoveMember(propName.c_str());
+            return true;
+        };
+    }
+
+    bool SchemaMigration::isCurrent(const rapidjson::Value& document)
+    {
+        if (!document.IsObject()) return true;
+
+        for (const auto& [componentName, steps] : s_steps)
+        {
+            if (!steps.empty() && getFileVersion(document, componentName) != steps.size()) return false;
+        }
+        return true;
+    }
+
+    int64_t SchemaMigration::migrateDocument(rapidjson::Document& document, std::string* error)
+    {
+        if (!document.IsObject())
+        {
+            if (error) *error = "Document is not an object";
+            return -1;
+        }
+
+        auto& allocator = document.GetAllocator();
+
+        // Steps left to run per component, a file from a newer build cannot be read safely.
+        // The steps are kept by pointer, workers migrating files must not go through s_steps[]
+        std::vector<std::tuple<const std::string*, const std::vector<MigrationStep>*, uint32_t>> pending;
+        for (const auto& [componentName, steps] : s_steps)
+        {
+            const uint32_t fileVersion = getFileVersion(document, componentName);
+            if (fileVersion > steps.size())
+            {
+                if (error) *error = componentName + " is at version " + std::to_string(fileVersion) +
+                    ", newer than this build (" + std::to_string(steps.size()) + ")";
+                return -1;
+            }
+            if (fileVersion < steps.size())
+            {
+                pending.emplace_back(&componentName, &steps, fileVersion);
+            }
+        }
+
+        int64_t migrated = 0;
+        std::string failure;
+        const bool success = forEachEntity(document, [&](rapidjson::Value& entity)
+        {
+            for (const auto& [componentName, steps, fromVersion] : pending)
+            {
+                auto component = entity.FindMember(componentName->c_str());
+                if (component == entity.MemberEnd() || !component->value.IsObject()) continue;
+
+                MigrationContext context{ *componentName, entity, component->value, allocator };
+                for (uint32_t version = fromVersion; version < steps->size(); version++)
+                {
+                    if (!(*steps)[version](context))
+                    {
+                        failure = "Failed to upgrade " + *componentName + " from version " + std::to_string(version);
+                        return false;
+                    }
+                }
+                migrated++;
+            }
+            return true;
+        });
+
+        if (!success)
+        {
+            if (error) *error = failure;
+            return -1;
+        }
+
+        stampDocument(document);
+        return migrated;
+    }
+
+    void SchemaMigration::stampDocument(rapidjson::Document& document)
+    {
+        auto& allocator = document.GetAllocator();
+
+        // Rebuilt so components without steps any more drop out
+        document.RemoveMember(SceneFileSchema::SchemaVersionsKey);
+        rapidjson::Value versions(rapidjson::kObjectType);
+        for (const auto& [componentName, version] : getCurrentVersions())
+        {
+            versions.AddMember(rapidjson::Value(componentName.c_str(), allocator), rapidjson::Value(version), allocator);
+        }
+        document.AddMember(rapidjson::StringRef(SceneFileSchema::SchemaVersionsKey), versions, allocator);
+    }
+
+    bool SchemaMigration::stampFile(const std::filesystem::path& path, std::string* error)
+    {
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(path, contents, error))
+        {
+            return false;
+        }
+
+        rapidjson::Document document;
+        document.Parse(contents.c_str(), contents.size());
+        if (document.HasParseError() || !document.IsObject())
+        {
+            if (error) *error = "Failed to parse file";
+            return false;
+        }
+
+        // Already stamped, or nothing is versioned yet
+        if (isCurrent(document)) return true;
+
+        stampDocument(document);
+        return writeDocument(path, document, error);
+    }
+
+    FileMigrationResult SchemaMigration::migrateFile(const std::filesystem::path& path, bool dryRun)
+    {
+        FileMigrationResult result;
+        result.filePath = path.string();
+
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(path, contents, &result.error))
+        {
+            return result;
+        }
+
+        rapidjson::Document document;
+        document.Parse(contents.c_str(), contents.size());
+        if (document.HasParseError() || !document.IsObject())
+        {
+            result.error = "Failed to parse file";
+            return result;
+        }
+
+        if (isCurrent(document)) return result;
+        result.outdated = true;
+
+        const int64_t migrated = migrateDocument(document, &result.error);
+        if (migrated < 0) return result;
+        result.componentsMigrated = static_cast<uint32_t>(migrated);
+        if (dryRun) return result;
+
+        if (!writeDocument(path, document, &result.error)) return result;
+
+        result.rewritten = true;
+        return result;
+    }
+
+    bool SchemaMigration::writeDocument(const std::filesystem::path& path, const rapidjson::Document& document, std::string* error)
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+        document.Accept(writer);
+
+        // Write next to the file and swap it in only once complete, compressed files stay compressed
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+
+        std::ifstream header(path, std::ios::binary);
+        char magic[4] = {};
+        header.read(magic, sizeof(magic));
+        const bool compressed = btEngine::BlockCompression::isCompressed(std::string_view(magic, static_cast<size_t>(header.gcount())));
+        header.close();
+
+        std::error_code fsError;
+        if (!btEngine::BlockCompression::writeFile(tempPath, std::string_view(buffer.GetString(), buffer.GetSize()), compressed))
+        {
+            if (error) *error = "Failed to write temporary file";
+            std::filesystem::remove(tempPath, fsError);
+            return false;
+        }
+
+        std::filesystem::rename(tempPath, path, fsError);
+        if (fsError)
+        {
+            if (error) *error = "Failed to replace file: " + fsError.message();
+            std::filesystem::remove(tempPath, fsError);
+            return false;
+        }
+
+        return true;
+    }
+
+    SchemaMigrationReport SchemaMigration::run(const std::filesystem::path& projectDirectory, bool dryRun, btEngine::JobSystem* jobSystem)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        SchemaMigrationReport report;
+        report.dryRun = dryRun;
+
+        std::error_code error;
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(projectDirectory, error))
+        {
+            if (!entry.is_regular_file()) continue;
+            const auto extension = entry.path().extension();
+            if (extension == SceneFileSchema::SceneExtension || extension == SceneFileSchema::PrefabExtension)
+            {
+                files.push_back(entry.path());
+            }
+        }
+        report.filesScanned = files.size();
+
+        // One job per file, each job only touches its own result slot
+        std::vector<FileMigrationResult> results(files.size());
+        auto processFile = [&](btEngine::JobArgs args)
+        {
+            results[args.jobIndex] = migrateFile(files[args.jobIndex], dryRun);
+        };
+
+        if (jobSystem)
+        {
+            jobSystem->wait(jobSystem->dispatch(static_cast<uint32_t>(files.size()), 1, processFile));
+        }
+        else
+        {
+            for (uint32_t i = 0; i < files.size(); i++)
+            {
+                processFile(btEngine::JobArgs{ i, i, 0 });
+            }
+        }
+
+        for (auto& result : results)
+        {
+            if (result.outdated || !result.error.empty())
+            {
+                report.files.push_back(std::move(result));
+            }
+        }
+
+        report.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        return report;
+    }
+
+    void SchemaMigration::logReport(const SchemaMigrationReport& report)
+    {
+        TEA_INFO("{0}Schema migration: {1} files scanned, {2} outdated in {3} ms",
+            report.dryRun ? "[Dry run] " : "", report.filesScanned, report.files.size(), report.elapsedMs);
+
+        for (const auto& file : report.files)
+        {
+            if (!file.error.empty())
+            {
+                TEA_ERROR("  {0}: {1}", file.filePath, file.error);
+                continue;
+            }
+
+            TEA_INFO("  {0}: {1} components upgraded{2}", file.filePath, file.componentsMigrated, file.rewritten ? ", rewritten" : "");
+        }
+    }
+
+    bool SchemaMigration::checkOnLoad(rapidjson::Document& document, const std::string& path)
+    {
+        if (isCurrent(document)) return true;
+
+        if (!getMigrateOnLoad())
+        {
+            TEA_ERROR("{0} was saved with an older component schema, run the schema migration pass on the project", path);
+            return false;
+        }
+
+        std::string error;
+        if (migrateDocument(document, &error) < 0)
+        {
+            TEA_ERROR("Failed to upgrade {0} to the current component schema: {1}", path, error);
+            return false;
+        }
+
+        TEA_WARNING("{0} was upgraded to the current component schema on load, run the schema migration pass to keep it upgraded", path);
+        return true;
+    }
+}
@@ -0,0 +1,203 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SchemaMigration.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Versioned component schemas with registered upgrade steps
+- Offline migration pass upgrading scene and prefab files once, at cook time
+- Load gate letting loaders assume the current schema
+- Schema stamp of files written without one
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+#include "../Core/JobSystem.hpp"
+#include "OfflinePrefabPropagation.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief What an upgrade step gets to work on
+    */
+    struct MigrationContext
+    {
+        const std::string& componentName;
+        rapidjson::Value& entity;           // Whole serialized entity, for steps that touch its override paths
+        rapidjson::Value& component;        // entity[componentName]
+        rapidjson::Document::AllocatorType& allocator;
+    };
+
+    // Upgrades a component by one version, returns false if the data cannot be upgraded
+    using MigrationStep = std::function<bool(MigrationContext& context)>;
+
+    struct FileMigrationResult
+    {
+        std::string filePath;
+        uint32_t componentsMigrated = 0;
+        bool outdated = false;
+        bool rewritten = false;         // File was replaced on disk
+        std::string error;              // Empty on success
+    };
+
+    struct SchemaMigrationReport
+    {
+        bool dryRun = false;
+        size_t filesScanned = 0;
+        std::vector<FileMigrationResult> files;     // Outdated or failed files only
+        double elapsedMs = 0.0;
+    };
+
+    /**
+     * @brief Component schema versions and the cook time pass upgrading files to them
+     *
+     * This class handles:
+     * 1. Registering, per component, the steps upgrading its serialized data one version at a time.
+     *    The current version of a component is the number of steps registered for it
+     * 2. Stamping the current versions into every file written, under SceneFileSchema::SchemaVersionsKey.
+     *    Components missing from the stamp, and files without one, are at version 0
+     * 3. Upgrading every scene and prefab of a project on the job system and writing them back
+     * 4. Checking documents on load with one comparison per versioned component, so the property
+     *    deserializer never has to guess which layout it is reading
+     *
+     * Register every step at startup, before anything is loaded or cooked. Properties that are
+     * missing from a file keep the component's default value, so adding a property needs no step.
+    */
+    class SchemaMigration
+    {
+    public:
+        /**
+         * @brief Registers the step upgrading a component from one version to the next
+         * @param componentName Registered component name
+         * @param fromVersion Version the step reads, steps must be registered in order starting at 0
+         * @param step Upgrade applied to every serialized instance of the component
+        */
+        static void registerStep(const std::string& componentName, uint32_t fromVersion, MigrationStep step);
+
+        static uint32_t getCurrentVersion(const std::string& componentName);
+
+        // (component, version) of every component above version 0, sorted by name
+        static std::vector<std::pair<std::string, uint32_t>> getCurrentVersions();
+
+        static void clear();
+
+        // Step renaming a property, also renames the entity's override paths pointing at it
+        static MigrationStep renameProperty(const std::string& oldName, const std::string& newName);
+
+        // Step dropping a property that no longer exists
+        static MigrationStep removeProperty(const std::string& propName);
+
+        /**
+         * @brief Checks the schema stamp of a scene or prefab document
+         * @param document Parsed file
+         * @return True if every versioned component is at its current version
+        */
+        static bool isCurrent(const rapidjson::Value& document);
+
+        /**
+         * @brief Upgrades every entity of a scene or prefab document and stamps the current versions
+         * @param document Parsed file, changed in place
+         * @param error Optional, receives the reason of a failure
+         * @return Number of component instances upgraded, -1 on failure
+        */
+        static int64_t migrateDocument(rapidjson::Document& document, std::string* error = nullptr);
+
+        /**
+         * @brief Replaces the schema stamp of a document with the current versions
+         * @param document Parsed file holding data of this build, changed in place
+        */
+        static void stampDocument(rapidjson::Document& document);
+
+        /**
+         * @brief Stamps a file that was just written without a schema stamp
+         *
+         * For savers that do not call writeVersions themselves, e.g. the editor's prefab save
+         * (outside this tree), which calls it right after serializing the prefab. The file must
+         * hold data of this build, it is stamped with the current versions and no step runs.
+         * Never call it on a file that was not just written, an older file would be marked
+         * current and skip its upgrade for good. Use migrateFile for files of older builds.
+         *
+         * @param path File to stamp, kept compressed if it was
+         * @param error Optional, receives the reason of a failure
+         * @return False if the file could not be read or rewritten
+        */
+        static bool stampFile(const std::filesystem::path& path, std::string* error = nullptr);
+
+        /**
+         * @brief Upgrades one scene or prefab file, keeping it compressed if it was
+         * @param path File to upgrade
+         * @param dryRun Report only, nothing is written
+         * @return What was (or would be) upgraded
+        */
+        static FileMigrationResult migrateFile(const std::filesystem::path& path, bool dryRun);
+
+        /**
+         * @brief Cook pass upgrading every scene and prefab of a project
+         * @param projectDirectory Searched recursively
+         * @param dryRun Report only, nothing is written
+         * @param jobSystem Job system to process the files on, nullptr runs them on the calling thread
+         * @return Report of the outdated files
+        */
+        static SchemaMigrationReport run(const std::filesystem::path& projectDirectory, bool dryRun, btEngine::JobSystem* jobSystem);
+
+        static void logReport(const SchemaMigrationReport& report);
+
+        /**
+         * @brief Load gate, called by loaders right after parsing
+         *
+         * Current documents pass straight through. Outdated ones are upgraded in memory with a
+         * warning when migrating on load is allowed, and rejected otherwise. Every loader has to
+         * call it, including the scene manager's scene loader outside this tree, and every saver
+         * has to stamp what it writes (writeVersions, stampDocument or stampFile), otherwise a
+         * freshly saved file reads as version 0 and cooked builds reject it.
+         *
+         * @param document Parsed file
+         * @param path File the document came from, for the log
+         * @return False if the document cannot be used
+        */
+        static bool checkOnLoad(rapidjson::Document& document, const std::string& path);
+
+        // On in the editor, cooked builds turn it off so an unmigrated file fails loudly
+        static void setMigrateOnLoad(bool migrate) { s_migrateOnLoad.store(migrate, std::memory_order_relaxed); }
+        static bool getMigrateOnLoad() { return s_migrateOnLoad.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief Writes the current versions as the schema stamp of a file being written
+         * @param writer SAX writer positioned inside the root object
+        */
+        template<typename Writer>
+        static void writeVersions(Writer& writer)
+        {
+            writer.Key(SceneFileSchema::SchemaVersionsKey);
+            writer.StartObject();
+            for (const auto& [componentName, version] : getCurrentVersions())
+            {
+                writer.Key(componentName.c_str(), static_cast<rapidjson::SizeType>(componentName.size()));
+                writer.Uint(version);
+            }
+            writer.EndObject();
+        }
+
+    private:
+        // Writes next to the file and swaps it in, compressed files stay compressed
+        static bool writeDocument(const std::filesystem::path& path, const rapidjson::Document& document, std::string* error);
+
+        static std::unordered_map<std::string, std::vector<MigrationStep>>  s_steps;    // Index is the version a step reads
+        static std::atomic<bool>                                            s_migrateOnLoad;
+    };
+}
@@ -0,0 +1,234 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       SkinningBenchmark.cpp
+@project    TeaEngine
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Headless skinning palette benchmark (entry point of the benchmark target)
+- Synthetic skeletons and crowds built from command line options
+- JSON report with characters per millisecond, single threaded and on the job system
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Graphics/SkinningPalette.hpp"
+#include "Core/JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    struct BenchmarkOptions
+    {
+        uint32_t characters = 1000;
+        uint32_t bones = 64;
+        uint32_t skeletons = 4;             // Distinct skeletons shared by the crowd
+        uint32_t iterations = 20;
+        uint32_t workers = 0;               // Job system workers, 0 picks hardware concurrency - 1
+        uint32_t seed = 1234;
+        std::string outputPath;             // Report file, stdout when empty
+    };
+
+    struct RunResult
+    {
+        double totalMs = 0.0;
+        double minMs = 0.0;
+    };
+
+    void printUsage()
+    {
+        std::cerr << "Usage: SkinningBenchmark [--characters N] [--bones N] [--skeletons N] [--iterations N]\n"
+                     "                         [--workers N] [--seed N] [--out FILE]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                return false;
+            }
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << arg << "\n";
+                return false;
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--characters")          options.characters = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--bones")          options.bones = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--skeletons")      options.skeletons = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--iterations")     options.iterations = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+            else if (arg == "--workers")        options.workers = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--seed")           options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--out")            options.outputPath = value;
+            else
+            {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Random tree where every bone hangs off an earlier one, shuffled so the cache has to sort it
+    std::shared_ptr<const TeaAnimation::SkeletonRestData> makeSkeleton(uint32_t boneCount, std::mt19937& rng)
+    {
+        std::vector<uint32_t> shuffled(boneCount);
+        for (uint32_t i = 0; i < boneCount; i++) shuffled[i] = i;
+        std::shuffle(shuffled.begin() + 1, shuffled.end(), rng);
+
+        std::vector<int32_t> parents(boneCount, TeaAnimation::SkeletonRestData::NoParent);
+        std::vector<glm::mat4> inverseBind(boneCount, glm::mat4(1.0f));
+        std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        for (uint32_t i = 1; i < boneCount; i++)
+        {
+            std::uniform_int_distribution<uint32_t> parentPick(i - std::min(i, 4u), i - 1);
+            parents[shuffled[i]] = static_cast<int32_t>(shuffled[parentPick(rng)]);
+            inverseBind[shuffled[i]][3] = glm::vec4(offset(rng), offset(rng), offset(rng), 1.0f);
+        }
+        return TeaAnimation::SkeletonCache::getOrCreate(parents, inverseBind);
+    }
+
+    void randomizePose(TeaAnimation::SkeletonPose& pose, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+        for (uint32_t bone = 0; bone < pose.getBoneCount(); bone++)
+        {
+            glm::vec4 rotation = glm::normalize(glm::vec4(value(rng), value(rng), value(rng), value(rng) + 2.0f));
+            pose.tx[bone] = value(rng);
+            pose.ty[bone] = value(rng);
+            pose.tz[bone] = value(rng);
+            pose.rx[bone] = rotation.x;
+            pose.ry[bone] = rotation.y;
+            pose.rz[bone] = rotation.z;
+            pose.rw[bone] = rotation.w;
+        }
+    }
+
+    RunResult run(std::vector<TeaAnimation::SkinnedCharacter>& characters, btEngine::JobSystem* jobSystem, uint32_t iterations)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // One untimed pass sizes the output arrays
+        TeaAnimation::SkinningPaletteSystem::computeAll(characters, jobSystem);
+
+        RunResult result;
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            auto start = Clock::now();
+            TeaAnimation::SkinningPaletteSystem::computeAll(characters, jobSystem);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            result.totalMs += ms;
+            result.minMs = iteration == 0 ? ms : std::min(result.minMs, ms);
+        }
+        return result;
+    }
+
+    void writeRun(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const char* name, const RunResult& result,
+        uint32_t threads, const BenchmarkOptions& options)
+    {
+        const double averageMs = result.totalMs / options.iterations;
+
+        writer.StartObject();
+        writer.Key("name");                 writer.String(name);
+        writer.Key("threads");              writer.Uint(threads);
+        writer.Key("averageMs");            writer.Double(averageMs);
+        writer.Key("minMs");                writer.Double(result.minMs);
+        writer.Key("charactersPerMs");      writer.Double(averageMs > 0.0 ? options.characters / averageMs : 0.0);
+        writer.Key("bonesPerMs");           writer.Double(averageMs > 0.0 ? static_cast<double>(options.characters) * options.bones / averageMs : 0.0);
+        writer.EndObject();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::mt19937 rng(options.seed);
+
+    std::vector<std::shared_ptr<const TeaAnimation::SkeletonRestData>> skeletons;
+    for (uint32_t i = 0; i < options.skeletons; i++)
+    {
+        skeletons.push_back(makeSkeleton(options.bones, rng));
+        if (!skeletons.back())
+        {
+            std::cerr << "Failed to build skeleton " << i << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<TeaAnimation::SkinnedCharacter> characters(options.characters);
+    for (uint32_t i = 0; i < options.characters; i++)
+    {
+        characters[i].skeleton = skeletons[i % skeletons.size()];
+        characters[i].pose.resize(options.bones);
+        randomizePose(characters[i].pose, rng);
+    }
+
+    btEngine::JobSystem jobSystem;
+    if (!jobSystem.initialize(options.workers))
+    {
+        std::cerr << "Failed to start the job system\n";
+        return 1;
+    }
+
+    RunResult single = run(characters, nullptr, options.iterations);
+    RunResult parallel = run(characters, &jobSystem, options.iterations);
+    const uint32_t threadCount = jobSystem.getThreadCount();
+    jobSystem.shutdown();
+
+    // Machine readable report, one object per run so results can be diffed across commits
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("benchmark");        writer.String("skinning_palette");
+    writer.Key("simd");             writer.Bool(TeaAnimation::SkinningPalette::isSimdEnabled());
+    writer.Key("options");
+    writer.StartObject();
+    writer.Key("characters");       writer.Uint(options.characters);
+    writer.Key("bones");            writer.Uint(options.bones);
+    writer.Key("skeletons");        writer.Uint(options.skeletons);
+    writer.Key("sharedSkeletons");  writer.Uint64(TeaAnimation::SkeletonCache::getSkeletonCount());
+    writer.Key("iterations");       writer.Uint(options.iterations);
+    writer.Key("seed");             writer.Uint(options.seed);
+    writer.EndObject();
+    writer.Key("runs");
+    writer.StartArray();
+    writeRun(writer, "single_thread", single, 1, options);
+    writeRun(writer, "job_system", parallel, threadCount, options);
+    writer.EndArray();
+    writer.EndObject();
+
+    if (options.outputPath.empty())
+    {
+        std::cout << buffer.GetString() << std::endl;
+    }
+    else
+    {
+        std::ofstream(options.outputPath, std::ios::binary | std::ios::trunc) << buffer.GetString() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,376 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SkinningPalette.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SkeletonCache implementation (hierarchy sorting and deduplication)
+- SSE / scalar matrix multiply and local bone matrices composed four bones at a time
+- Per character palette computation and the parallel crowd pass
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "SkinningPalette.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TEA_SKINNING_SSE 1
+#include <xmmintrin.h>
+#else
+#define TEA_SKINNING_SSE 0
+#endif
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAnimation
+{
+    std::unordered_map<uint64_t, std::weak_ptr<const SkeletonRestData>>    SkeletonCache::s_skeletons;
+    size_t                                                                  SkeletonCache::s_lookupsSincePrune = 0;
+    std::mutex                                                              SkeletonCache::s_mutex;
+
+    namespace
+    {
+        uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        // Local bone matrix from the SoA pose, column major like glm
+        void composeLocal(const SkeletonPose& pose, uint32_t bone, glm::mat4& out)
+        {
+            const float x = pose.rx[bone], y = pose.ry[bone], z = pose.rz[bone], w = pose.rw[bone];
+            const float xx = x * x, yy = y * y, zz = z * z;
+            const float xy = x * y, xz = x * z, yz = y * z;
+            const float wx = w * x, wy = w * y, wz = w * z;
+            const float sx = pose.sx[bone], sy = pose.sy[bone], sz = pose.sz[bone];
+
+            out[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx, 2.0f * (xz - wy) * sx, 0.0f);
+            out[1] = glm::vec4(2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy, 2.0f * (yz + wx) * sy, 0.0f);
+            out[2] = glm::vec4(2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz, (1.0f - 2.0f * (xx + yy)) * sz, 0.0f);
+            out[3] = glm::vec4(pose.tx[bone], pose.ty[bone], pose.tz[bone], 1.0f);
+        }
+
+        // Local bone matrices of every bone, mesh order. The SoA pose is read four bones per lane set
+        void composeLocals(const SkeletonPose& pose, glm::mat4* out)
+        {
+            const uint32_t boneCount = pose.getBoneCount();
+            uint32_t bone = 0;
+#if TEA_SKINNING_SSE
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            for (; bone + 4 <= boneCount; bone += 4)
+            {
+                const __m128 x = _mm_loadu_ps(pose.rx.data() + bone);
+                const __m128 y = _mm_loadu_ps(pose.ry.data() + bone);
+                const __m128 z = _mm_loadu_ps(pose.rz.data() + bone);
+                const __m128 w = _mm_loadu_ps(pose.rw.data() + bone);
+                const __m128 sx = _mm_loadu_ps(pose.sx.data() + bone);
+                const __m128 sy = _mm_loadu_ps(pose.sy.data() + bone);
+                const __m128 sz = _mm_loadu_ps(pose.sz.data() + bone);
+
+                const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+                const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+                const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+                // Rows of the three rotation-scale columns, one bone per lane
+                __m128 c0r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+                __m128 c0r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+                __m128 c0r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+                __m128 c0r3 = _mm_setzero_ps();
+                __m128 c1r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+                __m128 c1r1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+                __m128 c1r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+                __m128 c1r3 = _mm_setzero_ps();
+                __m128 c2r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+                __m128 c2r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+                __m128 c2r2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+                __m128 c2r3 = _mm_setzero_ps();
+                __m128 c3r0 = _mm_loadu_ps(pose.tx.data() + bone);
+                __m128 c3r1 = _mm_loadu_ps(pose.ty.data() + bone);
+                __m128 c3r2 = _mm_loadu_ps(pose.tz.data() + bone);
+                __m128 c3r3 = one;
+
+                // Transposing turns the four lanes of a column into that column of four matrices
+                _MM_TRANSPOSE4_PS(c0r0, c0r1, c0r2, c0r3);
+                _MM_TRANSPOSE4_PS(c1r0, c1r1, c1r2, c1r3);
+                _MM_TRANSPOSE4_PS(c2r0, c2r1, c2r2, c2r3);
+                _MM_TRANSPOSE4_PS(c3r0, c3r1, c3r2, c3r3);
+
+                const __m128 columns[4][4] = {
+                    { c0r0, c1r0, c2r0, c3r0 },
+                    { c0r1, c1r1, c2r1, c3r1 },
+                    { c0r2, c1r2, c2r2, c3r2 },
+                    { c0r3, c1r3, c2r3, c3r3 } };
+                for (uint32_t lane = 0; lane < 4; lane++)
+                {
+                    float* matrix = &out[bone + lane][0][0];
+                    for (int column = 0; column < 4; column++)
+                    {
+                        _mm_storeu_ps(matrix + column * 4, columns[lane][column]);
+                    }
+                }
+            }
+#endif
+            for (; bone < boneCount; bone++)
+            {
+                composeLocal(pose, bone, out[bone]);
+            }
+        }
+
+        // Guards against hash collisions, the rest data is stored in hierarchy order
+        bool matches(const SkeletonRestData& skeleton, const std::vector<int32_t>& parents, const std::vector<glm::mat4>& inverseBind)
+        {
+            if (skeleton.getBoneCount() != parents.size()) return false;
+
+            for (uint32_t position = 0; position < skeleton.getBoneCount(); position++)
+            {
+                const uint32_t bone = skeleton.order[position];
+                const int32_t parent = skeleton.parents[position];
+                const int32_t expected = parent == SkeletonRestData::NoParent ? SkeletonRestData::NoParent : static_cast<int32_t>(skeleton.order[parent]);
+                if (skeleton.inverseBind[position] != inverseBind[bone] || expected != (parents[bone] < 0 ? SkeletonRestData::NoParent : parents[bone]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    void SkeletonPose::resize(uint32_t boneCount)
+    {
+        for (auto* component : { &tx, &ty, &tz, &rx, &ry, &rz })
+        {
+            component->resize(boneCount, 0.0f);
+        }
+        for (auto* component : { &rw, &sx, &sy, &sz })
+        {
+            component->resize(boneCount, 1.0f);
+        }
+    }
+
+    std::shared_ptr<const SkeletonRestData> SkeletonCache::getOrCreate(const std::vector<int32_t>& parents,
+        const std::vector<glm::mat4>& inverseBind)
+    {
+        const uint32_t boneCount = static_cast<uint32_t>(parents.size());
+        if (inverseBind.size() != parents.size())
+        {
+            TEA_ERROR("SkeletonCache: {0} parents but {1} inverse bind matrices", parents.size(), inverseBind.size());
+            return nullptr;
+        }
+
+        uint64_t hash = fnv1a(parents.data(), parents.size() * sizeof(int32_t));
+        hash = fnv1a(inverseBind.data(), inverseBind.size() * sizeof(glm::mat4), hash);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        // Meshes that are gone leave expired entries, drop them once they outnumber the live ones
+        if (s_skeletons.size() >= PruneThreshold && ++s_lookupsSincePrune >= s_skeletons.size() / 2)
+        {
+            pruneLocked();
+        }
+
+        // Same bones and bind pose, possibly from another mesh: reuse it
+        bool collision = false;
+        auto it = s_skeletons.find(hash);
+        if (it != s_skeletons.end())
+        {
+            if (auto existing = it->second.lock())
+            {
+                if (matches(*existing, parents, inverseBind))
+                {
+                    return existing;
+                }
+                collision = true;
+            }
+        }
+
+        // Depth of every bone, a depth past the bone count means the hierarchy loops
+        std::vector<uint32_t> depths(boneCount, 0);
+        for (uint32_t bone = 0; bone < boneCount; bone++)
+        {
+            uint32_t depth = 0;
+            for (int32_t parent = parents[bone]; parent >= 0; parent = parents[parent])
+            {
+                if (static_cast<uint32_t>(parent) >= boneCount || ++depth > boneCount)
+                {
+                    TEA_ERROR("SkeletonCache: bone {0} has an invalid or cyclic parent chain", bone);
+                    return nullptr;
+                }
+            }
+            depths[bone] = depth;
+        }
+
+        auto skeleton = std::make_shared<SkeletonRestData>();
+        skeleton->hash = hash;
+        skeleton->order.resize(boneCount);
+        std::iota(skeleton->order.begin(), skeleton->order.end(), 0u);
+        std::stable_sort(skeleton->order.begin(), skeleton->order.end(),
+            [&depths](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+        std::vector<int32_t> positions(boneCount);
+        for (uint32_t position = 0; position < boneCount; position++)
+        {
+            positions[skeleton->order[position]] = static_cast<int32_t>(position);
+        }
+
+        skeleton->parents.resize(boneCount);
+        skeleton->inverseBind.resize(boneCount);
+        for (uint32_t position = 0; position < boneCount; position++)
+        {
+            const uint32_t bone = skeleton->order[position];
+            skeleton->parents[position] = parents[bone] < 0 ? SkeletonRestData::NoParent : positions[parents[bone]];
+            skeleton->inverseBind[position] = inverseBind[bone];
+        }
+
+        // A colliding skeleton is still valid, it just is not shared
+        if (!collision)
+        {
+            s_skeletons[hash] = skeleton;
+        }
+        return skeleton;
+    }
+
+    size_t SkeletonCache::prune()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return pruneLocked();
+    }
+
+    size_t SkeletonCache::pruneLocked()
+    {
+        s_lookupsSincePrune = 0;
+        size_t pruned = 0;
+        for (auto it = s_skeletons.begin(); it != s_skeletons.end();)
+        {
+            if (it->second.expired())
+            {
+                it = s_skeletons.erase(it);
+                pruned++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        return pruned;
+    }
+
+    size_t SkeletonCache::getSkeletonCount()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return static_cast<size_t>(std::count_if(s_skeletons.begin(), s_skeletons.end(),
+            [](const auto& entry) { return !entry.second.expired(); }));
+    }
+
+    void SkeletonCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_skeletons.clear();
+        s_lookupsSincePrune = 0;
+    }
+
+    namespace SkinningPalette
+    {
+        void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+        {
+#if TEA_SKINNING_SSE
+            const float* aData = &a[0][0];
+            const float* bData = &b[0][0];
+            float* outData = &out[0][0];
+
+            // Columns of a stay in registers, so out may alias a; column j of b is read before column j of out is written
+            const __m128 a0 = _mm_loadu_ps(aData);
+            const __m128 a1 = _mm_loadu_ps(aData + 4);
+            const __m128 a2 = _mm_loadu_ps(aData + 8);
+            const __m128 a3 = _mm_loadu_ps(aData + 12);
+            for (int column = 0; column < 4; column++)
+            {
+                const float* bColumn = bData + column * 4;
+                __m128 result = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+                result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+                result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+                result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+                _mm_storeu_ps(outData + column * 4, result);
+            }
+#else
+            glm::mat4 result;
+            for (int column = 0; column < 4; column++)
+            {
+                result[column] = a[0] * b[column][0] + a[1] * b[column][1] + a[2] * b[column][2] + a[3] * b[column][3];
+            }
+            out = result;
+#endif
+        }
+
+        void compute(SkinnedCharacter& character)
+        {
+            if (!character.skeleton) return;
+
+            const SkeletonRestData& skeleton = *character.skeleton;
+            const uint32_t boneCount = skeleton.getBoneCount();
+            if (character.pose.getBoneCount() != boneCount) return;
+
+            character.local.resize(boneCount);
+            character.modelSpace.resize(boneCount);
+            character.palette.resize(boneCount);
+
+            // Local matrices need no parent, so they are composed in one vectorized pass over the pose
+            composeLocals(character.pose, character.local.data());
+
+            // Hierarchy order: the parent's model space matrix is always ready
+            for (uint32_t position = 0; position < boneCount; position++)
+            {
+                const uint32_t bone = skeleton.order[position];
+                const glm::mat4& local = character.local[bone];
+
+                const int32_t parent = skeleton.parents[position];
+                if (parent == SkeletonRestData::NoParent)
+                {
+                    character.modelSpace[position] = local;
+                }
+                else
+                {
+                    multiply(character.modelSpace[parent], local, character.modelSpace[position]);
+                }
+
+                multiply(character.modelSpace[position], skeleton.inverseBind[position], character.palette[bone]);
+            }
+        }
+
+        bool isSimdEnabled()
+        {
+            return TEA_SKINNING_SSE != 0;
+        }
+    }
+
+    void SkinningPaletteSystem::computeAll(std::vector<SkinnedCharacter>& characters, btEngine::JobSystem* jobSystem)
+    {
+        const uint32_t count = static_cast<uint32_t>(characters.size());
+        if (!jobSystem || count <= CharactersPerJob)
+        {
+            for (auto& character : characters)
+            {
+                SkinningPalette::compute(character);
+            }
+            return;
+        }
+
+        // Characters only write their own matrices, so no synchronization is needed inside the pass
+        btEngine::JobHandle palettes = jobSystem->dispatch(count, CharactersPerJob, [&characters](btEngine::JobArgs args)
+        {
+            SkinningPalette::compute(characters[args.jobIndex]);
+        });
+        jobSystem->wait(palettes);
+    }
+}
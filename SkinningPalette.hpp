@@ -0,0 +1,148 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SkinningPalette.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SkeletonRestData shared by every character using the same skeleton
+- SkeletonPose local bone transforms stored as structure of arrays
+- SkinningPalette functions computing model space and skinning matrices
+- SkinningPaletteSystem spreading characters across the job system
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../Core/JobSystem.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAnimation
+{
+    /**
+     * @brief Immutable rest data of a skeleton, shared by every character using it
+     *
+     * Bones are stored in hierarchy order (every parent before its children) so the
+     * model space pass is a single forward loop. order maps that position back to the
+     * bone index used by the mesh, poses and palettes use the mesh order.
+    */
+    struct SkeletonRestData
+    {
+        static constexpr int32_t NoParent = -1;
+
+        std::vector<int32_t> parents;               // Parent position in hierarchy order, NoParent for roots
+        std::vector<uint32_t> order;                // Hierarchy position -> mesh bone index
+        std::vector<glm::mat4> inverseBind;         // Per hierarchy position
+        uint64_t hash = 0;
+
+        uint32_t getBoneCount() const { return static_cast<uint32_t>(parents.size()); }
+    };
+
+    /**
+     * @brief Local bone transforms of one character, one array per component
+    */
+    struct SkeletonPose
+    {
+        std::vector<float> tx, ty, tz;              // Translation
+        std::vector<float> rx, ry, rz, rw;          // Rotation quaternion
+        std::vector<float> sx, sy, sz;              // Scale
+
+        void resize(uint32_t boneCount);            // New bones get the identity transform
+        uint32_t getBoneCount() const { return static_cast<uint32_t>(tx.size()); }
+    };
+
+    /**
+     * @brief Skeleton, pose and output matrices of one skinned character
+    */
+    struct SkinnedCharacter
+    {
+        std::shared_ptr<const SkeletonRestData> skeleton;
+        SkeletonPose pose;                          // Local pose, mesh bone order
+        std::vector<glm::mat4> local;               // Mesh order, scratch of the local pass
+        std::vector<glm::mat4> modelSpace;          // Hierarchy order, scratch of the model space pass
+        std::vector<glm::mat4> palette;             // Skinning matrices, mesh bone order, uploaded to the shader
+    };
+
+    /**
+     * @brief Deduplicated skeleton rest data
+     *
+     * This class handles:
+     * 1. Sorting bones into hierarchy order
+     * 2. Sharing one SkeletonRestData between every mesh with the same bones and bind pose
+     * 3. Dropping the entries of skeletons no mesh uses any more, on demand or as new ones come in
+    */
+    class SkeletonCache
+    {
+    public:
+        /**
+         * @brief Gets the shared rest data for a skeleton, creating it on first use
+         * @param parents Parent bone index per bone (mesh order), negative for roots
+         * @param inverseBind Inverse bind matrix per bone (mesh order)
+         * @return Shared rest data, nullptr if the hierarchy has a cycle or the arrays do not match
+        */
+        static std::shared_ptr<const SkeletonRestData> getOrCreate(const std::vector<int32_t>& parents,
+            const std::vector<glm::mat4>& inverseBind);
+
+        // Erases the entries of expired skeletons, returns how many were erased
+        static size_t prune();
+
+        static size_t getSkeletonCount();
+        static void clear();
+
+    private:
+        static constexpr size_t PruneThreshold = 64;    // Smaller caches are not worth sweeping
+
+        static size_t pruneLocked();
+
+        static std::unordered_map<uint64_t, std::weak_ptr<const SkeletonRestData>>  s_skeletons;
+        static size_t                                                               s_lookupsSincePrune;    // Lookups since the last sweep
+        static std::mutex                                                           s_mutex;
+    };
+
+    namespace SkinningPalette
+    {
+        /**
+         * @brief Multiplies two column major 4x4 matrices, out = a * b
+         *
+         * Uses SSE when available, out may alias a or b.
+        */
+        void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+        /**
+         * @brief Computes the skinning palette of one character
+         * @param character Character to update, its pose must match its skeleton
+        */
+        void compute(SkinnedCharacter& character);
+
+        // True when multiply() uses the SSE path
+        bool isSimdEnabled();
+    }
+
+    /**
+     * @brief Computes the palettes of every character of a crowd
+     *
+     * Characters are independent, so they are split into groups and spread across the job system.
+    */
+    class SkinningPaletteSystem
+    {
+    public:
+        static constexpr uint32_t CharactersPerJob = 16;
+
+        /**
+         * @brief Computes the palette of every character
+         * @param characters Characters to update
+         * @param jobSystem Job system to run on, nullptr computes on the calling thread
+        */
+        static void computeAll(std::vector<SkinnedCharacter>& characters, btEngine::JobSystem* jobSystem);
+    };
+}
@@ -0,0 +1,76 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       StatusBar.cpp
+@project    TeaEditor
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Editor status bar showing the progress of queued background tasks
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "StatusBar.hpp"
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaEditor
+{
+    void StatusBar::render(const btEngine::MainLoopTaskQueue& taskQueue)
+    {
+        // Pin a one line window to the bottom of the main viewport
+        ImGuiViewport* viewport = ImGui::GetMainViewport();
+        const float height = ImGui::GetFrameHeight();
+
+        ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x, viewport->WorkPos.y + viewport->WorkSize.y - height));
+        ImGui::SetNextWindowSize(ImVec2(viewport->WorkSize.x, height));
+        ImGui::SetNextWindowViewport(viewport->ID);
+
+        ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove |
+            ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDocking |
+            ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(6.0f, 0.0f));
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+        if (ImGui::Begin("##StatusBar", nullptr, flags))
+        {
+            std::vector<btEngine::TaskStatus> tasks = taskQueue.getStatus();
+            if (tasks.empty())
+            {
+                ImGui::AlignTextToFramePadding();
+                ImGui::TextDisabled("Ready");
+            }
+            else
+            {
+                // Only the oldest task gets a progress bar, the rest are summarised
+                const auto& current = tasks.front();
+                ImGui::AlignTextToFramePadding();
+                ImGui::Text("%s", current.progress.label.c_str());
+                ImGui::SameLine();
+
+                if (current.progress.total > 0)
+                {
+                    char overlay[64];
+                    snprintf(overlay, sizeof(overlay), "%u / %u", current.progress.completed, current.progress.total);
+                    ImGui::ProgressBar(current.progress.getFraction(), ImVec2(200.0f, 0.0f), overlay);
+                }
+                else
+                {
+                    ImGui::TextDisabled("working...");
+                }
+
+                if (tasks.size() > 1)
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(+%d queued)", static_cast<int>(tasks.size() - 1));
+                }
+
+                ImGui::SameLine();
+                ImGui::TextDisabled("%.2f ms", taskQueue.getLastFrameMs());
+            }
+        }
+        ImGui::End();
+        ImGui::PopStyleVar(2);
+    }
+}
@@ -0,0 +1,37 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file       StatusBar.hpp
+@project    TeaEditor
+@author(s)  Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Editor status bar showing the progress of queued background tasks
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include "imgui.h"
+#include "../Src/Core/engine.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaEditor
+{
+    class StatusBar
+    {
+    public:
+        /**
+         * @brief Renders the status bar along the bottom of the main viewport
+         *
+         * This function handles:
+         * 1. Docking a thin window to the bottom edge of the main viewport
+         * 2. Showing the name and progress of the oldest running task
+         * 3. Showing how many other tasks are waiting behind it
+         * 4. Showing the time the queue used last frame
+         *
+         * @param taskQueue Main loop task queue to report on
+         */
+        static void render(const btEngine::MainLoopTaskQueue& taskQueue);
+    };
+}
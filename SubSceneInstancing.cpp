@@ -0,0 +1,528 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SubSceneInstancing.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- Shared sub-scene loading and caching
+- Sub-scene instance placement, override resolution and materialization
+- Restoring saved instances after a scene is loaded
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "SubSceneInstancing.hpp"
+#include "OfflinePrefabPropagation.hpp"
+#include "SchemaMigration.hpp"
+#include "../Core/BlockCompression.hpp"
+#include "../Core/Serializer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <glm/gtc/quaternion.hpp>
+#include <rapidjson/document.h>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace TeaAsset
+{
+    std::unordered_map<std::string, std::shared_ptr<SharedSubScene>> SubSceneInstancing::s_subScenes;
+
+    namespace
+    {
+        std::string makeKey(const std::string& scenePath)
+        {
+            return std::filesystem::path(scenePath).lexically_normal().generic_string();
+        }
+
+        const TeaComponents::SubSceneInstanceComponent::Override* findOverride(
+            const TeaComponents::SubSceneInstanceComponent& component, uint32_t entityIndex, const std::string& typeName,
+            const std::string& propName)
+        {
+            for (const auto& entry : component.overrides)
+            {
+                if (entry.entityIndex == entityIndex && entry.typeName == typeName && entry.propName == propName)
+                {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+
+        // Unsigned 64 bit member of a serialized component, e.g. the UUIDComponent uuid
+        bool readComponentUint64(const rapidjson::Value& entity, const char* componentName, const char* key, uint64_t& value)
+        {
+            auto component = entity.FindMember(componentName);
+            if (component == entity.MemberEnd() || !component->value.IsObject()) return false;
+
+            auto member = component->value.FindMember(key);
+            if (member == component->value.MemberEnd() || !member->value.IsUint64()) return false;
+
+            value = member->value.GetUint64();
+            return true;
+        }
+
+        // Value of a property in the shared data, invalid if the entity does not have it
+        rttr::variant readShared(const TeaAsset::SharedSubScene& shared, uint32_t entityIndex, const std::string& typeName,
+            const std::string& propName)
+        {
+            if (entityIndex >= shared.getEntityCount()) return {};
+
+            const auto* sharedComponent = shared.entities[entityIndex]->findComponent(typeName);
+            if (!sharedComponent) return {};
+
+            rttr::property prop = sharedComponent->type.get_property(propName);
+            return prop.is_valid() ? prop.get_value(rttr::instance(sharedComponent->prototype)) : rttr::variant();
+        }
+
+        /**
+         * @brief Links a materialized entity to its parent the way the scene file stores it
+         *
+         * The Parent component holds the parent's UUID and the parent's Child component lists
+         * the UUIDs of its children.
+        */
+        void linkParent(btEngine::Entity& child, btEngine::Entity& parent)
+        {
+            const char* parentComponent = TeaAsset::SceneFileSchema::ParentComponent;
+            if (!child.hasComponent(parentComponent))
+            {
+                child.addComponent(parentComponent);
+            }
+
+            rttr::variant parentVar = child.getComponent(parentComponent);
+            rttr::property parentProp = rttr::type::get_by_name(parentComponent).get_property(TeaAsset::SceneFileSchema::ParentKey);
+            rttr::variant parentUUID = static_cast<uint64_t>(parent.getUUID());
+            rttr::instance parentInstance = parentVar;
+            if (!parentVar.is_valid() || !parentProp.is_valid() || !parentUUID.convert(parentProp.get_type()) ||
+                !parentProp.set_value(parentInstance, parentUUID))
+            {
+                TEA_WARNING("Failed to link a materialized sub-scene entity to its parent");
+                return;
+            }
+
+            if (!parent.hasComponent("Child"))
+            {
+                parent.addComponent("Child");
+            }
+
+            rttr::variant childVar = parent.getComponent("Child");
+            if (!childVar.is_valid()) return;
+
+            // The child list is the component's sequential property
+            rttr::instance childInstance = childVar;
+            for (auto& prop : rttr::type::get_by_name("Child").get_properties())
+            {
+                rttr::variant children = prop.get_value(childInstance);
+                if (!children.is_sequential_container()) continue;
+
+                auto view = children.create_sequential_view();
+                rttr::variant childUUID = static_cast<uint64_t>(child.getUUID());
+                if (childUUID.convert(view.get_value_type()) && view.insert(view.end(), childUUID).is_valid())
+                {
+                    prop.set_value(childInstance, children);
+                }
+                return;
+            }
+        }
+
+        // Places a sub-scene local transform under the instance root, rotations are Euler degrees
+        void composeTransform(const glm::vec3& rootPosition, const glm::vec3& rootRotation, const glm::vec3& rootScale,
+            TeaComponents::Transform& transform)
+        {
+            const glm::quat rootOrientation(glm::radians(rootRotation));
+            const glm::quat localOrientation(glm::radians(transform.getRotation()));
+
+            transform.setPosition(rootPosition + rootOrientation * (rootScale * transform.getPosition()));
+            transform.setRotation(glm::degrees(glm::eulerAngles(rootOrientation * localOrientation)));
+            transform.setScale(rootScale * transform.getScale());
+        }
+    }
+
+    std::shared_ptr<SharedSubScene> SubSceneInstancing::load(const std::string& scenePath)
+    {
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(scenePath, contents))
+        {
+            TEA_ERROR("Failed to open sub-scene: {0}", scenePath);
+            return nullptr;
+        }
+
+        rapidjson::Document document;
+        document.Parse(contents.c_str(), contents.size());
+        const char* entitiesKey = SceneFileSchema::EntitiesKey;
+        if (document.HasParseError() || !document.IsObject() || !document.HasMember(entitiesKey) || !document[entitiesKey].IsArray())
+        {
+            TEA_ERROR("Failed to parse sub-scene: {0}", scenePath);
+            return nullptr;
+        }
+        if (!SchemaMigration::checkOnLoad(document, scenePath))
+        {
+            return nullptr;
+        }
+
+        auto shared = std::make_shared<SharedSubScene>();
+        shared->scenePath = makeKey(scenePath);
+        shared->entities.reserve(document[entitiesKey].Size());
+
+        std::vector<const rapidjson::Value*> entityData;
+        entityData.reserve(document[entitiesKey].Size());
+        std::unordered_map<uint64_t, uint32_t> indexByUUID;
+        for (const auto& data : document[entitiesKey].GetArray())
+        {
+            if (!data.IsObject()) continue;
+
+            uint64_t uuid = 0;
+            if (readComponentUint64(data, SceneFileSchema::UUIDComponent, SceneFileSchema::UUIDKey, uuid))
+            {
+                indexByUUID.emplace(uuid, static_cast<uint32_t>(entityData.size()));
+            }
+
+            // Same prototypes as lightweight prefab instances, identity and hierarchy data is left out
+            shared->entities.push_back(PrefabFlyweight::build(0, data));
+            entityData.push_back(&data);
+        }
+
+        // The hierarchy is kept as indices, materialized entities get new UUIDs
+        const uint32_t count = static_cast<uint32_t>(entityData.size());
+        shared->parents.assign(count, SharedSubScene::NoParent);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint64_t parentUUID = 0;
+            if (!readComponentUint64(*entityData[i], SceneFileSchema::ParentComponent, SceneFileSchema::ParentKey, parentUUID)) continue;
+
+            auto it = indexByUUID.find(parentUUID);
+            if (it != indexByUUID.end() && it->second != i)
+            {
+                shared->parents[i] = it->second;
+            }
+        }
+
+        // A looping chain is cut at the entity that closes it, so every entity reaches a root
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t current = i;
+            uint32_t steps = 0;
+            while (shared->parents[current] != SharedSubScene::NoParent && steps <= count)
+            {
+                current = shared->parents[current];
+                steps++;
+            }
+            if (steps > count)
+            {
+                TEA_WARNING("Sub-scene {0} has a looping hierarchy, entity {1} is made a root", scenePath, i);
+                shared->parents[i] = SharedSubScene::NoParent;
+            }
+        }
+        return shared;
+    }
+
+    std::shared_ptr<const SharedSubScene> SubSceneInstancing::acquire(const std::string& scenePath)
+    {
+        const std::string key = makeKey(scenePath);
+        auto it = s_subScenes.find(key);
+        if (it != s_subScenes.end())
+        {
+            return it->second;
+        }
+
+        auto shared = load(scenePath);
+        if (!shared)
+        {
+            return nullptr;
+        }
+
+        s_subScenes[key] = shared;
+        TEA_INFO("Loaded sub-scene {0} with {1} entities for instancing", key, shared->getEntityCount());
+        return shared;
+    }
+
+    size_t SubSceneInstancing::refresh(const std::string& scenePath, entt::registry& registry)
+    {
+        const std::string key = makeKey(scenePath);
+        auto it = s_subScenes.find(key);
+        if (it == s_subScenes.end())
+        {
+            return 0;
+        }
+
+        auto shared = load(scenePath);
+        if (!shared)
+        {
+            return 0;
+        }
+        it->second = shared;
+
+        // Overrides are kept, the ones pointing past the new entity count are simply ignored
+        size_t repointed = 0;
+        auto view = registry.view<TeaComponents::SubSceneInstanceComponent>();
+        for (auto entityHandle : view)
+        {
+            auto& instance = view.get<TeaComponents::SubSceneInstanceComponent>(entityHandle);
+            if (instance.scenePath == key)
+            {
+                instance.shared = shared;
+                repointed++;
+            }
+        }
+        return repointed;
+    }
+
+    btEngine::Entity SubSceneInstancing::instantiate(SceneManager::sceneManager* sceneManager, const std::string& scenePath,
+        const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+    {
+        auto shared = acquire(scenePath);
+        if (!shared)
+        {
+            return {};
+        }
+
+        btEngine::Entity entity = sceneManager->createEntity();
+        if (!entity.hasComponent<TeaComponents::Transform>())
+        {
+            entity.addComponent<TeaComponents::Transform>();
+        }
+
+        auto& transform = entity.getComponent<TeaComponents::Transform>();
+        transform.setPosition(position);
+        transform.setRotation(rotation);
+        transform.setScale(scale);
+
+        auto& component = entity.addComponent<TeaComponents::SubSceneInstanceComponent>();
+        component.scenePath = shared->scenePath;
+        component.shared = shared;
+        return entity;
+    }
+
+    bool SubSceneInstancing::isInstance(btEngine::Entity& entity)
+    {
+        return entity.hasComponent<TeaComponents::SubSceneInstanceComponent>();
+    }
+
+    rttr::variant SubSceneInstancing::readProperty(btEngine::Entity& instance, uint32_t entityIndex, const std::string& typeName,
+        const std::string& propName)
+    {
+        if (!isInstance(instance)) return {};
+
+        const auto& component = instance.getComponent<TeaComponents::SubSceneInstanceComponent>();
+        if (const auto* entry = findOverride(component, entityIndex, typeName, propName))
+        {
+            return entry->value;
+        }
+
+        return component.shared ? readShared(*component.shared, entityIndex, typeName, propName) : rttr::variant();
+    }
+
+    bool SubSceneInstancing::setOverride(btEngine::Entity& instance, uint32_t entityIndex, const std::string& typeName,
+        const std::string& propName, const rttr::variant& value)
+    {
+        if (!isInstance(instance))
+        {
+            TEA_WARNING("Entity is not a sub-scene instance, edit its entities directly. Cannot override {0}/{1}.", typeName, propName);
+            return false;
+        }
+
+        auto& component = instance.getComponent<TeaComponents::SubSceneInstanceComponent>();
+        if (!component.shared || entityIndex >= component.shared->getEntityCount())
+        {
+            TEA_WARNING("Sub-scene entity {0} does not exist. Cannot override {1}/{2}.", entityIndex, typeName, propName);
+            return false;
+        }
+
+        const auto* sharedComponent = component.shared->entities[entityIndex]->findComponent(typeName);
+        if (!sharedComponent || !sharedComponent->type.get_property(propName).is_valid())
+        {
+            TEA_WARNING("Sub-scene entity {0} has no property {1}/{2}", entityIndex, typeName, propName);
+            return false;
+        }
+
+        auto existing = std::find_if(component.overrides.begin(), component.overrides.end(),
+            [&](const TeaComponents::SubSceneInstanceComponent::Override& entry) {
+                return entry.entityIndex == entityIndex && entry.typeName == typeName && entry.propName == propName;
+            });
+        if (existing != component.overrides.end())
+        {
+            existing->value = value;
+            return true;
+        }
+
+        component.overrides.push_back({ entityIndex, typeName, propName, value });
+        return true;
+    }
+
+    std::vector<btEngine::Entity> SubSceneInstancing::materialize(SceneManager::sceneManager* sceneManager, btEngine::Entity& instance)
+    {
+        std::vector<btEngine::Entity> created;
+        if (!isInstance(instance)) return created;
+
+        // Copied out, creating entities may move the component pools
+        auto component = instance.getComponent<TeaComponents::SubSceneInstanceComponent>();
+        if (!component.shared)
+        {
+            TEA_WARNING("Sub-scene {0} is not loaded, its instance cannot be materialized", component.scenePath);
+            return created;
+        }
+
+        const auto& rootTransform = instance.getComponent<TeaComponents::Transform>();
+        const glm::vec3 rootPosition = rootTransform.getPosition();
+        const glm::vec3 rootRotation = rootTransform.getRotation();
+        const glm::vec3 rootScale = rootTransform.getScale();
+
+        const SharedSubScene& shared = *component.shared;
+        created.reserve(shared.getEntityCount());
+        for (uint32_t index = 0; index < shared.getEntityCount(); index++)
+        {
+            btEngine::Entity entity = sceneManager->createEntity();
+            for (const auto& sharedComponent : shared.entities[index]->components)
+            {
+                if (sharedComponent.typeName == "Child" || sharedComponent.typeName == "Parent") continue;
+
+                if (!entity.hasComponent(sharedComponent.typeName))
+                {
+                    entity.addComponent(sharedComponent.typeName);
+                }
+                rttr::variant componentVar = entity.getComponent(sharedComponent.typeName);
+                if (!componentVar.is_valid())
+                {
+                    TEA_WARNING("Failed to materialize component {0}", sharedComponent.typeName);
+                    continue;
+                }
+                PrefabFlyweight::copyProperties(sharedComponent.type, sharedComponent.prototype, componentVar);
+            }
+
+            // Overrides are in sub-scene space, so they go in before the root transform is applied
+            for (const auto& entry : component.overrides)
+            {
+                if (entry.entityIndex != index) continue;
+
+                rttr::variant componentVar = entity.getComponent(entry.typeName);
+                rttr::property prop = rttr::type::get_by_name(entry.typeName).get_property(entry.propName);
+                rttr::instance target = componentVar;
+                if (!componentVar.is_valid() || !prop.is_valid() || !prop.set_value(target, entry.value))
+                {
+                    TEA_WARNING("Failed to apply sub-scene override {0}/{1}", entry.typeName, entry.propName);
+                }
+            }
+            created.push_back(entity);
+        }
+
+        // Children stay relative to their parent, only the roots are placed under the instance
+        for (uint32_t index = 0; index < shared.getEntityCount(); index++)
+        {
+            const uint32_t parent = index < shared.parents.size() ? shared.parents[index] : SharedSubScene::NoParent;
+            if (parent != SharedSubScene::NoParent)
+            {
+                linkParent(created[index], created[parent]);
+            }
+            else if (created[index].hasComponent<TeaComponents::Transform>())
+            {
+                composeTransform(rootPosition, rootRotation, rootScale, created[index].getComponent<TeaComponents::Transform>());
+            }
+        }
+
+        instance.removeComponent<TeaComponents::SubSceneInstanceComponent>();
+        return created;
+    }
+
+    size_t SubSceneInstancing::materializeAll(SceneManager::sceneManager* sceneManager)
+    {
+        auto* registry = sceneManager->getRegistry();
+
+        // Collected first, materializing adds entities to the registry
+        std::vector<entt::entity> instances;
+        for (auto entityHandle : registry->view<TeaComponents::SubSceneInstanceComponent>())
+        {
+            instances.push_back(entityHandle);
+        }
+
+        for (entt::entity entityHandle : instances)
+        {
+            btEngine::Entity instance(entityHandle, registry);
+            materialize(sceneManager, instance);
+        }
+        return instances.size();
+    }
+
+    size_t SubSceneInstancing::restoreInstances(entt::registry& registry, const rapidjson::Value& document)
+    {
+        const char* entitiesKey = SceneFileSchema::EntitiesKey;
+        if (!document.IsObject() || !document.HasMember(entitiesKey) || !document[entitiesKey].IsArray()) return 0;
+
+        std::unordered_map<uint64_t, entt::entity> entityByUUID;
+        for (auto entityHandle : registry.view<TeaComponents::UUIDComponent>())
+        {
+            entityByUUID.emplace(static_cast<uint64_t>(btEngine::Entity(entityHandle, &registry).getUUID()), entityHandle);
+        }
+
+        size_t restored = 0;
+        for (const auto& entityData : document[entitiesKey].GetArray())
+        {
+            if (!entityData.IsObject()) continue;
+
+            auto instanceData = entityData.FindMember(SceneFileSchema::SubSceneInstanceKey);
+            if (instanceData == entityData.MemberEnd() || !instanceData->value.IsObject()) continue;
+
+            uint64_t uuid = 0;
+            if (!readComponentUint64(entityData, SceneFileSchema::UUIDComponent, SceneFileSchema::UUIDKey, uuid)) continue;
+            auto entityIt = entityByUUID.find(uuid);
+            if (entityIt == entityByUUID.end()) continue;
+
+            auto path = instanceData->value.FindMember(SceneFileSchema::SubScenePath);
+            if (path == instanceData->value.MemberEnd() || !path->value.IsString()) continue;
+
+            // Kept even if the file is missing, so saving the scene again does not lose the placement
+            auto& component = registry.emplace_or_replace<TeaComponents::SubSceneInstanceComponent>(entityIt->second);
+            component.scenePath = makeKey(path->value.GetString());
+            component.shared = acquire(component.scenePath);
+            restored++;
+
+            auto overrides = instanceData->value.FindMember(SceneFileSchema::SubSceneOverrides);
+            if (!component.shared || overrides == instanceData->value.MemberEnd() || !overrides->value.IsArray()) continue;
+
+            for (const auto& entry : overrides->value.GetArray())
+            {
+                if (!entry.IsObject()) continue;
+
+                auto entityIndex = entry.FindMember(SceneFileSchema::SubSceneEntityIndex);
+                auto typeName = entry.FindMember(SceneFileSchema::SubSceneComponent);
+                auto propName = entry.FindMember(SceneFileSchema::SubSceneProperty);
+                auto value = entry.FindMember(SceneFileSchema::SubSceneValue);
+                if (entityIndex == entry.MemberEnd() || !entityIndex->value.IsUint() || typeName == entry.MemberEnd() ||
+                    !typeName->value.IsString() || propName == entry.MemberEnd() || !propName->value.IsString() ||
+                    value == entry.MemberEnd()) continue;
+
+                // The shared value gives the override its type, overrides of properties that are gone are dropped
+                TeaComponents::SubSceneInstanceComponent::Override restoredEntry{ entityIndex->value.GetUint(),
+                    typeName->value.GetString(), propName->value.GetString(), {} };
+                restoredEntry.value = readShared(*component.shared, restoredEntry.entityIndex, restoredEntry.typeName, restoredEntry.propName);
+                if (!restoredEntry.value.is_valid())
+                {
+                    TEA_WARNING("Dropped sub-scene override {0}/{1}, {2} no longer has it", restoredEntry.typeName,
+                        restoredEntry.propName, component.scenePath);
+                    continue;
+                }
+
+                Serialize::deserializeEachProperty(value->value, restoredEntry.value, restoredEntry.value.get_type());
+                component.overrides.push_back(std::move(restoredEntry));
+            }
+        }
+        return restored;
+    }
+
+    SubSceneInstanceStats SubSceneInstancing::getStats(entt::registry& registry)
+    {
+        SubSceneInstanceStats stats;
+        stats.sharedSubScenes = s_subScenes.size();
+
+        auto view = registry.view<TeaComponents::SubSceneInstanceComponent>();
+        for (auto entityHandle : view)
+        {
+            const auto& instance = view.get<TeaComponents::SubSceneInstanceComponent>(entityHandle);
+            stats.instances++;
+            stats.virtualEntities += instance.shared ? instance.shared->getEntityCount() : 0;
+            stats.overrides += instance.overrides.size();
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,191 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      SubSceneInstancing.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- SharedSubScene holding the immutable entities of a sub-scene file
+- SubSceneInstanceComponent, one placement of a sub-scene with its overrides
+- SubSceneInstancing class for placing, reading, overriding and materializing instances
+- Restoring saved instances after a scene is loaded
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <rapidjson/document.h>
+#include <rttr/type>
+
+#include "../Core/entity.hpp"
+#include "../Core/Scenemanager.hpp"
+#include "PrefabFlyweight.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace TeaAsset
+{
+    /**
+     * @brief Immutable entities of a sub-scene file, loaded once and shared by every placement
+    */
+    struct SharedSubScene
+    {
+        static constexpr uint32_t NoParent = UINT32_MAX;
+
+        std::string scenePath;
+        std::vector<std::shared_ptr<const SharedPrefabData>> entities;     // File order, indexed by overrides
+        std::vector<uint32_t> parents;                                      // Parent index of each entity, NoParent for the roots
+
+        size_t getEntityCount() const { return entities.size(); }
+    };
+}
+
+namespace TeaComponents
+{
+    /**
+     * @brief One placement of a sub-scene
+     *
+     * The entity holding it owns a UUIDComponent and the Transform of the placement root.
+     * The sub-scene entities only exist as shared data until the instance is materialized.
+     *
+     * Not an rttr component: SceneWriter saves the path and the overrides under
+     * SceneFileSchema::SubSceneInstanceKey and SubSceneInstancing::restoreInstances
+     * rebuilds the component, shared data included, once the scene is loaded.
+    */
+    struct SubSceneInstanceComponent
+    {
+        struct Override
+        {
+            uint32_t entityIndex = 0;   // Entity of the sub-scene, in file order
+            std::string typeName;
+            std::string propName;
+            rttr::variant value;
+        };
+
+        std::string scenePath;                                      // Saved, the shared data is looked up from it
+        std::shared_ptr<const TeaAsset::SharedSubScene> shared;     // Runtime only, nullptr if the file failed to load
+        std::vector<Override> overrides;
+    };
+}
+
+namespace TeaAsset
+{
+    struct SubSceneInstanceStats
+    {
+        size_t instances = 0;           // Placements still sharing their data
+        size_t sharedSubScenes = 0;     // Distinct sub-scenes loaded
+        size_t virtualEntities = 0;     // Entities the placements stand for
+        size_t overrides = 0;
+    };
+
+    /**
+     * @brief Sub-scenes placed many times across a level without duplicating their entities
+     *
+     * This class handles:
+     * 1. Loading the component data of a sub-scene file once and caching it by path
+     * 2. Placing instances that only own a root transform and their overrides
+     * 3. Resolving property reads to an override or to the shared data
+     * 4. Materializing an instance into regular entities when it is edited or simulated
+     * 5. Repointing every instance when the sub-scene file changes
+    */
+    class SubSceneInstancing
+    {
+    public:
+        /**
+         * @brief Gets the shared data of a sub-scene, loading it the first time
+         * @param scenePath Sub-scene file
+         * @return Shared data, nullptr if the file could not be read
+        */
+        static std::shared_ptr<const SharedSubScene> acquire(const std::string& scenePath);
+
+        /**
+         * @brief Reloads a sub-scene after it was saved and repoints its instances
+         * @param scenePath Sub-scene file
+         * @param registry Registry holding the instances
+         * @return Number of instances repointed
+        */
+        static size_t refresh(const std::string& scenePath, entt::registry& registry);
+
+        /**
+         * @brief Places an instance of a sub-scene
+         * @param sceneManager Scene manager to create the root entity in
+         * @param scenePath Sub-scene file
+         * @param position Root position
+         * @param rotation Root rotation, Euler degrees like the Transform
+         * @param scale Root scale
+         * @return Root entity of the instance, invalid if the sub-scene could not be loaded
+        */
+        static btEngine::Entity instantiate(SceneManager::sceneManager* sceneManager, const std::string& scenePath,
+            const glm::vec3& position, const glm::vec3& rotation = glm::vec3(0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+        static bool isInstance(btEngine::Entity& entity);
+
+        /**
+         * @brief Reads a property of one sub-scene entity, from the overrides first
+         * @param instance Root entity of the instance
+         * @param entityIndex Entity of the sub-scene, in file order
+         * @param typeName Registered component name
+         * @param propName Property name
+         * @return Property value, invalid if the entity does not have it
+        */
+        static rttr::variant readProperty(btEngine::Entity& instance, uint32_t entityIndex, const std::string& typeName,
+            const std::string& propName);
+
+        /**
+         * @brief Overrides a property of one sub-scene entity for this instance only
+         * @param instance Root entity of the instance
+         * @param entityIndex Entity of the sub-scene, in file order
+         * @param typeName Registered component name
+         * @param propName Property name
+         * @param value New value
+         * @return False if the instance is materialized or the property does not exist
+        */
+        static bool setOverride(btEngine::Entity& instance, uint32_t entityIndex, const std::string& typeName,
+            const std::string& propName, const rttr::variant& value);
+
+        /**
+         * @brief Turns an instance into regular entities placed under its root transform
+         *
+         * Only the sub-scene roots are moved by the root transform, the other entities keep
+         * their local transform and get their Parent / Child links back.
+         *
+         * @param sceneManager Scene manager to create the entities in
+         * @param instance Root entity of the instance, keeps its transform and loses the instance component
+         * @return Created entities, in sub-scene file order
+        */
+        static std::vector<btEngine::Entity> materialize(SceneManager::sceneManager* sceneManager, btEngine::Entity& instance);
+
+        /**
+         * @brief Materializes every instance, used before simulation starts
+         * @param sceneManager Scene manager owning the instances
+         * @return Number of instances materialized
+        */
+        static size_t materializeAll(SceneManager::sceneManager* sceneManager);
+
+        /**
+         * @brief Rebuilds the instance components of a scene that was just loaded
+         *
+         * Call right after the scene is deserialized, the entities are matched by UUID.
+         *
+         * @param registry Registry the scene was loaded into
+         * @param document Parsed scene file
+         * @return Number of instances restored
+        */
+        static size_t restoreInstances(entt::registry& registry, const rapidjson::Value& document);
+
+        static SubSceneInstanceStats getStats(entt::registry& registry);
+
+    private:
+        static std::shared_ptr<SharedSubScene> load(const std::string& scenePath);
+
+        static std::unordered_map<std::string, std::shared_ptr<SharedSubScene>> s_subScenes;
+    };
+}
@@ -0,0 +1,103 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      Task.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- CoroutineScheduler implementation
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "Task.hpp"
+
+#include <mutex>
+#include <unordered_set>
+
+/*                                                              function definitions
+====================================================================================*/
+namespace
+{
+    std::unordered_set<void*>   s_detached;
+    std::mutex                  s_detachedMutex;
+}
+
+namespace btEngine
+{
+    namespace detail
+    {
+        void trackDetached(std::coroutine_handle<> handle)
+        {
+            std::lock_guard<std::mutex> lock(s_detachedMutex);
+            s_detached.insert(handle.address());
+        }
+
+        void untrackDetached(std::coroutine_handle<> handle)
+        {
+            std::lock_guard<std::mutex> lock(s_detachedMutex);
+            s_detached.erase(handle.address());
+        }
+    }
+
+    JobSystem*          CoroutineScheduler::s_jobSystem = nullptr;
+    MainLoopTaskQueue*  CoroutineScheduler::s_mainLoop  = nullptr;
+
+    void CoroutineScheduler::initialize(JobSystem* jobSystem, MainLoopTaskQueue* mainLoop)
+    {
+        s_jobSystem = jobSystem;
+        s_mainLoop = mainLoop;
+    }
+
+    void CoroutineScheduler::shutdown()
+    {
+        // Resumes posted by the last jobs would touch the frames freed below
+        if (s_mainLoop)
+        {
+            s_mainLoop->discardPosted();
+        }
+        s_jobSystem = nullptr;
+        s_mainLoop = nullptr;
+
+        std::unordered_set<void*> detached;
+        {
+            std::lock_guard<std::mutex> lock(s_detachedMutex);
+            detached.swap(s_detached);
+        }
+
+        // Freeing a detached frame frees the tasks it awaits along with it
+        for (void* address : detached)
+        {
+            std::coroutine_handle<>::from_address(address).destroy();
+        }
+        if (!detached.empty())
+        {
+            TEA_WARNING("Freed {0} coroutines still suspended at shutdown", detached.size());
+        }
+    }
+
+    void CoroutineScheduler::resumeOnMainThread(std::coroutine_handle<> handle)
+    {
+        if (s_mainLoop)
+        {
+            s_mainLoop->post([handle] { handle.resume(); });
+        }
+        else
+        {
+            handle.resume();
+        }
+    }
+
+    void CoroutineScheduler::runOnWorker(std::function<void()> job)
+    {
+        if (s_jobSystem)
+        {
+            s_jobSystem->execute([job = std::move(job)](JobArgs) { job(); });
+        }
+        else
+        {
+            job();
+        }
+    }
+}
@@ -0,0 +1,381 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      Task.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- C++20 coroutine Task type with continuation chaining
+- CoroutineScheduler connecting coroutines to the job system and the main loop queue
+- Awaitables for "next frame", worker jobs, file I/O and asset loads
+- spawn() for starting detached workflows from editor and engine code
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <coroutine>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "../Core/logging.hpp"
+#include "../Core/JobSystem.hpp"
+#include "../Core/TaskQueue.hpp"
+#include "../Asset/AssetManager.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace btEngine
+{
+    /**
+     * @brief Routes coroutine resumption through the engine's job system and main loop queue
+     *
+     * Every awaitable in this file resumes its coroutine on the main thread, through
+     * MainLoopTaskQueue::post, so coroutine bodies can touch the registry and ImGui state
+     * the same way straight-line editor code does. Without a queue (headless tools) the
+     * coroutine is resumed immediately on whichever thread finished the work.
+    */
+    class CoroutineScheduler
+    {
+    public:
+        static void initialize(JobSystem* jobSystem, MainLoopTaskQueue* mainLoop);
+
+        /**
+         * @brief Frees every spawned coroutine that is still suspended
+         *
+         * Call after the job system shut down, so no worker still holds an awaiter. Their
+         * pending resumes are dropped from the main loop queue, which must not run again.
+        */
+        static void shutdown();
+
+        // Resumes the coroutine at the start of the next main loop frame
+        static void resumeOnMainThread(std::coroutine_handle<> handle);
+
+        // Runs the function on a worker, or inline when there is no job system
+        static void runOnWorker(std::function<void()> job);
+
+    private:
+        static JobSystem*           s_jobSystem;
+        static MainLoopTaskQueue*   s_mainLoop;
+    };
+
+    template<typename T = void>
+    class Task;
+
+    namespace detail
+    {
+        struct TaskPromiseBase
+        {
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::exception_ptr exception;
+
+            // Tasks are lazy, they start when awaited or spawned
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // Hand control straight back to whoever awaited the task
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+
+                template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    return handle.promise().continuation;
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() noexcept { exception = std::current_exception(); }
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+            void return_void() noexcept {}
+        };
+    }
+
+    /**
+     * @brief Lazily started coroutine producing a T
+     *
+     * A Task is started by co_await-ing it from another coroutine or by passing it to spawn().
+     * The awaiting coroutine is resumed when the task finishes, and exceptions thrown inside
+     * the task are rethrown at the co_await.
+    */
+    template<typename T>
+    class Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_handle) m_handle.destroy();
+                m_handle = std::exchange(other.m_handle, {});
+            }
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task()
+        {
+            if (m_handle) m_handle.destroy();
+        }
+
+        bool isDone() const { return !m_handle || m_handle.done(); }
+
+        auto operator co_await() noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    // Start the task, it jumps back to the awaiting coroutine when done
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume()
+                {
+                    auto& promise = handle.promise();
+                    if (promise.exception)
+                    {
+                        std::rethrow_exception(promise.exception);
+                    }
+                    if constexpr (!std::is_void_v<T>)
+                    {
+                        return std::move(*promise.value);
+                    }
+                }
+            };
+            return Awaiter{ m_handle };
+        }
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    namespace detail
+    {
+        template<typename T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>{ std::coroutine_handle<TaskPromise<T>>::from_promise(*this) };
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>{ std::coroutine_handle<TaskPromise<void>>::from_promise(*this) };
+        }
+
+        // Spawned coroutines still alive, the scheduler frees the suspended ones on shutdown
+        void trackDetached(std::coroutine_handle<> handle);
+        void untrackDetached(std::coroutine_handle<> handle);
+
+        // Eagerly started coroutine that frees itself when it finishes
+        struct DetachedTask
+        {
+            struct promise_type
+            {
+                ~promise_type() { untrackDetached(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+                DetachedTask get_return_object() noexcept
+                {
+                    trackDetached(std::coroutine_handle<promise_type>::from_promise(*this));
+                    return {};
+                }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept {}
+            };
+        };
+
+        inline DetachedTask runDetached(Task<void> task, std::string name)
+        {
+            try
+            {
+                co_await task;
+            }
+            catch (const std::exception& e)
+            {
+                TEA_ERROR("Coroutine {0} failed: {1}", name, e.what());
+            }
+            catch (...)
+            {
+                TEA_ERROR("Coroutine {0} failed with an unknown exception", name);
+            }
+        }
+    }
+
+    /**
+     * @brief Starts a task without anyone awaiting it, exceptions are logged
+     * @param task Task to run
+     * @param name Name used in the log if the task fails
+    */
+    inline void spawn(Task<void> task, std::string name = "coroutine")
+    {
+        detail::runDetached(std::move(task), std::move(name));
+    }
+
+    /**
+     * @brief Awaitable that resumes the coroutine on the next main loop frame
+    */
+    struct NextFrameAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { CoroutineScheduler::resumeOnMainThread(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    inline NextFrameAwaiter nextFrame() { return {}; }
+
+    /**
+     * @brief Runs a function on a worker thread and resumes the coroutine on the main thread with its result
+     * @param fn Function to run, must not touch main thread only state
+     * @return Awaitable producing the function's return value
+    */
+    template<typename Fn>
+    auto runOnWorker(Fn fn)
+    {
+        using Result = std::invoke_result_t<Fn&>;
+
+        struct WorkerAwaiter
+        {
+            Fn fn;
+            std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result{};
+            std::exception_ptr exception;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                // The awaiter lives in the coroutine frame until it is resumed, so this stays valid
+                CoroutineScheduler::runOnWorker([this, handle]
+                {
+                    try
+                    {
+                        if constexpr (std::is_void_v<Result>)
+                        {
+                            fn();
+                        }
+                        else
+                        {
+                            result.emplace(fn());
+                        }
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+                    CoroutineScheduler::resumeOnMainThread(handle);
+                });
+            }
+
+            Result await_resume()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+                if constexpr (!std::is_void_v<Result>)
+                {
+                    return std::move(*result);
+                }
+            }
+        };
+
+        return WorkerAwaiter{ std::move(fn), {}, {} };
+    }
+
+    /**
+     * @brief Reads a whole file on a worker thread
+     * @param path File to read
+     * @return Awaitable producing the file contents, or nullopt if the file could not be opened
+    */
+    inline auto readFileAsync(std::filesystem::path path)
+    {
+        return runOnWorker([path = std::move(path)]() -> std::optional<std::string>
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+            {
+                return std::nullopt;
+            }
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            return contents.str();
+        });
+    }
+
+    /**
+     * @brief Writes a whole file on a worker thread
+     * @param path File to write
+     * @param contents Bytes to write
+     * @return Awaitable producing true if the file was written
+    */
+    inline auto writeFileAsync(std::filesystem::path path, std::string contents)
+    {
+        return runOnWorker([path = std::move(path), contents = std::move(contents)]() -> bool
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            return static_cast<bool>(file);
+        });
+    }
+
+    /**
+     * @brief Loads an asset without blocking the frame on disk I/O
+     *
+     * Only the disk read moves off the main thread: the source file is read on a worker so
+     * it is in the OS cache, then getAsset still parses and creates the asset on the main
+     * thread, because the asset manager is not thread safe.
+     *
+     * @param handle Handle of the asset to load
+     * @return Task producing the loaded asset, nullptr if it failed
+    */
+    template<typename AssetType>
+    Task<std::shared_ptr<AssetType>> loadAssetAsync(TeaAsset::AssetHandle handle)
+    {
+        std::filesystem::path sourcePath = TeaAsset::AssetManager::getSourceFilePath(handle);
+        co_await readFileAsync(sourcePath);
+        co_return TeaAsset::AssetManager::getAsset<AssetType>(handle);
+    }
+}
@@ -0,0 +1,145 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      TaskQueue.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- MainLoopTaskQueue implementation
+- Budgeted round robin stepping of queued tasks
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "TaskQueue.hpp"
+
+/*                                                              function definitions
+====================================================================================*/
+namespace btEngine
+{
+    uint64_t MainLoopTaskQueue::enqueue(const std::string& name, TaskStep step, std::function<void()> onComplete)
+    {
+        Task task;
+        task.id = m_nextId++;
+        task.name = name;
+        task.step = std::move(step);
+        task.onComplete = std::move(onComplete);
+        task.progress.label = name;
+
+        m_tasks.push_back(std::move(task));
+        TEA_INFO("Queued background task {0} ({1})", name, m_tasks.back().id);
+        return m_tasks.back().id;
+    }
+
+    void MainLoopTaskQueue::cancel(uint64_t id)
+    {
+        // Only flag it, the task may be the one currently running its step
+        for (auto& task : m_tasks)
+        {
+            if (task.id == id)
+            {
+                task.cancelled = true;
+                return;
+            }
+        }
+    }
+
+    void MainLoopTaskQueue::post(std::function<void()> callback)
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posted.push_back(std::move(callback));
+    }
+
+    void MainLoopTaskQueue::discardPosted()
+    {
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        m_posted.clear();
+    }
+
+    bool MainLoopTaskQueue::isIdle() const
+    {
+        if (!m_tasks.empty()) return false;
+
+        std::lock_guard<std::mutex> lock(m_postMutex);
+        return m_posted.empty();
+    }
+
+    void MainLoopTaskQueue::runPostedCallbacks()
+    {
+        std::vector<std::function<void()>> posted;
+        {
+            std::lock_guard<std::mutex> lock(m_postMutex);
+            posted.swap(m_posted);
+        }
+
+        // Callbacks posted while these run are picked up next frame
+        for (auto& callback : posted)
+        {
+            callback();
+        }
+    }
+
+    void MainLoopTaskQueue::runFrame(std::chrono::microseconds budget)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto frameStart = clock::now();
+        const auto deadline = frameStart + budget;
+
+        runPostedCallbacks();
+
+        // Always run at least one step so queued work moves forward even on a busy frame.
+        // Stop early once a full pass over the queue made no progress, the tasks are only
+        // waiting on something else and polling them again would just spin until the deadline
+        bool ranStep = false;
+        size_t idleSteps = 0;
+        while (!m_tasks.empty() && (!ranStep || clock::now() < deadline) && idleSteps < m_tasks.size())
+        {
+            if (m_cursor == m_tasks.end())
+            {
+                m_cursor = m_tasks.begin();
+            }
+
+            auto current = m_cursor++;
+            bool finished = current->cancelled;
+            if (!finished)
+            {
+                const uint32_t completedBefore = current->progress.completed;
+                const uint32_t totalBefore = current->progress.total;
+                finished = current->step(current->progress);
+                ranStep = true;
+
+                const bool progressed = finished || current->progress.completed != completedBefore || current->progress.total != totalBefore;
+                idleSteps = progressed ? 0 : idleSteps + 1;
+            }
+
+            // The step may have cancelled its own task
+            if (finished)
+            {
+                if (!current->cancelled)
+                {
+                    TEA_INFO("Background task {0} finished", current->name);
+                    if (current->onComplete)
+                    {
+                        current->onComplete();
+                    }
+                }
+                m_tasks.erase(current);
+            }
+        }
+
+        m_lastFrameMs = std::chrono::duration<double, std::milli>(clock::now() - frameStart).count();
+    }
+
+    std::vector<TaskStatus> MainLoopTaskQueue::getStatus() const
+    {
+        std::vector<TaskStatus> status;
+        status.reserve(m_tasks.size());
+        for (const auto& task : m_tasks)
+        {
+            if (task.cancelled) continue;
+            status.push_back({ task.id, task.name, task.progress });
+        }
+        return status;
+    }
+}
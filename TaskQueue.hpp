@@ -0,0 +1,141 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      TaskQueue.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- MainLoopTaskQueue class definition
+- Resumable task steps run on the main thread under a per frame time budget
+- Thread safe posting of main thread callbacks
+- Progress reporting for the editor status bar
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*                                                             function declarations
+====================================================================================*/
+namespace btEngine
+{
+    /**
+     * @brief Progress of a queued task, written by the task's step function
+    */
+    struct TaskProgress
+    {
+        std::string label;          // What the task is currently doing
+        uint32_t completed = 0;     // Units of work done
+        uint32_t total = 0;         // Units of work in total, 0 if unknown
+
+        float getFraction() const { return total > 0 ? static_cast<float>(completed) / static_cast<float>(total) : 0.0f; }
+    };
+
+    /**
+     * @brief One resumable step of a long operation
+     *
+     * Called repeatedly on the main thread. Each call should do a small slice of work,
+     * update the progress and return true once the whole operation is finished.
+     * A step that leaves progress.completed and total unchanged counts as waiting, once every queued
+     * task is waiting the queue stops polling for the rest of the frame.
+    */
+    using TaskStep = std::function<bool(TaskProgress&)>;
+
+    /**
+     * @brief Snapshot of a queued task for display purposes
+    */
+    struct TaskStatus
+    {
+        uint64_t id = 0;
+        std::string name;
+        TaskProgress progress;
+    };
+
+    /**
+     * @brief Queue of long running main thread operations split into resumable steps
+     *
+     * This class handles:
+     * 1. Queueing tasks made of resumable steps
+     * 2. Running steps round robin until the per frame budget is spent, carrying the rest over
+     * 3. Running callbacks posted from worker threads on the main thread
+     * 4. Reporting task progress for the status bar
+     *
+     * The window loop calls runFrame() once per frame after polling events, so input keeps
+     * being processed no matter how much work is queued.
+    */
+    class MainLoopTaskQueue
+    {
+    public:
+        static constexpr std::chrono::microseconds DefaultFrameBudget{ 4000 };
+
+        /**
+         * @brief Queues a new task
+         * @param name Name shown in the status bar
+         * @param step Step function, called until it returns true
+         * @param onComplete Optional callback run on the main thread once the task finished
+         * @return Id of the task, used to cancel it
+        */
+        uint64_t enqueue(const std::string& name, TaskStep step, std::function<void()> onComplete = nullptr);
+
+        /**
+         * @brief Cancels a queued task, its completion callback is not run
+         * @param id Id returned by enqueue
+        */
+        void cancel(uint64_t id);
+
+        /**
+         * @brief Runs a callback on the main thread at the start of the next frame
+         *
+         * Safe to call from any thread, used by workers to hand results back.
+         * @param callback Function to run
+        */
+        void post(std::function<void()> callback);
+
+        // Drops the posted callbacks without running them, used on shutdown
+        void discardPosted();
+
+        /**
+         * @brief Runs posted callbacks, then task steps until the budget is spent
+         * @param budget Time the queue is allowed to use this frame
+        */
+        void runFrame(std::chrono::microseconds budget = DefaultFrameBudget);
+
+        // True once no task is queued and no posted callback is waiting to run
+        bool isIdle() const;
+        size_t getPendingCount() const { return m_tasks.size(); }
+        double getLastFrameMs() const { return m_lastFrameMs; }
+
+        /**
+         * @brief Gets the progress of every queued task, oldest first
+         * @return Status of the queued tasks
+        */
+        std::vector<TaskStatus> getStatus() const;
+
+    private:
+        struct Task
+        {
+            uint64_t id = 0;
+            std::string name;
+            TaskStep step;
+            std::function<void()> onComplete;
+            TaskProgress progress;
+            bool cancelled = false;
+        };
+
+        void runPostedCallbacks();
+
+        std::list<Task>                     m_tasks;            // Only touched on the main thread
+        std::list<Task>::iterator           m_cursor = m_tasks.end();
+        std::vector<std::function<void()>>  m_posted;           // Guarded by m_postMutex
+        mutable std::mutex                  m_postMutex;
+        uint64_t                            m_nextId = 1;
+        double                              m_lastFrameMs = 0.0;
+    };
+}
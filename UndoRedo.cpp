@@ -7,6 +7,8 @@ All content (c) 2024 Digipen Institute of Technology Singapore. All rights reser
 Contents:
 - Command interface for encapsulating operations such as execute, undo, and redo.
 - Concrete Command classes for entity creation, transformation, and material changes.
+- Prefab instantiation and property edit commands going through PrefabFlyweight.
+- PropagationRecorder and PrefabPropagationCommand for undoing a whole prefab propagation in one step.
 - CommandManager class for managing undo/redo stacks and Command execution flow.
 ====================================================================================*/
 
@@ -15,6 +17,9 @@ Contents:
 ====================================================================================*/
 #include "UndoRedo.hpp"
 
+#include <algorithm>
+#include <cstdint>
+
 /*                                                              function definitions
 ====================================================================================*/
 namespace Cmd
@@ -23,14 +28,20 @@ namespace Cmd
     {
         cmd->execute();
 
-        // Add Command to undo stack
-        undoStack.push(std::move(cmd));
-
         // Clear redo stack since we cant redo after a new Command
         while (!redoStack.empty())
         {
             redoStack.pop();
         }
+
+        // A Command that cannot be undone would do nothing on undo, keep it off the stack
+        if (!cmd->isUndoable())
+        {
+            return;
+        }
+
+        // Add Command to undo stack
+        undoStack.push(std::move(cmd));
     }
 
     void CommandManager::undo()
@@ -63,13 +74,19 @@ namespace Cmd
         undoStack.push(std::move(cmd));
     }
 
-    CreateEntityCommand::CreateEntityCommand(SceneManager::sceneManager* mgr)
-        : m_sceneManager(mgr) {}
+    CreateEntityCommand::CreateEntityCommand(SceneManager::sceneManager* mgr, const std::string& archetype)
+        : m_sceneManager(mgr), m_archetype(archetype) {}
 
     void CreateEntityCommand::execute()
     {
         // Create new entity and store its UUID
-        m_entity = m_sceneManager->createEntity();
+        m_entity = m_archetype.empty()
+            ? m_sceneManager->createEntity()
+            : SceneManager::ArchetypeLibrary::instantiate(m_sceneManager, m_archetype);
+        if (!m_entity)
+        {
+            m_entity = m_sceneManager->createEntity();
+        }
         m_uuid = m_entity.getUUID();
 
         TEA_INFO("[CreateEntityCommand] execute() called.\n"
@@ -89,6 +106,10 @@ namespace Cmd
     {
         // Recreate entity with same UUID
         m_entity = m_sceneManager->createEntityWithUUID(m_uuid);
+        if (!m_archetype.empty())
+        {
+            SceneManager::ArchetypeLibrary::applyTo(m_sceneManager, m_entity, m_archetype);
+        }
 
         TEA_INFO("[CreateEntityCommand] redo() called.\n" 
             "Recreated entity with UUID: {}", m_uuid.toString());
@@ -209,4 +230,342 @@ namespace Cmd
             TEA_ERROR("Failed to set material property on component instance");
         }
     }
+
+    InstantiatePrefabCommand::InstantiatePrefabCommand(SceneManager::sceneManager* mgr, const TeaAsset::AssetHandle& handle,
+        const glm::vec3& position)
+        : m_sceneManager(mgr), m_handle(handle), m_position(position) {}
+
+    void InstantiatePrefabCommand::execute()
+    {
+        m_entity = TeaAsset::PrefabFlyweight::instantiate(m_sceneManager, m_handle, m_position);
+        if (!m_entity)
+        {
+            TEA_WARNING("[InstantiatePrefabCommand] Failed to instantiate prefab {}", static_cast<uint64_t>(m_handle));
+            return;
+        }
+        m_uuid = m_entity.getUUID();
+
+        TEA_INFO("[InstantiatePrefabCommand] execute() called.\n"
+            "Created prefab instance with UUID: {}", m_uuid.toString());
+    }
+
+    void InstantiatePrefabCommand::undo()
+    {
+        if (!m_entity) return;
+
+        m_sceneManager->destroyEntity(m_entity);
+
+        TEA_INFO("[InstantiatePrefabCommand] undo() called.\n"
+            "Destroyed prefab instance with UUID: {}", m_uuid.toString());
+    }
+
+    void InstantiatePrefabCommand::redo()
+    {
+        if (!m_entity) return;
+
+        // Same UUID so commands above this one still find the instance
+        m_entity = TeaAsset::PrefabFlyweight::instantiate(m_sceneManager, m_handle, m_position, &m_uuid);
+
+        TEA_INFO("[InstantiatePrefabCommand] redo() called.\n"
+            "Recreated prefab instance with UUID: {}", m_uuid.toString());
+    }
+
+    ChangeComponentPropertyCommand::ChangeComponentPropertyCommand(btEngine::Entity entity, std::string typeName,
+        std::string propName, rttr::variant newValue)
+        : m_entity(entity), m_typeName(std::move(typeName)), m_propName(std::move(propName)), m_newValue(std::move(newValue))
+    {
+        // Lightweight instances answer from the shared data, so the old value is known before materializing
+        m_oldValue = TeaAsset::PrefabFlyweight::readProperty(m_entity, m_typeName, m_propName);
+    }
+
+    void ChangeComponentPropertyCommand::execute()
+    {
+        if (!m_oldValue.is_valid())
+        {
+            TEA_WARNING("[ChangeComponentPropertyCommand] {}/{} cannot be read, the edit is skipped", m_typeName, m_propName);
+            return;
+        }
+
+        // writeProperty records the override, remember whether it was already there
+        if (m_entity.hasComponent<TeaComponents::OverrideComponent>())
+        {
+            const auto& properties = m_entity.getComponent<TeaComponents::OverrideComponent>().properties;
+            std::string propertyPath = m_typeName + "/" + m_propName;
+            m_addedOverride = std::none_of(properties.begin(), properties.end(),
+                [&propertyPath](const TeaComponents::OverrideComponent::Property& overrideProp) {
+                    return overrideProp.path == propertyPath;
+                });
+        }
+
+        m_written = TeaAsset::PrefabFlyweight::writeProperty(m_entity, m_typeName, m_propName, m_newValue);
+    }
+
+    void ChangeComponentPropertyCommand::undo()
+    {
+        if (!m_written) return;
+
+        // The instance stays materialized, only the value and the override are put back
+        TeaAsset::PrefabFlyweight::writeProperty(m_entity, m_typeName, m_propName, m_oldValue);
+        if (m_addedOverride && m_entity.hasComponent<TeaComponents::OverrideComponent>())
+        {
+            auto& properties = m_entity.getComponent<TeaComponents::OverrideComponent>().properties;
+            std::string propertyPath = m_typeName + "/" + m_propName;
+            properties.erase(std::remove_if(properties.begin(), properties.end(),
+                [&propertyPath](const TeaComponents::OverrideComponent::Property& overrideProp) {
+                    return overrideProp.path == propertyPath;
+                }), properties.end());
+        }
+    }
+
+    void ChangeComponentPropertyCommand::redo()
+    {
+        if (!m_written) return;
+
+        TeaAsset::PrefabFlyweight::writeProperty(m_entity, m_typeName, m_propName, m_newValue);
+    }
+
+    bool PropagationRecorder::canRecord()
+    {
+        if (m_overflowed) return false;
+
+        if (getChangeCount() >= MaxRecordedChanges)
+        {
+            TEA_WARNING("[PropagationRecorder] More than {} changes recorded, this propagation will not be undoable", MaxRecordedChanges);
+
+            // A partial recording cannot be undone correctly, release all of it
+            m_overflowed = true;
+            m_propertyChanges = {};
+            m_structuralChanges = {};
+            m_sharedDataChanges = {};
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t PropagationRecorder::instanceIndex(uint64_t instanceUUID)
+    {
+        auto it = m_instanceLookup.find(instanceUUID);
+        if (it != m_instanceLookup.end()) return it->second;
+
+        uint32_t index = static_cast<uint32_t>(m_instanceUUIDs.size());
+        m_instanceUUIDs.push_back(instanceUUID);
+        m_instanceLookup.emplace(instanceUUID, index);
+        return index;
+    }
+
+    uint32_t PropagationRecorder::componentIndex(const std::string& typeName)
+    {
+        auto it = m_componentLookup.find(typeName);
+        if (it != m_componentLookup.end()) return it->second;
+
+        uint32_t index = static_cast<uint32_t>(m_componentNames.size());
+        m_componentNames.push_back(typeName);
+        m_componentLookup.emplace(typeName, index);
+        return index;
+    }
+
+    uint32_t PropagationRecorder::propertyIndex(uint32_t component, const rttr::property& prop)
+    {
+        // Only a few dozen distinct properties per propagation, a linear search is enough
+        for (uint32_t i = 0; i < m_properties.size(); i++)
+        {
+            if (m_properties[i].component == component && m_properties[i].prop == prop)
+            {
+                return i;
+            }
+        }
+
+        m_properties.push_back({ component, prop });
+        return static_cast<uint32_t>(m_properties.size() - 1);
+    }
+
+    void PropagationRecorder::recordProperty(uint64_t instanceUUID, const std::string& typeName, const rttr::property& prop,
+        rttr::variant oldValue, rttr::variant newValue)
+    {
+        if (!canRecord()) return;
+
+        uint32_t instance = instanceIndex(instanceUUID);
+        uint32_t property = propertyIndex(componentIndex(typeName), prop);
+        m_propertyChanges.push_back({ instance, property, std::move(oldValue), std::move(newValue) });
+    }
+
+    void PropagationRecorder::recordComponentAdded(uint64_t instanceUUID, const std::string& typeName)
+    {
+        if (!canRecord()) return;
+
+        m_structuralChanges.push_back({ instanceIndex(instanceUUID), componentIndex(typeName), true, rttr::variant() });
+    }
+
+    void PropagationRecorder::recordComponentRemoved(btEngine::Entity& entity, const rttr::type& componentType)
+    {
+        if (!canRecord()) return;
+
+        std::string typeName = componentType.get_name().to_string();
+
+        // Keep a detached copy so undo can put the component back with its values
+        rttr::variant snapshot = componentType.create();
+        rttr::variant componentVar = entity.getComponent(typeName);
+        if (snapshot.is_valid() && componentVar.is_valid())
+        {
+            TeaAsset::PrefabFlyweight::copyProperties(componentType, componentVar, snapshot);
+        }
+
+        uint32_t instance = instanceIndex(static_cast<uint64_t>(entity.getUUID()));
+        m_structuralChanges.push_back({ instance, componentIndex(typeName), false, std::move(snapshot) });
+    }
+
+    void PropagationRecorder::recordSharedData(std::shared_ptr<const TeaAsset::SharedPrefabData> previous,
+        std::shared_ptr<const TeaAsset::SharedPrefabData> current)
+    {
+        if (!previous || !current || m_overflowed) return;
+
+        // Holding the previous data keeps it alive for undo once the instances let go of it
+        m_sharedDataChanges.push_back({ std::move(previous), std::move(current) });
+    }
+
+    PrefabPropagationCommand::PrefabPropagationCommand(SceneManager::sceneManager* mgr, std::string description,
+        std::shared_ptr<PropagationRecorder> recorder)
+        : m_sceneManager(mgr), m_description(std::move(description)), m_recorder(std::move(recorder)) {}
+
+    void PrefabPropagationCommand::execute()
+    {
+        // The propagation already ran before the command was pushed
+        if (m_applied) return;
+
+        applyChanges(false);
+        m_applied = true;
+    }
+
+    void PrefabPropagationCommand::undo()
+    {
+        applyChanges(true);
+        m_applied = false;
+
+        TEA_INFO("[PrefabPropagationCommand] undo() called.\n"
+            "Reverted {} changes on {} instances of {}",
+            m_recorder->getChangeCount(), m_recorder->getInstanceCount(), m_description);
+    }
+
+    void PrefabPropagationCommand::redo()
+    {
+        applyChanges(false);
+        m_applied = true;
+
+        TEA_INFO("[PrefabPropagationCommand] redo() called.\n"
+            "Reapplied {} changes on {} instances of {}",
+            m_recorder->getChangeCount(), m_recorder->getInstanceCount(), m_description);
+    }
+
+    void PrefabPropagationCommand::applyChanges(bool undoing)
+    {
+        auto* registry = m_sceneManager->getRegistry();
+        const PropagationRecorder& rec = *m_recorder;
+
+        // Find every recorded instance in one pass over the scene instead of one lookup per change
+        std::vector<entt::entity> entities(rec.m_instanceUUIDs.size(), entt::null);
+        for (auto entityHandle : registry->view<TeaComponents::UUIDComponent>())
+        {
+            uint64_t uuid = static_cast<uint64_t>(btEngine::Entity(entityHandle, registry).getUUID());
+            auto it = rec.m_instanceLookup.find(uuid);
+            if (it != rec.m_instanceLookup.end())
+            {
+                entities[it->second] = entityHandle;
+            }
+        }
+
+        size_t missing = static_cast<size_t>(std::count(entities.begin(), entities.end(), entt::entity{ entt::null }));
+        if (missing > 0)
+        {
+            TEA_WARNING("[PrefabPropagationCommand] {} instances of {} no longer exist and are skipped", missing, m_description);
+        }
+
+        auto applyStructure = [&](const PropagationRecorder::StructuralChange& change, bool add)
+        {
+            if (entities[change.instance] == entt::null) return;
+
+            btEngine::Entity entity(entities[change.instance], registry);
+            const std::string& typeName = rec.m_componentNames[change.component];
+            if (add)
+            {
+                if (!entity.hasComponent(typeName))
+                {
+                    entity.addComponent(typeName);
+                }
+                if (change.snapshot.is_valid())
+                {
+                    rttr::variant componentVar = entity.getComponent(typeName);
+                    TeaAsset::PrefabFlyweight::copyProperties(rttr::type::get_by_name(typeName), change.snapshot, componentVar);
+                }
+            }
+            else if (entity.hasComponent(typeName))
+            {
+                entity.removeComponent(typeName);
+            }
+        };
+
+        // Consecutive changes mostly hit the same component, so fetch it once per run
+        uint32_t cachedInstance = UINT32_MAX;
+        uint32_t cachedComponent = UINT32_MAX;
+        rttr::variant componentVar;
+        auto applyProperty = [&](const PropagationRecorder::PropertyChange& change, const rttr::variant& value)
+        {
+            if (entities[change.instance] == entt::null) return;
+
+            const auto& slot = rec.m_properties[change.property];
+            if (change.instance != cachedInstance || slot.component != cachedComponent)
+            {
+                btEngine::Entity entity(entities[change.instance], registry);
+                const std::string& typeName = rec.m_componentNames[slot.component];
+                componentVar = entity.hasComponent(typeName) ? entity.getComponent(typeName) : rttr::variant();
+                cachedInstance = change.instance;
+                cachedComponent = slot.component;
+            }
+            if (!componentVar.is_valid()) return;
+
+            rttr::instance component = componentVar;
+            slot.prop.set_value(component, value);
+        };
+
+        if (undoing)
+        {
+            // Old values first (newest change first), then put the structure back
+            for (auto it = rec.m_propertyChanges.rbegin(); it != rec.m_propertyChanges.rend(); ++it)
+            {
+                applyProperty(*it, it->oldValue);
+            }
+            for (auto it = rec.m_structuralChanges.rbegin(); it != rec.m_structuralChanges.rend(); ++it)
+            {
+                applyStructure(*it, !it->added);
+            }
+            for (auto it = rec.m_sharedDataChanges.rbegin(); it != rec.m_sharedDataChanges.rend(); ++it)
+            {
+                TeaAsset::PrefabFlyweight::repoint(*registry, it->current, it->previous);
+            }
+        }
+        else
+        {
+            // Structure first so the added components exist, then the new values
+            for (const auto& change : rec.m_sharedDataChanges)
+            {
+                TeaAsset::PrefabFlyweight::repoint(*registry, change.previous, change.current);
+            }
+            for (const auto& change : rec.m_structuralChanges)
+            {
+                applyStructure(change, change.added);
+            }
+            for (const auto& change : rec.m_propertyChanges)
+            {
+                applyProperty(change, change.newValue);
+            }
+        }
+
+        // Lightweight instances draw from their proxy, which carries their transform
+        for (auto entityHandle : entities)
+        {
+            if (entityHandle != entt::null)
+            {
+                TeaAsset::PrefabFlyweight::updateRenderProxy(*registry, entityHandle);
+            }
+        }
+    }
 }
\ No newline at end of file
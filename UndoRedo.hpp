@@ -7,6 +7,8 @@ All content (c) 2024 Digipen Institute of Technology Singapore. All rights reser
 Contents:
 - Command interface for encapsulating operations such as execute, undo, and redo.
 - Concrete Command classes for entity creation, transformation, and material changes.
+- Prefab instantiation and property edit commands going through PrefabFlyweight.
+- PropagationRecorder and PrefabPropagationCommand for undoing a whole prefab propagation in one step.
 - CommandManager class for managing undo/redo stacks and Command execution flow.
 
 ====================================================================================*/
@@ -17,6 +19,9 @@ Contents:
 #include <memory>     
 #include <stack>      
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../../TeaEngine/Src/Core/logging.hpp"
 #include "../Src/Core/engine.hpp"
@@ -28,6 +33,8 @@ Contents:
 #include "../Src/Components/SoundComponent.hpp"
 #include "Assetbrowser.hpp"
 #include "Graphics/AnimationClip.hpp"
+#include "../Src/Core/Archetype.hpp"
+#include "../Src/Asset/PrefabFlyweight.hpp"
 
 /*                                                             function declarations
 ====================================================================================*/
@@ -45,7 +52,7 @@ namespace Cmd
     {
     public:
         /**
-        * @brief Executes a Command and adds it to the undo stack
+        * @brief Executes a Command and adds it to the undo stack, unless it reports it cannot be undone
         * @param cmd Unique pointer to the Command to execute
         */
         void executeCommand(std::unique_ptr<Command> cmd);
@@ -72,20 +79,28 @@ namespace Cmd
         virtual void execute() = 0;
         virtual void undo() = 0;
         virtual void redo() = 0;
+
+        // Checked after execute, commands that cannot be undone are not kept on the undo stack
+        virtual bool isUndoable() const { return true; }
     };
 
     /**
      * @brief Command for creating new entities in the scene
      *
      * This Command handles:
-     * 1. Entity creation in the scene
+     * 1. Entity creation in the scene, optionally from a named archetype
      * 2. UUID assignment
      * 3. Proper cleanup during undo operations
     */
     class CreateEntityCommand : public Command 
     {
     public:
-        CreateEntityCommand(SceneManager::sceneManager* mgr);
+        /**
+         * @brief Constructs a create entity Command
+         * @param mgr Pointer to the scene manager
+         * @param archetype Archetype the entity is created from, empty for a bare entity
+        */
+        CreateEntityCommand(SceneManager::sceneManager* mgr, const std::string& archetype = "");
 
         void execute() override;
         void undo() override;
@@ -95,6 +110,7 @@ namespace Cmd
         SceneManager::sceneManager* m_sceneManager;
         btEngine::Entity m_entity; // Created entity reference
 		btEngine::UUID m_uuid;     // UUID of the created entity
+        std::string m_archetype;   // Archetype applied on execute and redo
     };
 
     /**
@@ -191,4 +207,204 @@ namespace Cmd
         btEngine::UUID m_oldValue;    // Previous material UUID
         btEngine::UUID m_newValue;    // New material UUID
     };
+
+    /**
+     * @brief Command for placing a prefab instance in the scene
+     *
+     * This Command handles:
+     * 1. Creating a lightweight instance through PrefabFlyweight
+     * 2. Destroying the instance during undo operations
+     * 3. Recreating it with the same UUID on redo
+    */
+    class InstantiatePrefabCommand : public Command
+    {
+    public:
+        /**
+         * @brief Constructs an instantiate prefab Command
+         * @param mgr Pointer to the scene manager
+         * @param handle Asset handle of the prefab
+         * @param position World position of the instance
+        */
+        InstantiatePrefabCommand(SceneManager::sceneManager* mgr, const TeaAsset::AssetHandle& handle, const glm::vec3& position);
+
+        void execute() override;
+        void undo() override;
+        void redo() override;
+
+        btEngine::Entity getEntity() const { return m_entity; }
+
+    private:
+        SceneManager::sceneManager* m_sceneManager;
+        TeaAsset::AssetHandle m_handle;
+        glm::vec3 m_position;
+        btEngine::Entity m_entity;  // Created instance, invalid if the prefab could not be loaded
+        btEngine::UUID m_uuid;      // UUID of the created instance
+    };
+
+    /**
+     * @brief Command for editing a component property, resolving prefab instances through PrefabFlyweight
+     *
+     * This Command handles:
+     * 1. Reading the old value from the instance or from the shared prefab data
+     * 2. Materializing a lightweight instance on its first write
+     * 3. Recording the override, and dropping it again on undo if this edit added it
+    */
+    class ChangeComponentPropertyCommand : public Command
+    {
+    public:
+        /**
+         * @brief Constructs a change component property Command
+         * @param entity Entity to edit
+         * @param typeName Registered component name
+         * @param propName Property name
+         * @param newValue Value to write
+        */
+        ChangeComponentPropertyCommand(btEngine::Entity entity, std::string typeName, std::string propName, rttr::variant newValue);
+
+        void execute() override;
+        void undo() override;
+        void redo() override;
+
+        bool succeeded() const { return m_written; }
+
+    private:
+        btEngine::Entity m_entity;
+        std::string m_typeName;
+        std::string m_propName;
+        rttr::variant m_oldValue;
+        rttr::variant m_newValue;
+        bool m_addedOverride = false;   // The override did not exist before this edit
+        bool m_written = false;
+    };
+
+    /**
+     * @brief Collects what a prefab propagation changed, in packed arrays instead of one command per property
+     *
+     * This class handles:
+     * 1. Recording only the properties whose value actually changed, with the old and new value
+     * 2. Recording the components added and removed, keeping a copy of the removed ones
+     * 3. Sharing instance UUIDs, component names and properties through small lookup tables
+     * 4. Giving up once the recording grows past MaxRecordedChanges, so memory stays bounded
+     * 5. Keeping the shared data lightweight instances were pointed away from, so undo can point them back
+     *
+     * An overflowed recorder drops everything it holds, a propagation is undoable in full or not at all.
+    */
+    class PropagationRecorder
+    {
+    public:
+        static constexpr size_t MaxRecordedChanges = 1u << 20;
+
+        /**
+         * @brief Records a property that propagation changed on an instance
+         * @param instanceUUID UUID of the prefab instance
+         * @param typeName Registered component name
+         * @param prop Property that changed
+         * @param oldValue Value before propagation
+         * @param newValue Value written by propagation
+        */
+        void recordProperty(uint64_t instanceUUID, const std::string& typeName, const rttr::property& prop,
+            rttr::variant oldValue, rttr::variant newValue);
+        void recordComponentAdded(uint64_t instanceUUID, const std::string& typeName);
+        /**
+         * @brief Records a component propagation is about to remove, copying its values for undo
+         * @param entity Prefab instance
+         * @param componentType Type of the component being removed
+        */
+        void recordComponentRemoved(btEngine::Entity& entity, const rttr::type& componentType);
+        /**
+         * @brief Records the lightweight instances of a prefab being pointed at new shared data
+         * @param previous Shared data the instances held before
+         * @param current Shared data the instances hold now
+        */
+        void recordSharedData(std::shared_ptr<const TeaAsset::SharedPrefabData> previous,
+            std::shared_ptr<const TeaAsset::SharedPrefabData> current);
+
+        bool empty() const { return m_propertyChanges.empty() && m_structuralChanges.empty() && m_sharedDataChanges.empty(); }
+        bool hasOverflowed() const { return m_overflowed; }
+        size_t getInstanceCount() const { return m_instanceUUIDs.size(); }
+        size_t getChangeCount() const { return m_propertyChanges.size() + m_structuralChanges.size(); }
+
+    private:
+        friend class PrefabPropagationCommand;
+
+        struct PropertyChange
+        {
+            uint32_t instance;      // Index into m_instanceUUIDs
+            uint32_t property;      // Index into m_properties
+            rttr::variant oldValue;
+            rttr::variant newValue;
+        };
+
+        struct StructuralChange
+        {
+            uint32_t instance;
+            uint32_t component;     // Index into m_componentNames
+            bool added;             // Added by propagation, otherwise removed
+            rttr::variant snapshot; // Copy of a removed component
+        };
+
+        struct SharedDataChange
+        {
+            std::shared_ptr<const TeaAsset::SharedPrefabData> previous;
+            std::shared_ptr<const TeaAsset::SharedPrefabData> current;
+        };
+
+        struct PropertySlot
+        {
+            uint32_t component;
+            rttr::property prop;
+        };
+
+        bool canRecord();
+        uint32_t instanceIndex(uint64_t instanceUUID);
+        uint32_t componentIndex(const std::string& typeName);
+        uint32_t propertyIndex(uint32_t component, const rttr::property& prop);
+
+        std::vector<uint64_t>                       m_instanceUUIDs;
+        std::vector<std::string>                    m_componentNames;
+        std::vector<PropertySlot>                   m_properties;
+        std::vector<PropertyChange>                 m_propertyChanges;
+        std::vector<StructuralChange>               m_structuralChanges;
+        std::vector<SharedDataChange>               m_sharedDataChanges;
+        std::unordered_map<uint64_t, uint32_t>      m_instanceLookup;
+        std::unordered_map<std::string, uint32_t>   m_componentLookup;
+        bool                                        m_overflowed = false;
+    };
+
+    /**
+     * @brief Single undo entry for a whole prefab apply / propagation
+     *
+     * This Command handles:
+     * 1. Looking up every recorded instance once per undo or redo
+     * 2. Restoring old property values and structure in bulk on undo
+     * 3. Reapplying structure and new property values in bulk on redo
+     *
+     * The first execute() does nothing. A propagation is pushed once it has finished, including one
+     * spread over several frames, so the recording is always complete. An overflowed recording is
+     * not undoable and the command never reaches the undo stack.
+    */
+    class PrefabPropagationCommand : public Command
+    {
+    public:
+        /**
+         * @brief Constructs a prefab propagation command
+         * @param mgr Pointer to the scene manager holding the instances
+         * @param description Name shown in logs, for example the prefab file name
+         * @param recorder Changes recorded while the propagation runs
+        */
+        PrefabPropagationCommand(SceneManager::sceneManager* mgr, std::string description, std::shared_ptr<PropagationRecorder> recorder);
+
+        void execute() override;
+        void undo() override;
+        void redo() override;
+        bool isUndoable() const override { return !m_recorder->hasOverflowed(); }
+
+    private:
+        void applyChanges(bool undoing);
+
+        SceneManager::sceneManager* m_sceneManager;
+        std::string m_description;
+        std::shared_ptr<PropagationRecorder> m_recorder;
+        bool m_applied = true;
+    };
 }
\ No newline at end of file
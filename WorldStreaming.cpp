@@ -0,0 +1,555 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      WorldStreaming.cpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- WorldStreamer manifest loading, wanted cell computation and budgeted load / unload
+- Scene partitioning into per cell scene chunks
+====================================================================================*/
+
+/*                                                                          includes
+====================================================================================*/
+#include "pch.hpp"
+#include "WorldStreaming.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+
+#include "../Asset/OfflinePrefabPropagation.hpp"
+#include "../Asset/SchemaMigration.hpp"
+#include "../Core/BlockCompression.hpp"
+
+/*                                                              function definitions
+====================================================================================*/
+namespace SceneManager
+{
+    namespace
+    {
+        constexpr const char* ManifestName = "world.json";
+
+        float distanceToSegment(const glm::vec2& point, const glm::vec2& start, const glm::vec2& end)
+        {
+            const glm::vec2 segment = end - start;
+            const float lengthSquared = glm::dot(segment, segment);
+            const float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(point - start, segment) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+            return glm::length(point - (start + segment * t));
+        }
+
+        // Transform position of a serialized entity, either { "x", "y", "z" } or [x, y, z]
+        bool readPosition(const rapidjson::Value& entity, float& x, float& z)
+        {
+            auto transform = entity.FindMember("Transform");
+            if (transform == entity.MemberEnd() || !transform->value.IsObject()) return false;
+
+            auto position = transform->value.FindMember("Position");
+            if (position == transform->value.MemberEnd()) return false;
+
+            const rapidjson::Value& value = position->value;
+            if (value.IsArray() && value.Size() >= 3 && value[0].IsNumber() && value[2].IsNumber())
+            {
+                x = value[0].GetFloat();
+                z = value[2].GetFloat();
+                return true;
+            }
+            if (value.IsObject() && value.HasMember("x") && value.HasMember("z") && value["x"].IsNumber() && value["z"].IsNumber())
+            {
+                x = value["x"].GetFloat();
+                z = value["z"].GetFloat();
+                return true;
+            }
+            return false;
+        }
+
+        // Unsigned 64 bit member of a serialized component, e.g. the UUIDComponent uuid
+        bool readComponentUint64(const rapidjson::Value& entity, const char* componentName, const char* key, uint64_t& value)
+        {
+            auto component = entity.FindMember(componentName);
+            if (component == entity.MemberEnd() || !component->value.IsObject()) return false;
+
+            auto member = component->value.FindMember(key);
+            if (member == component->value.MemberEnd() || !member->value.IsUint64()) return false;
+
+            value = member->value.GetUint64();
+            return true;
+        }
+
+        /**
+         * @brief Index of the hierarchy root of every serialized entity
+         *
+         * Parents are found by UUID, an entity whose parent is not in the scene, or whose parent
+         * chain loops, is its own root.
+        */
+        std::vector<uint32_t> findRoots(const rapidjson::Value& entities)
+        {
+            using Schema = TeaAsset::SceneFileSchema;
+            const uint32_t count = entities.Size();
+
+            std::unordered_map<uint64_t, uint32_t> indexByUUID;
+            indexByUUID.reserve(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint64_t uuid = 0;
+                if (entities[i].IsObject() && readComponentUint64(entities[i], Schema::UUIDComponent, Schema::UUIDKey, uuid))
+                {
+                    indexByUUID.emplace(uuid, i);
+                }
+            }
+
+            constexpr uint32_t NoParent = std::numeric_limits<uint32_t>::max();
+            std::vector<uint32_t> parents(count, NoParent);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint64_t parentUUID = 0;
+                if (!entities[i].IsObject() || !readComponentUint64(entities[i], Schema::ParentComponent, Schema::ParentKey, parentUUID)) continue;
+
+                auto it = indexByUUID.find(parentUUID);
+                if (it != indexByUUID.end() && it->second != i)
+                {
+                    parents[i] = it->second;
+                }
+            }
+
+            // Walks up once per entity, roots found on the way are reused by the entities below them
+            std::vector<uint32_t> roots(count, NoParent);
+            std::vector<uint32_t> chain;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                chain.clear();
+                uint32_t current = i;
+                while (roots[current] == NoParent && parents[current] != NoParent && chain.size() < count)
+                {
+                    chain.push_back(current);
+                    current = parents[current];
+                }
+
+                uint32_t root = current;
+                if (roots[current] != NoParent)         root = roots[current];
+                else if (parents[current] != NoParent)  root = i;       // The chain loops
+
+                roots[current] = root;
+                for (uint32_t entity : chain)
+                {
+                    roots[entity] = root;
+                }
+            }
+            return roots;
+        }
+    }
+
+    WorldStreamer::~WorldStreamer()
+    {
+        // Scenes may already be gone at this point, so only stop the queued work
+        for (auto& runtime : m_cells)
+        {
+            if (runtime.taskId != 0)
+            {
+                m_taskQueue.cancel(runtime.taskId);
+            }
+        }
+    }
+
+    uint64_t WorldStreamer::makeKey(int32_t x, int32_t z)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+
+    bool WorldStreamer::loadWorld(const std::string& manifestPath)
+    {
+        std::ifstream file(manifestPath, std::ios::binary);
+        if (!file.is_open())
+        {
+            TEA_ERROR("Failed to open world manifest: {0}", manifestPath);
+            return false;
+        }
+
+        rapidjson::IStreamWrapper stream(file);
+        rapidjson::Document document;
+        document.ParseStream(stream);
+        if (document.HasParseError() || !document.IsObject() || !document.HasMember("Cells") || !document["Cells"].IsArray())
+        {
+            TEA_ERROR("Failed to parse world manifest: {0}", manifestPath);
+            return false;
+        }
+
+        unloadWorld();
+
+        m_cellSize = document.HasMember("CellSize") && document["CellSize"].IsNumber() ? document["CellSize"].GetFloat() : 64.0f;
+        if (m_cellSize <= 0.0f) m_cellSize = 64.0f;
+
+        // Chunk paths are stored relative to the manifest
+        const std::filesystem::path directory = std::filesystem::path(manifestPath).parent_path();
+        for (const auto& value : document["Cells"].GetArray())
+        {
+            if (!value.IsObject() || !value.HasMember("X") || !value.HasMember("Z") || !value.HasMember("Scene")) continue;
+            if (!value["X"].IsInt() || !value["Z"].IsInt() || !value["Scene"].IsString()) continue;
+
+            CellRuntime runtime;
+            runtime.cell.x = value["X"].GetInt();
+            runtime.cell.z = value["Z"].GetInt();
+            runtime.cell.scenePath = (directory / value["Scene"].GetString()).string();
+            if (value.HasMember("Entities") && value["Entities"].IsUint()) runtime.cell.entityCount = value["Entities"].GetUint();
+
+            const uint64_t key = makeKey(runtime.cell.x, runtime.cell.z);
+            if (m_cellLookup.count(key)) continue;
+
+            m_cellLookup.emplace(key, static_cast<uint32_t>(m_cells.size()));
+            m_cells.push_back(std::move(runtime));
+        }
+
+        TEA_INFO("Loaded world manifest {0}: {1} cells of {2} units", manifestPath, m_cells.size(), m_cellSize);
+        return true;
+    }
+
+    void WorldStreamer::unloadWorld()
+    {
+        for (auto& runtime : m_cells)
+        {
+            if (runtime.taskId != 0)
+            {
+                m_taskQueue.cancel(runtime.taskId);
+                runtime.taskId = 0;
+            }
+
+            // Partially loaded cells are unloaded too, the backend removes whatever was created
+            if (runtime.state == CellState::Loading || runtime.state == CellState::Loaded)
+            {
+                unloadCell(runtime);
+            }
+        }
+
+        // Tasks of the old world check the generation and ignore the new cells
+        m_generation++;
+        m_cells.clear();
+        m_cellLookup.clear();
+        m_active.clear();
+        m_candidates.clear();
+        m_stats = StreamingStats{};
+    }
+
+    void WorldStreamer::markCells(const StreamingFocus& focus)
+    {
+        const glm::vec2 start(focus.position.x, focus.position.z);
+        glm::vec2 lookahead = glm::vec2(focus.velocity.x, focus.velocity.z) * m_settings.prefetchSeconds;
+        const float lookaheadLength = glm::length(lookahead);
+        if (lookaheadLength > m_settings.maxPrefetchDistance)
+        {
+            lookahead *= m_settings.maxPrefetchDistance / lookaheadLength;
+        }
+        const glm::vec2 end = start + lookahead;
+
+        // A cell counts as inside when its center is within the radius plus half its diagonal
+        const float halfDiagonal = m_cellSize * 0.70710678f;
+        const float reach = std::max(m_settings.loadRadius, m_settings.unloadRadius) + halfDiagonal;
+        const glm::vec2 low = glm::min(start, end) - reach;
+        const glm::vec2 high = glm::max(start, end) + reach;
+
+        const int32_t minX = static_cast<int32_t>(std::floor(low.x / m_cellSize));
+        const int32_t maxX = static_cast<int32_t>(std::floor(high.x / m_cellSize));
+        const int32_t minZ = static_cast<int32_t>(std::floor(low.y / m_cellSize));
+        const int32_t maxZ = static_cast<int32_t>(std::floor(high.y / m_cellSize));
+
+        auto visit = [&](uint32_t index)
+        {
+            CellRuntime& runtime = m_cells[index];
+            const glm::vec2 center((runtime.cell.x + 0.5f) * m_cellSize, (runtime.cell.z + 0.5f) * m_cellSize);
+            const float distance = std::max(0.0f, distanceToSegment(center, start, end) - halfDiagonal);
+            if (distance > m_settings.unloadRadius) return;
+
+            if (!runtime.keep)
+            {
+                runtime.keep = true;
+                runtime.priority = std::numeric_limits<float>::max();
+                m_candidates.push_back(index);
+            }
+
+            // Cells around the focus itself come before the ones only reached by the lookahead
+            runtime.priority = std::min(runtime.priority, glm::length(center - start));
+            runtime.wanted |= distance <= m_settings.loadRadius;
+        };
+
+        // Fast travel can span more grid squares than the world has cells
+        const uint64_t rangeCount = static_cast<uint64_t>(maxX - minX + 1) * static_cast<uint64_t>(maxZ - minZ + 1);
+        if (rangeCount > m_cells.size())
+        {
+            for (uint32_t index = 0; index < m_cells.size(); index++)
+            {
+                const StreamingCell& cell = m_cells[index].cell;
+                if (cell.x >= minX && cell.x <= maxX && cell.z >= minZ && cell.z <= maxZ) visit(index);
+            }
+            return;
+        }
+
+        for (int32_t z = minZ; z <= maxZ; z++)
+        {
+            for (int32_t x = minX; x <= maxX; x++)
+            {
+                auto it = m_cellLookup.find(makeKey(x, z));
+                if (it != m_cellLookup.end()) visit(it->second);
+            }
+        }
+    }
+
+    void WorldStreamer::startLoad(CellRuntime& runtime)
+    {
+        const uint32_t index = static_cast<uint32_t>(&runtime - m_cells.data());
+        const uint64_t generation = m_generation;
+
+        btEngine::TaskStep step = m_backend.createLoadStep(runtime.cell);
+        auto wrapped = [this, index, generation, step = std::move(step)](btEngine::TaskProgress& progress) mutable
+        {
+            if (generation != m_generation) return true;
+
+            m_cells[index].state = CellState::Loading;
+            return step(progress);
+        };
+        auto onComplete = [this, index, generation]()
+        {
+            if (generation != m_generation) return;
+
+            m_cells[index].state = CellState::Loaded;
+            m_cells[index].taskId = 0;
+        };
+
+        runtime.state = CellState::Queued;
+        runtime.taskId = m_taskQueue.enqueue("Stream cell " + std::to_string(runtime.cell.x) + ", " + std::to_string(runtime.cell.z),
+            std::move(wrapped), std::move(onComplete));
+        m_active.push_back(index);
+        m_stats.loadsStarted++;
+    }
+
+    void WorldStreamer::unloadCell(CellRuntime& runtime)
+    {
+        if (m_backend.unload)
+        {
+            m_backend.unload(runtime.cell);
+        }
+        runtime.state = CellState::Unloaded;
+        runtime.taskId = 0;
+        m_stats.unloads++;
+    }
+
+    void WorldStreamer::update(const std::vector<StreamingFocus>& foci)
+    {
+        if (m_cells.empty() || !m_backend.createLoadStep) return;
+
+        for (uint32_t index : m_candidates)
+        {
+            m_cells[index].wanted = false;
+            m_cells[index].keep = false;
+        }
+        m_candidates.clear();
+
+        for (const auto& focus : foci)
+        {
+            markCells(focus);
+        }
+
+        // Drop queued loads that left the load area, unload far cells within the frame budget
+        uint32_t unloadsThisFrame = 0;
+        uint32_t loading = 0;
+        for (uint32_t index : m_active)
+        {
+            CellRuntime& runtime = m_cells[index];
+            switch (runtime.state)
+            {
+            case CellState::Queued:
+                if (!runtime.wanted)
+                {
+                    m_taskQueue.cancel(runtime.taskId);
+                    runtime.state = CellState::Unloaded;
+                    runtime.taskId = 0;
+                    m_stats.loadsCancelled++;
+                }
+                else
+                {
+                    loading++;
+                }
+                break;
+            case CellState::Loading:
+                // Finishes first, it is unloaded on a later frame if it is still out of range
+                loading++;
+                break;
+            case CellState::Loaded:
+                if (!runtime.keep && unloadsThisFrame < m_settings.maxUnloadsPerFrame)
+                {
+                    unloadCell(runtime);
+                    unloadsThisFrame++;
+                }
+                break;
+            case CellState::Unloaded:
+                break;
+            }
+        }
+        m_active.erase(std::remove_if(m_active.begin(), m_active.end(),
+            [this](uint32_t index) { return m_cells[index].state == CellState::Unloaded; }), m_active.end());
+
+        // Start the closest wanted cells while load slots are free
+        uint32_t wantedCount = 0;
+        m_pending.clear();
+        for (uint32_t index : m_candidates)
+        {
+            if (!m_cells[index].wanted) continue;
+
+            wantedCount++;
+            if (m_cells[index].state == CellState::Unloaded) m_pending.push_back(index);
+        }
+        std::sort(m_pending.begin(), m_pending.end(),
+            [this](uint32_t a, uint32_t b) { return m_cells[a].priority < m_cells[b].priority; });
+        for (uint32_t index : m_pending)
+        {
+            if (loading >= m_settings.maxConcurrentLoads) break;
+
+            startLoad(m_cells[index]);
+            loading++;
+        }
+
+        m_stats.wantedCells = wantedCount;
+        m_stats.loadingCells = loading;
+        m_stats.loadedCells = static_cast<uint32_t>(std::count_if(m_active.begin(), m_active.end(),
+            [this](uint32_t index) { return m_cells[index].state == CellState::Loaded; }));
+    }
+
+    CellState WorldStreamer::getCellState(int32_t x, int32_t z) const
+    {
+        auto it = m_cellLookup.find(makeKey(x, z));
+        return it != m_cellLookup.end() ? m_cells[it->second].state : CellState::Unloaded;
+    }
+
+    std::string WorldStreamer::partitionScene(const std::string& scenePath, const std::string& outputDirectory, float cellSize)
+    {
+        if (cellSize <= 0.0f)
+        {
+            TEA_ERROR("Invalid cell size {0} for partitioning {1}", cellSize, scenePath);
+            return {};
+        }
+
+        std::string contents;
+        if (!btEngine::BlockCompression::readFile(scenePath, contents))
+        {
+            TEA_ERROR("Failed to open scene for partitioning: {0}", scenePath);
+            return {};
+        }
+
+        rapidjson::Document document;
+        document.Parse(contents.c_str(), contents.size());
+        const char* entitiesKey = TeaAsset::SceneFileSchema::EntitiesKey;
+        if (document.HasParseError() || !document.IsObject() || !document.HasMember(entitiesKey) || !document[entitiesKey].IsArray())
+        {
+            TEA_ERROR("Failed to parse scene for partitioning: {0}", scenePath);
+            return {};
+        }
+        if (!TeaAsset::SchemaMigration::checkOnLoad(document, scenePath))
+        {
+            return {};
+        }
+
+        // A hierarchy stays in one chunk, placed by its root. The root has no parent, so its
+        // Transform position is already its world position. Ordered so chunks and manifest
+        // entries come out the same on every run
+        const rapidjson::Value& entities = document[entitiesKey];
+        const std::vector<uint32_t> roots = findRoots(entities);
+        std::map<std::pair<int32_t, int32_t>, std::vector<const rapidjson::Value*>> cells;
+        for (uint32_t i = 0; i < entities.Size(); i++)
+        {
+            float x = 0.0f;
+            float z = 0.0f;
+            if (entities[roots[i]].IsObject())
+            {
+                readPosition(entities[roots[i]], x, z);
+            }
+            const int32_t cellX = static_cast<int32_t>(std::floor(x / cellSize));
+            const int32_t cellZ = static_cast<int32_t>(std::floor(z / cellSize));
+            cells[{ cellX, cellZ }].push_back(&entities[i]);
+        }
+
+        std::error_code fsError;
+        std::filesystem::create_directories(outputDirectory, fsError);
+        const std::string stem = std::filesystem::path(scenePath).stem().string();
+
+        struct ChunkEntry
+        {
+            int32_t x, z;
+            std::string fileName;
+            uint32_t entityCount;
+        };
+        std::vector<ChunkEntry> chunks;
+
+        for (const auto& [coordinates, chunkEntities] : cells)
+        {
+            const std::string fileName = stem + "_" + std::to_string(coordinates.first) + "_" + std::to_string(coordinates.second)
+                + TeaAsset::SceneFileSchema::SceneExtension;
+            std::ofstream output(std::filesystem::path(outputDirectory) / fileName, std::ios::binary | std::ios::trunc);
+            if (!output.is_open())
+            {
+                TEA_ERROR("Failed to write scene chunk: {0}", fileName);
+                return {};
+            }
+
+            rapidjson::OStreamWrapper osw(output);
+            rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
+            writer.StartObject();
+
+            // Scene wide data (settings, environment, ...) is copied into every chunk
+            for (const auto& member : document.GetObject())
+            {
+                const char* key = member.name.GetString();
+                if (std::strcmp(key, entitiesKey) == 0 || std::strcmp(key, TeaAsset::SceneFileSchema::SchemaVersionsKey) == 0) continue;
+
+                writer.Key(key, member.name.GetStringLength());
+                member.value.Accept(writer);
+            }
+
+            writer.Key(entitiesKey);
+            writer.StartArray();
+            for (const rapidjson::Value* entity : chunkEntities)
+            {
+                entity->Accept(writer);
+            }
+            writer.EndArray();
+            TeaAsset::SchemaMigration::writeVersions(writer);
+            writer.EndObject();
+
+            chunks.push_back({ coordinates.first, coordinates.second, fileName, static_cast<uint32_t>(chunkEntities.size()) });
+        }
+
+        const std::string manifestPath = (std::filesystem::path(outputDirectory) / ManifestName).string();
+        std::ofstream manifest(manifestPath, std::ios::binary | std::ios::trunc);
+        if (!manifest.is_open())
+        {
+            TEA_ERROR("Failed to write world manifest: {0}", manifestPath);
+            return {};
+        }
+
+        rapidjson::OStreamWrapper osw(manifest);
+        rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
+        writer.StartObject();
+        writer.Key("CellSize");     writer.Double(cellSize);
+        writer.Key("Cells");
+        writer.StartArray();
+        for (const auto& chunk : chunks)
+        {
+            writer.StartObject();
+            writer.Key("X");            writer.Int(chunk.x);
+            writer.Key("Z");            writer.Int(chunk.z);
+            writer.Key("Scene");        writer.String(chunk.fileName.c_str());
+            writer.Key("Entities");     writer.Uint(chunk.entityCount);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+
+        TEA_INFO("Partitioned {0} into {1} cells of {2} units", scenePath, chunks.size(), cellSize);
+        return manifestPath;
+    }
+}
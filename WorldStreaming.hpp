@@ -0,0 +1,180 @@
+/*====================================================================================
+All content (c) 2024 Digipen Institute of Technology Singapore. All rights reserved.
+@file      WorldStreaming.hpp
+@project   TeaEngine
+@author(s) Bjorn Pokin Chinnaphongse <bjornpokin.c@digipen.edu> (primary: 100%)
+
+Contents:
+- StreamingCell and world manifest describing a world split into scene chunks
+- WorldStreamer class loading and unloading cells around moving focus points
+- Scene partitioning into per cell scene chunks
+====================================================================================*/
+#pragma once
+
+/*                                                                          includes
+====================================================================================*/
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../Core/TaskQueue.hpp"
+
+/*                                                             function declarations
+====================================================================================*/
+namespace SceneManager
+{
+    enum class CellState : uint8_t
+    {
+        Unloaded,
+        Queued,         // Load task queued, no step has run yet
+        Loading,
+        Loaded
+    };
+
+    /**
+     * @brief One square of the world grid (XZ plane), stored as its own scene file
+    */
+    struct StreamingCell
+    {
+        int32_t x = 0;
+        int32_t z = 0;
+        std::string scenePath;
+        uint32_t entityCount = 0;       // Written by the partitioner, informational
+    };
+
+    /**
+     * @brief Something the world has to be loaded around, usually a camera or a player
+    */
+    struct StreamingFocus
+    {
+        glm::vec3 position{ 0.0f };
+        glm::vec3 velocity{ 0.0f };     // World units per second
+    };
+
+    struct StreamingSettings
+    {
+        float loadRadius = 96.0f;               // Cells closer than this to a focus are loaded
+        float unloadRadius = 160.0f;            // Loaded cells further than this from every focus are unloaded
+        float prefetchSeconds = 2.0f;           // How far ahead along the velocity the load area reaches
+        float maxPrefetchDistance = 256.0f;     // Cap on the lookahead, for teleports and fast travel
+        uint32_t maxConcurrentLoads = 2;        // Cells loading at the same time, the task queue budgets their steps
+        uint32_t maxUnloadsPerFrame = 1;
+    };
+
+    struct StreamingStats
+    {
+        uint32_t loadedCells = 0;
+        uint32_t loadingCells = 0;      // Queued or loading
+        uint32_t wantedCells = 0;       // Inside the load area last update
+        uint32_t loadsStarted = 0;      // Since the world was loaded
+        uint32_t unloads = 0;
+        uint32_t loadsCancelled = 0;
+    };
+
+    /**
+     * @brief Scene manager side of streaming, loads and unloads the scene chunk of a cell
+    */
+    struct StreamingBackend
+    {
+        // Creates the resumable step loading a cell, run on the main loop task queue
+        std::function<btEngine::TaskStep(const StreamingCell& cell)> createLoadStep;
+
+        // Removes every entity of a loaded cell
+        std::function<void(const StreamingCell& cell)> unload;
+    };
+
+    /**
+     * @brief Streams the cells of a partitioned world in and out around focus points
+     *
+     * This class handles:
+     * 1. Loading the world manifest listing every cell and its scene chunk
+     * 2. Computing the wanted cells each frame: everything within the load radius of the
+     *    segment from each focus to where its velocity takes it in prefetchSeconds
+     * 3. Queueing the closest wanted cells as budgeted tasks, a few at a time, and cancelling
+     *    queued loads that are no longer wanted
+     * 4. Unloading far away cells a few per frame, with the unload radius larger than the
+     *    load radius so cells on the border do not thrash
+     * 5. Splitting a scene into cell scene chunks and writing the manifest
+    */
+    class WorldStreamer
+    {
+    public:
+        explicit WorldStreamer(btEngine::MainLoopTaskQueue& taskQueue) : m_taskQueue(taskQueue) {}
+        ~WorldStreamer();
+
+        WorldStreamer(const WorldStreamer&) = delete;
+        WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+        /**
+         * @brief Loads a world manifest, unloading the current world first
+         * @param manifestPath Manifest written by partitionScene
+         * @return False if the manifest could not be read
+        */
+        bool loadWorld(const std::string& manifestPath);
+
+        /**
+         * @brief Unloads every cell and forgets the world
+        */
+        void unloadWorld();
+
+        void setBackend(StreamingBackend backend) { m_backend = std::move(backend); }
+        void setSettings(const StreamingSettings& settings) { m_settings = settings; }
+        const StreamingSettings& getSettings() const { return m_settings; }
+
+        /**
+         * @brief Updates the wanted cells and starts or stops loads, call once per frame
+         * @param foci Current focus points
+        */
+        void update(const std::vector<StreamingFocus>& foci);
+
+        CellState getCellState(int32_t x, int32_t z) const;
+        float getCellSize() const { return m_cellSize; }
+        const StreamingStats& getStats() const { return m_stats; }
+
+        /**
+         * @brief Splits a scene file into one scene file per cell plus a manifest
+         *
+         * Each hierarchy goes whole to the cell containing its root's Transform position, roots
+         * without a position go to the cell at the origin. Every other top level member of the
+         * scene is copied into each chunk.
+         *
+         * @param scenePath Scene to split
+         * @param outputDirectory Directory receiving the chunks and world.json
+         * @param cellSize Width of a cell in world units
+         * @return Path of the manifest, empty on failure
+        */
+        static std::string partitionScene(const std::string& scenePath, const std::string& outputDirectory, float cellSize);
+
+    private:
+        struct CellRuntime
+        {
+            StreamingCell cell;
+            CellState state = CellState::Unloaded;
+            uint64_t taskId = 0;
+            float priority = 0.0f;      // Distance to the closest focus, smaller loads first
+            bool wanted = false;
+            bool keep = false;          // Inside the unload radius
+        };
+
+        static uint64_t makeKey(int32_t x, int32_t z);
+        void markCells(const StreamingFocus& focus);
+        void startLoad(CellRuntime& runtime);
+        void unloadCell(CellRuntime& runtime);
+
+        btEngine::MainLoopTaskQueue&                m_taskQueue;
+        StreamingBackend                            m_backend;
+        StreamingSettings                           m_settings;
+        StreamingStats                              m_stats;
+        float                                       m_cellSize = 64.0f;
+        std::vector<CellRuntime>                    m_cells;
+        std::unordered_map<uint64_t, uint32_t>      m_cellLookup;       // Packed coordinates -> index in m_cells
+        std::vector<uint32_t>                       m_active;           // Cells not unloaded
+        std::vector<uint32_t>                       m_candidates;       // Cells inside the unload radius last update
+        std::vector<uint32_t>                       m_pending;          // Scratch, wanted cells not loaded yet
+        uint64_t                                    m_generation = 0;   // Bumped per world so stale tasks do nothing
+    };
+}